@@ -3,9 +3,10 @@ import sys
 import os
 import glob
 import stat
+import subprocess
 
 minEvent = 0
-maxEvent = 16755464 # default number
+maxEvent = -1 # must be given (or use --plan)
 jobName = ""
 outputName = ""
 directory = ""
@@ -35,11 +36,28 @@ def query_yes_no(question, default="yes"):
 		else:
 			sys.stdout.write("Please respond with 'yes' or 'no' (or 'y' or 'n').\n")
 
+def read_plan(filename):
+	# reads the chunks written by planner.out, i.e. the lines "<begin> <end> <cost>"
+	ranges = []
+	for line in open(filename):
+		fields = line.split('#')[0].split()
+		if len(fields) < 2: continue
+		ranges.append([int(fields[0]), int(fields[1])])
+	if len(ranges) == 0:
+		sys.exit('No chunks found in ' + filename)
+	return ranges
+
+def count_events(args):
+	# the number of entries printed by nevents.out, which takes it from the metadata cache if the file hasn't changed
+	nevents = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'bin', 'nevents.out')
+	return int(subprocess.check_output([nevents] + args).strip())
+
 if __name__ == '__main__':
 	parser = argparse.ArgumentParser(description='Generates N jobs as *.sh files.')
 	parser.add_argument('-j', action='store', dest='jobs', help='number of jobs to be generated')
+	parser.add_argument('--plan', action='store', dest='plan', help='chunk definitions written by planner.out (replaces -j, --min-event and --max-event)')
 	parser.add_argument('--min-event', action='store', dest='min_event', help='min event (default 0)')
-	parser.add_argument('--max-event', action='store', dest='max_event', help='max event (must be given)')
+	parser.add_argument('--max-event', action='store', dest='max_event', help='max event (default: the number of events of the input, see nevents.out)')
 	parser.add_argument('--job-name', action='store', dest='job_name', help='prefix of the job script *.sh name')
 	parser.add_argument('--output', action='store', dest='output', help='prefix of the *.root output file name')
 	parser.add_argument('--dir', action='store', dest='dir', help='directory of the *.sh files')
@@ -54,7 +72,7 @@ if __name__ == '__main__':
 	results = parser.parse_args()
 	
 	j_parsed = results.jobs
-	if(j_parsed == None):
+	if(j_parsed == None and results.plan == None):
 		parser.error('You have to specify the number of jobs.')
 	if(results.config == None):
 		parser.error('You have to specify the config file.')
@@ -63,52 +81,60 @@ if __name__ == '__main__':
 	if(results.output == None):
 		parser.error('You have to specify the name of the root output files')
 	
-	Nmin = minEvent if results.min_event == None else int(results.min_event)
-	Nmax = maxEvent if results.max_event == None else int(results.max_event)
-	j = int(j_parsed)
-	
-	if(j < 2):
-		parser.error('Number of jobs must be greater than 1.')
-	if(j > Nmax - Nmin):
-		parser.error('Number of jobs cannot exceed the number of events.')
-	if(Nmax < 0 or Nmin < 0):
-		parser.error('Event number must be positive.')
-	if(Nmax < Nmin):
-		parser.error('Max cannot be smaller than min.')
-	
-	N = Nmax - Nmin
-	doDivide = (N % j == 0)
-	if(not doDivide): j = j - 1
-	incr = N / j
-	doAdd = False
-	if(not doDivide): doAdd = (Nmax - j*incr < incr / 2)
-	ranges = []
-	for i in range(0, j):
-		start = Nmin + i * incr
-		end = Nmin + (i + 1) * incr
-		if(i == j - 1 and doAdd):
-			ranges.append([start, Nmax])
-			break
-		ranges.append([start, end])
-	if(doAdd):
-		print "You had only ", Nmax - j * incr, " events for the last job,"
-		print "so they were added to the next-to-last job."
-	print "Start at: ", Nmin
-	print "End at: ", Nmax
-	print "Number of events per job: ", incr
-	if(not doDivide):
-		print "Number of events for the last job: ",
-		print (ranges[len(ranges) - 1][1] - ranges[len(ranges) - 1][0])
-	print "Total number of jobs: ", len(ranges)
-	if(j > 5):
-		print "%d) [%d,%d]" % (1,ranges[0][0],ranges[0][1])
-		print "%d) [%d,%d]" % (2,ranges[1][0],ranges[1][1])
-		print "\t..."
-		print "%d) [%d,%d]" % (len(ranges) - 1,ranges[len(ranges) - 2][0],ranges[len(ranges) - 2][1])
-		print "%d) [%d,%d]" % (len(ranges),ranges[len(ranges) - 1][0],ranges[len(ranges) - 1][1])
-	else:
+	if(results.plan != None):
+		ranges = read_plan(results.plan)
+		print "Read", len(ranges), "chunks from", results.plan
 		for i in range(len(ranges)):
 			print "%d) [%d,%d]" % (i + 1,ranges[i][0],ranges[i][1])
+	else:
+		Nmin = minEvent if results.min_event == None else int(results.min_event)
+		# the input given by --input replaces the one of the config file, as in the jobs
+		countArgs = ['-c', results.config, '-f', 'S'] + ([] if results.input == None else ['-i', results.input])
+		Nmax = count_events(countArgs) if results.max_event == None else int(results.max_event)
+		j = int(j_parsed)
+		
+		if(j < 2):
+			parser.error('Number of jobs must be greater than 1.')
+		if(j > Nmax - Nmin):
+			parser.error('Number of jobs cannot exceed the number of events.')
+		if(Nmax < 0 or Nmin < 0):
+			parser.error('Event number must be positive.')
+		if(Nmax < Nmin):
+			parser.error('Max cannot be smaller than min.')
+		
+		N = Nmax - Nmin
+		doDivide = (N % j == 0)
+		if(not doDivide): j = j - 1
+		incr = N / j
+		doAdd = False
+		if(not doDivide): doAdd = (Nmax - j*incr < incr / 2)
+		ranges = []
+		for i in range(0, j):
+			start = Nmin + i * incr
+			end = Nmin + (i + 1) * incr
+			if(i == j - 1 and doAdd):
+				ranges.append([start, Nmax])
+				break
+			ranges.append([start, end])
+		if(doAdd):
+			print "You had only ", Nmax - j * incr, " events for the last job,"
+			print "so they were added to the next-to-last job."
+		print "Start at: ", Nmin
+		print "End at: ", Nmax
+		print "Number of events per job: ", incr
+		if(not doDivide):
+			print "Number of events for the last job: ",
+			print (ranges[len(ranges) - 1][1] - ranges[len(ranges) - 1][0])
+		print "Total number of jobs: ", len(ranges)
+		if(j > 5):
+			print "%d) [%d,%d]" % (1,ranges[0][0],ranges[0][1])
+			print "%d) [%d,%d]" % (2,ranges[1][0],ranges[1][1])
+			print "\t..."
+			print "%d) [%d,%d]" % (len(ranges) - 1,ranges[len(ranges) - 2][0],ranges[len(ranges) - 2][1])
+			print "%d) [%d,%d]" % (len(ranges),ranges[len(ranges) - 1][0],ranges[len(ranges) - 1][1])
+		else:
+			for i in range(len(ranges)):
+				print "%d) [%d,%d]" % (i + 1,ranges[i][0],ranges[i][1])
 	doContinue = query_yes_no("Proceed?")
 	if not doContinue: sys.exit()
 	
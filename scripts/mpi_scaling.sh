@@ -0,0 +1,74 @@
+#!/bin/bash
+
+# A POSIX variable
+# Reset in case getopts has been used previously in the shell
+OPTIND=1
+
+# Initialize our variables:
+workers="1 2 4 8"
+mpiargs=
+binary=bin/mpidriver.out
+
+function usage {
+cat << EOF2
+Usage: $0 options -- <arguments of mpidriver.out>
+
+This script measures the strong scaling of mpidriver.out: the same events
+are processed with an increasing number of worker ranks (plus the rank 0
+that hands out the chunks) and the wall time, speedup and efficiency
+relative to the first run are printed.
+
+OPTIONS:
+   [-w "<int> ..."] Numbers of worker ranks (default "$workers")
+   [-m <string>]    Additional arguments of mpirun (e.g. "--oversubscribe")
+   [-x <path>]      Path to mpidriver.out (default $binary)
+
+EXAMPLE:
+   $0 -w "1 2 4" -- -i in.root -t tree -o out.root -T tree -- \\
+      bin/analyze.out -i in.root -t tree ... -b {begin} -e {end} -o {output}
+EOF2
+}
+
+while getopts ":w:m:x:" opt; do
+	case "$opt" in
+	w)  workers=$OPTARG
+		;;
+	m)  mpiargs=$OPTARG
+		;;
+	x)  binary=$OPTARG
+		;;
+	*)
+		usage
+		exit 0
+	esac
+done
+shift $((OPTIND - 1))
+
+if [[ $# -eq 0 ]]; then
+	usage
+	exit 1
+fi
+
+if [ ! -x $binary ]; then
+	echo "error: $binary does not exist (run make mpi)" 1>&2
+	exit 1
+fi
+
+echo -e "workers\twall [s]\tspeedup\tefficiency"
+reference_time=
+reference_workers=
+for n in $workers; do
+	wall=$(mpirun -np $((n + 1)) $mpiargs $binary -v "$@" | grep "Wall time" | awk '{print $3}')
+	if [[ -z $wall ]]; then
+		echo "error: the run with $n workers failed" 1>&2
+		exit 1
+	fi
+	if [[ -z $reference_time ]]; then
+		reference_time=$wall
+		reference_workers=$n
+	fi
+	awk -v n=$n -v t=$wall -v t0=$reference_time -v n0=$reference_workers \
+		'BEGIN { s = t0 / t; printf "%d\t%.2f\t\t%.2f\t%.2f\n", n, t, s, s * n0 / n }'
+done
+
+# EOF
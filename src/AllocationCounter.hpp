@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdlib> // std::malloc(), std::free()
+#include <new> // std::bad_alloc
+
+#include <TMath.h>
+
+/**
+ * @brief Counts the heap allocations of the calling thread, by replacing the global operator new.
+ *
+ * The difference of getNumberOfAllocations() around a piece of code is the number of allocations it made
+ * (including those of ROOT on the same thread). The replacement operators are defined here, not inline,
+ * hence this header is included by at most one source file of a program (a tool, like common.hpp).
+ *
+ * Only built with -DCOUNT_ALLOCATIONS (make COUNT_ALLOCATIONS=1), since every allocation of the program pays for it;
+ * otherwise nothing is replaced, enabled is false and the count stays 0.
+ */
+namespace AllocationCounter {
+#ifdef COUNT_ALLOCATIONS
+	const bool enabled = true;
+#else
+	const bool enabled = false;
+#endif
+	thread_local Long64_t nAllocations = 0;
+
+	Long64_t getNumberOfAllocations() {
+		return nAllocations;
+	}
+}
+
+#ifdef COUNT_ALLOCATIONS
+void * operator new(std::size_t size) {
+	++AllocationCounter::nAllocations;
+	if(void * p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void * operator new[](std::size_t size) {
+	return ::operator new(size);
+}
+
+void operator delete(void * p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void * p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept {
+	std::free(p);
+}
+#endif
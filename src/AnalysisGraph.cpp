@@ -0,0 +1,409 @@
+#include "AnalysisGraph.hpp"
+#include "EventReader.hpp"
+#include "SkimCache.hpp"
+#include "KahanSum.hpp"
+
+#include <iostream> // std::cout, std::endl
+#include <stdexcept> // std::runtime_error
+#include <memory> // std::unique_ptr<>
+#include <chrono> // std::chrono
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+#include <TDirectory.h>
+#include <TParameter.h>
+
+const std::size_t AnalysisGraph::none = std::size_t(-1);
+
+AnalysisGraph::Event::Event(AnalysisGraph * graph)
+	: graph(graph) { }
+
+Long64_t AnalysisGraph::Event::getEntry() const {
+	return graph -> entry;
+}
+
+Int_t AnalysisGraph::Event::getNumberOfJets() const {
+	return graph -> nhJets + graph -> naJets;
+}
+
+Int_t AnalysisGraph::Event::getNumberOfHJets() const {
+	return graph -> nhJets;
+}
+
+Float_t AnalysisGraph::Event::jet(std::size_t column, Int_t j) {
+	graph -> check(column, "jet column");
+	AnalysisGraph::Node & n = graph -> nodes[column];
+	if(n.kind == kJetBranch) return (j < graph -> nhJets) ? n.hJet[j] : n.aJet[j - graph -> nhJets];
+	if(n.kind != kJet) {
+		throw std::runtime_error(n.name + " is not a jet column");
+	}
+	if(n.stamp != graph -> entry) {
+		// the whole event at once; the stamp is set first, so that a column can't depend on itself
+		n.stamp = graph -> entry;
+		for(Int_t k = 0; k < getNumberOfJets(); ++k) n.jets[k] = n.jetFunction(*this, k);
+	}
+	return n.jets[j];
+}
+
+Double_t AnalysisGraph::Event::value(std::size_t column) {
+	graph -> check(column, "event column");
+	AnalysisGraph::Node & n = graph -> nodes[column];
+	if(n.kind == kEventBranch) {
+		if(n.type == 'I') return *reinterpret_cast<const Int_t *> (n.buffer);
+		return *reinterpret_cast<const Float_t *> (n.buffer);
+	}
+	if(n.kind == kFilter) return passes(column);
+	if(n.kind != kEvent) {
+		throw std::runtime_error(n.name + " is not an event column");
+	}
+	if(n.stamp != graph -> entry) {
+		n.stamp = graph -> entry;
+		n.value = n.eventFunction(*this);
+	}
+	return n.value;
+}
+
+bool AnalysisGraph::Event::passes(std::size_t filter) {
+	if(filter == none) return true;
+	AnalysisGraph::Node & n = graph -> nodes[filter];
+	if(n.kind != kFilter) {
+		throw std::runtime_error(n.name + " is not a filter");
+	}
+	if(n.stamp != graph -> entry) {
+		n.stamp = graph -> entry;
+		n.value = passes(n.inputs[1]) && value(n.inputs[0]) != 0;
+	}
+	return n.value != 0;
+}
+
+AnalysisGraph::AnalysisGraph(std::string filename, std::string treeName, Long64_t beginEvent, Long64_t endEvent, Int_t readAhead,
+							 const SkimCache * skim)
+	: filename(filename), treeName(treeName), beginEvent(beginEvent), endEvent(endEvent), readAhead(readAhead), skim(skim),
+	  event(this), entry(-1), nhJets(0), naJets(0) { }
+
+AnalysisGraph::~AnalysisGraph() {
+	for(auto & s: sinks) delete s.sum;
+}
+
+std::size_t AnalysisGraph::add(const Node & node) {
+	std::size_t index = find(node.name);
+	if(index != none) {
+		if(nodes[index].kind != node.kind) {
+			throw std::runtime_error(node.name + " is declared twice as different kinds of nodes");
+		}
+		return index;
+	}
+	for(auto input: node.inputs) {
+		if(input != none && input >= nodes.size()) {
+			throw std::runtime_error("unknown input of " + node.name);
+		}
+	}
+	nodes.push_back(node);
+	nodes.back().stamp = -1;
+	nodes.back().used = false;
+	return nodes.size() - 1;
+}
+
+std::size_t AnalysisGraph::jetBranch(std::string suffix) {
+	Node n;
+	n.name = suffix;
+	n.kind = kJetBranch;
+	return add(n);
+}
+
+std::size_t AnalysisGraph::eventBranch(std::string name, char type) {
+	if(type != 'I' && type != 'F') {
+		throw std::runtime_error("branch " + name + " must be Int_t ('I') or Float_t ('F')");
+	}
+	Node n;
+	n.name = name;
+	n.kind = kEventBranch;
+	n.type = type;
+	return add(n);
+}
+
+std::size_t AnalysisGraph::defineJet(std::string name, const std::vector<std::size_t> & inputs, JetFunction f) {
+	Node n;
+	n.name = name;
+	n.kind = kJet;
+	n.inputs = inputs;
+	n.jetFunction = f;
+	return add(n);
+}
+
+std::size_t AnalysisGraph::defineEvent(std::string name, const std::vector<std::size_t> & inputs, EventFunction f) {
+	Node n;
+	n.name = name;
+	n.kind = kEvent;
+	n.inputs = inputs;
+	n.eventFunction = f;
+	return add(n);
+}
+
+std::size_t AnalysisGraph::filter(std::string name, std::size_t column, std::size_t parent) {
+	Node n;
+	n.name = name;
+	n.kind = kFilter;
+	n.inputs.push_back(column);
+	n.inputs.push_back(parent);
+	return add(n);
+}
+
+std::size_t AnalysisGraph::find(std::string name) const {
+	for(std::size_t i = 0; i < nodes.size(); ++i) {
+		if(nodes[i].name == name) return i;
+	}
+	return none;
+}
+
+void AnalysisGraph::histogram(std::string name, std::string title, std::size_t x, Int_t nBins, Double_t xMin, Double_t xMax,
+							  std::size_t weight, std::size_t filter) {
+	Sink s;
+	s.kind = kHistogram;
+	s.names.push_back(name);
+	s.title = title;
+	s.columns.push_back(x);
+	s.columns.push_back(weight);
+	s.filter = filter;
+	s.nBins = nBins;
+	s.xMin = xMin;
+	s.xMax = xMax;
+	s.sum = 0;
+	s.tree = 0;
+	sinks.push_back(s);
+}
+
+void AnalysisGraph::histograms(const std::vector<std::string> & names, std::size_t index, std::size_t x, Int_t nBins, Double_t xMin, Double_t xMax,
+							   std::size_t filter) {
+	Sink s;
+	s.kind = kHistograms;
+	s.names = names;
+	s.columns.push_back(index);
+	s.columns.push_back(x);
+	s.filter = filter;
+	s.nBins = nBins;
+	s.xMin = xMin;
+	s.xMax = xMax;
+	s.sum = 0;
+	s.tree = 0;
+	sinks.push_back(s);
+}
+
+void AnalysisGraph::sum(std::string name, std::size_t column, std::size_t filter) {
+	Sink s;
+	s.kind = kSum;
+	s.names.push_back(name);
+	s.columns.push_back(column);
+	s.filter = filter;
+	s.sum = new KahanSum();
+	s.nPassed = 0;
+	s.tree = 0;
+	sinks.push_back(s);
+}
+
+void AnalysisGraph::tree(std::string name, const std::vector<std::size_t> & columns, std::size_t filter) {
+	Sink s;
+	s.kind = kTree;
+	s.names.push_back(name);
+	s.columns = columns;
+	s.filter = filter;
+	s.sum = 0;
+	s.tree = 0;
+	sinks.push_back(s);
+}
+
+const AnalysisGraph::Node & AnalysisGraph::getNode(std::size_t index) const {
+	if(index >= nodes.size()) {
+		throw std::runtime_error("unknown node " + std::to_string(index));
+	}
+	return nodes[index];
+}
+
+void AnalysisGraph::use(std::size_t index) {
+	if(index == none) return;
+	getNode(index); // checks the index
+	Node & n = nodes[index];
+	if(n.used) return;
+	n.used = true;
+	for(auto input: n.inputs) use(input);
+}
+
+void AnalysisGraph::check(std::size_t index, std::string what) const {
+	const Node & n = getNode(index);
+	if(! n.used) {
+		throw std::runtime_error("the " + what + " " + n.name + " is used, but it isn't an input of the node using it");
+	}
+}
+
+void AnalysisGraph::fill(Sink & s) {
+	if(! event.passes(s.filter)) return;
+	switch(s.kind) {
+		case kHistogram: {
+			bool perJet = nodes[s.columns[0]].kind == kJetBranch || nodes[s.columns[0]].kind == kJet;
+			if(! perJet) {
+				s.histograms[0] -> Fill(event.value(s.columns[0]), (s.columns[1] == none) ? 1.0 : event.value(s.columns[1]));
+				break;
+			}
+			bool jetWeight = s.columns[1] != none && (nodes[s.columns[1]].kind == kJetBranch || nodes[s.columns[1]].kind == kJet);
+			Double_t w = (s.columns[1] == none) ? 1.0 : jetWeight ? 0 : event.value(s.columns[1]);
+			for(Int_t j = 0; j < event.getNumberOfJets(); ++j) {
+				s.histograms[0] -> Fill(event.jet(s.columns[0], j), jetWeight ? event.jet(s.columns[1], j) : w);
+			}
+			break;
+		}
+		case kHistograms:
+			for(Int_t j = 0; j < event.getNumberOfJets(); ++j) {
+				Int_t index = Int_t(event.jet(s.columns[0], j));
+				if(index < 0 || index >= Int_t(s.histograms.size())) continue;
+				s.histograms[index] -> Fill(event.jet(s.columns[1], j), 1); // for under/overflow
+			}
+			break;
+		case kSum: {
+			Kind kind = nodes[s.columns[0]].kind;
+			if(kind == kJetBranch || kind == kJet) {
+				for(Int_t j = 0; j < event.getNumberOfJets(); ++j) *(s.sum) += event.jet(s.columns[0], j);
+			}
+			else *(s.sum) += event.value(s.columns[0]);
+			++s.nPassed;
+			break;
+		}
+		case kTree: {
+			s.nJets = event.getNumberOfJets();
+			std::size_t v = 0, jc = 0;
+			for(auto c: s.columns) {
+				Kind kind = nodes[c].kind;
+				if(kind == kJetBranch || kind == kJet) {
+					for(Int_t j = 0; j < s.nJets; ++j) s.jets[jc][j] = event.jet(c, j);
+					++jc;
+				}
+				else s.values[v++] = event.value(c);
+			}
+			s.tree -> Fill();
+			break;
+		}
+	}
+}
+
+void AnalysisGraph::run(TDirectory * out, bool enableVerbose) {
+	// only the nodes the sinks need are evaluated, and only their branches are read
+	for(auto & s: sinks) {
+		for(auto c: s.columns) use(c);
+		use(s.filter);
+	}
+
+	std::unique_ptr<TFile> in;
+	TTree * t = 0; // not needed if the input is a skim
+	if(! skim && ! SkimCache::isSkim(filename)) {
+		in.reset(TFile::Open(filename.c_str(), "read"));
+		if(! in || in -> IsZombie() || ! in -> IsOpen()) {
+			throw std::runtime_error("error on opening " + filename);
+		}
+		t = dynamic_cast<TTree *> (in -> Get(treeName.c_str()));
+		if(! t) {
+			throw std::runtime_error("error on accessing tree " + treeName + " in " + filename);
+		}
+	}
+	EventReader reader(t, filename, beginEvent, endEvent, readAhead, skim);
+	endEvent = reader.getEndEvent();
+	reader.setBranchAddress("nhJets", &nhJets);
+	reader.setBranchAddress("naJets", &naJets);
+	Int_t nBranches = 2;
+	for(auto & n: nodes) {
+		if(! n.used) continue;
+		if(n.kind == kJetBranch) {
+			reader.setBranchAddress("hJet_" + n.name, n.hJet, sizeof(n.hJet));
+			reader.setBranchAddress("aJet_" + n.name, n.aJet, sizeof(n.aJet));
+			nBranches += 2;
+		}
+		else if(n.kind == kEventBranch) {
+			reader.setBranchAddress(n.name, n.buffer, n.type == 'I' ? sizeof(Int_t) : sizeof(Float_t));
+			++nBranches;
+		}
+	}
+
+	// the sinks are created in the output directory
+	out -> cd();
+	for(auto & s: sinks) {
+		if(s.kind == kHistogram || s.kind == kHistograms) {
+			for(std::size_t i = 0; i < s.names.size(); ++i) {
+				const char * title = (s.kind == kHistogram) ? s.title.c_str() : s.names[i].c_str();
+				TH1F * h = new TH1F(s.names[i].c_str(), title, s.nBins, s.xMin, s.xMax);
+				h -> SetDirectory(out);
+				h -> Sumw2();
+				s.histograms.push_back(h);
+			}
+		}
+		else if(s.kind == kTree) {
+			s.tree = new TTree(s.names[0].c_str(), s.names[0].c_str());
+			s.tree -> SetDirectory(out);
+			s.tree -> Branch("nJets", &s.nJets, "nJets/I");
+			std::size_t nValues = 0, nJetColumns = 0;
+			for(auto c: s.columns) {
+				if(nodes[c].kind == kJetBranch || nodes[c].kind == kJet) ++nJetColumns;
+				else ++nValues;
+			}
+			s.values.resize(nValues);
+			s.jets.resize(nJetColumns, std::vector<Float_t>(maxNumberOfHJets + maxNumberOfAJets));
+			std::size_t v = 0, jc = 0;
+			for(auto c: s.columns) {
+				const std::string & name = nodes[c].name;
+				if(nodes[c].kind == kJetBranch || nodes[c].kind == kJet) {
+					s.tree -> Branch(name.c_str(), &s.jets[jc++][0], (name + "[nJets]/F").c_str());
+				}
+				else s.tree -> Branch(name.c_str(), &s.values[v++], (name + "/D").c_str());
+			}
+		}
+	}
+
+	if(enableVerbose) {
+		std::cout << "Looping over " << (endEvent - beginEvent) << " events for " << sinks.size() << " sinks ("
+				  << nBranches << " branches) ..." << std::endl;
+	}
+	auto start = std::chrono::steady_clock::now();
+	while(reader.next()) {
+		entry = reader.getEntry();
+		for(auto & s: sinks) fill(s);
+	}
+	std::chrono::duration<Double_t> elapsed = std::chrono::steady_clock::now() - start;
+	if(enableVerbose) {
+		std::cout << (endEvent - beginEvent) << " events in " << elapsed.count() << " s" << std::endl;
+	}
+
+	out -> cd();
+	for(auto & s: sinks) {
+		if(s.kind == kHistogram || s.kind == kHistograms) {
+			for(auto h: s.histograms) h -> Write();
+		}
+		else if(s.kind == kTree) s.tree -> Write();
+		else if(s.kind == kSum) {
+			TParameter<Double_t> sum(s.names[0].c_str(), s.sum -> getValue());
+			TParameter<Long64_t> passed((s.names[0] + "_events").c_str(), s.nPassed);
+			sum.Write();
+			passed.Write();
+		}
+	}
+	if(in) in -> Close();
+}
+
+Double_t AnalysisGraph::getSum(std::string name) const {
+	for(auto & s: sinks) {
+		if(s.kind == kSum && s.names[0] == name) return s.sum -> getValue();
+	}
+	return 0;
+}
+
+Long64_t AnalysisGraph::getPassed(std::string name) const {
+	for(auto & s: sinks) {
+		if(s.kind == kSum && s.names[0] == name) return s.nPassed;
+	}
+	return 0;
+}
+
+Long64_t AnalysisGraph::getBeginEvent() const {
+	return beginEvent;
+}
+
+Long64_t AnalysisGraph::getEndEvent() const {
+	return endEvent;
+}
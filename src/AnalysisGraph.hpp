@@ -0,0 +1,125 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <functional> // std::function<>
+
+#include <TMath.h>
+
+class TDirectory;
+class TH1F;
+class TTree;
+class KahanSum;
+class SkimCache;
+
+/**
+ * @brief Columns, filters and sinks of several analyses, declared up front and filled in one loop over the events.
+ *
+ * Nodes are referred to by the index returned when they are declared:
+ *   jetBranch()   hJet_<suffix> and aJet_<suffix> (Float_t arrays); the jets of an event are the hJets followed by the aJets
+ *   eventBranch() a scalar branch (Int_t 'I' or Float_t 'F')
+ *   defineJet()   a Float_t value of every jet, computed from other nodes
+ *   defineEvent() a Double_t value of the event, computed from other nodes
+ *   filter()      the events where a column is not zero (and the parent filter passes)
+ * A node declared again under the same name is the same node, so that the presets of several tools share
+ * their common columns (bin ids, generated CSV values, ...); every derived value is computed at most once per event,
+ * when a sink or another node asks for it first.
+ *
+ * Sinks (histograms, sums and trees) name the nodes they need. Nothing is read before run(): it activates only
+ * the branches the sinks depend on, reads the events [begin, end) once with EventReader and writes the sinks.
+ * A derived node may only use the nodes it lists as inputs.
+ * Wrong declarations and unreadable inputs throw std::runtime_error, so that the daemon survives a bad job.
+ */
+class AnalysisGraph {
+public:
+	static const std::size_t none;
+
+	/** @brief The values of the current event, as seen by the functions of the derived nodes. */
+	class Event {
+	public:
+		Long64_t getEntry() const;
+		Int_t getNumberOfJets() const;
+		Int_t getNumberOfHJets() const;
+		Float_t jet(std::size_t column, Int_t j);
+		Double_t value(std::size_t column);
+		bool passes(std::size_t filter);
+	private:
+		friend class AnalysisGraph;
+		Event(AnalysisGraph * graph);
+		AnalysisGraph * graph;
+	};
+	typedef std::function<Float_t(Event &, Int_t)> JetFunction;
+	typedef std::function<Double_t(Event &)> EventFunction;
+
+	AnalysisGraph(std::string filename, std::string treeName, Long64_t beginEvent, Long64_t endEvent, Int_t readAhead,
+				  const SkimCache * skim = 0);
+	~AnalysisGraph();
+	std::size_t jetBranch(std::string suffix);
+	std::size_t eventBranch(std::string name, char type);
+	std::size_t defineJet(std::string name, const std::vector<std::size_t> & inputs, JetFunction f);
+	std::size_t defineEvent(std::string name, const std::vector<std::size_t> & inputs, EventFunction f);
+	std::size_t filter(std::string name, std::size_t column, std::size_t parent = none);
+	std::size_t find(std::string name) const;
+	void histogram(std::string name, std::string title, std::size_t x, Int_t nBins, Double_t xMin, Double_t xMax,
+				   std::size_t weight = none, std::size_t filter = none);
+	void histograms(const std::vector<std::string> & names, std::size_t index, std::size_t x, Int_t nBins, Double_t xMin, Double_t xMax,
+					std::size_t filter = none);
+	void sum(std::string name, std::size_t column, std::size_t filter = none);
+	void tree(std::string name, const std::vector<std::size_t> & columns, std::size_t filter = none);
+	void run(TDirectory * out, bool enableVerbose);
+	Double_t getSum(std::string name) const;
+	Long64_t getPassed(std::string name) const;
+	Long64_t getBeginEvent() const;
+	Long64_t getEndEvent() const;
+	static const Int_t maxNumberOfHJets = 2;
+	static const Int_t maxNumberOfAJets = 20;
+private:
+	enum Kind { kJetBranch, kEventBranch, kJet, kEvent, kFilter };
+	struct Node {
+		std::string name;
+		Kind kind;
+		std::vector<std::size_t> inputs; // for a filter: the column and the parent
+		JetFunction jetFunction;
+		EventFunction eventFunction;
+		char type; // kEventBranch
+		Float_t hJet[maxNumberOfHJets], aJet[maxNumberOfAJets]; // kJetBranch
+		char buffer[8]; // kEventBranch
+		Float_t jets[maxNumberOfHJets + maxNumberOfAJets]; // kJet
+		Double_t value; // kEvent, kFilter
+		Long64_t stamp; // the entry of the cached value
+		bool used;
+	};
+	enum SinkKind { kHistogram, kHistograms, kSum, kTree };
+	struct Sink {
+		SinkKind kind;
+		std::vector<std::string> names; // kHistograms: one per index, otherwise the name
+		std::string title;
+		std::vector<std::size_t> columns; // kHistogram: x, weight; kHistograms: index, x; kSum: column; kTree: the columns
+		std::size_t filter;
+		Int_t nBins;
+		Double_t xMin, xMax;
+		std::vector<TH1F *> histograms;
+		KahanSum * sum;
+		Long64_t nPassed;
+		TTree * tree;
+		Int_t nJets; // kTree
+		std::vector<Double_t> values; // kTree, the event columns
+		std::vector<std::vector<Float_t> > jets; // kTree, the jet columns
+	};
+	std::size_t add(const Node & node);
+	void use(std::size_t index);
+	void check(std::size_t index, std::string what) const;
+	void fill(Sink & sink);
+	const Node & getNode(std::size_t index) const;
+
+	std::string filename;
+	std::string treeName;
+	Long64_t beginEvent, endEvent;
+	Int_t readAhead;
+	const SkimCache * skim; // mapped by the caller, see EventReader
+	std::vector<Node> nodes;
+	std::vector<Sink> sinks;
+	Event event;
+	Long64_t entry;
+	Int_t nhJets, naJets;
+};
@@ -0,0 +1,56 @@
+#include "Arena.hpp"
+
+#include <algorithm> // std::max()
+
+Arena::Arena(std::size_t capacity)
+	: position(0), used(0) {
+	Block block = { std::unique_ptr<char[]>(new char[capacity]), capacity };
+	blocks.push_back(std::move(block));
+}
+
+void * Arena::allocate(std::size_t size, std::size_t alignment) {
+	Block & current = blocks.back();
+	std::size_t address = reinterpret_cast<std::size_t>(current.memory.get()) + position;
+	std::size_t padding = (alignment - address % alignment) % alignment;
+	if(position + padding + size <= current.size) {
+		void * p = current.memory.get() + position + padding;
+		position += padding + size;
+		used += padding + size;
+		return p;
+	}
+	// a new block, at least as large as the previous one (new[] returns memory aligned for any scalar type)
+	std::size_t capacity = std::max(2 * current.size, size);
+	Block block = { std::unique_ptr<char[]>(new char[capacity]), capacity };
+	blocks.push_back(std::move(block));
+	position = size;
+	used += size;
+	return blocks.back().memory.get();
+}
+
+void Arena::reset() {
+	if(blocks.size() > 1) {
+		// one block for everything the last event needed
+		std::size_t capacity = 0;
+		for(auto & block: blocks) capacity += block.size;
+		blocks.clear();
+		Block block = { std::unique_ptr<char[]>(new char[capacity]), capacity };
+		blocks.push_back(std::move(block));
+	}
+	position = 0;
+	used = 0;
+}
+
+std::size_t Arena::getUsed() const {
+	return used;
+}
+
+std::size_t Arena::getCapacity() const {
+	std::size_t capacity = 0;
+	for(auto & block: blocks) capacity += block.size;
+	return capacity;
+}
+
+Arena & Arena::local() {
+	thread_local Arena arena;
+	return arena;
+}
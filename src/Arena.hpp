@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef> // std::size_t
+#include <vector> // std::vector<>
+#include <memory> // std::unique_ptr<>
+
+/**
+ * @brief Monotonic memory of one thread for the scratch data of an event, released all at once by reset().
+ *
+ * allocate() only moves a pointer; the objects are never destroyed, hence only trivially destructible types belong here.
+ * If the current block is full, another one is taken from the heap; reset() then replaces the blocks by a single one
+ * as large as all of them, so that after the first (largest) events the arena doesn't allocate anymore.
+ * local() is the arena of the calling thread.
+ */
+class Arena {
+public:
+	Arena(std::size_t capacity = 64 * 1024);
+	void * allocate(std::size_t size, std::size_t alignment);
+	template<typename T>
+	T * allocate(std::size_t n) {
+		return static_cast<T *>(allocate(n * sizeof(T), alignof(T)));
+	}
+	void reset();
+	std::size_t getUsed() const;
+	std::size_t getCapacity() const;
+	static Arena & local();
+private:
+	struct Block {
+		std::unique_ptr<char[]> memory;
+		std::size_t size;
+	};
+	std::vector<Block> blocks; // the last one is the current block
+	std::size_t position; // in the current block
+	std::size_t used; // in all blocks
+};
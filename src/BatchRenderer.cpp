@@ -0,0 +1,185 @@
+#include "BatchRenderer.hpp"
+
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <fstream> // std::ifstream, std::ofstream
+#include <sstream> // std::stringstream
+#include <iomanip> // std::setw(), std::setfill()
+#include <map> // std::map<>
+#include <atomic> // std::atomic<>
+#include <chrono> // std::chrono
+#include <cstdio> // std::rename(), std::remove()
+#include <cstdlib> // EXIT_SUCCESS
+#include <algorithm> // std::min(), std::max()
+#include <new> // placement new
+
+#include <unistd.h> // fork(), _exit(), access()
+#include <sys/mman.h> // mmap(), munmap()
+#include <sys/wait.h> // waitpid()
+
+#include <TROOT.h>
+#include <TH1.h>
+#include <TAxis.h>
+
+namespace {
+	enum Status { kPending = 0, kDone = 1, kFailed = 2 };
+}
+
+BatchRenderer::Hash::Hash()
+	: value(14695981039346656037ULL) { }
+
+BatchRenderer::Hash & BatchRenderer::Hash::add(const void * data, std::size_t size) {
+	const unsigned char * bytes = static_cast<const unsigned char *>(data);
+	for(std::size_t i = 0; i < size; ++i) {
+		value ^= bytes[i];
+		value *= 1099511628211ULL;
+	}
+	return *this;
+}
+
+BatchRenderer::Hash & BatchRenderer::Hash::add(const std::string & s) {
+	add(s.data(), s.size());
+	return add("\0", 1); // "ab" + "c" differs from "a" + "bc"
+}
+
+BatchRenderer::Hash & BatchRenderer::Hash::add(Double_t x) {
+	return add(&x, sizeof(x));
+}
+
+BatchRenderer::Hash & BatchRenderer::Hash::add(const TH1 * h) {
+	add(std::string(h -> GetName()));
+	add(std::string(h -> GetTitle()));
+	Int_t nBins = h -> GetNbinsX();
+	add(&nBins, sizeof(nBins));
+	for(Int_t bin = 0; bin <= nBins + 1; ++bin) {
+		add(h -> GetXaxis() -> GetBinLowEdge(bin));
+		add(h -> GetBinContent(bin));
+		add(h -> GetBinError(bin));
+	}
+	return add(h -> GetEntries());
+}
+
+std::string BatchRenderer::Hash::toString() const {
+	std::stringstream ss;
+	ss << std::hex << std::setw(16) << std::setfill('0') << value;
+	return ss.str();
+}
+
+BatchRenderer::BatchRenderer(std::string cacheFile, Int_t nWorkers, bool force)
+	: cacheFile(cacheFile), nWorkers(nWorkers < 1 ? 1 : nWorkers), force(force),
+	  nRendered(0), nSkipped(0), nFailed(0), nStarted(0), wallTime(0) { }
+
+void BatchRenderer::add(std::string output, const Hash & hash, std::function<void()> render) {
+	Job job = { output, hash.toString(), render };
+	jobs.push_back(job);
+}
+
+bool BatchRenderer::run() {
+	auto t0 = std::chrono::steady_clock::now();
+	
+	// the plots rendered before with the same inputs
+	std::map<std::string, std::string> cache;
+	std::ifstream in(cacheFile.c_str());
+	std::string hash, output;
+	while(in >> hash >> output) cache[output] = hash;
+	in.close();
+	
+	std::vector<std::size_t> todo;
+	for(std::size_t i = 0; i < jobs.size(); ++i) {
+		bool unchanged = cache.count(jobs[i].output) && cache[jobs[i].output] == jobs[i].hash && access(jobs[i].output.c_str(), F_OK) == 0;
+		if(unchanged && ! force) ++nSkipped;
+		else todo.push_back(i);
+	}
+	
+	if(! todo.empty()) {
+		// shared by the workers: the next job to take and the status of every job
+		std::size_t size = sizeof(std::atomic<Int_t>) + todo.size();
+		void * memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if(memory == MAP_FAILED) {
+			std::cerr << "cannot allocate the shared memory of the renderer" << std::endl;
+			return false;
+		}
+		std::atomic<Int_t> * next = new (memory) std::atomic<Int_t>(0);
+		char * status = static_cast<char *>(memory) + sizeof(std::atomic<Int_t>);
+		for(std::size_t i = 0; i < todo.size(); ++i) status[i] = kPending;
+		auto render = [this, &todo, status] (Int_t i) -> void {
+			const Job & job = jobs[todo[i]];
+			std::remove(job.output.c_str()); // a failed job must not leave the old plot behind
+			job.render();
+			status[i] = (access(job.output.c_str(), F_OK) == 0) ? kDone : kFailed;
+		};
+		
+		std::cout.flush();
+		std::cerr.flush();
+		std::vector<pid_t> workers;
+		Int_t n = std::min<std::size_t>(nWorkers, todo.size());
+		for(Int_t w = 0; w < n; ++w) {
+			pid_t pid = fork();
+			if(pid < 0) {
+				std::cerr << "cannot start a rendering worker" << std::endl;
+				break;
+			}
+			if(pid == 0) {
+				gROOT -> SetBatch(kTRUE);
+				Int_t i;
+				while((i = (*next)++) < Int_t(todo.size())) render(i);
+				std::cout.flush();
+				_exit(EXIT_SUCCESS); // don't run the destructors of the objects of the parent
+			}
+			workers.push_back(pid);
+		}
+		nStarted = workers.size();
+		if(workers.empty()) {
+			// render here if no worker could be started
+			gROOT -> SetBatch(kTRUE);
+			for(std::size_t i = 0; i < todo.size(); ++i) render(i);
+		}
+		for(auto pid: workers) {
+			int status;
+			waitpid(pid, &status, 0);
+		}
+		
+		for(std::size_t i = 0; i < todo.size(); ++i) {
+			const Job & job = jobs[todo[i]];
+			if(status[i] == kDone) {
+				++nRendered;
+				cache[job.output] = job.hash;
+			}
+			else {
+				++nFailed;
+				cache.erase(job.output);
+				std::cerr << "failed to render " << job.output << std::endl;
+			}
+		}
+		munmap(memory, size);
+		
+		std::string tmpName = cacheFile + ".tmp";
+		std::ofstream out(tmpName.c_str());
+		for(auto & kv: cache) out << kv.second << " " << kv.first << std::endl;
+		out.close();
+		std::rename(tmpName.c_str(), cacheFile.c_str());
+	}
+	
+	wallTime = std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - t0).count();
+	return nFailed == 0;
+}
+
+std::string BatchRenderer::report() const {
+	std::stringstream ss;
+	ss << "Rendered " << nRendered << " plots in " << wallTime << " s";
+	if(wallTime > 0 && nRendered > 0) ss << " (" << nRendered / wallTime << " plots/s on " << std::max(nStarted, 1) << " workers)";
+	ss << ", " << nSkipped << " unchanged";
+	if(nFailed > 0) ss << ", " << nFailed << " failed";
+	return ss.str();
+}
+
+Int_t BatchRenderer::getNumberOfRendered() const {
+	return nRendered;
+}
+
+Int_t BatchRenderer::getNumberOfSkipped() const {
+	return nSkipped;
+}
+
+Int_t BatchRenderer::getNumberOfFailed() const {
+	return nFailed;
+}
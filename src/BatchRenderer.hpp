@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <functional> // std::function<>
+
+#include <TMath.h>
+
+class TH1;
+
+/**
+ * @brief Renders a list of plot jobs in parallel worker processes in ROOT batch mode.
+ *
+ * A job is an output file, the hash of everything the plot depends on (input histograms and style)
+ * and a function which draws the plot and saves it. The jobs are handed out dynamically to
+ * fork()ed workers, which inherit the histograms already read by the caller; hence the render
+ * functions must not read from files opened before run() (the file offset would be shared).
+ *
+ * The hashes of the rendered plots are kept in a cache file ("<hash> <output>" per line); a job
+ * whose output exists and whose hash is unchanged is skipped unless force is set.
+ */
+class BatchRenderer {
+public:
+	/**
+	 * @brief 64-bit FNV-1a hash of the inputs of a plot.
+	 */
+	class Hash {
+	public:
+		Hash();
+		Hash & add(const void * data, std::size_t size);
+		Hash & add(const std::string & s);
+		Hash & add(Double_t x);
+		Hash & add(const TH1 * h);
+		std::string toString() const;
+	private:
+		ULong64_t value;
+	};
+	BatchRenderer(std::string cacheFile, Int_t nWorkers, bool force);
+	void add(std::string output, const Hash & hash, std::function<void()> render);
+	bool run();
+	std::string report() const;
+	Int_t getNumberOfRendered() const;
+	Int_t getNumberOfSkipped() const;
+	Int_t getNumberOfFailed() const;
+private:
+	struct Job {
+		std::string output;
+		std::string hash;
+		std::function<void()> render;
+	};
+	std::string cacheFile;
+	Int_t nWorkers;
+	bool force;
+	std::vector<Job> jobs;
+	Int_t nRendered, nSkipped, nFailed;
+	Int_t nStarted; // workers
+	Double_t wallTime;
+};
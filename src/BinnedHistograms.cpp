@@ -0,0 +1,114 @@
+#include "BinnedHistograms.hpp"
+
+#include <cstdlib> // std::exit(), EXIT_FAILURE
+#include <iostream> // std::cerr, std::endl
+#include <cmath> // std::abs(), std::sqrt()
+#include <algorithm> // std::max()
+
+#include <TFile.h>
+#include <TH1.h>
+
+BinnedHistograms::BinnedHistograms(std::string filename, const std::vector<std::string> & names, Double_t normalization)
+	: filename(filename) {
+	TFile * f = TFile::Open(filename.c_str(), "read");
+	if(! f || f -> IsZombie() || ! f -> IsOpen()) {
+		std::cerr << "error on opening " << filename << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	offsets.push_back(0);
+	for(auto & name: names) {
+		TH1 * h = dynamic_cast<TH1 *> (f -> Get(name.c_str()));
+		if(! h) {
+			std::cerr << "error on accessing histogram " << name << " in " << filename << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		Int_t nBins = h -> GetNbinsX();
+		Double_t integral = h -> Integral();
+		Double_t factor = (integral != 0) ? normalization / integral : 1;
+		for(Int_t bin = 1; bin <= nBins; ++bin) {
+			Double_t error = h -> GetBinError(bin);
+			contents.push_back(Float_t(h -> GetBinContent(bin) * factor));
+			errors2.push_back(error * error * factor * factor);
+		}
+		offsets.push_back(contents.size());
+		delete h;
+	}
+	f -> Close();
+}
+
+std::size_t BinnedHistograms::size() const {
+	return offsets.size() - 1;
+}
+
+Int_t BinnedHistograms::getNbins(std::size_t index) const {
+	return offsets[index + 1] - offsets[index];
+}
+
+const Double_t * BinnedHistograms::getContents(std::size_t index) const {
+	return &contents[offsets[index]];
+}
+
+const Double_t * BinnedHistograms::getErrors2(std::size_t index) const {
+	return &errors2[offsets[index]];
+}
+
+const std::string & BinnedHistograms::getFilename() const {
+	return filename;
+}
+
+Double_t BinnedHistograms::kolmogorovTest(const BinnedHistograms & h1, const BinnedHistograms & h2, std::size_t index) {
+	Int_t nBins = h1.getNbins(index);
+	if(nBins != h2.getNbins(index)) return 0;
+	const Double_t * c1 = h1.getContents(index), * c2 = h2.getContents(index);
+	const Double_t * e1 = h1.getErrors2(index), * e2 = h2.getErrors2(index);
+	Double_t sum1 = 0, sum2 = 0, w1 = 0, w2 = 0;
+	for(Int_t i = 0; i < nBins; ++i) {
+		sum1 += c1[i];
+		sum2 += c2[i];
+		w1 += e1[i];
+		w2 += e2[i];
+	}
+	if(sum1 == 0 || sum2 == 0 || (w1 <= 0 && w2 <= 0)) return 0;
+	// effective numbers of entries; a histogram without errors is compared as a function
+	Double_t esum1 = (w1 > 0) ? sum1 * sum1 / w1 : 0;
+	Double_t esum2 = (w2 > 0) ? sum2 * sum2 / w2 : 0;
+	Double_t s1 = 1 / sum1, s2 = 1 / sum2;
+	Double_t rsum1 = 0, rsum2 = 0, dfmax = 0;
+	for(Int_t i = 0; i < nBins; ++i) {
+		rsum1 += s1 * c1[i];
+		rsum2 += s2 * c2[i];
+		dfmax = std::max(dfmax, std::abs(rsum1 - rsum2));
+	}
+	Double_t z;
+	if(w1 <= 0)		 z = dfmax * std::sqrt(esum2);
+	else if(w2 <= 0) z = dfmax * std::sqrt(esum1);
+	else			 z = dfmax * std::sqrt(esum1 * esum2 / (esum1 + esum2));
+	return TMath::KolmogorovProb(z);
+}
+
+Double_t BinnedHistograms::chi2Test(const BinnedHistograms & h1, const BinnedHistograms & h2, std::size_t index) {
+	Int_t nBins = h1.getNbins(index);
+	if(nBins != h2.getNbins(index)) return 0;
+	const Double_t * c1 = h1.getContents(index), * c2 = h2.getContents(index);
+	Double_t sum1 = 0, sum2 = 0;
+	for(Int_t i = 0; i < nBins; ++i) {
+		sum1 += c1[i];
+		sum2 += c2[i];
+	}
+	if(sum1 == 0 || sum2 == 0) return 0;
+	// chi2 = sum_i (N2 n1_i - N1 n2_i)^2 / (n1_i + n2_i) / (N1 N2); bins empty in both histograms don't count
+	Double_t chi2 = 0;
+	Int_t ndf = nBins - 1;
+	for(Int_t i = 0; i < nBins; ++i) {
+		Double_t cntsum = c1[i] + c2[i];
+		if(cntsum == 0) {
+			--ndf;
+			continue;
+		}
+		Double_t delta = sum2 * c1[i] - sum1 * c2[i];
+		chi2 += delta * delta / cntsum;
+	}
+	chi2 /= sum1 * sum2;
+	if(ndf <= 0) return 0;
+	return TMath::Prob(chi2, ndf);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+
+#include <TMath.h>
+
+/**
+ * @brief Bin contents and squared bin errors of a list of histograms read once from a file.
+ *
+ * The bins 1..n of every histogram are stored one histogram after another in two contiguous arrays,
+ * after scaling the histogram to the given normalization the same way TH1::Scale() does
+ * (the contents are rounded to Float_t as in a TH1F, the squared errors stay Double_t).
+ *
+ * kolmogorovTest() and chi2Test() are the binned tests of TH1::KolmogorovTest() (default options)
+ * and TH1::Chi2Test() (option "UU"); they only read the arrays, hence any number of them may run in parallel.
+ */
+class BinnedHistograms {
+public:
+	BinnedHistograms(std::string filename, const std::vector<std::string> & names, Double_t normalization);
+	std::size_t size() const;
+	Int_t getNbins(std::size_t index) const;
+	const Double_t * getContents(std::size_t index) const;
+	const Double_t * getErrors2(std::size_t index) const;
+	const std::string & getFilename() const;
+	static Double_t kolmogorovTest(const BinnedHistograms & h1, const BinnedHistograms & h2, std::size_t index);
+	static Double_t chi2Test(const BinnedHistograms & h1, const BinnedHistograms & h2, std::size_t index);
+private:
+	std::string filename;
+	std::vector<Double_t> contents;
+	std::vector<Double_t> errors2;
+	std::vector<std::size_t> offsets; // offsets[i] is the first bin of histogram i, offsets[size()] the end
+};
@@ -0,0 +1,160 @@
+#include "BootstrapReplicas.hpp"
+
+#include <cstdlib> // std::exit(), EXIT_FAILURE
+#include <iostream> // std::cerr, std::endl
+#include <cmath> // std::exp()
+
+#include <TFile.h>
+#include <TDirectory.h>
+#include <TH1F.h>
+#include <TH2F.h>
+
+namespace {
+	// SplitMix64, a counter-based generator: the n-th number of a stream needs no state
+	inline ULong64_t splitMix(ULong64_t x) {
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+
+	// cumulative distribution of Poisson(1); P(k > 12) is below 1e-10
+	const Int_t maxWeight = 12;
+	struct PoissonTable {
+		Double_t cdf[maxWeight + 1];
+		PoissonTable() {
+			Double_t p = std::exp(-1.0), sum = 0;
+			for(Int_t k = 0; k <= maxWeight; ++k) {
+				sum += p;
+				cdf[k] = sum;
+				p /= k + 1;
+			}
+		}
+	};
+	const PoissonTable poisson;
+}
+
+BootstrapReplicas::BootstrapReplicas(const std::vector<std::string> & names, Int_t nReplicas, Int_t nBins, Double_t xMin, Double_t xMax)
+	: names(names), nBinIds(names.size()), nReplicas(nReplicas), nBins(nBins), xMin(xMin), xMax(xMax),
+	  nominal(nBinIds * (nBins + 2), 0), contents(nBinIds * (nBins + 2) * nReplicas, 0) { }
+
+BootstrapReplicas::BootstrapReplicas(std::string filename, const std::vector<std::string> & names)
+	: names(names), nBinIds(names.size()), nReplicas(0), nBins(0), xMin(0), xMax(1) {
+	TFile * f = TFile::Open(filename.c_str(), "read");
+	if(! f || f -> IsZombie() || ! f -> IsOpen()) {
+		std::cerr << "error on opening " << filename << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	for(Int_t binId = 0; binId < nBinIds; ++binId) {
+		const std::string & name = names[binId];
+		TH1F * h = dynamic_cast<TH1F *> (f -> Get(name.c_str()));
+		TH2F * r = dynamic_cast<TH2F *> (f -> Get(("replicas_" + name).c_str()));
+		if(! h || ! r) {
+			std::cerr << "error on accessing the replicas of " << name << " in " << filename << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(binId == 0) {
+			nReplicas = r -> GetNbinsY();
+			nBins = h -> GetNbinsX();
+			xMin = h -> GetXaxis() -> GetXmin();
+			xMax = h -> GetXaxis() -> GetXmax();
+			nominal.assign(nBinIds * (nBins + 2), 0);
+			contents.assign(nBinIds * (nBins + 2) * nReplicas, 0);
+		}
+		for(Int_t bin = 0; bin <= nBins + 1; ++bin) {
+			nominal[binId * (nBins + 2) + bin] = h -> GetBinContent(bin);
+			for(Int_t replica = 0; replica < nReplicas; ++replica) {
+				contents[cell(binId, bin) + replica] = r -> GetBinContent(bin, replica + 1);
+			}
+		}
+		delete h;
+		delete r;
+	}
+	f -> Close();
+}
+
+std::size_t BootstrapReplicas::cell(Int_t binId, Int_t bin) const {
+	return (std::size_t(binId) * (nBins + 2) + bin) * nReplicas;
+}
+
+Int_t BootstrapReplicas::findBin(Float_t x) const {
+	if(x < xMin) return 0;
+	if(! (x < xMax)) return nBins + 1;
+	return 1 + Int_t(nBins * (x - xMin) / (xMax - xMin));
+}
+
+void BootstrapReplicas::fill(Int_t binId, Int_t bin, const Double_t * weights) {
+	nominal[binId * (nBins + 2) + bin] += 1;
+	Double_t * c = &contents[cell(binId, bin)];
+	for(Int_t replica = 0; replica < nReplicas; ++replica) c[replica] += weights[replica];
+}
+
+BootstrapReplicas & BootstrapReplicas::operator+=(const BootstrapReplicas & other) {
+	for(std::size_t i = 0; i < nominal.size(); ++i) nominal[i] += other.nominal[i];
+	for(std::size_t i = 0; i < contents.size(); ++i) contents[i] += other.contents[i];
+	return *this;
+}
+
+void BootstrapReplicas::write(TDirectory * d) const {
+	d -> cd();
+	for(Int_t binId = 0; binId < nBinIds; ++binId) {
+		const std::string & name = names[binId];
+		std::string replicaName = "replicas_" + name;
+		TH1F h(name.c_str(), name.c_str(), nBins, xMin, xMax);
+		TH2F r(replicaName.c_str(), replicaName.c_str(), nBins, xMin, xMax, nReplicas, 0, nReplicas);
+		h.SetDirectory(0);
+		r.SetDirectory(0);
+		h.Sumw2();
+		for(Int_t bin = 0; bin <= nBins + 1; ++bin) {
+			Double_t n = nominal[binId * (nBins + 2) + bin];
+			h.SetBinContent(bin, n);
+			h.SetBinError(bin, std::sqrt(n));
+			for(Int_t replica = 0; replica < nReplicas; ++replica) {
+				r.SetBinContent(bin, replica + 1, contents[cell(binId, bin) + replica]);
+			}
+		}
+		h.SetEntries(h.Integral(0, nBins + 1));
+		h.Write();
+		r.Write();
+	}
+}
+
+Int_t BootstrapReplicas::getNumberOfReplicas() const {
+	return nReplicas;
+}
+
+std::vector<Float_t> BootstrapReplicas::getProbabilities(Int_t replica, Float_t workingPoint) const {
+	// cumulative.cpp: running sum of the bins 1..nBins on [0, 1], normalized to the integral;
+	// analyze.cpp: 1 - linear interpolation of it inside the bin of the working point
+	std::vector<Float_t> probabilities(nBinIds, 0);
+	std::vector<Float_t> cumulative(nBins + 2, 0);
+	for(Int_t binId = 0; binId < nBinIds; ++binId) {
+		Float_t total = 0;
+		for(Int_t bin = 1; bin <= nBins; ++bin) {
+			total += contents[cell(binId, bin) + replica];
+			cumulative[bin] = total;
+		}
+		if(total == 0) continue;
+		for(Int_t bin = 1; bin <= nBins; ++bin) cumulative[bin] = cumulative[bin] * (1.0 / total);
+		Int_t bin = (workingPoint < 0) ? 0 : (workingPoint >= 1 ? nBins + 1 : 1 + Int_t(nBins * workingPoint));
+		if(bin < 1 || bin > nBins) {
+			probabilities[binId] = (bin < 1) ? 1 : 0;
+			continue;
+		}
+		Float_t x1 = Float_t(bin - 1) / nBins, x2 = Float_t(bin) / nBins;
+		Float_t y1 = cumulative[bin - 1], y2 = cumulative[bin];
+		probabilities[binId] = 1.0 - (y1 + (y2 - y1) * (workingPoint - x1) / (x2 - x1));
+	}
+	return probabilities;
+}
+
+void BootstrapReplicas::generateWeights(ULong64_t seed, Long64_t event, std::vector<Double_t> & weights) {
+	ULong64_t state = splitMix(seed ^ splitMix(ULong64_t(event)));
+	for(std::size_t replica = 0; replica < weights.size(); ++replica) {
+		state = splitMix(state);
+		Double_t u = (state >> 11) * (1.0 / 9007199254740992.0); // 53 bits in [0, 1)
+		Int_t k = 0;
+		while(k < maxWeight && u >= poisson.cdf[k]) ++k;
+		weights[replica] = k;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+
+#include <TMath.h>
+
+class TDirectory;
+
+/**
+ * @brief Poisson-weighted bootstrap replicas of the flavor/pt/eta CSV histograms (names indexed by getBinId()).
+ *
+ * Every event gets an independent Poisson(1) weight per replica, computed from the seed and the event number only,
+ * so the replicas don't depend on the number of threads nor on how the events are split into jobs
+ * (the outputs of split jobs can be summed with merge.cpp or hadd).
+ * The replicas of a cell are stored next to each other, hence a jet adds the whole weight vector of its event in one loop.
+ *
+ * write() stores the nominal histograms under their usual names (as process.cpp) and the replicas
+ * as TH2F "replicas_<name>" (x: CSV, y: replica); the file constructor reads them back.
+ * getProbabilities() repeats cumulative.cpp and the analytic probability of analyze.cpp for one replica.
+ */
+class BootstrapReplicas {
+public:
+	BootstrapReplicas(const std::vector<std::string> & names, Int_t nReplicas, Int_t nBins, Double_t xMin, Double_t xMax);
+	BootstrapReplicas(std::string filename, const std::vector<std::string> & names);
+	Int_t findBin(Float_t x) const;
+	void fill(Int_t binId, Int_t bin, const Double_t * weights);
+	BootstrapReplicas & operator+=(const BootstrapReplicas & other);
+	void write(TDirectory * d) const;
+	Int_t getNumberOfReplicas() const;
+	std::vector<Float_t> getProbabilities(Int_t replica, Float_t workingPoint) const;
+	static void generateWeights(ULong64_t seed, Long64_t event, std::vector<Double_t> & weights);
+private:
+	std::size_t cell(Int_t binId, Int_t bin) const;
+	std::vector<std::string> names; // indexed by getBinId()
+	Int_t nBinIds;
+	Int_t nReplicas;
+	Int_t nBins;
+	Double_t xMin, xMax;
+	std::vector<Double_t> nominal; // [binId][bin], bins 0..nBins+1
+	std::vector<Double_t> contents; // [binId][bin][replica]
+};
@@ -0,0 +1,113 @@
+#include "BtagWeight.hpp"
+#include "CdfSampler.hpp"
+#include "JetBins.hpp"
+
+#include <cmath> // std::fabs()
+#include <cstdlib> // std::atof()
+#include <algorithm> // std::min(), std::fill()
+#include <stdexcept> // std::runtime_error
+
+#include <TFile.h>
+#include <TH1F.h>
+#include <TH1D.h>
+#include <TAxis.h>
+
+namespace {
+	const std::size_t blockSize = 256; // uniforms drawn at once by sampleCSV()
+}
+
+BtagWeight::BtagWeight(std::string cumulFile, Float_t workingPoint)
+	: workingPoint(workingPoint), probabilities(numberOfBins, 0) {
+	samplers.resize(numberOfBins);
+	std::unique_ptr<TFile> f(TFile::Open(cumulFile.c_str(), "read"));
+	if(! f || f -> IsZombie() || ! f -> IsOpen()) throw std::runtime_error("Cannot open " + cumulFile + ".");
+	for(Int_t binId = 0; binId < numberOfBins; ++binId) {
+		std::string name = getBinName(binId);
+		TH1F * h = dynamic_cast<TH1F *> (f -> Get(name.c_str()));
+		if(! h) continue;
+		samplers[binId].reset(new CdfSampler(h));
+		// the table of cumulative.cpp if it has the working point, otherwise the interpolation of analyze.cpp
+		bool found = false;
+		TH1D * table = dynamic_cast<TH1D *> (f -> Get(("tagprob_" + name).c_str()));
+		for(Int_t i = 1; table && i <= table -> GetNbinsX() && ! found; ++i) {
+			if(std::fabs(std::atof(table -> GetXaxis() -> GetBinLabel(i)) - workingPoint) > 1e-6) continue;
+			probabilities[binId] = table -> GetBinContent(i);
+			found = true;
+		}
+		if(found) continue;
+		Int_t bin = h -> FindBin(workingPoint);
+		Float_t x1 = h -> GetBinLowEdge(bin), x2 = h -> GetBinLowEdge(bin + 1);
+		Float_t y1 = h -> GetBinContent(bin - 1), y2 = h -> GetBinContent(bin);
+		probabilities[binId] = 1.0 - (y1 + (y2 - y1) * (workingPoint - x1) / (x2 - x1));
+	}
+	f -> Close();
+}
+
+BtagWeight::~BtagWeight() { }
+
+Float_t BtagWeight::getWorkingPoint() const {
+	return workingPoint;
+}
+
+Float_t BtagWeight::getTagProbability(Int_t binId) const {
+	return (binId < 0 || binId >= numberOfBins) ? 0 : probabilities[binId];
+}
+
+void BtagWeight::tagProbabilities(std::size_t nJets, const Float_t * pt, const Float_t * eta, const Float_t * flavour,
+								  Float_t * p) const {
+	for(std::size_t j = 0; j < nJets; ++j) p[j] = getTagProbability(getBinId(flavour[j], pt[j], eta[j]));
+}
+
+void BtagWeight::tagDistributions(std::size_t nEvents, const Long64_t * offsets, const Float_t * p,
+								  Int_t maxTags, Double_t * distributions) const {
+	// Poisson-binomial distribution jet by jet: d[k] is the probability that k of the jets so far are tagged
+	// (the entries above maxTags are dropped, which doesn't change the others)
+	if(maxTags < 0) throw std::runtime_error("negative maximal number of b-tags for tagDistributions()");
+	for(std::size_t i = 0; i < nEvents; ++i) {
+		Double_t * d = distributions + i * (maxTags + 1);
+		std::fill(d, d + maxTags + 1, 0.0);
+		d[0] = 1;
+		for(Long64_t j = offsets[i]; j < offsets[i + 1]; ++j) {
+			Double_t q = p[j];
+			for(Int_t k = maxTags; k > 0; --k) d[k] = d[k] * (1 - q) + d[k - 1] * q;
+			d[0] *= 1 - q;
+		}
+	}
+}
+
+Double_t BtagWeight::eventProbability(std::size_t nJets, const Float_t * p, Int_t nTags) const {
+	if(nTags < 0 || std::size_t(nTags) > nJets) return 0;
+	if(nTags >= 64) throw std::runtime_error("too many b-tags for eventProbability()");
+	Double_t d[64];
+	const Long64_t offsets[2] = { 0, Long64_t(nJets) };
+	tagDistributions(1, offsets, p, nTags, d);
+	return d[nTags];
+}
+
+void BtagWeight::sampleCSV(std::size_t nJets, const Float_t * pt, const Float_t * eta, const Float_t * flavour,
+						   ULong64_t stream, Long64_t first, Float_t * csv) const {
+	Double_t u[blockSize];
+	for(std::size_t done = 0; done < nJets; done += blockSize) {
+		std::size_t size = std::min(blockSize, nJets - done);
+		CdfSampler::uniforms(stream, first + done, u, size);
+		for(std::size_t i = 0; i < size; ++i) {
+			std::size_t j = done + i;
+			Int_t binId = getBinId(flavour[j], pt[j], eta[j]);
+			if(binId < 0 || ! samplers[binId]) {
+				csv[j] = -1;
+				continue;
+			}
+			Double_t x;
+			samplers[binId] -> sample(&u[i], &x, 1);
+			csv[j] = x;
+		}
+	}
+}
+
+Int_t BtagWeight::getBinId(Float_t flavour, Float_t pt, Float_t eta) {
+	return ::getBinId(flavour, pt, eta);
+}
+
+ULong64_t BtagWeight::getStream(ULong64_t seed, std::string name) {
+	return CdfSampler::getStream(seed, name);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <memory> // std::unique_ptr<>
+
+#include <TMath.h>
+
+class CdfSampler;
+
+/**
+ * @brief The b-tag quantities of analyze.cpp for the event loops of other programs (libbtagweight.so).
+ *
+ * The cumulatives of cumulative.cpp are read once by the constructor; afterwards the object is immutable,
+ * so that any number of threads can share it. The batch functions read the jets from the arrays of the caller
+ * (pt, eta and flavour of consecutive jets, the jets of event i being [offsets[i], offsets[i + 1]), as in a skim)
+ * and write into its buffers; they don't copy the inputs and don't allocate.
+ *
+ * A jet out of the (flavour, pt, |eta|) bins has the tag probability 0 and the sampled CSV value -1.
+ * The CSV values are drawn with a counter-based generator: the value of jet j depends only on (stream, first + j),
+ * not on the thread or the batch (see CdfSampler). The jet selection of analyze.cpp is left to the caller.
+ * Errors (an unreadable file, a negative maxTags) are thrown as std::runtime_error.
+ */
+class BtagWeight {
+public:
+	BtagWeight(std::string cumulFile, Float_t workingPoint);
+	~BtagWeight();
+	Float_t getWorkingPoint() const;
+	Float_t getTagProbability(Int_t binId) const;
+	void tagProbabilities(std::size_t nJets, const Float_t * pt, const Float_t * eta, const Float_t * flavour,
+						  Float_t * probabilities) const;
+	void tagDistributions(std::size_t nEvents, const Long64_t * offsets, const Float_t * probabilities,
+						  Int_t maxTags, Double_t * distributions) const;
+	Double_t eventProbability(std::size_t nJets, const Float_t * probabilities, Int_t nTags) const;
+	void sampleCSV(std::size_t nJets, const Float_t * pt, const Float_t * eta, const Float_t * flavour,
+				   ULong64_t stream, Long64_t first, Float_t * csv) const;
+	static Int_t getBinId(Float_t flavour, Float_t pt, Float_t eta);
+	static ULong64_t getStream(ULong64_t seed, std::string name);
+	static const Int_t numberOfBins = 3 * 6 * 3;
+private:
+	Float_t workingPoint;
+	std::vector<Float_t> probabilities; // indexed by getBinId()
+	std::vector<std::unique_ptr<CdfSampler> > samplers;
+};
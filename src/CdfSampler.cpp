@@ -0,0 +1,85 @@
+#include "CdfSampler.hpp"
+
+#include <algorithm> // std::min(), std::max()
+
+#include <TH1.h>
+
+namespace {
+	const std::size_t blockSize = 4096; // draws generated and inverted at once
+	const Int_t guidePerBin = 4; // entries of the guide table per bin
+
+	// SplitMix64; the n-th number of a stream is splitMix(stream + n * golden ratio), which needs no state
+	inline ULong64_t splitMix(ULong64_t x) {
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+}
+
+CdfSampler::CdfSampler(const TH1 * cumulative) {
+	Int_t nBins = cumulative -> GetNbinsX();
+	cdf.resize(nBins + 2);
+	edges.resize(nBins + 2);
+	for(Int_t bin = 0; bin <= nBins + 1; ++bin) cdf[bin] = cumulative -> GetBinContent(bin);
+	for(Int_t bin = 1; bin <= nBins + 1; ++bin) edges[bin] = cumulative -> GetBinLowEdge(bin);
+	binMin = cumulative -> GetMinimumBin();
+	binMax = cumulative -> GetMaximumBin();
+	guide.resize(std::max(1, (binMax - binMin + 1) * guidePerBin));
+	Int_t bin = binMin;
+	for(std::size_t g = 0; g < guide.size(); ++g) {
+		Double_t r = Double_t(g) / guide.size();
+		while(bin <= binMax && cdf[bin] <= r) ++bin;
+		guide[g] = bin;
+	}
+}
+
+Int_t CdfSampler::findBin(Double_t r) const {
+	std::size_t g = std::min(guide.size() - 1, std::size_t(std::max(0.0, r) * guide.size()));
+	Int_t bin = guide[g];
+	while(bin <= binMax && cdf[bin] <= r) ++bin;
+	return std::min(bin, binMax); // r above the largest content (rounding) stays in the last bin
+}
+
+void CdfSampler::sample(const Double_t * u, Double_t * x, std::size_t n) const {
+	for(std::size_t i = 0; i < n; ++i) {
+		Int_t bin = findBin(u[i]);
+		Double_t x1 = edges[bin], x2 = edges[bin + 1];
+		Double_t y1 = cdf[bin - 1], y2 = cdf[bin];
+		x[i] = (y2 > y1) ? (u[i] - y1) * (x2 - x1) / (y2 - y1) + x1 : x1;
+	}
+}
+
+void CdfSampler::fill(ULong64_t stream, Long64_t first, Long64_t n, Int_t nBins, Double_t xMin, Double_t xMax, std::vector<Long64_t> & counts) const {
+	counts.resize(nBins + 2, 0);
+	Double_t u[blockSize], x[blockSize];
+	const Double_t scale = nBins / (xMax - xMin);
+	for(Long64_t done = 0; done < n; ) {
+		std::size_t size = std::size_t(std::min(Long64_t(blockSize), n - done));
+		uniforms(stream, first + done, u, size);
+		sample(u, x, size);
+		// the bins of TH1::Fill(): underflow 0, overflow nBins + 1
+		for(std::size_t i = 0; i < size; ++i) {
+			Int_t bin = (x[i] < xMin) ? 0 : (x[i] >= xMax) ? nBins + 1 : 1 + std::min(nBins - 1, Int_t((x[i] - xMin) * scale));
+			++counts[bin];
+		}
+		done += size;
+	}
+}
+
+ULong64_t CdfSampler::getStream(ULong64_t seed, std::string name) {
+	// 64-bit FNV-1a of the name, so that the stream of a histogram doesn't depend on its position in the file
+	ULong64_t hash = 14695981039346656037ULL;
+	for(char c: name) {
+		hash ^= (unsigned char) c;
+		hash *= 1099511628211ULL;
+	}
+	return splitMix(seed ^ splitMix(hash));
+}
+
+void CdfSampler::uniforms(ULong64_t stream, Long64_t first, Double_t * u, std::size_t n) {
+	// independent iterations, hence the loop is vectorized
+	for(std::size_t i = 0; i < n; ++i) {
+		u[i] = (splitMix(stream + ULong64_t(first + i) * 0x9E3779B97F4A7C15ULL) >> 11) * (1.0 / 9007199254740992.0); // 53 bits in [0, 1)
+	}
+}
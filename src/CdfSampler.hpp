@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+
+#include <TMath.h>
+
+class TH1;
+
+/**
+ * @brief Batch sampling of a binned cumulative distribution (the output of cumulative.cpp) by linear interpolation.
+ *
+ * The bin of a uniform number is the first bin in [GetMinimumBin(), GetMaximumBin()] whose content exceeds it
+ * (as the brute-force search of genrand.cpp did), found from a guide table and a short scan;
+ * the value is interpolated linearly between the low edges of the bin and of the next one.
+ *
+ * fill() draws a block of uniforms at a time from a counter-based generator (SplitMix64 of the seed, the stream and the
+ * draw number), so the n-th draw of a stream doesn't depend on how the draws are split into chunks or threads,
+ * and counts the samples directly in the bins of a uniform histogram instead of filling it one value at a time.
+ */
+class CdfSampler {
+public:
+	CdfSampler(const TH1 * cumulative);
+	void sample(const Double_t * u, Double_t * x, std::size_t n) const;
+	void fill(ULong64_t stream, Long64_t first, Long64_t n, Int_t nBins, Double_t xMin, Double_t xMax, std::vector<Long64_t> & counts) const;
+	static ULong64_t getStream(ULong64_t seed, std::string name);
+	static void uniforms(ULong64_t stream, Long64_t first, Double_t * u, std::size_t n);
+private:
+	Int_t findBin(Double_t r) const;
+	std::vector<Double_t> cdf; // bins 0..nBins+1 of the cumulative histogram
+	std::vector<Double_t> edges; // low edges of the bins 1..nBins+1
+	Int_t binMin, binMax;
+	std::vector<Int_t> guide; // guide[g] is the first bin whose content exceeds g / guide.size()
+};
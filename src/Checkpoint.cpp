@@ -0,0 +1,146 @@
+#include "Checkpoint.hpp"
+
+#include <cstdlib> // std::exit(), EXIT_FAILURE
+#include <cstdio> // std::rename(), std::remove()
+#include <iostream> // std::cerr, std::endl
+#include <fstream> // std::ifstream
+#include <chrono> // std::chrono
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TRandom.h>
+#include <TObjString.h>
+#include <TDirectory.h>
+
+Checkpoint::Checkpoint(std::string filename, Long64_t interval)
+	: filename(filename), interval(interval), lastEntry(-1), nSaves(0), overhead(0) { }
+
+bool Checkpoint::isDue(Long64_t nextEntry) {
+	if(interval <= 0) return false;
+	if(lastEntry < 0) lastEntry = nextEntry; // the first call marks the start of the loop
+	return nextEntry - lastEntry >= interval;
+}
+
+void Checkpoint::save(Long64_t nextEntry, TTree * tree) {
+	auto t0 = std::chrono::steady_clock::now();
+	TDirectory::TContext context; // restore the current directory afterwards
+	if(tree) {
+		tree -> AutoSave("SaveSelf");
+		set("entries", tree -> GetEntries());
+	}
+	set("next", nextEntry);
+	std::string state;
+	for(auto & kv: values) state += kv.first + "=" + kv.second + "\n";
+
+	std::string temporary = filename + ".tmp";
+	TFile * f = TFile::Open(temporary.c_str(), "recreate");
+	if(! f || f -> IsZombie() || ! f -> IsOpen()) {
+		std::cerr << "cannot create " << temporary << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	TObjString(state.c_str()).Write("state");
+	if(gRandom) gRandom -> Write("random");
+	f -> Close();
+	delete f;
+	if(std::rename(temporary.c_str(), filename.c_str()) != 0) {
+		std::cerr << "cannot rename " << temporary << " to " << filename << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	lastEntry = nextEntry;
+	++nSaves;
+	overhead += std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - t0).count();
+}
+
+bool Checkpoint::load() {
+	if(! std::ifstream(filename.c_str()).good()) return false;
+	TDirectory::TContext context;
+	TFile * f = TFile::Open(filename.c_str(), "read");
+	if(! f || f -> IsZombie() || ! f -> IsOpen()) {
+		std::cerr << "cannot open checkpoint " << filename << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	TObjString * state = dynamic_cast<TObjString *> (f -> Get("state"));
+	if(! state) {
+		std::cerr << "no state in checkpoint " << filename << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	values.clear();
+	std::istringstream ss(state -> GetString().Data());
+	std::string line;
+	while(std::getline(ss, line)) {
+		std::size_t pos = line.find('=');
+		if(pos == std::string::npos) continue;
+		values[line.substr(0, pos)] = line.substr(pos + 1);
+	}
+	TRandom * random = dynamic_cast<TRandom *> (f -> Get("random"));
+	if(random) {
+		delete gRandom;
+		gRandom = random;
+	}
+	f -> Close();
+	delete f;
+	lastEntry = getNextEntry();
+	return true;
+}
+
+void Checkpoint::remove() {
+	std::remove(filename.c_str());
+}
+
+Long64_t Checkpoint::getNextEntry() const {
+	return get<Long64_t>("next");
+}
+
+Long64_t Checkpoint::getEntries() const {
+	return values.count("entries") ? get<Long64_t>("entries") : 0;
+}
+
+Int_t Checkpoint::getNumberOfSaves() const {
+	return nSaves;
+}
+
+Double_t Checkpoint::getOverhead() const {
+	return overhead;
+}
+
+bool Checkpoint::truncateTree(std::string filename, std::string treeName, Long64_t nEntries) {
+	TDirectory::TContext context;
+	TFile * in = TFile::Open(filename.c_str(), "read");
+	if(! in || in -> IsZombie() || ! in -> IsOpen()) {
+		std::cerr << "cannot open " << filename << std::endl;
+		return false;
+	}
+	TTree * t = dynamic_cast<TTree *> (in -> Get(treeName.c_str()));
+	if(! t || t -> GetEntries() < nEntries) {
+		std::cerr << filename << " has fewer entries than the checkpoint" << std::endl;
+		in -> Close();
+		return false;
+	}
+	if(t -> GetEntries() == nEntries) {
+		in -> Close();
+		return true;
+	}
+	// the tree was flushed after the last checkpoint, copy only the entries up to it
+	std::string temporary = filename + ".tmp";
+	TFile * out = TFile::Open(temporary.c_str(), "recreate");
+	TTree * copy = t -> CloneTree(0);
+	copy -> SetDirectory(out);
+	for(Long64_t i = 0; i < nEntries; ++i) {
+		t -> GetEntry(i);
+		copy -> Fill();
+	}
+	out -> cd();
+	copy -> Write();
+	out -> Close();
+	in -> Close();
+	return std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+std::string Checkpoint::getString(std::string key) const {
+	auto it = values.find(key);
+	if(it == values.end()) {
+		std::cerr << "no " << key << " in checkpoint " << filename << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	return it -> second;
+}
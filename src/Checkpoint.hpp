@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string> // std::string
+#include <map> // std::map<>
+#include <sstream> // std::ostringstream, std::istringstream
+#include <iomanip> // std::setprecision()
+
+#include <TMath.h>
+
+class TTree;
+
+/**
+ * @brief Periodic snapshot of an event loop, so that an interrupted job can be resumed.
+ *
+ * A snapshot holds the next entry to be processed, the number of entries of the output tree,
+ * any values set by the caller (random generator states, partial sums, ...) and a copy of gRandom.
+ * The output tree is flushed with AutoSave("SaveSelf") first and the snapshot is then written
+ * to a temporary ROOT file which is renamed, so that a checkpoint is either complete or absent.
+ * After a crash the output file may hold more entries than the checkpoint; truncateTree() drops them.
+ */
+class Checkpoint {
+public:
+	Checkpoint(std::string filename, Long64_t interval);
+	bool isDue(Long64_t nextEntry);
+	void save(Long64_t nextEntry, TTree * tree);
+	bool load();
+	void remove();
+	Long64_t getNextEntry() const;
+	Long64_t getEntries() const;
+	Int_t getNumberOfSaves() const;
+	Double_t getOverhead() const;
+	template<typename T>
+	void set(std::string key, const T & value) {
+		std::ostringstream ss;
+		ss << std::setprecision(17) << value;
+		values[key] = ss.str();
+	}
+	template<typename T>
+	T get(std::string key) const {
+		T value;
+		std::istringstream ss(getString(key));
+		ss >> value;
+		return value;
+	}
+	static bool truncateTree(std::string filename, std::string treeName, Long64_t nEntries);
+private:
+	std::string getString(std::string key) const;
+	std::string filename;
+	Long64_t interval;
+	Long64_t lastEntry;
+	std::map<std::string, std::string> values;
+	Int_t nSaves;
+	Double_t overhead;
+};
@@ -0,0 +1,65 @@
+#include "ChunkCommand.hpp"
+
+#include <cstdlib> // std::exit(), EXIT_FAILURE, EXIT_SUCCESS
+#include <iostream> // std::cerr, std::endl
+
+#include <boost/algorithm/string.hpp>
+
+#include <spawn.h> // posix_spawnp()
+#include <fcntl.h> // O_WRONLY, O_CREAT, O_TRUNC
+#include <unistd.h> // STDOUT_FILENO, STDERR_FILENO
+#include <sys/wait.h> // waitpid()
+
+extern char ** environ;
+
+ChunkCommand::ChunkCommand(std::vector<std::string> arguments)
+	: arguments(arguments) {
+	if(arguments.empty()) {
+		std::cerr << "empty command" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+}
+
+std::vector<std::string> ChunkCommand::getArguments(std::size_t chunk, Long64_t begin, Long64_t end, std::string output) const {
+	std::vector<std::string> result;
+	for(auto arg: arguments) {
+		boost::algorithm::replace_all(arg, "{begin}", std::to_string(begin));
+		boost::algorithm::replace_all(arg, "{end}", std::to_string(end));
+		boost::algorithm::replace_all(arg, "{output}", output);
+		boost::algorithm::replace_all(arg, "{chunk}", std::to_string(chunk));
+		result.push_back(arg);
+	}
+	return result;
+}
+
+pid_t ChunkCommand::launch(std::size_t chunk, Long64_t begin, Long64_t end, std::string output, std::string logFile) const {
+	std::vector<std::string> args = getArguments(chunk, begin, end, output);
+	std::vector<char *> argv;
+	for(auto & arg: args) argv.push_back(const_cast<char *> (arg.c_str()));
+	argv.push_back(0);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, logFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+	pid_t pid;
+	int error = posix_spawnp(&pid, argv[0], &actions, 0, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if(error != 0) {
+		std::cerr << "cannot execute " << args[0] << std::endl;
+		return -1;
+	}
+	return pid;
+}
+
+bool ChunkCommand::run(std::size_t chunk, Long64_t begin, Long64_t end, std::string output, std::string logFile) const {
+	pid_t pid = launch(chunk, begin, end, output, logFile);
+	if(pid < 0) return false;
+	int status;
+	if(waitpid(pid, &status, 0) != pid) return false;
+	return succeeded(status);
+}
+
+bool ChunkCommand::succeeded(int status) {
+	return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+
+#include <sys/types.h> // pid_t
+
+#include <TMath.h>
+
+/**
+ * @brief Command line of a tool that is run over one chunk of events.
+ *
+ * The placeholders {begin}, {end}, {output} and {chunk} in the arguments are replaced for each chunk.
+ * The process is started with posix_spawnp() (the caller is not forked, which is also safe in MPI ranks)
+ * and its standard output and error are redirected to the log file.
+ */
+class ChunkCommand {
+public:
+	ChunkCommand(std::vector<std::string> arguments);
+	std::vector<std::string> getArguments(std::size_t chunk, Long64_t begin, Long64_t end, std::string output) const;
+	pid_t launch(std::size_t chunk, Long64_t begin, Long64_t end, std::string output, std::string logFile) const;
+	bool run(std::size_t chunk, Long64_t begin, Long64_t end, std::string output, std::string logFile) const;
+	static bool succeeded(int status);
+private:
+	std::vector<std::string> arguments;
+};
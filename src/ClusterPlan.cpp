@@ -0,0 +1,192 @@
+#include "ClusterPlan.hpp"
+#include "SkimCache.hpp"
+
+#include <cstdlib> // std::exit(), EXIT_FAILURE
+#include <iostream> // std::cerr, std::endl
+#include <fstream> // std::ifstream, std::ofstream
+#include <sstream> // std::stringstream
+#include <algorithm> // std::min(), std::max()
+#include <memory> // std::unique_ptr<>
+#include <stdexcept> // std::runtime_error
+
+#include <TTree.h>
+
+namespace {
+	const Long64_t skimClusterSize = 10000; // skims have no clusters, use blocks of the same size as EventReader
+
+	// SkimCache throws (for the daemon), a bad skim stops the planning as the other errors here
+	SkimCache * openSkim(std::string filename) {
+		try {
+			return new SkimCache(filename);
+		}
+		catch(std::runtime_error & e) {
+			std::cerr << e.what() << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	// greedy packing of the clusters into chunks whose cost does not exceed the limit
+	std::size_t countChunks(const std::vector<ClusterPlan::Chunk> & clusters, Double_t limit) {
+		std::size_t n = 0;
+		Double_t cost = 0;
+		for(auto & c: clusters) {
+			if(n == 0 || cost + c.cost > limit) {
+				++n;
+				cost = 0;
+			}
+			cost += c.cost;
+		}
+		return n;
+	}
+}
+
+ClusterPlan::ClusterPlan() { }
+
+ClusterPlan::ClusterPlan(std::string filename) {
+	std::ifstream in(filename.c_str());
+	if(! in.good()) {
+		std::cerr << "cannot open plan " << filename << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	std::string line;
+	while(std::getline(in, line)) {
+		line = line.substr(0, line.find("#")); // remove the comment
+		std::stringstream ss(line);
+		Chunk c;
+		if(! (ss >> c.begin >> c.end)) continue;
+		if(! (ss >> c.cost)) c.cost = c.end - c.begin;
+		chunks.push_back(c);
+	}
+	clusters = chunks;
+}
+
+void ClusterPlan::findClusters(TTree * t, std::string filename, Long64_t beginEvent, Long64_t endEvent) {
+	clusters.clear();
+	bool isSkim = SkimCache::isSkim(filename);
+	Long64_t nEntries = isSkim ? std::unique_ptr<SkimCache>(openSkim(filename)) -> getEntries() : t -> GetEntries();
+	if(endEvent < 0 || endEvent > nEntries) endEvent = nEntries;
+	if(isSkim) {
+		for(Long64_t first = beginEvent; first < endEvent; first += skimClusterSize) {
+			Chunk c = { first, std::min(first + skimClusterSize, endEvent), 0 };
+			clusters.push_back(c);
+		}
+		return;
+	}
+	TTree::TClusterIterator it = t -> GetClusterIterator(beginEvent);
+	Long64_t clusterBegin;
+	while((clusterBegin = it()) < endEvent) {
+		Chunk c = { std::max(clusterBegin, beginEvent), std::min(it.GetNextEntry(), endEvent), 0 };
+		clusters.push_back(c);
+	}
+}
+
+void ClusterPlan::setClusters(const std::vector<Long64_t> & boundaries, Long64_t beginEvent, Long64_t endEvent) {
+	clusters.clear();
+	if(boundaries.empty()) return;
+	Long64_t nEntries = boundaries.back();
+	if(endEvent < 0 || endEvent > nEntries) endEvent = nEntries;
+	for(std::size_t i = 0; i + 1 < boundaries.size(); ++i) {
+		if(boundaries[i + 1] <= beginEvent || boundaries[i] >= endEvent) continue;
+		Chunk c = { std::max(boundaries[i], beginEvent), std::min(boundaries[i + 1], endEvent), 0 };
+		clusters.push_back(c);
+	}
+}
+
+void ClusterPlan::estimateCost(TTree * t, std::string filename, Int_t samplesPerCluster, Double_t baseCost, Double_t jetCost) {
+	if(samplesPerCluster < 0) {
+		for(auto & c: clusters) c.cost = baseCost * (c.end - c.begin);
+		return;
+	}
+	if(SkimCache::isSkim(filename)) {
+		// the jet multiplicities are known exactly from the offsets
+		std::unique_ptr<SkimCache> skim(openSkim(filename));
+		const Long64_t * hOffsets = skim -> getOffsets(SkimCache::kHJet);
+		const Long64_t * aOffsets = skim -> getOffsets(SkimCache::kAJet);
+		for(auto & c: clusters) {
+			Long64_t nJets = (hOffsets[c.end] - hOffsets[c.begin]) + (aOffsets[c.end] - aOffsets[c.begin]);
+			c.cost = baseCost * (c.end - c.begin) + jetCost * nJets;
+		}
+		return;
+	}
+	Int_t nhJets, naJets;
+	t -> SetBranchStatus("*", 0);
+	t -> SetBranchStatus("nhJets", 1);
+	t -> SetBranchStatus("naJets", 1);
+	t -> SetBranchAddress("nhJets", &nhJets);
+	t -> SetBranchAddress("naJets", &naJets);
+	for(auto & c: clusters) {
+		Long64_t n = c.end - c.begin;
+		Long64_t step = (samplesPerCluster > 0) ? std::max(Long64_t(1), n / samplesPerCluster) : 1;
+		Double_t sum = 0;
+		Long64_t nSampled = 0;
+		for(Long64_t i = c.begin; i < c.end; i += step) {
+			t -> GetEntry(i);
+			sum += baseCost + jetCost * (nhJets + naJets);
+			++nSampled;
+		}
+		c.cost = (nSampled > 0) ? sum / nSampled * n : 0;
+	}
+	t -> ResetBranchAddresses();
+	t -> SetBranchStatus("*", 1);
+}
+
+void ClusterPlan::split(Int_t nChunks) {
+	chunks.clear();
+	if(clusters.empty()) return;
+	if(nChunks < 1) nChunks = 1;
+
+	// binary search for the smallest cost limit that can be met with nChunks chunks
+	Double_t lo = 0, hi = getTotalCost();
+	for(auto & c: clusters) lo = std::max(lo, c.cost);
+	if(std::size_t(nChunks) < clusters.size()) {
+		for(int iter = 0; iter < 100 && hi - lo > 1e-9 * hi; ++iter) {
+			Double_t mid = 0.5 * (lo + hi);
+			if(countChunks(clusters, mid) <= std::size_t(nChunks)) hi = mid;
+			else lo = mid;
+		}
+	}
+	else {
+		hi = lo; // every cluster is a chunk
+	}
+
+	for(auto & c: clusters) {
+		if(chunks.empty() || chunks.back().cost + c.cost > hi) {
+			Chunk chunk = { c.begin, c.end, 0 };
+			chunks.push_back(chunk);
+		}
+		chunks.back().end = c.end;
+		chunks.back().cost += c.cost;
+	}
+}
+
+void ClusterPlan::write(std::string filename) const {
+	std::ofstream out(filename.c_str());
+	if(! out.good()) {
+		std::cerr << "cannot create " << filename << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	out << "# <begin> <end> <cost>" << std::endl;
+	for(auto & c: chunks) {
+		out << c.begin << " " << c.end << " " << c.cost << std::endl;
+	}
+}
+
+const std::vector<ClusterPlan::Chunk> & ClusterPlan::getChunks() const {
+	return chunks;
+}
+
+const std::vector<ClusterPlan::Chunk> & ClusterPlan::getClusters() const {
+	return clusters;
+}
+
+Double_t ClusterPlan::getTotalCost() const {
+	Double_t total = 0;
+	for(auto & c: clusters) total += c.cost;
+	return total;
+}
+
+Double_t ClusterPlan::getMaxCost() const {
+	Double_t maxCost = 0;
+	for(auto & c: chunks) maxCost = std::max(maxCost, c.cost);
+	return maxCost;
+}
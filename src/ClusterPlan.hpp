@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+
+#include <TMath.h>
+
+class TTree;
+
+/**
+ * @brief Splits the entries [begin, end) of a tree into chunks aligned to the TTree clusters.
+ *
+ * The cost of an event is modelled as baseCost + jetCost * (nhJets + naJets); the cost of
+ * each cluster is estimated from a sample of its events (every event if samplesPerCluster == 0,
+ * none if samplesPerCluster < 0: then the cost is baseCost per event and the tree isn't read).
+ * The clusters are either read from the tree or given as boundaries (e.g. from MetaCache).
+ * The contiguous chunks are chosen so that the cost of the most expensive chunk is minimal,
+ * hence no two chunks share a basket and the slowest job finishes close to the mean.
+ *
+ * The plan is written as plain text, one chunk per line: "<begin> <end> <cost>".
+ */
+class ClusterPlan {
+public:
+	struct Chunk {
+		Long64_t begin;
+		Long64_t end;
+		Double_t cost;
+	};
+	ClusterPlan();
+	ClusterPlan(std::string filename);
+	void findClusters(TTree * t, std::string filename, Long64_t beginEvent, Long64_t endEvent);
+	void setClusters(const std::vector<Long64_t> & boundaries, Long64_t beginEvent, Long64_t endEvent);
+	void estimateCost(TTree * t, std::string filename, Int_t samplesPerCluster, Double_t baseCost, Double_t jetCost);
+	void split(Int_t nChunks);
+	void write(std::string filename) const;
+	const std::vector<Chunk> & getChunks() const;
+	const std::vector<Chunk> & getClusters() const;
+	Double_t getTotalCost() const;
+	Double_t getMaxCost() const;
+private:
+	std::vector<Chunk> clusters;
+	std::vector<Chunk> chunks;
+};
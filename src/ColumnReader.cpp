@@ -0,0 +1,205 @@
+#include "ColumnReader.hpp"
+#include "SkimCache.hpp"
+
+#include <cstdlib> // std::exit(), EXIT_FAILURE
+#include <cstring> // std::memcpy()
+#include <iostream> // std::cerr, std::endl
+#include <algorithm> // std::min(), std::max()
+#include <mutex> // std::once_flag, std::call_once()
+#include <stdexcept> // std::runtime_error
+
+#include <RVersion.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TBranch.h>
+#include <TLeaf.h>
+#include <TDirectory.h>
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+#include <TROOT.h>
+#else
+#include <TThread.h>
+#endif
+
+namespace {
+	const Long64_t maxBlockSize = 65536; // entries per block, if the cluster is larger
+	const Long64_t cacheSize = 30000000; // TTreeCache size in bytes
+	const Long64_t pairwiseBlock = 256; // below this the partial sums are added directly
+
+	std::once_flag threadSafetyFlag;
+	void enableThreadSafety() {
+		std::call_once(threadSafetyFlag, [] () -> void {
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+			ROOT::EnableThreadSafety();
+#else
+			TThread::Initialize();
+#endif
+		});
+	}
+}
+
+ColumnReader::ColumnReader(std::string filename, std::string treeName, Long64_t beginEvent, Long64_t endEvent)
+	: filename(filename), beginEvent(beginEvent), endEvent(endEvent), file(0), t(0), skim(0),
+	  first(beginEvent), size(0), nextEntry(beginEvent), started(false) {
+	Long64_t nEntries;
+	if(SkimCache::isSkim(filename)) {
+		try {
+			skim = new SkimCache(filename);
+		}
+		catch(std::runtime_error & e) { // SkimCache throws for the daemon, the columns stop the program as before
+			std::cerr << e.what() << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		nEntries = skim -> getEntries();
+	}
+	else {
+		enableThreadSafety();
+		// the file is opened here so that gDirectory of the caller stays intact
+		TDirectory::TContext context;
+		file = TFile::Open(filename.c_str(), "read");
+		if(! file || file -> IsZombie() || ! file -> IsOpen()) {
+			std::cerr << "error on opening " << filename << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		t = dynamic_cast<TTree *> (file -> Get(treeName.c_str()));
+		if(! t) {
+			std::cerr << "error on accessing tree " << treeName << " in " << filename << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		nEntries = t -> GetEntries();
+	}
+	if(this -> endEvent < 0 || this -> endEvent > nEntries) this -> endEvent = nEntries;
+}
+
+ColumnReader::~ColumnReader() {
+	if(file) {
+		file -> Close();
+		delete file;
+	}
+	delete skim;
+}
+
+std::size_t ColumnReader::addBranch(std::string name, std::size_t size) {
+	if(started) {
+		std::cerr << "column " << name << " registered after the first block has been read" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	Column c;
+	c.name = name;
+	c.size = size;
+	c.branch = 0;
+	c.skimData = 0;
+	if(skim) {
+		const SkimCache::Column * column = skim -> getColumn(name);
+		if(! column || column -> kind != SkimCache::kEvent || std::size_t(column -> size) != size) {
+			std::cerr << "no column " << name << " of " << size << " bytes per event in skim " << filename << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		c.skimData = skim -> getData(column);
+	}
+	else {
+		c.branch = t -> GetBranch(name.c_str());
+		TLeaf * leaf = c.branch ? c.branch -> GetLeaf(name.c_str()) : 0;
+		if(! leaf || std::size_t(leaf -> GetLenType()) != size || leaf -> GetLenStatic() != 1 || leaf -> GetLeafCount()) {
+			std::cerr << "no scalar branch " << name << " of " << size << " bytes in " << filename << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+	}
+	columns.push_back(c);
+	return columns.size() - 1;
+}
+
+void ColumnReader::start() {
+	started = true;
+	if(skim) return;
+	t -> SetBranchStatus("*", 0);
+	for(auto & c: columns) t -> SetBranchStatus(c.name.c_str(), 1);
+	t -> SetCacheSize(cacheSize);
+	t -> SetCacheEntryRange(beginEvent, endEvent);
+	for(auto & c: columns) t -> AddBranchToCache(c.name.c_str(), kTRUE);
+	t -> StopCacheLearningPhase();
+}
+
+void ColumnReader::read(Long64_t first, Long64_t size) {
+	if(! started) start();
+	size = std::max(Long64_t(0), std::min(size, endEvent - first));
+	this -> first = first;
+	this -> size = size;
+	if(skim) return;
+	for(auto & c: columns) {
+		c.data.resize(size * c.size);
+		char * column = c.data.empty() ? 0 : &c.data[0];
+		char value[8];
+		c.branch -> SetAddress(value);
+		for(Long64_t i = 0; i < size; ++i) {
+			if(c.branch -> GetEntry(first + i) <= 0) {
+				std::cerr << "error on reading " << c.name << " from " << filename << " at entry " << (first + i) << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+			std::memcpy(column + i * c.size, value, c.size);
+		}
+	}
+}
+
+bool ColumnReader::next() {
+	if(nextEntry >= endEvent) return false;
+	Long64_t blockEnd = std::min(nextEntry + maxBlockSize, endEvent);
+	if(t) {
+		// one block per cluster (or a part of it), so that the baskets of a block are read together
+		TTree::TClusterIterator clusters = t -> GetClusterIterator(nextEntry);
+		clusters();
+		blockEnd = std::min(blockEnd, std::max(clusters.GetNextEntry(), nextEntry + 1));
+	}
+	read(nextEntry, blockEnd - nextEntry);
+	nextEntry = blockEnd;
+	return true;
+}
+
+Long64_t ColumnReader::getFirst() const {
+	return first;
+}
+
+Long64_t ColumnReader::getSize() const {
+	return size;
+}
+
+Long64_t ColumnReader::getBeginEvent() const {
+	return beginEvent;
+}
+
+Long64_t ColumnReader::getEndEvent() const {
+	return endEvent;
+}
+
+const void * ColumnReader::getData(std::size_t index) const {
+	const Column & c = columns[index];
+	if(c.skimData) return c.skimData + first * c.size;
+	return c.data.empty() ? 0 : &c.data[0];
+}
+
+Double_t ColumnReader::sum(const Float_t * x, Long64_t n) {
+	if(n > pairwiseBlock) {
+		Long64_t half = (n / 2 + 7) / 8 * 8;
+		return sum(x, half) + sum(x + half, n - half);
+	}
+	// eight independent partial sums, which the compiler keeps in vector registers
+	Double_t s[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	Long64_t i = 0;
+	for(; i + 8 <= n; i += 8) {
+		for(int l = 0; l < 8; ++l) s[l] += x[i + l];
+	}
+	Double_t rest = 0;
+	for(; i < n; ++i) rest += x[i];
+	return ((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7])) + rest;
+}
+
+Long64_t ColumnReader::sum(const Int_t * x, Long64_t n) {
+	Long64_t s = 0;
+	for(Long64_t i = 0; i < n; ++i) s += x[i];
+	return s;
+}
+
+Long64_t ColumnReader::count(const Int_t * x, Long64_t n, Int_t value) {
+	Long64_t s = 0;
+	for(Long64_t i = 0; i < n; ++i) s += (x[i] == value);
+	return s;
+}
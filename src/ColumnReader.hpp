@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+
+#include <TMath.h>
+
+class TFile;
+class TTree;
+class TBranch;
+class SkimCache;
+
+/**
+ * @brief Reads blocks of entries of scalar branches into contiguous columns.
+ *
+ * Within a block the branches are read one after another (TBranch::GetEntry() of the single branch),
+ * so that every basket is decompressed once and its values are copied into a plain array;
+ * the reductions below then run over these arrays without touching the tree.
+ * If the file is a skim (see SkimCache), the columns point into the memory-mapped file.
+ *
+ * The reader opens its own file, hence readers of different files may be used on different threads.
+ */
+class ColumnReader {
+public:
+	ColumnReader(std::string filename, std::string treeName, Long64_t beginEvent, Long64_t endEvent);
+	~ColumnReader();
+	template<typename T>
+	std::size_t addColumn(std::string name) {
+		return addBranch(name, sizeof(T));
+	}
+	bool next();
+	void read(Long64_t first, Long64_t size);
+	Long64_t getFirst() const;
+	Long64_t getSize() const;
+	Long64_t getBeginEvent() const;
+	Long64_t getEndEvent() const;
+	template<typename T>
+	const T * getColumn(std::size_t index) const {
+		return static_cast<const T *> (getData(index));
+	}
+	static Double_t sum(const Float_t * x, Long64_t n);
+	static Long64_t sum(const Int_t * x, Long64_t n);
+	static Long64_t count(const Int_t * x, Long64_t n, Int_t value);
+private:
+	struct Column {
+		std::string name;
+		std::size_t size;
+		TBranch * branch;
+		const char * skimData;
+		std::vector<char> data;
+	};
+	std::size_t addBranch(std::string name, std::size_t size);
+	const void * getData(std::size_t index) const;
+	void start();
+
+	std::string filename;
+	Long64_t beginEvent;
+	Long64_t endEvent;
+	TFile * file;
+	TTree * t;
+	SkimCache * skim;
+	std::vector<Column> columns;
+	Long64_t first;
+	Long64_t size;
+	Long64_t nextEntry; // of next()
+	bool started;
+};
@@ -0,0 +1,263 @@
+#include "CutExpression.hpp"
+
+#include <algorithm> // std::find(), std::swap()
+#include <cctype> // std::isdigit(), std::isalpha(), std::isalnum(), std::isspace()
+#include <cmath> // std::fabs()
+#include <cstdlib> // std::exit(), EXIT_FAILURE, std::strtod()
+#include <functional> // std::less<>, std::less_equal<>, std::greater<>, std::greater_equal<>, std::equal_to<>, std::not_equal_to<>
+#include <iostream> // std::cerr, std::endl
+
+namespace {
+	// the comparison of a column (or its absolute value) with a number, the usual cut; no branch per object
+	template<typename Compare>
+	std::size_t compare(const Float_t * column, bool absolute, Double_t number, const UInt_t * candidates, std::size_t n, UInt_t * selected, Compare c) {
+		std::size_t m = 0;
+		if(absolute) {
+			for(std::size_t k = 0; k < n; ++k) {
+				UInt_t i = candidates[k];
+				selected[m] = i;
+				m += c(std::fabs(column[i]), number);
+			}
+		}
+		else {
+			for(std::size_t k = 0; k < n; ++k) {
+				UInt_t i = candidates[k];
+				selected[m] = i;
+				m += c(column[i], number);
+			}
+		}
+		return m;
+	}
+	
+	// the candidates not in 'passed' (a subsequence of them)
+	std::size_t complement(const UInt_t * candidates, std::size_t n, const UInt_t * passed, std::size_t nPassed, UInt_t * selected) {
+		std::size_t m = 0, p = 0;
+		for(std::size_t k = 0; k < n; ++k) {
+			UInt_t i = candidates[k];
+			if(p < nPassed && passed[p] == i) ++p;
+			else selected[m++] = i;
+		}
+		return m;
+	}
+}
+
+CutExpression::CutExpression(std::string expression, const std::vector<std::string> & variables)
+	: expression(expression), variables(variables), root(-1), position(0) {
+	root = parseOr();
+	skipSpaces();
+	if(position < expression.size()) fail("unexpected \"" + expression.substr(position) + "\"");
+}
+
+std::string CutExpression::getExpression() const {
+	return expression;
+}
+
+std::size_t CutExpression::select(const Float_t * const * columns, const UInt_t * candidates, std::size_t n, UInt_t * selected, Workspace & workspace) const {
+	if(workspace.lists.size() < 3 * nodes.size()) workspace.lists.resize(3 * nodes.size());
+	return select(root, columns, candidates, n, selected, workspace);
+}
+
+/*********** parser ****/
+
+Int_t CutExpression::addNode(Code code, Int_t left, Int_t right, Int_t variable, Double_t number) {
+	Node node = { code, left, right, variable, number };
+	nodes.push_back(node);
+	return nodes.size() - 1;
+}
+
+void CutExpression::fail(std::string what) const {
+	std::cerr << "cannot parse the cut \"" << expression << "\" at position " << position << ": " << what << std::endl;
+	std::exit(EXIT_FAILURE);
+}
+
+void CutExpression::skipSpaces() {
+	while(position < expression.size() && std::isspace(expression[position])) ++position;
+}
+
+bool CutExpression::accept(std::string token) {
+	skipSpaces();
+	if(expression.compare(position, token.size(), token) != 0) return false;
+	position += token.size();
+	return true;
+}
+
+Int_t CutExpression::parseOr() {
+	Int_t left = parseAnd();
+	while(accept("||")) {
+		Int_t right = parseAnd();
+		left = addNode(kOr, left, right);
+	}
+	return left;
+}
+
+Int_t CutExpression::parseAnd() {
+	Int_t left = parseUnary();
+	while(accept("&&")) {
+		Int_t right = parseUnary();
+		left = addNode(kAnd, left, right);
+	}
+	return left;
+}
+
+Int_t CutExpression::parseUnary() {
+	if(accept("!")) {
+		Int_t child = parseUnary();
+		return addNode(kNot, child, -1);
+	}
+	if(accept("(")) {
+		Int_t index = parseOr();
+		if(! accept(")")) fail("missing \")\"");
+		return index;
+	}
+	return parseComparison();
+}
+
+Int_t CutExpression::parseComparison() {
+	Int_t left = parseValue();
+	Code code;
+	if		(accept("<=")) code = kLessEqual;
+	else if	(accept("<")) code = kLess;
+	else if	(accept(">=")) code = kGreaterEqual;
+	else if	(accept(">")) code = kGreater;
+	else if	(accept("==")) code = kEqual;
+	else if	(accept("!=")) code = kNotEqual;
+	else {
+		fail("expected <, <=, >, >=, == or !=");
+		return -1;
+	}
+	Int_t right = parseValue();
+	// the number goes to the right, for the fast comparison
+	if(nodes[left].code == kNumber && nodes[right].code != kNumber) {
+		std::swap(left, right);
+		if		(code == kLess) code = kGreater;
+		else if	(code == kLessEqual) code = kGreaterEqual;
+		else if	(code == kGreater) code = kLess;
+		else if	(code == kGreaterEqual) code = kLessEqual;
+	}
+	return addNode(code, left, right);
+}
+
+Int_t CutExpression::parseValue() {
+	skipSpaces();
+	if(position >= expression.size()) {
+		fail("unexpected end");
+		return -1;
+	}
+	char c = expression[position];
+	if(std::isdigit(c) || c == '.' || c == '-' || c == '+') {
+		const char * begin = expression.c_str() + position;
+		char * end;
+		Double_t number = std::strtod(begin, &end);
+		if(end == begin) {
+			fail("expected a number");
+			return -1;
+		}
+		position += end - begin;
+		return addNode(kNumber, -1, -1, -1, number);
+	}
+	if(std::isalpha(c) || c == '_') {
+		std::size_t begin = position;
+		while(position < expression.size() && (std::isalnum(expression[position]) || expression[position] == '_')) ++position;
+		std::string name = expression.substr(begin, position - begin);
+		if(name == "abs" && accept("(")) {
+			Int_t value = parseValue();
+			if(! accept(")")) fail("missing \")\"");
+			if(nodes[value].code == kNumber) {
+				nodes[value].number = std::fabs(nodes[value].number);
+				return value;
+			}
+			if(nodes[value].code == kAbs) return value;
+			return addNode(kAbs, value, -1);
+		}
+		auto it = std::find(variables.begin(), variables.end(), name);
+		if(it == variables.end()) {
+			std::string known;
+			for(auto & v: variables) known += " " + v;
+			fail("unknown variable " + name + " (known:" + known + ")");
+		}
+		return addNode(kVariable, -1, -1, it - variables.begin());
+	}
+	fail("expected a variable or a number");
+	return -1;
+}
+
+/*********** evaluation ****/
+
+Double_t CutExpression::getValue(Int_t index, const Float_t * const * columns, UInt_t i) const {
+	const Node & node = nodes[index];
+	switch(node.code) {
+		case kVariable:	return columns[node.variable][i];
+		case kNumber:	return node.number;
+		case kAbs:		return std::fabs(getValue(node.left, columns, i));
+		default:		return 0; // not a value
+	}
+}
+
+std::size_t CutExpression::select(Int_t index, const Float_t * const * columns, const UInt_t * candidates, std::size_t n, UInt_t * selected, Workspace & workspace) const {
+	const Node & node = nodes[index];
+	auto getList = [&workspace, index, n] (int k) -> UInt_t * {
+		std::vector<UInt_t> & list = workspace.lists[3 * index + k];
+		if(list.size() < n) list.resize(n);
+		return list.data();
+	};
+	if(node.code == kAnd) {
+		UInt_t * passed = getList(0);
+		std::size_t nPassed = select(node.left, columns, candidates, n, passed, workspace);
+		return select(node.right, columns, passed, nPassed, selected, workspace);
+	}
+	if(node.code == kOr) {
+		UInt_t * passedLeft = getList(0), * failedLeft = getList(1), * passedRight = getList(2);
+		std::size_t nLeft = select(node.left, columns, candidates, n, passedLeft, workspace);
+		std::size_t nFailed = complement(candidates, n, passedLeft, nLeft, failedLeft);
+		std::size_t nRight = select(node.right, columns, failedLeft, nFailed, passedRight, workspace);
+		// both are subsequences of the candidates, merged in their order
+		std::size_t m = 0, l = 0, r = 0;
+		for(std::size_t k = 0; k < n; ++k) {
+			UInt_t i = candidates[k];
+			if		(l < nLeft && passedLeft[l] == i) { selected[m++] = i; ++l; }
+			else if	(r < nRight && passedRight[r] == i) { selected[m++] = i; ++r; }
+		}
+		return m;
+	}
+	if(node.code == kNot) {
+		UInt_t * passed = getList(0);
+		std::size_t nPassed = select(node.left, columns, candidates, n, passed, workspace);
+		return complement(candidates, n, passed, nPassed, selected);
+	}
+	
+	// comparisons
+	const Node & left = nodes[node.left];
+	const Node & right = nodes[node.right];
+	const Node * variable = left.code == kAbs ? &nodes[left.left] : &left;
+	if(right.code == kNumber && variable -> code == kVariable) {
+		const Float_t * column = columns[variable -> variable];
+		bool absolute = left.code == kAbs;
+		switch(node.code) {
+			case kLess:			return compare(column, absolute, right.number, candidates, n, selected, std::less<Double_t>());
+			case kLessEqual:	return compare(column, absolute, right.number, candidates, n, selected, std::less_equal<Double_t>());
+			case kGreater:		return compare(column, absolute, right.number, candidates, n, selected, std::greater<Double_t>());
+			case kGreaterEqual:	return compare(column, absolute, right.number, candidates, n, selected, std::greater_equal<Double_t>());
+			case kEqual:		return compare(column, absolute, right.number, candidates, n, selected, std::equal_to<Double_t>());
+			case kNotEqual:		return compare(column, absolute, right.number, candidates, n, selected, std::not_equal_to<Double_t>());
+			default:			break;
+		}
+	}
+	std::size_t m = 0;
+	for(std::size_t k = 0; k < n; ++k) {
+		UInt_t i = candidates[k];
+		Double_t a = getValue(node.left, columns, i), b = getValue(node.right, columns, i);
+		bool pass = false;
+		switch(node.code) {
+			case kLess:			pass = a < b; break;
+			case kLessEqual:	pass = a <= b; break;
+			case kGreater:		pass = a > b; break;
+			case kGreaterEqual:	pass = a >= b; break;
+			case kEqual:		pass = a == b; break;
+			case kNotEqual:		pass = a != b; break;
+			default:			break;
+		}
+		selected[m] = i;
+		m += pass;
+	}
+	return m;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef> // std::size_t
+#include <string> // std::string
+#include <vector> // std::vector<>
+
+#include <TMath.h>
+
+/**
+ * @brief A cut such as "pt > 30 && abs(eta) < 2.5", compiled once and applied to batches of objects.
+ *
+ * Grammar: comparisons (<, <=, >, >=, ==, !=) of variables, numbers and abs(...), combined with &&, || and !
+ * and grouped by parentheses. The variables are those given to the constructor; an unknown variable or a syntax error
+ * stops the program. The values are compared in double precision, as the hand-written cuts did.
+ *
+ * The objects are passed as columns (one Float_t array per variable, in the order of the constructor) and a list of
+ * the indices in question. The expression is a flat array of nodes, evaluated on such lists: the right side of && only
+ * sees the indices passing the left side, that of || only the failing ones, hence the cut short-circuits per object.
+ */
+class CutExpression {
+public:
+	/**
+	 * @brief Scratch lists of select(); a thread needs its own.
+	 */
+	class Workspace {
+		friend class CutExpression;
+		std::vector<std::vector<UInt_t> > lists;
+	};
+	CutExpression(std::string expression, const std::vector<std::string> & variables);
+	std::string getExpression() const;
+	/**
+	 * @brief Writes the indices of 'candidates' (n of them) passing the cut to 'selected', in the same order.
+	 * 'selected' may be 'candidates'.
+	 * @return the number of selected indices
+	 */
+	std::size_t select(const Float_t * const * columns, const UInt_t * candidates, std::size_t n, UInt_t * selected, Workspace & workspace) const;
+private:
+	enum Code { kVariable, kNumber, kAbs, kLess, kLessEqual, kGreater, kGreaterEqual, kEqual, kNotEqual, kAnd, kOr, kNot };
+	struct Node {
+		Code code;
+		Int_t left; // index of the node, -1 if none
+		Int_t right;
+		Int_t variable; // kVariable
+		Double_t number; // kNumber
+	};
+	std::string expression;
+	std::vector<std::string> variables;
+	std::vector<Node> nodes;
+	Int_t root;
+	std::size_t position; // of the parser
+	
+	Int_t addNode(Code code, Int_t left, Int_t right, Int_t variable = -1, Double_t number = 0);
+	void fail(std::string what) const;
+	void skipSpaces();
+	bool accept(std::string token);
+	Int_t parseOr();
+	Int_t parseAnd();
+	Int_t parseUnary();
+	Int_t parseComparison();
+	Int_t parseValue();
+	
+	Double_t getValue(Int_t index, const Float_t * const * columns, UInt_t i) const;
+	std::size_t select(Int_t index, const Float_t * const * columns, const UInt_t * candidates, std::size_t n, UInt_t * selected, Workspace & workspace) const;
+};
@@ -0,0 +1,37 @@
+#include "EfficiencyScan.hpp"
+
+#include <cmath> // std::sqrt()
+#include <algorithm> // std::upper_bound()
+
+#include <TH1.h>
+#include <TAxis.h>
+
+EfficiencyScan::EfficiencyScan(const TH1 * h)
+	: nBins(h -> GetNbinsX()), xMin(h -> GetXaxis() -> GetXmin()), xMax(h -> GetXaxis() -> GetXmax()),
+	  isVariable(h -> GetXaxis() -> IsVariableBinSize()), above(nBins + 2, 0), above2(nBins + 2, 0) {
+	for(Int_t bin = 1; bin <= nBins + 1; ++bin) edges.push_back(h -> GetXaxis() -> GetBinLowEdge(bin));
+	Double_t integral = h -> Integral();
+	Double_t factor = (integral != 0) ? 1.0 / integral : 1;
+	for(Int_t bin = nBins; bin >= 0; --bin) {
+		Double_t error = h -> GetBinError(bin);
+		above[bin] = above[bin + 1] + h -> GetBinContent(bin) * factor;
+		above2[bin] = above2[bin + 1] + error * error * factor * factor;
+	}
+}
+
+Int_t EfficiencyScan::findBin(Double_t x) const {
+	if(x < xMin) return 0;
+	if(! (x < xMax)) return nBins + 1;
+	if(isVariable) return std::upper_bound(edges.begin(), edges.end(), x) - edges.begin();
+	return 1 + Int_t(nBins * (x - xMin) / (xMax - xMin));
+}
+
+Double_t EfficiencyScan::getEfficiency(Double_t threshold, Double_t & error) const {
+	Int_t bin = findBin(threshold);
+	error = std::sqrt(above2[bin]);
+	return above[bin];
+}
+
+Int_t EfficiencyScan::getNbins() const {
+	return nBins;
+}
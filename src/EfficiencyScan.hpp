@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector> // std::vector<>
+
+#include <TMath.h>
+
+class TH1;
+
+/**
+ * @brief Efficiency above a threshold, i.e. the normalized integral from the threshold bin up to the last bin, and its error.
+ *
+ * The suffix sums of the bin contents and of the squared bin errors are built once, hence
+ * getEfficiency() returns the same values as h -> Scale(1 / h -> Integral()) followed by
+ * h -> IntegralAndError(h -> FindBin(threshold), h -> GetNbinsX(), error) in O(1)
+ * (O(log n) for variable bin sizes) without touching the histogram again.
+ */
+class EfficiencyScan {
+public:
+	EfficiencyScan(const TH1 * h);
+	Int_t findBin(Double_t x) const;
+	Double_t getEfficiency(Double_t threshold, Double_t & error) const;
+	Int_t getNbins() const;
+private:
+	Int_t nBins;
+	Double_t xMin, xMax;
+	bool isVariable;
+	std::vector<Double_t> edges;
+	std::vector<Double_t> above; // above[b]: sum of the normalized contents of the bins b..nBins (b = 0 is the underflow)
+	std::vector<Double_t> above2; // the same for the squared errors
+};
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <vector> // std::vector<>
+#include <algorithm> // std::sort(), std::prev_permutation(), std::fill()
+#include <random> // std::mt19937_64, std::uniform_real_distribution<>
+#include <cmath> // std::fabs()
+
+#include <TMath.h>
+#include <TH1F.h>
+
+#include "common.hpp"
+#include "Arena.hpp"
+
+/**
+ * @brief The per-event work of analyze.cpp and gsample.cpp with their modes as a policy.
+ *
+ * The kernels are templates of the modes: StaticAnalyzeModes<...> / StaticSampleModes<...> fix them at compile time,
+ * so every combination is instantiated with the unused branches removed, and getAnalyzeKernel() / getSampleKernel()
+ * pick the instantiation once at startup. RuntimeAnalyzeModes / RuntimeSampleModes run the same code with the modes
+ * tested per event and jet, as the tools did before (loopbench.cpp compares the two).
+ * The random numbers are drawn in the same order as before, hence the outputs don't change.
+ * The scratch arrays of analyzeKernel() are taken from Arena::local(), which the caller resets at each event;
+ * the kernels don't allocate from the heap. The bin ids precomputed by skim.cpp are used if given (otherwise getBinId()).
+ *
+ * @note Uses common.hpp, so it's included by the tools only.
+ */
+
+const int maxNumberOfHJets = 2;
+const int maxNumberOfAJets = 20;
+
+/*********** analyze.cpp ****/
+
+template<bool SampleOnce, bool SampleMultiple, bool UseAnalytic, bool RealCSV, bool RequireExact>
+struct StaticAnalyzeModes {
+	bool sampleOnce() const { return SampleOnce; }
+	bool sampleMultiple() const { return SampleMultiple; }
+	bool useAnalytic() const { return UseAnalytic; }
+	bool realCSV() const { return RealCSV; }
+	bool requireExact() const { return RequireExact; }
+};
+
+struct RuntimeAnalyzeModes {
+	bool once, multiple, analytic, real, exact;
+	bool sampleOnce() const { return once; }
+	bool sampleMultiple() const { return multiple; }
+	bool useAnalytic() const { return analytic; }
+	bool realCSV() const { return real; }
+	bool requireExact() const { return exact; }
+};
+
+/** @brief The constant inputs of the analyze kernel; the tables are indexed by getBinId(). */
+struct AnalyzeSetup {
+	Int_t requiredJets, requiredBtags, nIterMax;
+	Float_t workingPoint;
+	std::vector<TH1F *> histograms; // sampled with GetRandom() (-s, -m)
+	std::vector<Float_t> probabilities; // the analytic probabilities (-a)
+};
+
+/** @brief The jets of an event and the results of the analyze kernel. */
+struct AnalyzeEvent {
+	Int_t nhJets, naJets;
+	const Float_t * hJet_pt, * hJet_eta, * hJet_flavour, * hJet_csv;
+	const Float_t * aJet_pt, * aJet_eta, * aJet_flavour, * aJet_csv;
+	const Int_t * hJet_binId = 0, * aJet_binId = 0; // the bin ids of a skim, if any
+	Float_t * hJet_csvGen, * aJet_csvGen; // written if sampleOnce()
+	Int_t nPassed; // the selected jets, by descending pt
+	Int_t binIds[maxNumberOfHJets + maxNumberOfAJets];
+	Float_t mProb, aProb;
+	Int_t count, realCount;
+};
+
+/**
+ * @brief Probability that exactly K of the first N jets are tagged (the combinations of analyze.cpp).
+ * N is at most the number of jets of an event.
+ */
+inline Float_t combineProbabilities(const Float_t * v, int N, int K) {
+	char bitmask[maxNumberOfHJets + maxNumberOfAJets];
+	std::fill(bitmask, bitmask + K, 1); // K leading 1's
+	std::fill(bitmask + K, bitmask + N, 0); // N-K trailing 0's
+	Float_t sum_prob = 0;
+	do {
+		Float_t prob = 1;
+		for(int i = 0; i < N; ++i) {
+			if(bitmask[i]) prob *= v[i];
+			else prob *= (1 - v[i]);
+		}
+		sum_prob += prob;
+	} while(std::prev_permutation(bitmask, bitmask + N));
+	return sum_prob;
+}
+
+/**
+ * @brief Selects the jets and finds the b-tag quantities of the modes of one event; false if the event is skipped.
+ */
+template<class Modes>
+bool analyzeKernel(const AnalyzeSetup & s, AnalyzeEvent & e, const Modes & modes) {
+	struct SortedJet {
+		Float_t pt, eta, flavor, csv;
+		Int_t index;
+		bool isHJet;
+	};
+	Arena & arena = Arena::local();
+	SortedJet * jets = arena.allocate<SortedJet>(e.nhJets + e.naJets);
+	Int_t n = 0;
+	for(Int_t j = 0; j < e.nhJets; ++j) {
+		SortedJet jet = { e.hJet_pt[j], e.hJet_eta[j], e.hJet_flavour[j], e.hJet_csv[j], j, true };
+		jets[n++] = jet;
+	}
+	for(Int_t j = 0; j < e.naJets; ++j) {
+		SortedJet jet = { e.aJet_pt[j], e.aJet_eta[j], e.aJet_flavour[j], e.aJet_csv[j], j, false };
+		jets[n++] = jet;
+	}
+	// the same comparisons as JetCollection::sortPt(), hence the same order
+	std::sort(jets, jets + n, [] (SortedJet J1, SortedJet J2) -> bool {
+		return J1.pt > J2.pt;
+	});
+
+	const SortedJet ** passed = arena.allocate<const SortedJet *>(n);
+	e.nPassed = 0;
+	for(Int_t i = 0; i < n; ++i) {
+		if(jets[i].pt < 20 || std::fabs(jets[i].eta) >= 2.5) continue;
+		passed[e.nPassed] = &jets[i];
+		if(! e.hJet_binId) e.binIds[e.nPassed] = getBinId(jets[i].flavor, jets[i].pt, jets[i].eta);
+		else e.binIds[e.nPassed] = jets[i].isHJet ? e.hJet_binId[jets[i].index] : e.aJet_binId[jets[i].index];
+		++e.nPassed;
+		if(! modes.requireExact() && e.nPassed == s.requiredJets) break; // only first 'requiredJets' jets
+	}
+	if(e.nPassed != s.requiredJets) return false; // skip the event
+
+	// a jet out of the bins has no histogram, it's never tagged
+	auto sample = [&s] (Int_t binId) -> Float_t {
+		TH1F * h = (binId < 0) ? 0 : s.histograms[binId];
+		return h ? h -> GetRandom() : -1;
+	};
+	if(modes.sampleMultiple()) {
+		Int_t nPass = 0;
+		for(Int_t iterations = 1; iterations <= s.nIterMax; ++iterations) {
+			Int_t btagCounter = 0;
+			for(Int_t j = 0; j < e.nPassed; ++j) btagCounter += (sample(e.binIds[j]) >= s.workingPoint);
+			nPass += (btagCounter == s.requiredBtags);
+		}
+		e.mProb = Float_t(nPass) / s.nIterMax;
+	}
+	if(modes.useAnalytic()) {
+		Float_t * individual = arena.allocate<Float_t>(e.nPassed);
+		for(Int_t j = 0; j < e.nPassed; ++j) individual[j] = (e.binIds[j] < 0) ? 0 : s.probabilities[e.binIds[j]];
+		e.aProb = combineProbabilities(individual, s.requiredJets, s.requiredBtags);
+	}
+	if(modes.sampleOnce()) {
+		for(Int_t j = 0; j < e.nhJets; ++j) e.hJet_csvGen[j] = -1.0;
+		for(Int_t j = 0; j < e.naJets; ++j) e.aJet_csvGen[j] = -1.0;
+		e.count = 0;
+		for(Int_t j = 0; j < e.nPassed; ++j) {
+			Float_t r = sample(e.binIds[j]);
+			(passed[j] -> isHJet ? e.hJet_csvGen : e.aJet_csvGen)[passed[j] -> index] = r;
+			e.count += (r >= s.workingPoint);
+		}
+	}
+	if(modes.realCSV()) {
+		e.realCount = 0;
+		for(Int_t j = 0; j < e.nPassed; ++j) e.realCount += (passed[j] -> csv >= s.workingPoint);
+	}
+	return true;
+}
+
+typedef bool (*AnalyzeKernel)(const AnalyzeSetup &, AnalyzeEvent &);
+
+template<bool SampleOnce, bool SampleMultiple, bool UseAnalytic, bool RealCSV, bool RequireExact>
+bool staticAnalyzeKernel(const AnalyzeSetup & s, AnalyzeEvent & e) {
+	return analyzeKernel(s, e, StaticAnalyzeModes<SampleOnce, SampleMultiple, UseAnalytic, RealCSV, RequireExact>());
+}
+
+// one mode at a time, from the first to the last
+template<bool A, bool B, bool C, bool D>
+AnalyzeKernel getAnalyzeKernel(bool e) {
+	return e ? &staticAnalyzeKernel<A, B, C, D, true> : &staticAnalyzeKernel<A, B, C, D, false>;
+}
+template<bool A, bool B, bool C>
+AnalyzeKernel getAnalyzeKernel(bool d, bool e) {
+	return d ? getAnalyzeKernel<A, B, C, true>(e) : getAnalyzeKernel<A, B, C, false>(e);
+}
+template<bool A, bool B>
+AnalyzeKernel getAnalyzeKernel(bool c, bool d, bool e) {
+	return c ? getAnalyzeKernel<A, B, true>(d, e) : getAnalyzeKernel<A, B, false>(d, e);
+}
+template<bool A>
+AnalyzeKernel getAnalyzeKernel(bool b, bool c, bool d, bool e) {
+	return b ? getAnalyzeKernel<A, true>(c, d, e) : getAnalyzeKernel<A, false>(c, d, e);
+}
+
+/**
+ * @brief The instantiation of the analyze kernel for the given modes.
+ */
+inline AnalyzeKernel getAnalyzeKernel(const RuntimeAnalyzeModes & m) {
+	return m.once ? getAnalyzeKernel<true>(m.multiple, m.analytic, m.real, m.exact)
+				  : getAnalyzeKernel<false>(m.multiple, m.analytic, m.real, m.exact);
+}
+
+/*********** gsample.cpp ****/
+
+template<bool UseCumul, bool SampleALot>
+struct StaticSampleModes {
+	bool useCumul() const { return UseCumul; }
+	bool sampleALot() const { return SampleALot; }
+};
+
+struct RuntimeSampleModes {
+	bool cumul, aLot;
+	bool useCumul() const { return cumul; }
+	bool sampleALot() const { return aLot; }
+};
+
+/** @brief The constant inputs of the sample kernel; the tables are indexed by getBinId(). */
+struct SampleSetup {
+	Float_t workingPoint;
+	Int_t maxSamples;
+	std::vector<TH1F *> cumulatives; // if useCumul()
+	std::vector<TH1F *> histograms; // otherwise
+};
+
+/**
+ * @brief The CSV value of the cumulative distribution at r, by linear interpolation (the brute-force search of gsample.cpp).
+ */
+inline Float_t randLinpolEdge(TH1F * h, Float_t r) {
+	Int_t binMin = h -> GetMinimumBin(), binMax = h -> GetMaximumBin();
+	Int_t bin = binMin;
+	for( ; bin <= binMax; ++bin) {
+		if(h -> GetBinContent(bin) > r) break;
+	}
+	Float_t x1, y1, x2, y2;
+	x1 = h -> GetBinLowEdge(bin);
+	y1 = h -> GetBinContent(bin - 1);
+	x2 = h -> GetBinLowEdge(bin + 1);
+	y2 = h -> GetBinContent(bin);
+	return (r - y1) * (x2 - x1) / (y2 - y1) + x1;
+}
+
+/**
+ * @brief Generates the CSV values (and the number of tries if sampleALot()) of the jets of one collection.
+ * binIds are those of a skim, or null.
+ */
+template<class Modes>
+void sampleKernel(const SampleSetup & s, Int_t nJets, const Float_t * pt, const Float_t * eta, const Float_t * flavour, const Int_t * binIds,
+				  Float_t * csvGen, Long64_t * csvN, std::mt19937_64 & gen, const Modes & modes) {
+	std::uniform_real_distribution<Float_t> dis(0, 1);
+	auto draw = [&] (Int_t binId) -> Float_t {
+		if(modes.useCumul()) return randLinpolEdge(s.cumulatives[binId], dis(gen));
+		return s.histograms[binId] -> GetRandom();
+	};
+	for(Int_t j = 0; j < nJets; ++j) {
+		Int_t binId = binIds ? binIds[j] : getBinId(flavour[j], pt[j], eta[j]);
+		if(binId < 0) {
+			csvGen[j] = -1; // default value if not in the range
+			if(modes.sampleALot()) csvN[j] = -1;
+			continue;
+		}
+		if(! modes.sampleALot()) {
+			csvGen[j] = draw(binId);
+			continue;
+		}
+		Long64_t iterations = 1;
+		Double_t randomCSV = -2;
+		for(; iterations <= s.maxSamples; ++iterations) {
+			randomCSV = draw(binId);
+			if(randomCSV >= s.workingPoint) break;
+		}
+		if(randomCSV < s.workingPoint) {
+			csvGen[j] = -2;
+			csvN[j] = -2;
+		}
+		else {
+			csvGen[j] = randomCSV;
+			csvN[j] = iterations;
+		}
+	}
+}
+
+typedef void (*SampleKernel)(const SampleSetup &, Int_t, const Float_t *, const Float_t *, const Float_t *, const Int_t *,
+							 Float_t *, Long64_t *, std::mt19937_64 &);
+
+template<bool UseCumul, bool SampleALot>
+void staticSampleKernel(const SampleSetup & s, Int_t nJets, const Float_t * pt, const Float_t * eta, const Float_t * flavour, const Int_t * binIds,
+						Float_t * csvGen, Long64_t * csvN, std::mt19937_64 & gen) {
+	sampleKernel(s, nJets, pt, eta, flavour, binIds, csvGen, csvN, gen, StaticSampleModes<UseCumul, SampleALot>());
+}
+
+/**
+ * @brief The instantiation of the sample kernel for the given modes.
+ */
+inline SampleKernel getSampleKernel(const RuntimeSampleModes & m) {
+	if(m.cumul) return m.aLot ? &staticSampleKernel<true, true> : &staticSampleKernel<true, false>;
+	return m.aLot ? &staticSampleKernel<false, true> : &staticSampleKernel<false, false>;
+}
@@ -0,0 +1,256 @@
+#include "EventReader.hpp"
+#include "SkimCache.hpp"
+
+#include <cstring> // std::memcpy()
+#include <stdexcept> // std::runtime_error
+#include <algorithm> // std::min(), std::max()
+#include <chrono> // std::chrono
+
+#include <RVersion.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TDirectory.h>
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+#include <TROOT.h>
+#else
+#include <TThread.h>
+#endif
+
+namespace {
+	const Long64_t maxBlockSize = 10000; // events per block, if the cluster is larger
+	const Long64_t cacheSize = 30000000; // TTreeCache size in bytes
+
+	std::once_flag threadSafetyFlag;
+	void enableThreadSafety() {
+		std::call_once(threadSafetyFlag, [] () -> void {
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+			ROOT::EnableThreadSafety();
+#else
+			TThread::Initialize();
+#endif
+		});
+	}
+
+	Double_t secondsSince(std::chrono::steady_clock::time_point t0) {
+		return std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - t0).count();
+	}
+}
+
+EventReader::EventReader(TTree * t, std::string filename, Long64_t beginEvent, Long64_t endEvent, Int_t readAhead,
+						 const SkimCache * skim)
+	: t(t), filename(filename), beginEvent(beginEvent), endEvent(endEvent), readAhead(readAhead),
+	  rowSize(0), skim(skim), ownedSkim(0), currentEntry(beginEvent - 1), currentRow(0), readerFile(0), readerTree(0),
+	  started(false), finished(false), stopped(false), failed(false), waitTime(0), readTime(0) {
+	if(! skim && SkimCache::isSkim(filename)) {
+		ownedSkim = new SkimCache(filename);
+		this -> skim = ownedSkim;
+	}
+	if(this -> skim) this -> readAhead = 0; // already in memory
+	Long64_t nEntries = this -> skim ? this -> skim -> getEntries() : t -> GetEntries();
+	if(this -> endEvent < 0 || this -> endEvent > nEntries) this -> endEvent = nEntries;
+	currentBlock.first = beginEvent;
+	currentBlock.size = 0;
+	if(this -> readAhead > 0) enableThreadSafety();
+}
+
+EventReader::~EventReader() {
+	if(readerThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopped = true;
+		}
+		queueNotFull.notify_all();
+		readerThread.join();
+	}
+	if(readerFile) {
+		readerFile -> Close();
+		delete readerFile;
+	}
+	delete ownedSkim;
+}
+
+void EventReader::addBranch(std::string name, void * address, std::size_t size) {
+	if(started) throw std::runtime_error("branch " + name + " registered after the event loop has started");
+	Branch b = { name, address, size, rowSize, 0 };
+	if(skim) {
+		const SkimCache::Column * c = skim -> getColumn(name);
+		if(! c) throw std::runtime_error("no column " + name + " in skim " + filename);
+		if((c -> kind == SkimCache::kEvent && std::size_t(c -> size) != size) || size % c -> size != 0) {
+			throw std::runtime_error("type of column " + name + " in skim " + filename + " doesn't match");
+		}
+		b.column = c;
+	}
+	branches.push_back(b);
+	rowSize += size;
+	if(readAhead <= 0 && ! skim) t -> SetBranchAddress(name.c_str(), address);
+}
+
+void EventReader::start() {
+	started = true;
+	if(readAhead <= 0) return;
+
+	// the file is opened here so that gDirectory of the main thread stays intact
+	TDirectory::TContext context;
+	readerFile = TFile::Open(filename.c_str(), "read");
+	if(! readerFile || readerFile -> IsZombie() || ! readerFile -> IsOpen()) {
+		throw std::runtime_error("Cannot open " + filename + " for the reader thread.");
+	}
+	readerTree = dynamic_cast<TTree *> (readerFile -> Get(t -> GetName()));
+	if(! readerTree) throw std::runtime_error("Cannot access tree " + std::string(t -> GetName()) + " in " + filename + ".");
+	readerThread = std::thread(&EventReader::readLoop, this);
+}
+
+void EventReader::readLoop() {
+	std::vector<char> row(rowSize);
+	readerTree -> SetBranchStatus("*", 0);
+	for(auto & b: branches) {
+		readerTree -> SetBranchStatus(b.name.c_str(), 1);
+		readerTree -> SetBranchAddress(b.name.c_str(), &row[b.offset]);
+	}
+	readerTree -> SetCacheSize(cacheSize);
+	readerTree -> SetCacheEntryRange(beginEvent, endEvent);
+	for(auto & b: branches) {
+		readerTree -> AddBranchToCache(b.name.c_str(), kTRUE);
+	}
+	readerTree -> StopCacheLearningPhase();
+
+	// one block per cluster (or a part of it), so that each basket is decompressed only once
+	TTree::TClusterIterator clusters = readerTree -> GetClusterIterator(beginEvent);
+	Long64_t clusterBegin;
+	while((clusterBegin = clusters()) < endEvent) {
+		Long64_t clusterEnd = std::min(clusters.GetNextEntry(), endEvent);
+		for(Long64_t first = std::max(clusterBegin, beginEvent); first < clusterEnd; first += maxBlockSize) {
+			Block block;
+			block.first = first;
+			block.size = std::min(maxBlockSize, clusterEnd - first);
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				if(! spareBuffers.empty()) {
+					block.data.swap(spareBuffers.back());
+					spareBuffers.pop_back();
+				}
+			}
+			block.data.resize(block.size * rowSize);
+
+			auto t0 = std::chrono::steady_clock::now();
+			for(Long64_t i = 0; i < block.size; ++i) {
+				if(readerTree -> GetEntry(first + i) <= 0) {
+					std::lock_guard<std::mutex> lock(queueMutex);
+					failed = true;
+					finished = true;
+					queueNotEmpty.notify_all();
+					return;
+				}
+				std::memcpy(&block.data[i * rowSize], &row[0], rowSize);
+			}
+
+			std::unique_lock<std::mutex> lock(queueMutex);
+			readTime += secondsSince(t0);
+			queueNotFull.wait(lock, [this] () -> bool {
+				return stopped || queue.size() < std::size_t(readAhead);
+			});
+			if(stopped) return;
+			queue.push_back(std::move(block));
+			queueNotEmpty.notify_one();
+		}
+	}
+	std::lock_guard<std::mutex> lock(queueMutex);
+	finished = true;
+	queueNotEmpty.notify_all();
+}
+
+bool EventReader::nextBlock() {
+	auto t0 = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock(queueMutex);
+	queueNotEmpty.wait(lock, [this] () -> bool {
+		return ! queue.empty() || finished;
+	});
+	waitTime += secondsSince(t0);
+	if(queue.empty()) {
+		if(failed) throw std::runtime_error("error on reading " + filename + " at entry " + std::to_string(currentEntry + 1));
+		return false;
+	}
+	spareBuffers.push_back(std::vector<char>());
+	spareBuffers.back().swap(currentBlock.data);
+	currentBlock = std::move(queue.front());
+	queue.pop_front();
+	currentRow = 0;
+	queueNotFull.notify_one();
+	return true;
+}
+
+bool EventReader::next() {
+	if(! started) start();
+	if(currentEntry + 1 >= endEvent) return false;
+
+	if(skim) {
+		auto t0 = std::chrono::steady_clock::now();
+		++currentEntry;
+		copySkim();
+		std::lock_guard<std::mutex> lock(queueMutex);
+		readTime += secondsSince(t0);
+		return true;
+	}
+	if(readAhead <= 0) {
+		auto t0 = std::chrono::steady_clock::now();
+		t -> GetEntry(++currentEntry);
+		std::lock_guard<std::mutex> lock(queueMutex);
+		readTime += secondsSince(t0);
+		return true;
+	}
+
+	if(currentRow >= currentBlock.size) {
+		if(! nextBlock()) return false;
+	}
+	const char * row = &currentBlock.data[currentRow * rowSize];
+	for(auto & b: branches) {
+		std::memcpy(b.address, row + b.offset, b.size);
+	}
+	currentEntry = currentBlock.first + currentRow;
+	++currentRow;
+	return true;
+}
+
+void EventReader::copySkim() {
+	for(auto & b: branches) {
+		const SkimCache::Column * c = static_cast<const SkimCache::Column *> (b.column);
+		const char * values = skim -> getData(c);
+		if(c -> kind == SkimCache::kEvent) {
+			std::memcpy(b.address, values + currentEntry * c -> size, c -> size);
+			continue;
+		}
+		const Long64_t * offsets = skim -> getOffsets(c -> kind);
+		std::size_t n = (offsets[currentEntry + 1] - offsets[currentEntry]) * c -> size;
+		if(n > b.size) {
+			throw std::runtime_error("too many values of " + b.name + " at entry " + std::to_string(currentEntry) + " in skim " + filename);
+		}
+		std::memcpy(b.address, values + offsets[currentEntry] * c -> size, n);
+	}
+}
+
+Long64_t EventReader::getEntry() const {
+	return currentEntry;
+}
+
+Long64_t EventReader::getEndEvent() const {
+	return endEvent;
+}
+
+bool EventReader::isSkim() const {
+	return skim != 0;
+}
+
+// only the columns of a skim (e.g. the bin ids of skim.cpp), never the branches of a tree
+bool EventReader::hasColumn(std::string name) const {
+	return skim && skim -> getColumn(name);
+}
+
+Double_t EventReader::getWaitTime() const {
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return waitTime;
+}
+
+Double_t EventReader::getReadTime() const {
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return readTime;
+}
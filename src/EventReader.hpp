@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <deque> // std::deque<>
+#include <thread> // std::thread
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+
+#include <TMath.h>
+
+class TFile;
+class TTree;
+class SkimCache;
+
+/**
+ * @brief Reads the entries [begin, end) of a tree into the registered addresses.
+ *
+ * If readAhead > 0, a background thread reads the tree cluster by cluster
+ * and keeps up to readAhead decoded blocks of events in a bounded queue,
+ * so that the basket reads and decompression overlap with the event loop.
+ * Otherwise the entries are read synchronously with TTree::GetEntry().
+ * If the file is a skim (see SkimCache), the tree is not needed (may be null)
+ * and the values are copied from the memory-mapped columns of the same names.
+ * A skim already mapped by the caller (the daemon keeps them) may be passed instead of mapping the file again;
+ * it must outlive the reader.
+ *
+ * @note The branch addresses must be registered before the first call to next().
+ * Missing columns and read errors throw std::runtime_error (from the thread calling next()).
+ */
+class EventReader {
+public:
+	EventReader(TTree * t, std::string filename, Long64_t beginEvent, Long64_t endEvent, Int_t readAhead,
+				const SkimCache * skim = 0);
+	~EventReader();
+	template<typename T>
+	void setBranchAddress(std::string name, T * address) {
+		addBranch(name, address, sizeof(T));
+	}
+	void setBranchAddress(std::string name, void * address, std::size_t size) {
+		addBranch(name, address, size);
+	}
+	bool next();
+	Long64_t getEntry() const;
+	Long64_t getEndEvent() const;
+	bool isSkim() const;
+	bool hasColumn(std::string name) const;
+	Double_t getWaitTime() const;
+	Double_t getReadTime() const;
+private:
+	struct Branch {
+		std::string name;
+		void * address;
+		std::size_t size;
+		std::size_t offset;
+		const void * column; // the column in the skim
+	};
+	struct Block {
+		Long64_t first;
+		Long64_t size;
+		std::vector<char> data;
+	};
+	void addBranch(std::string name, void * address, std::size_t size);
+	void start();
+	void readLoop();
+	bool nextBlock();
+	void copySkim();
+
+	TTree * t;
+	std::string filename;
+	Long64_t beginEvent;
+	Long64_t endEvent;
+	Int_t readAhead;
+
+	std::vector<Branch> branches;
+	std::size_t rowSize;
+	const SkimCache * skim;
+	SkimCache * ownedSkim; // mapped by the reader itself
+
+	Long64_t currentEntry;
+	Block currentBlock;
+	Long64_t currentRow;
+
+	TFile * readerFile;
+	TTree * readerTree;
+	std::thread readerThread;
+	mutable std::mutex queueMutex;
+	std::condition_variable queueNotFull;
+	std::condition_variable queueNotEmpty;
+	std::deque<Block> queue;
+	std::vector<std::vector<char> > spareBuffers;
+	bool started;
+	bool finished;
+	bool stopped;
+	bool failed;
+
+	Double_t waitTime;
+	Double_t readTime;
+};
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/ini_parser.hpp>
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <set> // std::set<>
+#include <cmath> // std::fabs()
+#include <cstdlib> // std::atoi(), std::atof()
+#include <memory> // std::unique_ptr<>
+#include <ostream> // std::ostream
+#include <iomanip> // std::fixed
+#include <stdexcept> // std::runtime_error
+#include <algorithm> // std::find()
+
+#include <TFile.h>
+#include <TH1F.h>
+
+#include "common.hpp"
+#include "AnalysisGraph.hpp"
+#include "CdfSampler.hpp"
+#include "HistoBook.hpp"
+
+/**
+ * @brief The presets of graph.cpp (and of the jobs of daemon.cpp), the tools (and chains of tools) that run on the same input:
+ *  - process      the CSV histograms of process.cpp
+ *  - gsample      the generated CSV histograms (gsample.cpp followed by process.cpp -g)
+ *  - analyze      the b-tag tree of analyze.cpp -a -s -r (btag_aProb, btag_count, btag_real_count)
+ *  - btagcounter  the sums of btagcounter.cpp -a -r over the events analyze.cpp keeps
+ *  - consistency  the histograms of consistency.cpp (the book of the config file, without the method M)
+ * The generated CSV values are drawn from the cumulatives (-c) with a stream per event and jet,
+ * so every preset sees the same values.
+ * selection.cpp is no preset: it runs over the samples of a catalog (several files, each sample with its name and weight)
+ * and cuts on the lepton arrays, while a graph job has a single input and only jet and scalar branches as columns.
+ *
+ * The functions throw std::runtime_error on wrong jobs or unreadable files, so that a daemon survives them.
+ * @note Uses common.hpp, so it's included by the tools only.
+ */
+
+/** @brief The options of a graph job. */
+struct GraphJob {
+	std::string configFile, input, treeName, output, cumulFile;
+	std::vector<std::string> presets;
+	Long64_t beginEvent, endEvent;
+	Int_t readAhead, requiredJets, requiredBtags;
+	Float_t workingPoint;
+	ULong64_t seed;
+	bool requireExact;
+	Int_t bins; // the CSV binning of [histogram] of the config file
+	Float_t minCSV, maxCSV;
+};
+
+/** @brief The tables read from the cumulatives, indexed by getBinId(). */
+struct CalibrationTables {
+	std::vector<std::string> names;
+	std::vector<std::unique_ptr<CdfSampler> > samplers;
+	std::vector<Float_t> probabilities; // the analytic probabilities at the working point
+};
+
+/**
+ * @brief The options of a job (all of graph.out but help and verbose).
+ */
+inline void addGraphOptions(boost::program_options::options_description & desc, GraphJob & job) {
+	namespace po = boost::program_options;
+	desc.add_options()
+		("config,C", po::value<std::string>(&job.configFile), "config file (the input, the tree and the CSV binning of [histogram])")
+		("input,i", po::value<std::string>(&job.input), "input *.root file (or skim)\nif not set, read from config file")
+		("tree,t", po::value<std::string>(&job.treeName), "name of the tree\nif not set, read from config file")
+		("begin,b", po::value<Long64_t>(&job.beginEvent) -> default_value(0), "the event number to start with")
+		("end,e", po::value<Long64_t>(&job.endEvent) -> default_value(-1), "the event number to end with\ndefault (-1) means all events")
+		("output,o", po::value<std::string>(&job.output), "output *.root file")
+		("preset,p", po::value<std::vector<std::string> >(&job.presets) -> multitoken(), "presets run in the same event loop:\nprocess gsample analyze btagcounter consistency")
+		("cumulatives,c", po::value<std::string>(&job.cumulFile), "cumulatives of cumulative.cpp (needed by every preset but process)")
+		("Nj,j", po::value<Int_t>(&job.requiredJets) -> default_value(4), "required number of jets per event")
+		("Ntag,n", po::value<Int_t>(&job.requiredBtags) -> default_value(2), "required number of btags per event")
+		("exact,X", po::bool_switch(&job.requireExact), "require exact number of jets")
+		("working-point,w", po::value<Float_t>(&job.workingPoint) -> default_value(0.679), "CSV working point")
+		("seed", po::value<ULong64_t>(&job.seed) -> default_value(4357), "seed of the generated CSV values")
+		("read-ahead,R", po::value<Int_t>(&job.readAhead) -> default_value(4), "number of event blocks decoded ahead on a separate thread\n0 means synchronous reading")
+	;
+}
+
+/**
+ * @brief Checks the presets of a parsed job and completes it from its config file.
+ */
+inline void completeGraphJob(GraphJob & job) {
+	using boost::property_tree::ptree; // ptree, read_ini
+	if(job.output.empty() || job.presets.empty() || (job.configFile.empty() && (job.input.empty() || job.treeName.empty()))) {
+		throw std::runtime_error("the output, the presets and the input (or the config file) are needed");
+	}
+	const std::set<std::string> knownPresets = { "process", "gsample", "analyze", "btagcounter", "consistency" };
+	for(auto & p: job.presets) {
+		if(knownPresets.count(p) == 0) throw std::runtime_error("unknown preset " + p);
+	}
+	std::set<std::string> run(job.presets.begin(), job.presets.end());
+	if(run.size() > run.count("process") && job.cumulFile.empty()) {
+		throw std::runtime_error("the presets other than process need the cumulatives (-c)");
+	}
+	job.bins = 50;
+	job.minCSV = 0;
+	job.maxCSV = 1;
+	if(! job.configFile.empty()) {
+		ptree pt_ini;
+		read_ini(job.configFile, pt_ini);
+		auto trim = [] (std::string s) -> std::string {
+			s = s.substr(0, s.find(";")); // remove the comment
+			boost::algorithm::trim(s); // remove whitespaces around the string
+			return s;
+		};
+		if(job.input.empty()) job.input = trim(pt_ini.get<std::string>("histogram.in"));
+		if(job.treeName.empty()) job.treeName = trim(pt_ini.get<std::string>("histogram.tree"));
+		job.bins = std::atoi(trim(pt_ini.get<std::string>("histogram.bins")).c_str());
+		std::string csvRange = trim(pt_ini.get<std::string>("histogram.csvrange"));
+		job.minCSV = std::atof(csvRange.substr(0, csvRange.find(",")).c_str());
+		job.maxCSV = std::atof(csvRange.substr(csvRange.find(",") + 1).c_str());
+		if(job.minCSV >= job.maxCSV) throw std::runtime_error("wrong values for csv range");
+	}
+}
+
+/**
+ * @brief Reads the samplers and the analytic probabilities of a working point; only the names if there are no cumulatives.
+ */
+inline void readCalibrationTables(std::string cumulFile, Float_t workingPoint, CalibrationTables & tables) {
+	tables.names.clear();
+	for(int i = 0; i < 3; ++i) {
+		for(int j = 0; j < 6; ++j) {
+			for(int k = 0; k < 3; ++k) {
+				tables.names.push_back(getName(i, j, k));
+			}
+		}
+	}
+	tables.samplers.clear();
+	tables.samplers.resize(tables.names.size());
+	tables.probabilities.assign(tables.names.size(), 0);
+	if(cumulFile.empty()) return;
+	std::unique_ptr<TFile> cumulativeFile(TFile::Open(cumulFile.c_str(), "read"));
+	if(! cumulativeFile || cumulativeFile -> IsZombie() || ! cumulativeFile -> IsOpen()) {
+		throw std::runtime_error("Cannot open " + cumulFile + ".");
+	}
+	for(std::size_t binId = 0; binId < tables.names.size(); ++binId) {
+		TH1F * h = dynamic_cast<TH1F *> (cumulativeFile -> Get(tables.names[binId].c_str()));
+		if(! h) continue;
+		tables.samplers[binId].reset(new CdfSampler(h));
+		// the analytic probability of analyze.cpp
+		Int_t bin = h -> FindBin(workingPoint);
+		Float_t x1 = h -> GetBinLowEdge(bin), x2 = h -> GetBinLowEdge(bin + 1);
+		Float_t y1 = h -> GetBinContent(bin - 1), y2 = h -> GetBinContent(bin);
+		tables.probabilities[binId] = 1.0 - (y1 + (y2 - y1) * (workingPoint - x1) / (x2 - x1));
+	}
+	cumulativeFile -> Close();
+}
+
+/**
+ * @brief Declares the columns and the sinks of the presets of a job; the tables must outlive the graph.
+ */
+inline void declarePresets(AnalysisGraph & graph, const GraphJob & job, const CalibrationTables & tables) {
+	typedef AnalysisGraph::Event Event;
+	const std::set<std::string> run(job.presets.begin(), job.presets.end());
+	const Int_t requiredJets = job.requiredJets, requiredBtags = job.requiredBtags;
+	const bool requireExact = job.requireExact;
+	const Float_t workingPoint = job.workingPoint;
+	const std::vector<std::string> & names = tables.names;
+	const std::vector<std::unique_ptr<CdfSampler> > & samplers = tables.samplers;
+	const std::vector<Float_t> & probabilities = tables.probabilities;
+	
+	/*********** columns ****/
+	
+	const std::size_t pt = graph.jetBranch("pt");
+	const std::size_t eta = graph.jetBranch("eta");
+	const std::size_t flavour = graph.jetBranch("flavour");
+	const std::size_t csv = graph.jetBranch("csv");
+	const std::size_t binId = graph.defineJet("binId", { flavour, pt, eta }, [=] (Event & e, Int_t j) -> Float_t {
+		return getBinId(e.jet(flavour, j), e.jet(pt, j), e.jet(eta, j));
+	});
+	const ULong64_t stream = CdfSampler::getStream(job.seed, "csvGen");
+	const std::size_t csvGen = graph.defineJet("csvGen", { binId }, [=, &samplers] (Event & e, Int_t j) -> Float_t {
+		Int_t id = Int_t(e.jet(binId, j));
+		if(id < 0 || ! samplers[id]) return -1;
+		Double_t u, x;
+		CdfSampler::uniforms(stream, e.getEntry() * (AnalysisGraph::maxNumberOfHJets + AnalysisGraph::maxNumberOfAJets) + j, &u, 1);
+		samplers[id] -> sample(&u, &x, 1);
+		return x;
+	});
+	const std::size_t tagProb = graph.defineJet("tagProb", { binId }, [=, &probabilities] (Event & e, Int_t j) -> Float_t {
+		Int_t id = Int_t(e.jet(binId, j));
+		return (id < 0) ? 0 : probabilities[id];
+	});
+	
+	// the jets of analyze.cpp: pt >= 20, |eta| < 2.5, the first Nj by descending pt (the rank, -1 if not taken)
+	auto good = [] (Event & e, std::size_t pt, std::size_t eta, Int_t j) -> bool {
+		return e.jet(pt, j) >= 20 && std::fabs(e.jet(eta, j)) < 2.5;
+	};
+	const std::size_t selected = graph.defineJet("selected", { pt, eta }, [=] (Event & e, Int_t j) -> Float_t {
+		if(! good(e, pt, eta, j)) return -1;
+		Int_t rank = 0;
+		for(Int_t k = 0; k < e.getNumberOfJets(); ++k) {
+			if(k == j || ! good(e, pt, eta, k)) continue;
+			if(e.jet(pt, k) > e.jet(pt, j) || (e.jet(pt, k) == e.jet(pt, j) && k < j)) ++rank;
+		}
+		return (rank < requiredJets) ? rank : -1;
+	});
+	const std::size_t jetsPassed = graph.defineEvent("jetsPassed", { pt, eta }, [=] (Event & e) -> Double_t {
+		Int_t n = 0;
+		for(Int_t j = 0; j < e.getNumberOfJets(); ++j) n += good(e, pt, eta, j);
+		return requireExact ? (n == requiredJets) : (n >= requiredJets);
+	});
+	const std::size_t analyzed = graph.filter("analyzed", jetsPassed);
+	
+	// the probability of exactly Ntag b-tags among the selected jets, jet by jet instead of over the permutations
+	const std::size_t aProb = graph.defineEvent("btag_aProb", { selected, tagProb }, [=] (Event & e) -> Double_t {
+		std::vector<Double_t> p(requiredBtags + 1, 0); // p[k]: k of the jets so far are tagged (the sum of comb() of analyze.cpp)
+		p[0] = 1;
+		for(Int_t j = 0; j < e.getNumberOfJets(); ++j) {
+			if(e.jet(selected, j) < 0) continue;
+			Double_t q = e.jet(tagProb, j);
+			for(Int_t k = requiredBtags; k >= 0; --k) p[k] = p[k] * (1 - q) + ((k > 0) ? p[k - 1] * q : 0);
+		}
+		return p[requiredBtags];
+	});
+	auto countAbove = [=] (Event & e, std::size_t x) -> Double_t {
+		Int_t n = 0;
+		for(Int_t j = 0; j < e.getNumberOfJets(); ++j) {
+			if(e.jet(selected, j) >= 0 && e.jet(x, j) >= workingPoint) ++n;
+		}
+		return n;
+	};
+	const std::size_t count = graph.defineEvent("btag_count", { selected, csvGen }, [=] (Event & e) -> Double_t {
+		return countAbove(e, csvGen);
+	});
+	const std::size_t realCount = graph.defineEvent("btag_real_count", { selected, csv }, [=] (Event & e) -> Double_t {
+		return countAbove(e, csv);
+	});
+	const std::size_t countPassed = graph.defineEvent("countPassed", { count }, [=] (Event & e) -> Double_t {
+		return e.value(count) == requiredBtags;
+	});
+	const std::size_t realCountPassed = graph.defineEvent("realCountPassed", { realCount }, [=] (Event & e) -> Double_t {
+		return e.value(realCount) == requiredBtags;
+	});
+	const std::size_t counted = graph.filter("counted", countPassed, analyzed);
+	const std::size_t realCounted = graph.filter("realCounted", realCountPassed, analyzed);
+	
+	// the two highest pts of consistency.cpp, over all jets
+	auto leading = [=] (Event & e, Int_t n) -> Double_t {
+		Float_t lead = -1, sublead = -1;
+		for(Int_t j = 0; j < e.getNumberOfJets(); ++j) {
+			Float_t x = e.jet(pt, j);
+			if(lead < x) {
+				sublead = lead;
+				lead = x;
+			}
+			else if(sublead < x) sublead = x;
+		}
+		return (n == 0) ? lead : sublead;
+	};
+	const std::size_t leadPt = graph.defineEvent("leadPt", { pt }, [=] (Event & e) -> Double_t { return leading(e, 0); });
+	const std::size_t subleadPt = graph.defineEvent("subleadPt", { pt }, [=] (Event & e) -> Double_t { return leading(e, 1); });
+	
+	/*********** presets ****/
+	
+	if(run.count("process")) {
+		graph.histograms(names, binId, csv, job.bins, job.minCSV, job.maxCSV);
+	}
+	if(run.count("gsample")) {
+		std::vector<std::string> csvGenNames;
+		for(auto & n: names) csvGenNames.push_back("csvGen_" + n.substr(std::string("csv_").size()));
+		graph.histograms(csvGenNames, binId, csvGen, job.bins, job.minCSV, job.maxCSV);
+	}
+	if(run.count("analyze")) {
+		graph.tree("btag", { aProb, count, realCount }, analyzed);
+	}
+	if(run.count("btagcounter")) {
+		graph.sum("aProb", aProb, analyzed);
+		graph.sum("bcount", countPassed, analyzed);
+		graph.sum("realBcount", realCountPassed, analyzed);
+	}
+	if(run.count("consistency")) {
+		// the book of consistency.cpp ([consistency_variables] and [consistency_methods] of the config file), in its order;
+		// there is no btag_mProb here. The titles are those of consistency.cpp, the names get the label to be unique.
+		HistoBook book(job.configFile);
+		book.drop(HistoBook::kMProb);
+		const std::size_t variableColumns[] = { pt, eta, csv, csvGen, leadPt, subleadPt }; // HistoBook::Variable
+		const std::size_t weightColumns[] = { AnalysisGraph::none, aProb, AnalysisGraph::none }; // HistoBook::Weight
+		const std::size_t selectionFilters[] = { analyzed, counted, realCounted }; // HistoBook::Selection
+		for(auto & b: book.getBookings()) {
+			std::string name = HistoBook::getVariableName(b.variable);
+			graph.histogram(name + "_" + b.label, name + " " + b.label, variableColumns[b.variable], b.nBins, b.xMin, b.xMax,
+							weightColumns[b.weight], selectionFilters[b.selection]);
+		}
+	}
+}
+
+/**
+ * @brief Runs the graph into the output file of the job and prints the results of btagcounter.
+ */
+inline void runPresets(AnalysisGraph & graph, const GraphJob & job, std::ostream & results, bool enableVerbose) {
+	std::unique_ptr<TFile> out(new TFile(job.output.c_str(), "recreate"));
+	if(out -> IsZombie() || ! out -> IsOpen()) throw std::runtime_error("Cannot create " + job.output + ".");
+	graph.run(out.get(), enableVerbose);
+	out -> cd();
+	writeEventRange(graph.getBeginEvent(), graph.getEndEvent());
+	out -> Close();
+	
+	if(std::find(job.presets.begin(), job.presets.end(), "btagcounter") != job.presets.end()) {
+		results << "number of events that passed the cut:\t" << graph.getPassed("aProb") << std::endl;
+		results << "sum of " << job.requiredBtags << " b-tagged jets:\t\t\t" << Long64_t(graph.getSum("bcount")) << std::endl;
+		results << "sum of analytic probabilities:\t\t" << std::fixed << graph.getSum("aProb") << std::endl;
+		results << "number of real b-tags:\t\t\t" << Long64_t(graph.getSum("realBcount")) << std::endl;
+	}
+}
@@ -0,0 +1,270 @@
+#include "HistoBook.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/ini_parser.hpp>
+
+#include <sstream> // std::stringstream
+#include <stdexcept> // std::runtime_error
+#include <cmath> // std::sqrt()
+#include <algorithm> // std::remove_if()
+
+#include <TDirectory.h>
+#include <TH1F.h>
+
+namespace {
+	const char * variableNames[6] = {"pt", "eta", "csv", "csvGen", "leadPt", "subleadPt"};
+	const char * weightNames[3] = {"one", "aProb", "mProb"};
+	const char * selectionNames[3] = {"all", "count", "realCount"};
+
+	// <variable> = <bins> <min> <max>
+	const std::vector<std::string> defaultVariables = {
+		"pt = 50 0 250", "eta = 50 -3 3", "csv = 50 0 1", "leadPt = 50 0 250", "subleadPt = 50 0 250"
+	};
+	// <label> = <weight> <selection>
+	const std::vector<std::string> defaultMethods = {
+		"H = one count", "A = aProb all", "M = mProb all", "R = one realCount"
+	};
+
+	std::string trim(std::string s) {
+		s = s.substr(0, s.find(";")); // remove the comment
+		boost::algorithm::trim(s); // remove whitespaces around the string
+		return s;
+	}
+
+	// "<key> = <value>" -> key, value
+	std::pair<std::string, std::string> splitEntry(const std::string & entry) {
+		std::size_t i = entry.find("=");
+		return std::make_pair(trim(entry.substr(0, i)), trim(entry.substr(i + 1)));
+	}
+}
+
+std::size_t HistoBook::Block::size() const {
+	return events[0].size();
+}
+
+void HistoBook::Block::clear() {
+	for(auto & v: jets) v.clear();
+	for(auto & v: events) v.clear();
+	jetEvents.clear();
+	aProb.clear();
+	mProb.clear();
+	count.clear();
+	realCount.clear();
+}
+
+HistoBook::HistoBook()
+	: nCells(0) {
+	book(defaultVariables, defaultMethods);
+}
+
+HistoBook::HistoBook(std::string configFile)
+	: nCells(0) {
+	std::vector<std::string> variables, methods;
+	if(configFile.empty()) {
+		book(defaultVariables, defaultMethods);
+		return;
+	}
+	using boost::property_tree::ptree;
+	ptree pt_ini;
+	read_ini(configFile, pt_ini);
+	if(auto section = pt_ini.get_child_optional("consistency_variables")) {
+		for(auto & kv: *section) variables.push_back(kv.first + " = " + kv.second.data());
+	}
+	if(auto section = pt_ini.get_child_optional("consistency_methods")) {
+		for(auto & kv: *section) methods.push_back(kv.first + " = " + kv.second.data());
+	}
+	book(variables.empty() ? defaultVariables : variables, methods.empty() ? defaultMethods : methods);
+}
+
+HistoBook::~HistoBook() {
+	for(auto acc: accumulators) delete acc;
+}
+
+void HistoBook::book(const std::vector<std::string> & variables, const std::vector<std::string> & methods) {
+	for(auto & v: variables) {
+		auto variable = splitEntry(v);
+		Int_t nBins;
+		Double_t xMin, xMax;
+		std::stringstream ss(variable.second);
+		if(! (ss >> nBins >> xMin >> xMax) || nBins < 1 || xMin >= xMax) {
+			throw std::runtime_error("wrong binning of " + variable.first + ": " + variable.second);
+		}
+		for(auto & m: methods) {
+			auto method = splitEntry(m);
+			std::string weight, selection;
+			std::stringstream ms(method.second);
+			if(! (ms >> weight >> selection)) throw std::runtime_error("wrong method " + method.first + ": " + method.second);
+			book(parseVariable(variable.first), method.first, parseWeight(weight), parseSelection(selection), nBins, xMin, xMax);
+		}
+	}
+}
+
+void HistoBook::book(Variable variable, std::string label, Weight weight, Selection selection, Int_t nBins, Double_t xMin, Double_t xMax) {
+	Booking b = { variable, label, weight, selection, nBins, xMin, xMax, 0 };
+	bookings.push_back(b);
+	layout();
+}
+
+void HistoBook::drop(Weight weight) {
+	bookings.erase(std::remove_if(bookings.begin(), bookings.end(), [weight] (const Booking & b) { return b.weight == weight; }), bookings.end());
+	layout();
+}
+
+void HistoBook::drop(Selection selection) {
+	bookings.erase(std::remove_if(bookings.begin(), bookings.end(), [selection] (const Booking & b) { return b.selection == selection; }), bookings.end());
+	layout();
+}
+
+void HistoBook::layout() {
+	nCells = 0;
+	for(auto & booking: bookings) {
+		booking.offset = nCells;
+		nCells += booking.nBins + 2;
+	}
+}
+
+bool HistoBook::uses(Variable variable) const {
+	for(auto & b: bookings) if(b.variable == variable) return true;
+	return false;
+}
+
+bool HistoBook::uses(Weight weight) const {
+	for(auto & b: bookings) if(b.weight == weight) return true;
+	return false;
+}
+
+bool HistoBook::uses(Selection selection) const {
+	for(auto & b: bookings) if(b.selection == selection) return true;
+	return false;
+}
+
+std::size_t HistoBook::size() const {
+	return bookings.size();
+}
+
+const std::vector<HistoBook::Booking> & HistoBook::getBookings() const {
+	return bookings;
+}
+
+HistoBook::Accumulator * HistoBook::acquire() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if(freeAccumulators.empty()) {
+		Accumulator * acc = new Accumulator;
+		acc -> sumw.assign(nCells, 0);
+		acc -> sumw2.assign(nCells, 0);
+		acc -> stats.assign(4 * bookings.size(), 0);
+		acc -> entries.assign(bookings.size(), 0);
+		accumulators.push_back(acc);
+		return acc;
+	}
+	Accumulator * acc = freeAccumulators.back();
+	freeAccumulators.pop_back();
+	return acc;
+}
+
+void HistoBook::release(Accumulator * acc) {
+	std::lock_guard<std::mutex> lock(mutex);
+	freeAccumulators.push_back(acc);
+}
+
+void HistoBook::fill(const Block & block, Int_t nBtags) {
+	Accumulator * acc = acquire();
+	std::size_t nEvents = block.size();
+	acc -> weights.resize(nEvents);
+	acc -> selected.resize(nEvents);
+	for(std::size_t k = 0; k < bookings.size(); ++k) {
+		const Booking & b = bookings[k];
+		
+		// the weight and the selection of every event
+		const std::vector<Float_t> * w = (b.weight == kAProb) ? &block.aProb : (b.weight == kMProb ? &block.mProb : 0);
+		const std::vector<Int_t> * s = (b.selection == kCount) ? &block.count : (b.selection == kRealCount ? &block.realCount : 0);
+		for(std::size_t e = 0; e < nEvents; ++e) {
+			acc -> weights[e] = w ? (*w)[e] : 1.0;
+			acc -> selected[e] = s ? ((*s)[e] == nBtags) : 1;
+		}
+		
+		// the bins of the whole column, as TAxis::FindBin() for fixed bins; no branches, hence vectorized
+		bool perJet = b.variable < kLeadPt;
+		const std::vector<Float_t> & x = perJet ? block.jets[b.variable] : block.events[b.variable - kLeadPt];
+		std::size_t n = x.size();
+		acc -> bins.resize(n);
+		const Float_t * xs = x.data();
+		Int_t * bins = acc -> bins.data();
+		const Double_t xMin = b.xMin, xMax = b.xMax, width = b.xMax - b.xMin;
+		const Int_t nBins = b.nBins;
+		for(std::size_t i = 0; i < n; ++i) {
+			Double_t xi = xs[i];
+			// converted only inside the range; NaN fails both comparisons and goes to the overflow, as in TH1::Fill()
+			bins[i] = (xi < xMin) ? 0 : (! (xi < xMax) ? nBins + 1 : 1 + Int_t(nBins * (xi - xMin) / width));
+		}
+		
+		Double_t * sumw = &acc -> sumw[b.offset];
+		Double_t * sumw2 = &acc -> sumw2[b.offset];
+		Double_t * stats = &acc -> stats[4 * k];
+		Double_t entries = 0;
+		for(std::size_t i = 0; i < n; ++i) {
+			std::size_t e = perJet ? block.jetEvents[i] : i;
+			if(! acc -> selected[e]) continue;
+			Double_t wi = acc -> weights[e];
+			sumw[bins[i]] += wi;
+			sumw2[bins[i]] += wi * wi;
+			++entries;
+			if(bins[i] >= 1 && bins[i] <= nBins) {
+				stats[0] += wi;
+				stats[1] += wi * wi;
+				stats[2] += wi * xs[i];
+				stats[3] += wi * xs[i] * xs[i];
+			}
+		}
+		acc -> entries[k] += entries;
+	}
+	release(acc);
+}
+
+void HistoBook::write(TDirectory * d) const {
+	std::vector<Double_t> sumw(nCells, 0), sumw2(nCells, 0), stats(4 * bookings.size(), 0), entries(bookings.size(), 0);
+	for(auto acc: accumulators) {
+		for(std::size_t i = 0; i < nCells; ++i) {
+			sumw[i] += acc -> sumw[i];
+			sumw2[i] += acc -> sumw2[i];
+		}
+		for(std::size_t i = 0; i < stats.size(); ++i) stats[i] += acc -> stats[i];
+		for(std::size_t i = 0; i < entries.size(); ++i) entries[i] += acc -> entries[i];
+	}
+	d -> cd();
+	for(std::size_t k = 0; k < bookings.size(); ++k) {
+		const Booking & b = bookings[k];
+		std::string name = variableNames[b.variable];
+		std::string title = name + " " + b.label;
+		TH1F h(name.c_str(), title.c_str(), b.nBins, b.xMin, b.xMax);
+		h.SetDirectory(0);
+		h.Sumw2();
+		for(Int_t bin = 0; bin <= b.nBins + 1; ++bin) {
+			h.SetBinContent(bin, sumw[b.offset + bin]);
+			h.SetBinError(bin, std::sqrt(sumw2[b.offset + bin]));
+		}
+		h.PutStats(&stats[4 * k]);
+		h.SetEntries(entries[k]);
+		h.Write();
+	}
+}
+
+std::string HistoBook::getVariableName(Variable variable) {
+	return variableNames[variable];
+}
+
+HistoBook::Variable HistoBook::parseVariable(std::string s) {
+	for(int i = 0; i < 6; ++i) if(s == variableNames[i]) return Variable(i);
+	throw std::runtime_error("unknown variable " + s);
+}
+
+HistoBook::Weight HistoBook::parseWeight(std::string s) {
+	for(int i = 0; i < 3; ++i) if(s == weightNames[i]) return Weight(i);
+	throw std::runtime_error("unknown weight " + s);
+}
+
+HistoBook::Selection HistoBook::parseSelection(std::string s) {
+	for(int i = 0; i < 3; ++i) if(s == selectionNames[i]) return Selection(i);
+	throw std::runtime_error("unknown selection " + s);
+}
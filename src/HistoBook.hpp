@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <mutex> // std::mutex
+
+#include <TMath.h>
+
+class TDirectory;
+
+/**
+ * @brief Booked 1D distributions of consistency.cpp, filled from columns of events instead of one TH1F::Fill() per value.
+ *
+ * A histogram is the triple (variable, weight, selection) of a variable and a method:
+ *   variables  pt, eta, csv, csvGen (every jet), leadPt, subleadPt (every event)
+ *   weights    one, aProb (btag_aProb), mProb (btag_mProb)
+ *   selections all, count (btag_count == nBtags), realCount (btag_real_count == nBtags)
+ * The default book (also for an empty config file name) is the variables pt, eta, csv, leadPt, subleadPt with the methods
+ * H = one count, A = aProb all, M = mProb all and R = one realCount. The config file may replace them:
+ *   [consistency_variables] <variable> = <bins> <min> <max>
+ *   [consistency_methods]   <label> = <weight> <selection>
+ * The histograms are called <variable> with the title "<variable> <label>" and are written variable by variable.
+ *
+ * A wrong config file throws std::runtime_error (the consistency preset of GraphPresets.hpp runs in the daemon too).
+ *
+ * book() and drop() must precede the first fill(). fill() may be called from several threads: each call takes
+ * a private set of flat bin arrays (one per thread at most), finds the bins of a whole column at once and then adds the weights.
+ * write() sums the arrays and creates the TH1F with the same contents, errors and statistics as TH1F::Fill().
+ */
+class HistoBook {
+public:
+	enum Variable { kPt, kEta, kCSV, kCSVGen, kLeadPt, kSubleadPt };
+	enum Weight { kOne, kAProb, kMProb };
+	enum Selection { kAll, kCount, kRealCount };
+	struct Block {
+		std::vector<Float_t> jets[4]; // kPt, kEta, kCSV and kCSVGen of every jet
+		std::vector<UInt_t> jetEvents; // the event of every jet
+		std::vector<Float_t> events[2]; // kLeadPt and kSubleadPt of every event
+		std::vector<Float_t> aProb, mProb;
+		std::vector<Int_t> count, realCount;
+		std::size_t size() const;
+		void clear();
+	};
+	struct Booking {
+		Variable variable;
+		std::string label;
+		Weight weight;
+		Selection selection;
+		Int_t nBins;
+		Double_t xMin, xMax;
+		std::size_t offset; // of bin 0 in the flat arrays
+	};
+	HistoBook();
+	HistoBook(std::string configFile);
+	~HistoBook();
+	void book(Variable variable, std::string label, Weight weight, Selection selection, Int_t nBins, Double_t xMin, Double_t xMax);
+	void drop(Weight weight);
+	void drop(Selection selection);
+	bool uses(Variable variable) const;
+	bool uses(Weight weight) const;
+	bool uses(Selection selection) const;
+	std::size_t size() const;
+	const std::vector<Booking> & getBookings() const;
+	void fill(const Block & block, Int_t nBtags);
+	void write(TDirectory * d) const;
+	static std::string getVariableName(Variable variable);
+	static Variable parseVariable(std::string s);
+	static Weight parseWeight(std::string s);
+	static Selection parseSelection(std::string s);
+private:
+	struct Accumulator {
+		std::vector<Double_t> sumw, sumw2;
+		std::vector<Double_t> stats; // sum w, w^2, w x, w x^2 of the values in range, per booking
+		std::vector<Double_t> entries; // per booking
+		std::vector<Int_t> bins; // scratch
+		std::vector<Double_t> weights; // scratch
+		std::vector<char> selected; // scratch
+	};
+	void book(const std::vector<std::string> & variables, const std::vector<std::string> & methods);
+	void layout();
+	Accumulator * acquire();
+	void release(Accumulator * acc);
+	std::vector<Booking> bookings;
+	std::size_t nCells;
+	std::vector<Accumulator *> accumulators;
+	std::vector<Accumulator *> freeAccumulators;
+	std::mutex mutex;
+};
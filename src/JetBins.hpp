@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string> // std::string
+#include <TMath.h>
+
+/**
+ * @brief The (flavor, pt, |eta|) bins of the jets and the names of their histograms.
+ *
+ * Only inline definitions, hence included by common.hpp (the programs) and by libbtagweight.so alike.
+ */
+
+#define FL_EPS 0.1 // epsilon for flavor comparisons
+
+const int numberOfFlavorBins = 3;
+const int numberOfPtBins = 6;
+const int numberOfEtaBins = 3;
+
+constexpr const char * flavorBinStrings[numberOfFlavorBins] = 	{"c", "b", "l"};
+constexpr const char * ptBinStrings    [numberOfPtBins] = 		{"[20,30]", "[30,40]", "[40,60]", "[60,100]", "[100,160]", "[160,inf]"};
+constexpr const char * etaBinStrings   [numberOfEtaBins] = 		{"[0,0.8]", "[0.8,1.6]", "[1.6,2.5]"};
+
+inline std::string getName(int flavorIndex, int ptIndex, int etaIndex, std::string csvString) {
+	std::string s = csvString;
+	s.append(flavorBinStrings[flavorIndex]);
+	s.append("_");
+	s.append(ptBinStrings[ptIndex]);
+	s.append("_");
+	s.append(etaBinStrings[etaIndex]);
+	return s;
+}
+
+inline std::string getName(int flavorIndex, int ptIndex, int etaIndex) {
+	return getName(flavorIndex, ptIndex, etaIndex, "csv_");
+}
+
+inline int getFlavorIndex(Float_t flavor) {
+	if		(TMath::AreEqualAbs(flavor, 4, FL_EPS)) return 0;
+	else if	(TMath::AreEqualAbs(flavor, 5, FL_EPS)) return 1;
+	else if	(TMath::Abs(flavor) < 4 || TMath::AreEqualAbs(flavor, 21, FL_EPS))	return 2;
+	return -1;
+}
+
+inline int getPtIndex(Float_t pt) {
+	if		(20.0 <= pt && pt < 30.0) 	return 0;
+	else if	(30.0 <= pt && pt < 40.0) 	return 1;
+	else if	(40.0 <= pt && pt < 60.0) 	return 2;
+	else if (60.0 <= pt && pt < 100.0)	return 3;
+	else if (100.0 <= pt && pt < 160.0)	return 4;
+	else if (160.0 <= pt) 				return 5;
+	return -1;
+}
+
+inline int getEtaIndex(Float_t eta) {
+	if		(0.0 <= eta && eta < 0.8)	return 0;
+	else if	(0.8 <= eta && eta < 1.6)	return 1;
+	else if	(1.6 <= eta && eta < 2.5)	return 2;
+	return -1;
+}
+
+/**
+ * @brief Single index of the (flavor, pt, |eta|) bin of a jet, or -1 if the jet is out of the bins.
+ */
+inline int getBinId(Float_t flavor, Float_t pt, Float_t eta) {
+	int flavorIndex = getFlavorIndex(TMath::Abs(flavor));
+	int ptIndex = getPtIndex(pt);
+	int etaIndex = getEtaIndex(TMath::Abs(eta));
+	if(flavorIndex == -1 || ptIndex == -1 || etaIndex == -1) return -1;
+	return (flavorIndex * numberOfPtBins + ptIndex) * numberOfEtaBins + etaIndex;
+}
+
+/**
+ * @brief Name of the histogram of a bin of getBinId().
+ */
+inline std::string getBinName(int binId) {
+	return getName(binId / (numberOfPtBins * numberOfEtaBins), (binId / numberOfEtaBins) % numberOfPtBins, binId % numberOfEtaBins);
+}
@@ -0,0 +1,24 @@
+#include "KahanSum.hpp"
+
+#include <cmath> // std::fabs()
+
+KahanSum::KahanSum(Double_t value)
+	: sum(value), compensation(0) { }
+
+KahanSum & KahanSum::operator+=(Double_t x) {
+	Double_t t = sum + x;
+	if(std::fabs(sum) >= std::fabs(x))	compensation += (sum - t) + x;
+	else								compensation += (x - t) + sum;
+	sum = t;
+	return *this;
+}
+
+KahanSum & KahanSum::operator+=(const KahanSum & other) {
+	*this += other.sum;
+	compensation += other.compensation;
+	return *this;
+}
+
+Double_t KahanSum::getValue() const {
+	return sum + compensation;
+}
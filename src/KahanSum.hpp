@@ -0,0 +1,20 @@
+#pragma once
+
+#include <TMath.h>
+
+/**
+ * @brief Compensated (Kahan-Babuska-Neumaier) summation of doubles.
+ *
+ * The rounding error of every addition is accumulated separately, so that summing
+ * millions of per-event weights (or many partial sums) does not lose the small terms.
+ */
+class KahanSum {
+public:
+	KahanSum(Double_t value = 0);
+	KahanSum & operator+=(Double_t x);
+	KahanSum & operator+=(const KahanSum & other);
+	Double_t getValue() const;
+private:
+	Double_t sum;
+	Double_t compensation;
+};
@@ -0,0 +1,214 @@
+#include "MetaCache.hpp"
+
+#include <cstdlib> // std::getenv(), std::exit(), EXIT_FAILURE
+#include <cstdio> // std::rename(), std::remove()
+#include <iostream> // std::cerr, std::endl
+#include <fstream> // std::ifstream, std::ofstream
+#include <sstream> // std::stringstream
+#include <iomanip> // std::setw(), std::setfill()
+#include <set> // std::set<>
+
+#include <sys/stat.h> // stat(), mkdir()
+#include <unistd.h> // getpid()
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TKey.h>
+#include <TClass.h>
+#include <TBranch.h>
+#include <TObjArray.h>
+#include <TDirectory.h>
+
+namespace {
+	const char * header = "# btag metadata cache v1";
+
+	// creates the directory and its parents, like mkdir -p
+	void makeDirectories(std::string directory) {
+		for(std::size_t i = 1; i <= directory.size(); ++i) {
+			if(i == directory.size() || directory[i] == '/') mkdir(directory.substr(0, i).c_str(), 0755);
+		}
+	}
+}
+
+MetaCache::MetaCache(std::string directory)
+	: directory(directory), nHits(0), nMisses(0) {
+	if(this -> directory.empty()) {
+		const char * env = std::getenv("BTAG_METACACHE");
+		const char * home = std::getenv("HOME");
+		if(env && *env) this -> directory = env;
+		else this -> directory = std::string(home ? home : ".") + "/.cache/btag-metadata";
+	}
+}
+
+bool MetaCache::stat(std::string path, Long64_t & size, Long64_t & mtime) const {
+	if(path.find("://") != std::string::npos) return false; // remote protocols are not stat()able
+	struct ::stat st;
+	if(::stat(path.c_str(), &st) != 0) return false;
+	size = st.st_size;
+	mtime = st.st_mtime;
+	return true;
+}
+
+std::string MetaCache::cacheFile(std::string path) const {
+	// 64-bit FNV-1a of the path
+	ULong64_t hash = 14695981039346656037ULL;
+	for(char c: path) {
+		hash ^= (unsigned char) c;
+		hash *= 1099511628211ULL;
+	}
+	std::stringstream ss;
+	ss << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".meta";
+	return ss.str();
+}
+
+const MetaCache::File & MetaCache::get(std::string path) {
+	for(auto & f: files) {
+		if(f.path == path) return f;
+	}
+	Long64_t size, mtime;
+	bool cacheable = stat(path, size, mtime);
+	File file;
+	if(cacheable && load(cacheFile(path), file) && file.path == path && file.size == size && file.mtime == mtime) {
+		++nHits;
+		files.push_back(file);
+		return files.back();
+	}
+	++nMisses;
+	file = scan(path);
+	if(cacheable) {
+		file.size = size;
+		file.mtime = mtime;
+		store(cacheFile(path), file);
+	}
+	files.push_back(file);
+	return files.back();
+}
+
+const MetaCache::Tree * MetaCache::getTree(std::string path, std::string treeName) {
+	const File & file = get(path);
+	for(auto & t: file.trees) {
+		if(t.name == treeName) return &t;
+	}
+	return 0;
+}
+
+Long64_t MetaCache::getEntries(std::string path, std::string treeName) {
+	const Tree * t = getTree(path, treeName);
+	if(! t) {
+		std::cerr << "error on accessing tree " << treeName << " in " << path << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	return t -> entries;
+}
+
+Int_t MetaCache::getNumberOfHits() const {
+	return nHits;
+}
+
+Int_t MetaCache::getNumberOfMisses() const {
+	return nMisses;
+}
+
+MetaCache::File MetaCache::scan(std::string path) {
+	File file;
+	file.path = path;
+	file.size = -1;
+	file.mtime = -1;
+	TDirectory::TContext context;
+	TFile * f = TFile::Open(path.c_str(), "read");
+	if(! f || f -> IsZombie() || ! f -> IsOpen()) {
+		std::cerr << "error on opening " << path << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	std::set<std::string> treeNames;
+	TIter next(f -> GetListOfKeys());
+	TKey * key;
+	while((key = dynamic_cast<TKey *> (next()))) {
+		Key k = { key -> GetName(), key -> GetClassName(), key -> GetCycle() };
+		file.keys.push_back(k);
+		TClass * cl = TClass::GetClass(key -> GetClassName());
+		if(! cl || ! cl -> InheritsFrom("TTree") || ! treeNames.insert(k.name).second) continue; // the keys are sorted by cycle, highest first
+		TTree * t = dynamic_cast<TTree *> (key -> ReadObj());
+		if(! t) continue;
+		Tree tree;
+		tree.name = k.name;
+		tree.entries = t -> GetEntries();
+		TTree::TClusterIterator clusters = t -> GetClusterIterator(0);
+		Long64_t clusterBegin;
+		while((clusterBegin = clusters()) < tree.entries) tree.clusters.push_back(clusterBegin);
+		tree.clusters.push_back(tree.entries);
+		TObjArray * branches = t -> GetListOfBranches();
+		for(Int_t i = 0; i < branches -> GetEntriesFast(); ++i) {
+			TBranch * b = dynamic_cast<TBranch *> (branches -> At(i));
+			if(! b) continue;
+			Branch branch = { b -> GetName(), b -> GetZipBytes("*"), b -> GetTotBytes("*") };
+			tree.branches.push_back(branch);
+		}
+		file.trees.push_back(tree);
+		delete t;
+	}
+	f -> Close();
+	delete f;
+	return file;
+}
+
+bool MetaCache::load(std::string filename, File & file) const {
+	std::ifstream in(filename.c_str());
+	std::string line;
+	if(! std::getline(in, line) || line != header) return false;
+	file = File();
+	while(std::getline(in, line)) {
+		std::stringstream ss(line);
+		std::string field;
+		ss >> field;
+		if(field == "path") {
+			ss.get(); // the separating space; the path is the rest of the line
+			std::getline(ss, file.path);
+		}
+		else if(field == "size") ss >> file.size;
+		else if(field == "mtime") ss >> file.mtime;
+		else if(field == "key") {
+			Key k;
+			ss >> k.cycle >> k.className >> k.name;
+			file.keys.push_back(k);
+		}
+		else if(field == "tree") {
+			Tree t;
+			ss >> t.entries >> t.name;
+			file.trees.push_back(t);
+		}
+		else if(field == "cluster" && ! file.trees.empty()) {
+			Long64_t first;
+			while(ss >> first) file.trees.back().clusters.push_back(first);
+		}
+		else if(field == "branch" && ! file.trees.empty()) {
+			Branch b;
+			ss >> b.zipBytes >> b.totBytes >> b.name;
+			file.trees.back().branches.push_back(b);
+		}
+		if(ss.fail() && ! ss.eof()) return false;
+	}
+	return true;
+}
+
+void MetaCache::store(std::string filename, const File & file) const {
+	makeDirectories(directory);
+	// written under a temporary name and renamed, so that concurrent jobs never read a partial file
+	std::string tmp = filename + "." + std::to_string(getpid());
+	std::ofstream out(tmp.c_str());
+	if(! out.good()) return; // no cache, no harm
+	out << header << std::endl;
+	out << "path " << file.path << std::endl;
+	out << "size " << file.size << std::endl;
+	out << "mtime " << file.mtime << std::endl;
+	for(auto & k: file.keys) out << "key " << k.cycle << " " << k.className << " " << k.name << std::endl;
+	for(auto & t: file.trees) {
+		out << "tree " << t.entries << " " << t.name << std::endl;
+		out << "cluster";
+		for(auto first: t.clusters) out << " " << first;
+		out << std::endl;
+		for(auto & b: t.branches) out << "branch " << b.zipBytes << " " << b.totBytes << " " << b.name << std::endl;
+	}
+	out.close();
+	if(out.fail() || std::rename(tmp.c_str(), filename.c_str()) != 0) std::remove(tmp.c_str());
+}
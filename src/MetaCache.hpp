@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <deque> // std::deque<>
+
+#include <TMath.h>
+
+/**
+ * @brief Local cache of the metadata of ROOT files (keys, trees, clusters and branch sizes).
+ *
+ * A file is described by a text file in the cache directory named after the hash of its path;
+ * the description is valid as long as the size and the modification time of the file are the same.
+ * Otherwise (or if the file can't be stat()ed, e.g. a root:// URL) the file is opened and scanned,
+ * and the new description is stored. The default directory is $BTAG_METACACHE or ~/.cache/btag-metadata.
+ */
+class MetaCache {
+public:
+	struct Key {
+		std::string name;
+		std::string className;
+		Short_t cycle;
+	};
+	struct Branch {
+		std::string name;
+		Long64_t zipBytes;
+		Long64_t totBytes;
+	};
+	struct Tree {
+		std::string name;
+		Long64_t entries;
+		std::vector<Long64_t> clusters; // the first entry of every cluster, followed by the number of entries
+		std::vector<Branch> branches;
+	};
+	struct File {
+		std::string path;
+		Long64_t size;
+		Long64_t mtime;
+		std::vector<Key> keys;
+		std::vector<Tree> trees;
+	};
+	MetaCache(std::string directory = "");
+	const File & get(std::string path);
+	const Tree * getTree(std::string path, std::string treeName);
+	Long64_t getEntries(std::string path, std::string treeName);
+	Int_t getNumberOfHits() const;
+	Int_t getNumberOfMisses() const;
+	static File scan(std::string path);
+private:
+	bool stat(std::string path, Long64_t & size, Long64_t & mtime) const;
+	std::string cacheFile(std::string path) const;
+	bool load(std::string filename, File & file) const;
+	void store(std::string filename, const File & file) const;
+
+	std::string directory;
+	std::deque<File> files; // already looked up by this instance (a deque keeps the references valid)
+	Int_t nHits, nMisses;
+};
@@ -0,0 +1,80 @@
+#include "SampleCatalog.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/ini_parser.hpp>
+
+#include <cstdlib> // std::exit(), EXIT_FAILURE, std::atof(), std::atoll()
+#include <iostream> // std::cerr, std::endl
+#include <sstream> // std::stringstream
+
+namespace {
+	std::string trim(std::string s) {
+		s = s.substr(0, s.find(";")); // remove the comment
+		boost::algorithm::trim(s); // remove whitespaces around the string
+		return s;
+	}
+}
+
+SampleCatalog::SampleCatalog(std::string configFile)
+	: luminosity(0) {
+	using boost::property_tree::ptree;
+	ptree pt_ini;
+	read_ini(configFile, pt_ini);
+	if(auto value = pt_ini.get_optional<std::string>("catalog.luminosity")) {
+		luminosity = std::atof(trim(*value).c_str());
+	}
+	auto section = pt_ini.get_child_optional("catalog_samples");
+	if(! section || section -> empty()) {
+		std::cerr << "no [catalog_samples] in " << configFile << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	for(auto & kv: *section) {
+		Sample sample;
+		sample.name = kv.first;
+		sample.nGenerated = -1;
+		std::stringstream ss(trim(kv.second.data()));
+		std::string file;
+		ss >> sample.crossSection >> sample.treeName;
+		while(ss >> file) sample.files.push_back(file);
+		if(sample.treeName.empty() || sample.files.empty()) {
+			std::cerr << "cannot parse sample " << sample.name << " = " << kv.second.data()
+					  << " (expected <cross section> <tree> <file> [<file> ...])" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(sample.crossSection > 0 && luminosity <= 0) {
+			std::cerr << "sample " << sample.name << " has a cross section, but [catalog] has no luminosity" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(auto value = pt_ini.get_optional<std::string>("catalog_generated." + sample.name)) {
+			sample.nGenerated = std::atoll(trim(*value).c_str());
+		}
+		samples.push_back(sample);
+	}
+}
+
+SampleCatalog::SampleCatalog(std::string name, std::string treeName, const std::vector<std::string> & files)
+	: luminosity(0) {
+	Sample sample = { name, 0, treeName, files, -1 };
+	samples.push_back(sample);
+}
+
+std::size_t SampleCatalog::size() const {
+	return samples.size();
+}
+
+const SampleCatalog::Sample & SampleCatalog::getSample(std::size_t index) const {
+	return samples[index];
+}
+
+Double_t SampleCatalog::getLuminosity() const {
+	return luminosity;
+}
+
+Double_t SampleCatalog::getWeight(std::size_t index, Long64_t nProcessed) const {
+	const Sample & sample = samples[index];
+	if(sample.crossSection <= 0) return 1;
+	Long64_t nEvents = sample.nGenerated >= 0 ? sample.nGenerated : nProcessed;
+	if(nEvents <= 0) return 0;
+	return sample.crossSection * luminosity * 1000 / nEvents; // pb * fb^-1 = 1000
+}
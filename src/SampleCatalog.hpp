@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+
+#include <TMath.h>
+
+/**
+ * @brief Physics samples (files, tree, cross section) and the integrated luminosity they are normalized to.
+ *
+ * Read from the [catalog] and [catalog_samples] sections of the config file:
+ *   [catalog]          luminosity = <fb^-1>
+ *   [catalog_samples]  <name> = <cross section in pb> <tree> <file> [<file> ...]
+ *   [catalog_generated] <name> = <number of generated events> (optional; default: the processed events)
+ *
+ * A sample is scaled to cross section * luminosity / generated events;
+ * a sample without a cross section (<= 0) is not scaled.
+ */
+class SampleCatalog {
+public:
+	struct Sample {
+		std::string name;
+		Double_t crossSection; // pb
+		std::string treeName;
+		std::vector<std::string> files;
+		Long64_t nGenerated; // < 0 if not given
+	};
+	SampleCatalog(std::string configFile);
+	SampleCatalog(std::string name, std::string treeName, const std::vector<std::string> & files);
+	std::size_t size() const;
+	const Sample & getSample(std::size_t index) const;
+	Double_t getLuminosity() const;
+	Double_t getWeight(std::size_t index, Long64_t nProcessed) const;
+private:
+	std::vector<Sample> samples;
+	Double_t luminosity; // fb^-1
+};
@@ -0,0 +1,191 @@
+#include "SkimCache.hpp"
+
+#include <cstdlib> // std::exit(), EXIT_FAILURE
+#include <cstring> // std::memcpy(), std::memcmp(), std::strncpy()
+#include <cstdio> // std::remove()
+#include <iostream> // std::cerr, std::endl
+#include <stdexcept> // std::runtime_error
+
+#include <sys/mman.h> // mmap(), munmap(), posix_madvise()
+#include <sys/stat.h> // fstat()
+#include <fcntl.h> // open()
+#include <unistd.h> // close()
+
+const char SkimCache::magic[8] = {'B', 'T', 'A', 'G', 'S', 'K', 'I', 'M'};
+const UInt_t SkimCache::version;
+
+namespace {
+	Long64_t align(Long64_t position) {
+		return (position + 7) / 8 * 8;
+	}
+
+	void pad(std::ofstream & out, Long64_t position) {
+		static const char zeros[8] = {0};
+		out.write(zeros, align(position) - position);
+	}
+}
+
+/*********** writer *****************************************/
+
+SkimCache::Writer::Writer(std::string filename)
+	: filename(filename), closed(false) {
+	hOffsets.push_back(0);
+	aOffsets.push_back(0);
+}
+
+SkimCache::Writer::~Writer() {
+	if(! closed) close();
+}
+
+void SkimCache::Writer::addColumn(std::string name, Int_t kind, Int_t size, const void * address) {
+	if(name.size() >= sizeof(Column::name)) {
+		std::cerr << "column name " << name << " is too long" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	Column c;
+	std::memset(c.name, 0, sizeof(c.name));
+	std::strncpy(c.name, name.c_str(), sizeof(c.name) - 1);
+	c.kind = kind;
+	c.size = size;
+	c.position = 0;
+	columns.push_back(c);
+	addresses.push_back(address);
+	std::string tmpName = filename + "." + name + ".tmp";
+	streams.push_back(new std::ofstream(tmpName.c_str(), std::ios::binary | std::ios::trunc));
+	if(! streams.back() -> good()) {
+		std::cerr << "cannot create temporary file " << tmpName << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+}
+
+void SkimCache::Writer::fill(Int_t nhJets, Int_t naJets) {
+	for(std::size_t i = 0; i < columns.size(); ++i) {
+		Long64_t n = 1;
+		if(columns[i].kind == kHJet) n = nhJets;
+		else if(columns[i].kind == kAJet) n = naJets;
+		streams[i] -> write(static_cast<const char *> (addresses[i]), n * columns[i].size);
+	}
+	hOffsets.push_back(hOffsets.back() + nhJets);
+	aOffsets.push_back(aOffsets.back() + naJets);
+}
+
+void SkimCache::Writer::close() {
+	closed = true;
+	for(auto s: streams) {
+		s -> close();
+		delete s;
+	}
+	streams.clear();
+
+	Header h;
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.magic, magic, sizeof(magic));
+	h.version = version;
+	h.nColumns = columns.size();
+	h.nEvents = hOffsets.size() - 1;
+	h.nHJets = hOffsets.back();
+	h.nAJets = aOffsets.back();
+
+	// find the positions of the arrays
+	Long64_t position = align(sizeof(Header) + columns.size() * sizeof(Column));
+	h.hOffsets = position;
+	position = align(position + hOffsets.size() * sizeof(Long64_t));
+	h.aOffsets = position;
+	position = align(position + aOffsets.size() * sizeof(Long64_t));
+	for(auto & c: columns) {
+		Long64_t n = h.nEvents;
+		if(c.kind == kHJet) n = h.nHJets;
+		else if(c.kind == kAJet) n = h.nAJets;
+		c.position = position;
+		position = align(position + n * c.size);
+	}
+
+	std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+	if(! out.good()) {
+		std::cerr << "cannot create " << filename << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	out.write(reinterpret_cast<const char *> (&h), sizeof(h));
+	out.write(reinterpret_cast<const char *> (columns.data()), columns.size() * sizeof(Column));
+	pad(out, out.tellp());
+	out.write(reinterpret_cast<const char *> (hOffsets.data()), hOffsets.size() * sizeof(Long64_t));
+	pad(out, out.tellp());
+	out.write(reinterpret_cast<const char *> (aOffsets.data()), aOffsets.size() * sizeof(Long64_t));
+	pad(out, out.tellp());
+	for(auto & c: columns) {
+		std::string tmpName = filename + "." + c.name + ".tmp";
+		std::ifstream in(tmpName.c_str(), std::ios::binary);
+		if(in.peek() != std::ifstream::traits_type::eof()) out << in.rdbuf();
+		in.close();
+		std::remove(tmpName.c_str());
+		pad(out, out.tellp());
+	}
+	if(! out.good()) {
+		std::cerr << "error on writing " << filename << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	out.close();
+}
+
+/*********** reader *****************************************/
+
+SkimCache::SkimCache(std::string filename)
+	: filename(filename), data(0), size(0), header(0) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) != 0) {
+		if(fd >= 0) close(fd);
+		throw std::runtime_error("cannot open " + filename);
+	}
+	size = st.st_size;
+	if(size < sizeof(Header)) {
+		close(fd);
+		throw std::runtime_error(filename + " is not a skim file");
+	}
+	void * p = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED) throw std::runtime_error("cannot map " + filename + " into memory");
+	posix_madvise(p, size, POSIX_MADV_SEQUENTIAL);
+	data = static_cast<char *> (p);
+	header = reinterpret_cast<const Header *> (data);
+	if(std::memcmp(header -> magic, magic, sizeof(magic)) != 0 || header -> version != version) {
+		munmap(data, size); // the destructor won't run
+		throw std::runtime_error(filename + " is not a skim file of version " + std::to_string(version));
+	}
+	const Column * table = reinterpret_cast<const Column *> (data + sizeof(Header));
+	columns.assign(table, table + header -> nColumns);
+}
+
+SkimCache::~SkimCache() {
+	if(data) munmap(data, size);
+}
+
+bool SkimCache::isSkim(std::string filename) {
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	char buffer[sizeof(magic)];
+	if(! in.read(buffer, sizeof(buffer))) return false;
+	return std::memcmp(buffer, magic, sizeof(magic)) == 0;
+}
+
+Long64_t SkimCache::getEntries() const {
+	return header -> nEvents;
+}
+
+const SkimCache::Column * SkimCache::getColumn(std::string name) const {
+	for(auto & c: columns) {
+		if(name == c.name) return &c;
+	}
+	return 0;
+}
+
+const char * SkimCache::getData(const Column * column) const {
+	return data + column -> position;
+}
+
+const Long64_t * SkimCache::getOffsets(Int_t kind) const {
+	return reinterpret_cast<const Long64_t *> (data + (kind == kHJet ? header -> hOffsets : header -> aOffsets));
+}
+
+const std::vector<SkimCache::Column> & SkimCache::getColumns() const {
+	return columns;
+}
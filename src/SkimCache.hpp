@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <fstream> // std::ofstream
+
+#include <TMath.h>
+
+/**
+ * @brief Flat columnar cache of the selected events, meant to be memory-mapped.
+ *
+ * Layout of the file (all offsets in bytes from the beginning of the file, 8-byte aligned):
+ *   header, column table, hJet offsets [nEvents + 1], aJet offsets [nEvents + 1], columns.
+ * A column is either per event (one value per event) or per jet (values of all events
+ * stored contiguously; the jets of event i are [offset[i], offset[i + 1]) ).
+ *
+ * The branch names of the original tree are kept as the column names, so that the
+ * event loops can read the cache exactly as the tree (see EventReader).
+ *
+ * The reader throws std::runtime_error on a file it can't map, so that the daemon survives a bad job;
+ * the writer, used by skim.cpp only, stops the program.
+ */
+class SkimCache {
+public:
+	enum ColumnKind { kEvent = 0, kHJet = 1, kAJet = 2 };
+	struct Column {
+		char name[48];
+		Int_t kind;
+		Int_t size; // size of a single value in bytes
+		Long64_t position;
+	};
+
+	/**
+	 * @brief Writes the columns into temporary files and assembles the cache on close().
+	 */
+	class Writer {
+	public:
+		Writer(std::string filename);
+		~Writer();
+		void addColumn(std::string name, Int_t kind, Int_t size, const void * address);
+		void fill(Int_t nhJets, Int_t naJets);
+		void close();
+	private:
+		std::string filename;
+		std::vector<Column> columns;
+		std::vector<const void *> addresses;
+		std::vector<std::ofstream *> streams;
+		std::vector<Long64_t> hOffsets;
+		std::vector<Long64_t> aOffsets;
+		bool closed;
+	};
+
+	SkimCache(std::string filename);
+	~SkimCache();
+	static bool isSkim(std::string filename);
+	Long64_t getEntries() const;
+	const Column * getColumn(std::string name) const;
+	const char * getData(const Column * column) const;
+	const Long64_t * getOffsets(Int_t kind) const;
+	const std::vector<Column> & getColumns() const;
+private:
+	struct Header {
+		char magic[8];
+		UInt_t version;
+		UInt_t nColumns;
+		Long64_t nEvents;
+		Long64_t nHJets;
+		Long64_t nAJets;
+		Long64_t hOffsets;
+		Long64_t aOffsets;
+		Long64_t reserved;
+	};
+	static const char magic[8];
+	static const UInt_t version = 1;
+
+	std::string filename;
+	char * data;
+	std::size_t size;
+	const Header * header;
+	std::vector<Column> columns;
+};
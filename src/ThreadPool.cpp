@@ -0,0 +1,56 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned nThreads)
+	: nPending(0), stopping(false) {
+	if(nThreads < 1) nThreads = 1;
+	for(unsigned i = 0; i < nThreads; ++i) {
+		workers.push_back(std::thread(&ThreadPool::workLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	wait();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	taskAvailable.notify_all();
+	for(auto & w: workers) w.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(task);
+		++nPending;
+	}
+	taskAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	allDone.wait(lock, [this] () -> bool { return nPending == 0; });
+}
+
+unsigned ThreadPool::getNumberOfThreads() const {
+	return workers.size();
+}
+
+void ThreadPool::workLoop() {
+	while(true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			taskAvailable.wait(lock, [this] () -> bool { return stopping || ! tasks.empty(); });
+			if(tasks.empty()) return;
+			task = tasks.front();
+			tasks.pop_front();
+		}
+		task();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--nPending;
+			if(nPending == 0) allDone.notify_all();
+		}
+	}
+}
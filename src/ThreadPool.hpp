@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector> // std::vector<>
+#include <deque> // std::deque<>
+#include <functional> // std::function<>
+#include <thread> // std::thread
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+
+/**
+ * @brief Fixed number of threads executing the submitted tasks in the order of submission.
+ *
+ * wait() blocks until every task submitted so far has finished; the pool can be reused afterwards.
+ * The destructor waits for the remaining tasks and joins the threads.
+ */
+class ThreadPool {
+public:
+	ThreadPool(unsigned nThreads);
+	~ThreadPool();
+	void submit(std::function<void()> task);
+	void wait();
+	unsigned getNumberOfThreads() const;
+private:
+	void workLoop();
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()> > tasks;
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable allDone;
+	std::size_t nPending;
+	bool stopping;
+};
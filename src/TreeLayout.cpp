@@ -0,0 +1,117 @@
+#include "TreeLayout.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/ini_parser.hpp>
+
+#include <cstdlib> // std::atoi(), std::atoll(), std::exit(), EXIT_FAILURE
+#include <iostream> // std::cerr, std::endl
+#include <sstream> // std::stringstream
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TBranch.h>
+#include <TObjArray.h>
+
+namespace {
+	const char * algorithmNames[5] = {"default", "zlib", "lzma", "old", "lz4"};
+
+	std::string trim(std::string s) {
+		s = s.substr(0, s.find(";")); // remove the comment
+		boost::algorithm::trim(s); // remove whitespaces around the string
+		return s;
+	}
+}
+
+TreeLayout::TreeLayout()
+	: compression(-1), autoFlush(0), basketSize(0) { }
+
+TreeLayout::TreeLayout(Int_t compression, Long64_t autoFlush, Int_t basketSize)
+	: compression(compression), autoFlush(autoFlush), basketSize(basketSize) { }
+
+TreeLayout::TreeLayout(std::string configFile)
+	: compression(-1), autoFlush(0), basketSize(0) {
+	using boost::property_tree::ptree;
+	ptree pt_ini;
+	read_ini(configFile, pt_ini);
+	if(auto output = pt_ini.get_child_optional("output")) {
+		if(auto s = output -> get_optional<std::string>("compression")) compression = parseCompression(trim(*s));
+		if(auto s = output -> get_optional<std::string>("autoflush")) autoFlush = std::atoll(trim(*s).c_str());
+		if(auto s = output -> get_optional<std::string>("basket")) basketSize = std::atoi(trim(*s).c_str());
+	}
+	if(auto section = pt_ini.get_child_optional("output_compression")) {
+		for(auto & kv: *section) setBranchCompression(kv.first, parseCompression(trim(kv.second.data())));
+	}
+	if(auto section = pt_ini.get_child_optional("output_basket")) {
+		for(auto & kv: *section) setBranchBasketSize(kv.first, std::atoi(trim(kv.second.data()).c_str()));
+	}
+}
+
+void TreeLayout::setBranchCompression(std::string branch, Int_t compression) {
+	branchCompression[branch] = compression;
+}
+
+void TreeLayout::setBranchBasketSize(std::string branch, Int_t basketSize) {
+	branchBasketSize[branch] = basketSize;
+}
+
+void TreeLayout::apply(TFile * f) const {
+	if(compression >= 0) f -> SetCompressionSettings(compression);
+}
+
+void TreeLayout::apply(TTree * t) const {
+	if(autoFlush != 0) t -> SetAutoFlush(autoFlush);
+	if(compression >= 0) {
+		// the branches of a cloned tree keep the settings of the original file
+		TObjArray * branches = t -> GetListOfBranches();
+		for(Int_t i = 0; i < branches -> GetEntriesFast(); ++i) {
+			dynamic_cast<TBranch *> (branches -> At(i)) -> SetCompressionSettings(compression);
+		}
+	}
+	if(basketSize > 0) t -> SetBasketSize("*", basketSize);
+	for(auto & kv: branchBasketSize) {
+		t -> SetBasketSize(kv.first.c_str(), kv.second);
+	}
+	for(auto & kv: branchCompression) {
+		TBranch * b = t -> GetBranch(kv.first.c_str());
+		if(! b) {
+			std::cerr << "no branch " << kv.first << " in tree " << t -> GetName() << " to compress" << std::endl;
+			continue;
+		}
+		b -> SetCompressionSettings(kv.second);
+	}
+}
+
+std::string TreeLayout::toString() const {
+	std::stringstream ss;
+	ss << compressionString(compression);
+	ss << " autoflush=" << autoFlush << " basket=" << basketSize;
+	for(auto & kv: branchCompression) ss << " " << kv.first << "=" << compressionString(kv.second);
+	for(auto & kv: branchBasketSize) ss << " " << kv.first << "=" << kv.second;
+	return ss.str();
+}
+
+Int_t TreeLayout::parseCompression(std::string s) {
+	std::size_t i = s.find(":");
+	std::string algorithm = s.substr(0, i);
+	Int_t level = (i == std::string::npos) ? 1 : std::atoi(s.substr(i + 1).c_str());
+	for(Int_t a = 0; a < 5; ++a) {
+		if(boost::iequals(algorithm, algorithmNames[a])) {
+			if(level < 0 || level > 9) {
+				std::cerr << "invalid compression level in " << s << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+			return 100 * a + level;
+		}
+	}
+	std::cerr << "unknown compression algorithm " << algorithm << std::endl;
+	std::exit(EXIT_FAILURE);
+}
+
+std::string TreeLayout::compressionString(Int_t compression) {
+	if(compression < 0) return "default";
+	std::stringstream ss;
+	Int_t a = compression / 100;
+	ss << (a < 5 ? algorithmNames[a] : "unknown") << ":" << (compression % 100);
+	return ss.str();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string> // std::string
+#include <map> // std::map<>
+
+#include <TMath.h>
+
+class TFile;
+class TTree;
+
+/**
+ * @brief On-disk layout of an output tree: compression, AutoFlush cluster size and basket sizes.
+ *
+ * The config file may contain the following sections (all keys are optional):
+ *   [output]             compression = <algorithm>:<level>, autoflush = <N>, basket = <bytes>
+ *   [output_compression] <branch> = <algorithm>:<level>
+ *   [output_basket]      <branch> = <bytes>
+ * where algorithm is one of zlib, lzma, old or lz4 (ROOT 6 only) and level is 0..9;
+ * autoflush > 0 means the number of entries per cluster, autoflush < 0 the number of bytes.
+ *
+ * @note apply(TFile *) must be called before the branches are created,
+ *       apply(TTree *) after all the branches have been created.
+ */
+class TreeLayout {
+public:
+	TreeLayout();
+	TreeLayout(std::string configFile);
+	TreeLayout(Int_t compression, Long64_t autoFlush, Int_t basketSize);
+	void setBranchCompression(std::string branch, Int_t compression);
+	void setBranchBasketSize(std::string branch, Int_t basketSize);
+	void apply(TFile * f) const;
+	void apply(TTree * t) const;
+	std::string toString() const;
+	static Int_t parseCompression(std::string s);
+	static std::string compressionString(Int_t compression);
+private:
+	Int_t compression; // -1 means ROOT default
+	Long64_t autoFlush; // 0 means ROOT default
+	Int_t basketSize; // 0 means ROOT default
+	std::map<std::string, Int_t> branchCompression;
+	std::map<std::string, Int_t> branchBasketSize;
+};
@@ -1,40 +1,54 @@
-#include <boost/algorithm/string.hpp>
 #include <boost/program_options.hpp>
 #include <boost/progress.hpp>
 #include <boost/timer.hpp>
 
-#include <cstdlib> //EXIT_SUCCESS, std::abs
+#include <cstdlib> //EXIT_SUCCESS, std::abs, std::atof
+#include <cstring> // std::strlen
 #include <iostream> // std::cout
 #include <map> // std::map<>
-#include <cmath> // std::fabs
+#include <cmath> // std::fabs, std::sqrt
 #include <vector> // std::vector<>
-#include <algorithm> // std::find, std::sort, std::accumulate, std::prev_permutation
+#include <algorithm> // std::max
 #include <fstream> // std::ofstream
+#include <stdexcept> // std::runtime_error
 
 #include <TFile.h>
 #include <TTree.h>
 #include <TH1F.h>
+#include <TH1D.h>
+#include <TAxis.h>
 #include <TKey.h>
 #include <TROOT.h>
 #include <TClass.h>
 #include <TMath.h>
+#include <TRandom.h>
 
 #include "common.hpp"
-#include "Jet.hpp"
-#include "JetCollection.hpp"
+#include "EventReader.hpp"
+#include "SkimCache.hpp"
+#include "TreeLayout.hpp"
+#include "Checkpoint.hpp"
+#include "BootstrapReplicas.hpp"
+#include "EventKernels.hpp"
+#include "Arena.hpp"
+#include "AllocationCounter.hpp"
 
-int main(int argc, char ** argv) {
+int main(int argc, char ** argv) try {
 	
 	namespace po = boost::program_options;
 	
 	/*********** input ******************************************/
-	std::string inFilename, treeName, hinput, cinput, outFilename;
+	std::string inFilename, treeName, hinput, cinput, outFilename, layoutFile, replicaFile;
 	bool 	enableVerbose = false, sampleOnce = false, sampleMultiple = false,
 			useAnalytic = false, requireExact = false, realCSV = false;
 	Long64_t beginEvent, endEvent;
 	Int_t requiredJets, requiredBtags;
 	Float_t CSVM;
 	Int_t nIter, nIterMax;
+	Int_t readAhead;
+	Long64_t checkpointInterval;
+	UInt_t seed;
+	bool fixedSeed = false, resume = false;
 	
 	try {
 		po::options_description desc("allowed options");
@@ -54,8 +68,14 @@ int main(int argc, char ** argv) {
 			("sample-once,s", "sample only once (needs -k flag)")
 			("sample-multiple,m", "sample multiple times (needs -k flag)")
 			("use-analytic,a", "find the analytic probability (needs -c flag)")
+			("replicas,P", po::value<std::string>(&replicaFile), "bootstrap replicas written by bootstrap.out\nthe analytic probability is repeated for each of them (needs -a flag)")
 			("real-csv,r", "count b-tags from real csv")
 			("exact,X", "require exact number of jets")
+			("layout,L", po::value<std::string>(&layoutFile), "config file with the compression and basket layout of the output tree\n(sections [output], [output_compression] and [output_basket])")
+			("read-ahead,R", po::value<Int_t>(&readAhead) -> default_value(4), "number of event blocks decoded ahead on a separate thread\n0 means synchronous reading")
+			("seed", po::value<UInt_t>(&seed), "seed of gRandom")
+			("checkpoint,C", po::value<Long64_t>(&checkpointInterval) -> default_value(0), "save a checkpoint (<output>.checkpoint) every N events\n0 means no checkpoints")
+			("resume", "continue from the checkpoint of the output file")
 			("verbose,v", "verbose mode (enables progressbar)")
 		;
 		
@@ -97,12 +117,22 @@ int main(int argc, char ** argv) {
 			}
 			useAnalytic = true;
 		}
+		if(vm.count("replicas") > 0 && ! useAnalytic) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
 		if(vm.count("exact") > 0) {
 			requireExact = true;
 		}
 		if(vm.count("real-csv") > 0) {
 			realCSV = true;
 		}
+		if(vm.count("seed") > 0) {
+			fixedSeed = true;
+		}
+		if(vm.count("resume") > 0) {
+			resume = true;
+		}
 	}
 	catch(std::exception & e) {
 		std::cerr << "error: " << e.what() << std::endl;
@@ -132,9 +162,6 @@ int main(int argc, char ** argv) {
 	
 	/*********** jets *******************************************/
 	
-	int maxNumberOfHJets = 2;
-	int maxNumberOfAJets = 20;
-	
 	Int_t nhJets;
 	Int_t naJets;
 	
@@ -154,14 +181,18 @@ int main(int argc, char ** argv) {
 	//Float_t aJet_genPt[maxNumberOfAJets];
 	
 	/*********** open files *************************************/
-	if(enableVerbose) std::cout << "Opening file " << inFilename << " ..." << std::endl;
-	TFile * in = TFile::Open(inFilename.c_str(), "read");
-	if(in -> IsZombie() || ! in -> IsOpen()) {
-		std::cerr << "Cannot open " << inFilename << "." << std::endl;
-		std::exit(EXIT_FAILURE);
+	TFile * in = 0;
+	TTree * t = 0; // not needed if the input is a skim
+	if(! SkimCache::isSkim(inFilename)) {
+		if(enableVerbose) std::cout << "Opening file " << inFilename << " ..." << std::endl;
+		in = TFile::Open(inFilename.c_str(), "read");
+		if(in -> IsZombie() || ! in -> IsOpen()) {
+			std::cerr << "Cannot open " << inFilename << "." << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(enableVerbose) std::cout << "Accessing tree " << treeName << " ..." << std::endl;
+		t = dynamic_cast<TTree *> (in -> Get(treeName.c_str()));
 	}
-	if(enableVerbose) std::cout << "Accessing tree " << treeName << " ..." << std::endl;
-	TTree * t = dynamic_cast<TTree *> (in -> Get(treeName.c_str()));
 	
 	/*********** read histograms ******************************/
 	
@@ -201,8 +232,14 @@ int main(int argc, char ** argv) {
 		}
 		TKey * keyCumul;
 		TIter nextCumul(cumulativeFile -> GetListOfKeys());
+		std::map<TString, TH1D *> tables; // tagprob_<name> of cumulative.cpp
 		while((keyCumul = dynamic_cast<TKey *>(nextCumul()))) {
 			TClass * cl = gROOT -> GetClass(keyCumul -> GetClassName());
+			TString name = keyCumul -> GetName();
+			if(cl -> InheritsFrom("TH1D") && name.BeginsWith("tagprob_")) {
+				tables[name.Data() + std::strlen("tagprob_")] = dynamic_cast<TH1D *> (keyCumul -> ReadObj());
+				continue;
+			}
 			if(! cl -> InheritsFrom("TH1F")) continue;
 			TH1F * h = dynamic_cast<TH1F *> (keyCumul -> ReadObj());
 			cumulatives[h -> GetName()] = h;
@@ -218,8 +255,18 @@ int main(int argc, char ** argv) {
 			return y;
 		};
 		
-		// calculate the probabilities for the working point
+		// calculate the probabilities for the working point (or take them from the table, if it has the working point)
 		for(auto & kv: cumulatives) {
+			bool found = false;
+			if(tables.count(kv.first)) {
+				TH1D * table = tables[kv.first];
+				for(Int_t i = 1; i <= table -> GetNbinsX() && ! found; ++i) {
+					if(std::fabs(std::atof(table -> GetXaxis() -> GetBinLabel(i)) - CSVM) > 1e-6) continue;
+					probabilities[kv.first] = table -> GetBinContent(i);
+					found = true;
+				}
+			}
+			if(found) continue;
 			Int_t bin = kv.second -> FindBin(CSVM);
 			probabilities[kv.first] = 1.0 - randLinpolEdge(kv.second, CSVM, bin);
 		}
@@ -230,49 +277,131 @@ int main(int argc, char ** argv) {
 		cumulativeFile -> Close();
 	}
 	
-	auto comb = [] (std::vector<float> & v, int N, int K) -> float {
-		std::string bitmask(K, 1); // K leading 1's
-		bitmask.resize(N, 0); // N-K trailing 0's
-		float sum_prob = 0;
-		do {
-			float prob = 1;
-			for (int i = 0; i < N; ++i) {
-				if (bitmask[i]) prob *= v[i];
-				else prob *= (1 - v[i]);
+	/************* read bootstrap replicas *******************/
+	
+	// replicaProbabilities[r][binId]: the probabilities of the analytic method in replica r
+	std::vector<std::vector<Float_t> > replicaProbabilities;
+	if(! replicaFile.empty()) {
+		if(enableVerbose) std::cout << "Reading bootstrap replicas from " << replicaFile << " ..." << std::endl;
+		std::vector<std::string> names;
+		for(int i = 0; i < 3; ++i) {
+			for(int j = 0; j < 6; ++j) {
+				for(int k = 0; k < 3; ++k) {
+					names.push_back(getName(i, j, k));
+				}
 			}
-			sum_prob += prob;
-		} while (std::prev_permutation(bitmask.begin(), bitmask.end()));
-		return sum_prob;
-	};
+		}
+		BootstrapReplicas replicas(replicaFile, names);
+		for(Int_t r = 0; r < replicas.getNumberOfReplicas(); ++r) {
+			replicaProbabilities.push_back(replicas.getProbabilities(r, CSVM));
+		}
+	}
+	const std::size_t nReplicas = replicaProbabilities.size();
+	
+	/************* event kernel *****************************/
+	
+	// the modes are fixed for the whole run, hence the kernel is instantiated for them and chosen only once
+	AnalyzeSetup setup;
+	setup.requiredJets = requiredJets;
+	setup.requiredBtags = requiredBtags;
+	setup.nIterMax = sampleMultiple ? nIterMax : 0; // -x is needed by -m only
+	setup.workingPoint = CSVM;
+	setup.histograms.assign(3 * 6 * 3, 0);
+	setup.probabilities.assign(3 * 6 * 3, 0);
+	for(int i = 0; i < 3; ++i) {
+		for(int j = 0; j < 6; ++j) {
+			for(int k = 0; k < 3; ++k) {
+				TString name = getName(i, j, k).c_str();
+				int binId = (i * 6 + j) * 3 + k; // see getBinId()
+				if(histograms.count(name)) {
+					setup.histograms[binId] = histograms[name];
+					setup.histograms[binId] -> GetIntegral(); // computed by the first GetRandom() otherwise, in the event loop
+				}
+				if(probabilities.count(name)) setup.probabilities[binId] = probabilities[name];
+			}
+		}
+	}
+	RuntimeAnalyzeModes modes = { sampleOnce, sampleMultiple, useAnalytic, realCSV, requireExact };
+	AnalyzeKernel kernel = getAnalyzeKernel(modes);
+	
+	/************** checkpoint ******************************/
+	
+	// restores gRandom and the sums if resumed
+	Checkpoint checkpoint(outFilename + ".checkpoint", checkpointInterval);
+	bool resumed = resume && checkpoint.load();
+	if(resumed) {
+		if(checkpoint.get<Long64_t>("begin") != beginEvent || checkpoint.get<Long64_t>("end") != endEvent) {
+			std::cerr << "the checkpoint was made for a different range of events" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(enableVerbose) std::cout << "Resuming from event " << checkpoint.getNextEntry() << " ..." << std::endl;
+		if(! Checkpoint::truncateTree(outFilename, treeName, checkpoint.getEntries())) std::exit(EXIT_FAILURE);
+	}
+	else {
+		if(resume && enableVerbose) std::cout << "No checkpoint found, starting from event " << beginEvent << " ..." << std::endl;
+		if(fixedSeed) gRandom -> SetSeed(seed);
+		checkpoint.set("begin", beginEvent);
+		checkpoint.set("end", endEvent);
+	}
 	
 	/************** output file *****************************/
 	
-	if(enableVerbose) std::cout << "Creating file " << outFilename << " ..." << std::endl;
-	TFile * out = TFile::Open(outFilename.c_str(), "recreate");
-	TTree * u = new TTree(treeName.c_str(), treeName.c_str());
-	u -> SetDirectory(out);
+	TreeLayout layout;
+	if(! layoutFile.empty()) layout = TreeLayout(layoutFile);
+	
+	TFile * out;
+	TTree * u;
+	if(resumed) {
+		if(enableVerbose) std::cout << "Opening file " << outFilename << " ..." << std::endl;
+		out = TFile::Open(outFilename.c_str(), "update");
+		u = dynamic_cast<TTree *> (out -> Get(treeName.c_str()));
+	}
+	else {
+		if(enableVerbose) std::cout << "Creating file " << outFilename << " ..." << std::endl;
+		out = TFile::Open(outFilename.c_str(), "recreate");
+		layout.apply(out);
+		u = new TTree(treeName.c_str(), treeName.c_str());
+		u -> SetDirectory(out);
+	}
+	// the branches of a resumed tree exist already
+	auto branch = [&u, resumed] (const char * name, void * address, const char * leaves) -> void {
+		if(resumed) u -> SetBranchAddress(name, address);
+		else u -> Branch(name, address, leaves);
+	};
 	
 	/*********** jet branches ***********************************/
 	
 	if(enableVerbose) std::cout << "Setting up branch addresses ..." << std::endl;
 	
-	t -> SetBranchAddress("nhJets", &nhJets);
-	t -> SetBranchAddress("hJet_pt", &hJet_pt);
-	t -> SetBranchAddress("hJet_eta", &hJet_eta);
-	t -> SetBranchAddress("hJet_flavour", &hJet_flavour);
-	//t -> SetBranchAddress("hJet_phi", &hJet_phi);
-	//t -> SetBranchAddress("hJet_e", &hJet_e);
-	//t -> SetBranchAddress("hJet_genPt", &hJet_genPt);
-	t -> SetBranchAddress("hJet_csv", &hJet_csv);
-	
-	t -> SetBranchAddress("naJets", &naJets);
-	t -> SetBranchAddress("aJet_pt", &aJet_pt);
-	t -> SetBranchAddress("aJet_eta", &aJet_eta);
-	t -> SetBranchAddress("aJet_flavour", &aJet_flavour);
-	//t -> SetBranchAddress("aJet_phi", &aJet_phi);
-	//t -> SetBranchAddress("aJet_e", &aJet_e);
-	//t -> SetBranchAddress("aJet_genPt", &aJet_genPt);
-	t -> SetBranchAddress("aJet_csv", &aJet_csv);
+	Long64_t firstEvent = resumed ? checkpoint.getNextEntry() : beginEvent;
+	EventReader reader(t, inFilename, firstEvent, endEvent, readAhead);
+	endEvent = reader.getEndEvent();
+	
+	reader.setBranchAddress("nhJets", &nhJets);
+	reader.setBranchAddress("hJet_pt", &hJet_pt);
+	reader.setBranchAddress("hJet_eta", &hJet_eta);
+	reader.setBranchAddress("hJet_flavour", &hJet_flavour);
+	//reader.setBranchAddress("hJet_phi", &hJet_phi);
+	//reader.setBranchAddress("hJet_e", &hJet_e);
+	//reader.setBranchAddress("hJet_genPt", &hJet_genPt);
+	reader.setBranchAddress("hJet_csv", &hJet_csv);
+	
+	reader.setBranchAddress("naJets", &naJets);
+	reader.setBranchAddress("aJet_pt", &aJet_pt);
+	reader.setBranchAddress("aJet_eta", &aJet_eta);
+	reader.setBranchAddress("aJet_flavour", &aJet_flavour);
+	//reader.setBranchAddress("aJet_phi", &aJet_phi);
+	//reader.setBranchAddress("aJet_e", &aJet_e);
+	//reader.setBranchAddress("aJet_genPt", &aJet_genPt);
+	reader.setBranchAddress("aJet_csv", &aJet_csv);
+	
+	// the bin ids of a skim spare getBinId()
+	Int_t hJet_binId[maxNumberOfHJets], aJet_binId[maxNumberOfAJets];
+	bool precomputedBinIds = reader.hasColumn("hJet_binId") && reader.hasColumn("aJet_binId");
+	if(precomputedBinIds) {
+		reader.setBranchAddress("hJet_binId", &hJet_binId);
+		reader.setBranchAddress("aJet_binId", &aJet_binId);
+	}
 	
 	/*************** NEW TREE STUFF ***************************/
 	//int maxNumberOfHJets = 2;
@@ -296,97 +425,124 @@ int main(int argc, char ** argv) {
 	//Float_t n_aJet_e[maxNumberOfAJets];
 	//Float_t n_aJet_genPt[maxNumberOfAJets];
 	
-	u -> Branch("nhJets", &n_nhJets, "nhJets/I");
-	u -> Branch("hJet_pt", &n_hJet_pt, "hJet_pt[nhJets]/F");
-	u -> Branch("hJet_eta", &n_hJet_eta, "hJet_eta[nhJets]/F");
-	u -> Branch("hJet_csv", &n_hJet_csv, "hJet_csv[nhJets]/F");
-	u -> Branch("hJet_flavour", &n_hJet_flavour, "hJet_flavour[nhJets]/F");
-	//u -> Branch("hJet_phi", &n_hJet_phi, "hJet_phi[nhJets]/F");
-	//u -> Branch("hJet_e", &n_hJet_e, "hJet_e[nhJets]/F");
-	//u -> Branch("hJet_genPt", &n_hJet_genPt, "hJet_genPt[nhJets]/F");
-	
-	u -> Branch("naJets", &n_naJets, "naJets/I");
-	u -> Branch("aJet_pt", &n_aJet_pt, "aJet_pt[naJets]/F");
-	u -> Branch("aJet_eta", &n_aJet_eta, "aJet_eta[naJets]/F");
-	u -> Branch("aJet_csv", &n_aJet_csv, "aJet_csv[naJets]/F");
-	u -> Branch("aJet_flavour", &n_aJet_flavour, "aJet_flavour[naJets]/F");
-	//u -> Branch("aJet_phi", &n_aJet_phi, "aJet_phi[naJets]/F");
-	//u -> Branch("aJet_e", &n_aJet_e, "aJet_e[naJets]/F");
-	//u -> Branch("aJet_genPt", &n_aJet_genPt, "aJet_genPt[naJets]/F");
+	branch("nhJets", &n_nhJets, "nhJets/I");
+	branch("hJet_pt", &n_hJet_pt, "hJet_pt[nhJets]/F");
+	branch("hJet_eta", &n_hJet_eta, "hJet_eta[nhJets]/F");
+	branch("hJet_csv", &n_hJet_csv, "hJet_csv[nhJets]/F");
+	branch("hJet_flavour", &n_hJet_flavour, "hJet_flavour[nhJets]/F");
+	//branch("hJet_phi", &n_hJet_phi, "hJet_phi[nhJets]/F");
+	//branch("hJet_e", &n_hJet_e, "hJet_e[nhJets]/F");
+	//branch("hJet_genPt", &n_hJet_genPt, "hJet_genPt[nhJets]/F");
+	
+	branch("naJets", &n_naJets, "naJets/I");
+	branch("aJet_pt", &n_aJet_pt, "aJet_pt[naJets]/F");
+	branch("aJet_eta", &n_aJet_eta, "aJet_eta[naJets]/F");
+	branch("aJet_csv", &n_aJet_csv, "aJet_csv[naJets]/F");
+	branch("aJet_flavour", &n_aJet_flavour, "aJet_flavour[naJets]/F");
+	//branch("aJet_phi", &n_aJet_phi, "aJet_phi[naJets]/F");
+	//branch("aJet_e", &n_aJet_e, "aJet_e[naJets]/F");
+	//branch("aJet_genPt", &n_aJet_genPt, "aJet_genPt[naJets]/F");
 	
 	/************** NEW BRANCHES ****************************/
 	
 	Float_t n_btag_mProb;
 	Float_t n_btag_aProb;
+	Float_t n_btag_aProbError;
 	Int_t n_btag_count;
 	Float_t n_hJet_csvGen[maxNumberOfHJets];
 	Float_t n_aJet_csvGen[maxNumberOfAJets];
 	Int_t n_btag_real_count;
 	
 	if(sampleOnce) {
-		u -> Branch("btag_count", &n_btag_count, "btag_count/I");
-		u -> Branch("hJet_csvGen", &n_hJet_csvGen, "hJet_csvGen[nhJets]/F");
-		u -> Branch("aJet_csvGen", &n_aJet_csvGen, "aJet_csvGen[naJets]/F");
+		branch("btag_count", &n_btag_count, "btag_count/I");
+		branch("hJet_csvGen", &n_hJet_csvGen, "hJet_csvGen[nhJets]/F");
+		branch("aJet_csvGen", &n_aJet_csvGen, "aJet_csvGen[naJets]/F");
 	}
 	if(sampleMultiple) {
-		u -> Branch("btag_mProb", &n_btag_mProb, "btag_mProb/F");
+		branch("btag_mProb", &n_btag_mProb, "btag_mProb/F");
 	}
 	if(useAnalytic) {
-		u -> Branch("btag_aProb", &n_btag_aProb, "btag_aProb/F");
+		branch("btag_aProb", &n_btag_aProb, "btag_aProb/F");
+	}
+	if(nReplicas > 0) {
+		branch("btag_aProbError", &n_btag_aProbError, "btag_aProbError/F");
 	}
 	if(realCSV) {
-		u -> Branch("btag_real_count", &n_btag_real_count, "btag_real_count/I");
+		branch("btag_real_count", &n_btag_real_count, "btag_real_count/I");
 	}
+	if(! resumed) layout.apply(u);
 	
 	/*********** loop over events *******************************/
 	
-	if(endEvent < 0) endEvent = t -> GetEntries();
-	
 	boost::progress_display * show_progress;
 	if(enableVerbose) {
-		Long64_t dif = endEvent - beginEvent;
+		Long64_t dif = endEvent - firstEvent;
 		std::cout << "Looping over " << dif << " events ... " << std::endl;
-		show_progress = new boost::progress_display(endEvent - beginEvent);
+		show_progress = new boost::progress_display(endEvent - firstEvent);
 	}
 	
-	std::string bKey = "b", cKey = "c", lKey = "l";
-	std::vector<std::string> flavorKeys = {bKey, cKey, lKey};
-	auto findFlavor = [cKey, bKey, lKey] (Float_t flavorCode) -> std::string {
-		if		(TMath::AreEqualAbs(flavorCode, 4, FL_EPS)) return cKey;
-		else if (TMath::AreEqualAbs(flavorCode, 5, FL_EPS)) return bKey;
-		else if (TMath::Abs(flavorCode) < 4 || TMath::AreEqualAbs(flavorCode, 21, FL_EPS)) return lKey;
-		return "";
-	};
+	AnalyzeEvent e;
+	e.hJet_pt = hJet_pt;
+	e.hJet_eta = hJet_eta;
+	e.hJet_flavour = hJet_flavour;
+	e.hJet_csv = hJet_csv;
+	e.aJet_pt = aJet_pt;
+	e.aJet_eta = aJet_eta;
+	e.aJet_flavour = aJet_flavour;
+	e.aJet_csv = aJet_csv;
+	if(precomputedBinIds) {
+		e.hJet_binId = hJet_binId;
+		e.aJet_binId = aJet_binId;
+	}
+	e.hJet_csvGen = n_hJet_csvGen;
+	e.aJet_csvGen = n_aJet_csvGen;
 	
 	Float_t aProb = 0.0, mProb = 0.0;
 	Int_t bCounter = 0, realBcounter = 0;
+	if(resumed) {
+		aProb = checkpoint.get<Float_t>("aProb");
+		mProb = checkpoint.get<Float_t>("mProb");
+		bCounter = checkpoint.get<Int_t>("bCounter");
+		realBcounter = checkpoint.get<Int_t>("realBcounter");
+	}
+	std::vector<Double_t> replicaAProb(nReplicas, 0.0);
+	if(resumed) {
+		for(std::size_t r = 0; r < nReplicas; ++r) replicaAProb[r] = checkpoint.get<Double_t>("aProb_" + std::to_string(r));
+	}
 	
-	for(Long64_t i = beginEvent; i < endEvent; ++i) {
+	// the heap allocations of the event work (the kernel and the replicas), after the first event
+	Arena & arena = Arena::local();
+	Long64_t nAllocations = 0, nMeasured = 0;
+	bool warmedUp = false;
+	auto countAllocations = [&nAllocations, &nMeasured, &warmedUp] (Long64_t before) -> void {
+		if(warmedUp) {
+			nAllocations += AllocationCounter::getNumberOfAllocations() - before;
+			++nMeasured;
+		}
+		warmedUp = true;
+	};
+	
+	while(reader.next()) {
 		if(enableVerbose) ++(*show_progress);
 		
-		t -> GetEntry(i);
-		
-		JetCollection j_coll;
-		j_coll.add(nhJets, hJet_pt, hJet_eta, hJet_flavour, hJet_csv, "h");
-		j_coll.add(naJets, aJet_pt, aJet_eta, aJet_flavour, aJet_csv, "a");
-		
-		j_coll.sortPt(); // sort by jet pt (descending)
+		if(checkpoint.isDue(reader.getEntry())) {
+			checkpoint.set("aProb", aProb);
+			checkpoint.set("mProb", mProb);
+			checkpoint.set("bCounter", bCounter);
+			checkpoint.set("realBcounter", realBcounter);
+			for(std::size_t r = 0; r < nReplicas; ++r) checkpoint.set("aProb_" + std::to_string(r), replicaAProb[r]);
+			checkpoint.save(reader.getEntry(), u);
+		}
 		
-		/****************** find the correct jets **********************/
-		JetCollection passedJets;
-		for(auto & jet: j_coll) {
-			if(jet.getPt() < 20 || std::fabs(jet.getEta()) >= 2.5) continue;
-			Float_t pt = getPtIndex(jet.getPt());
-			Float_t eta = getEtaIndex(std::fabs(jet.getEta()));
-			Float_t flavor = getFlavorIndex(std::fabs(jet.getFlavor()));
-			std::string key = getName(flavor, pt, eta);
-			jet.setName(key);
-			passedJets.add(jet);
-			if(! requireExact) {
-				if(passedJets.size() == requiredJets) break; // only first 'requiredJets' jets
-			}
+		/****************** find the correct jets & run the modes *******/
+		arena.reset();
+		Long64_t allocationsBefore = AllocationCounter::getNumberOfAllocations();
+		e.nhJets = nhJets;
+		e.naJets = naJets;
+		if(! kernel(setup, e)) {
+			countAllocations(allocationsBefore);
+			continue; // skip the event
 		}
-		if(passedJets.size() != requiredJets) continue; // skip the event
 		
 		/************* copy tree branches ******************************/
 		
@@ -407,81 +563,44 @@ int main(int argc, char ** argv) {
 			n_aJet_flavour[j] = aJet_flavour[j];
 		}
 		
-		/**************** sample multiple times ******************************/
-		int Npass = 0;
-		if(sampleMultiple) {
-			for(int iterations = 1; iterations <= nIterMax; ++iterations) {
-				int btagCounter = 0;
-				for(auto & jet: passedJets) {
-					Float_t r = histograms[jet.getName().c_str()] -> GetRandom();
-					if(r >= CSVM) ++btagCounter;
-				}
-				if(btagCounter == requiredBtags) {
-					++Npass;
-				}
-			}
-		}
-		
-		/************ analytic combination of probabilities **********************/
-		std::vector<Float_t> individualProbabilities;
-		if(useAnalytic) {
-			for(auto & jet: passedJets) {
-				individualProbabilities.push_back(probabilities[jet.getName().c_str()]);
-			}
-		}
-		
-		/****************** sample once *********************************/
-		int btagCounter = 0;
-		if(sampleOnce) {
-			std::map<std::string, std::vector<int> > indices;
-			for(auto & jet: passedJets) {
-				int index = jet.getIndex();
-				std::string type = jet.getType();
-				Float_t r = histograms[jet.getName().c_str()] -> GetRandom();
-				if(boost::iequals(type, "a")) n_aJet_csvGen[index] = r;
-				else if(boost::iequals(type, "h")) n_hJet_csvGen[index] = r;
-				if(r >= CSVM) ++btagCounter;
-				indices[type].push_back(index);
-			}
-			for(int j = 0; j < n_naJets; ++j) {
-				if(std::find(indices["a"].begin(), indices["a"].end(), j) != indices["a"].end()) continue;
-				n_aJet_csvGen[j] = -1.0;
-			}
-			for(int j = 0; j < n_nhJets; ++j) {
-				if(std::find(indices["h"].begin(), indices["h"].end(), j) != indices["h"].end()) continue;
-				n_hJet_csvGen[j] = -1.0;
-			}
-		}
-		
-		/***************** count b-tags from real CSV value ****************/
-		int realBtagCounter = 0;
-		if(realCSV) {
-			for(auto & jet: passedJets) {
-				if(jet.getCSV() >= CSVM) ++realBtagCounter;
-			}
-		}
-		
 		/*********** assign & fill the tree *******************/
 		if(sampleMultiple) {
-			n_btag_mProb = float(Npass) / nIterMax;
+			n_btag_mProb = e.mProb;
 			mProb += n_btag_mProb;
 		}
 		if(useAnalytic) {
-			n_btag_aProb = comb(individualProbabilities, requiredJets, requiredBtags);
+			n_btag_aProb = e.aProb;
 			aProb += n_btag_aProb;
 		}
+		if(nReplicas > 0) {
+			// the spread of the event weight over the replicas
+			Double_t sum = 0, sum2 = 0;
+			Float_t replicaIndividual[maxNumberOfHJets + maxNumberOfAJets];
+			for(std::size_t r = 0; r < nReplicas; ++r) {
+				for(Int_t j = 0; j < e.nPassed; ++j) replicaIndividual[j] = (e.binIds[j] < 0) ? 0 : replicaProbabilities[r][e.binIds[j]];
+				Double_t w = combineProbabilities(replicaIndividual, requiredJets, requiredBtags);
+				replicaAProb[r] += w;
+				sum += w;
+				sum2 += w * w;
+			}
+			Double_t mean = sum / nReplicas;
+			n_btag_aProbError = (nReplicas > 1) ? std::sqrt(std::max(0.0, (sum2 - nReplicas * mean * mean) / (nReplicas - 1))) : 0;
+		}
 		if(sampleOnce) {
-			n_btag_count = btagCounter;
-			if(btagCounter == requiredBtags) ++bCounter;
+			n_btag_count = e.count;
+			if(e.count == requiredBtags) ++bCounter;
 		}
 		if(realCSV) {
-			n_btag_real_count = realBtagCounter;
-			if(realBtagCounter == requiredBtags) ++realBcounter;
+			n_btag_real_count = e.realCount;
+			if(e.realCount == requiredBtags) ++realBcounter;
 		}
+		countAllocations(allocationsBefore);
 		u -> Fill();
 	}
 	
-	u -> Write();
+	out -> cd();
+	u -> Write("", TObject::kOverwrite); // replaces the cycles saved by the checkpoints
+	writeEventRange(beginEvent, endEvent);
 	
 	/************* print out the results ************************/
 	if(enableVerbose) {
@@ -491,12 +610,25 @@ int main(int argc, char ** argv) {
 		if(useAnalytic) {
 			std::cout << "Analytic probability:\t" << aProb << std::endl;
 		}
+		if(nReplicas > 1) {
+			Double_t mean = 0, variance = 0;
+			for(auto w: replicaAProb) mean += w / nReplicas;
+			for(auto w: replicaAProb) variance += (w - mean) * (w - mean) / (nReplicas - 1);
+			std::cout << "Bootstrap error:\t" << std::sqrt(variance) << " (" << nReplicas << " replicas)" << std::endl;
+		}
 		if(sampleOnce) {
 			std::cout << "Sampled once:\t\t" << bCounter << std::endl;
 		}
 		if(realCSV) {
 			std::cout << "Real no b-tags:\t\t" << realBcounter << std::endl;
 		}
+		if(AllocationCounter::enabled) {
+			std::cout << "Allocations:\t\t" << nAllocations << " in " << nMeasured << " events (arena: " << arena.getCapacity() << " bytes)" << std::endl;
+		}
+		std::cout << "Reading:\t\t" << reader.getReadTime() << " s (waited " << reader.getWaitTime() << " s)" << std::endl;
+		if(checkpointInterval > 0) {
+			std::cout << "Checkpoints:\t\t" << checkpoint.getNumberOfSaves() << " (" << checkpoint.getOverhead() << " s)" << std::endl;
+		}
 	}
 	
 	/*********** close everything *******************************/
@@ -508,11 +640,16 @@ int main(int argc, char ** argv) {
 		}
 		std::cout << " and " << outFilename << " ..." << std::endl;
 	}
-	in -> Close();
+	if(in) in -> Close();
 	out -> Close();
 	if(sampleOnce || sampleMultiple) {
 		histoFile -> Close();
 	}
+	checkpoint.remove(); // the output is complete
 	
 	return EXIT_SUCCESS;
+}
+catch(std::runtime_error & e) { // EventReader and SkimCache throw, for the daemon
+	std::cerr << e.what() << std::endl;
+	return EXIT_FAILURE;
 }
\ No newline at end of file
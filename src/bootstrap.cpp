@@ -0,0 +1,259 @@
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/ini_parser.hpp>
+
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <cstdlib> // std::atoi(), std::atof(), EXIT_SUCCESS
+#include <memory> // std::unique_ptr<>, std::shared_ptr<>
+#include <functional> // std::bind()
+#include <mutex> // std::mutex, std::lock_guard<>
+#include <thread> // std::thread::hardware_concurrency()
+#include <chrono> // std::chrono
+#include <stdexcept> // std::runtime_error
+
+#include <TTree.h>
+#include <TFile.h>
+
+#include "common.hpp"
+#include "EventReader.hpp"
+#include "SkimCache.hpp"
+#include "ThreadPool.hpp"
+#include "BootstrapReplicas.hpp"
+
+namespace {
+	// the jets of a block of events, handed over to a worker thread
+	struct Block {
+		std::vector<Long64_t> events;
+		std::vector<std::size_t> jetOffsets; // the jets of events[i] are [jetOffsets[i], jetOffsets[i + 1])
+		std::vector<Int_t> binIds;
+		std::vector<Int_t> bins;
+	};
+	const std::size_t blockSize = 10000;
+}
+
+int main(int argc, char ** argv) try {
+	
+	namespace po = boost::program_options;
+	using boost::property_tree::ptree; // ptree, read_ini
+	
+	// command line option parsing
+	std::string configFile, cmd_output, cmd_input, cmd_treeName;
+	Long64_t beginEvent, endEvent;
+	Int_t readAhead, nReplicas;
+	unsigned nThreads;
+	ULong64_t seed;
+	bool enableVerbose = false;
+	try {
+		po::options_description desc("allowed options");
+		desc.add_options()
+			("help,h", "prints this message")
+			("config,c", po::value<std::string>(&configFile), "read config file (CSV binning from section [histogram])")
+			("begin,b", po::value<Long64_t>(&beginEvent) -> default_value(0), "the event number to start with")
+			("end,e", po::value<Long64_t>(&endEvent) -> default_value(-1), "the event number to end with\ndefault (-1) means all events")
+			("output,o", po::value<std::string>(&cmd_output), "output file name")
+			("input,i", po::value<std::string>(&cmd_input), "input *.root file\nif not set, read from config file")
+			("tree,t", po::value<std::string>(&cmd_treeName), "name of the tree\nif not set, read from config file")
+			("replicas,r", po::value<Int_t>(&nReplicas) -> default_value(100), "number of bootstrap replicas")
+			("threads,j", po::value<unsigned>(&nThreads) -> default_value(std::thread::hardware_concurrency()), "number of threads filling the replicas")
+			("seed", po::value<ULong64_t>(&seed) -> default_value(4357), "seed of the replica weights")
+			("read-ahead,R", po::value<Int_t>(&readAhead) -> default_value(4), "number of event blocks decoded ahead on a separate thread\n0 means synchronous reading")
+			("verbose,v", "verbose mode")
+		;
+		
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+		po::notify(vm);
+		
+		if(vm.count("help")) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_SUCCESS); // ugly
+		}
+		if(vm.count("verbose")) {
+			enableVerbose = true;
+		}
+		if(vm.count("config") == 0 || vm.count("output") == 0) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+	}
+	catch(std::exception & e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		std::exit(EXIT_FAILURE); // ugly
+	}
+	catch(...) {
+		std::cerr << "exception of unkown type" << std::endl;
+	}
+	
+	// sanity check
+	if((endEvent >=0 && beginEvent > endEvent) || beginEvent < 0) {
+		std::cerr << "incorrect values for begin and/or end" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if(nReplicas < 1) {
+		std::cerr << "number of replicas must be positive" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if(nThreads < 1) nThreads = 1;
+	
+	// the same binning as process.cpp, so that the nominal histograms can be used in its place
+	ptree pt_ini;
+	read_ini(configFile, pt_ini);
+	auto trim = [] (std::string s) -> std::string {
+		s = s.substr(0, s.find(";")); // remove the comment
+		boost::algorithm::trim(s); // remove whitespaces around the string
+		return s;
+	};
+	std::string config_csvRanges = trim(pt_ini.get<std::string>("histogram.csvrange"));
+	const Int_t bins = std::atoi(trim(pt_ini.get<std::string>("histogram.bins")).c_str());
+	int i = config_csvRanges.find(",");
+	const Float_t minCSV = std::atof(config_csvRanges.substr(0, i).c_str());
+	const Float_t maxCSV = std::atof(config_csvRanges.substr(i + 1).c_str());
+	if(minCSV >= maxCSV) {
+		std::cerr << "wrong values for csv range" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	std::string inputFilename = cmd_input.empty() ? trim(pt_ini.get<std::string>("histogram.in")) : cmd_input;
+	std::string treeName = cmd_treeName.empty() ? trim(pt_ini.get<std::string>("histogram.tree")) : cmd_treeName;
+	
+	std::vector<std::string> names;
+	for(int i = 0; i < 3; ++i) {
+		for(int j = 0; j < 6; ++j) {
+			for(int k = 0; k < 3; ++k) {
+				names.push_back(getName(i, j, k));
+			}
+		}
+	}
+	
+	/*********** open the input *********************************/
+	
+	std::unique_ptr<TFile> in;
+	TTree * t = 0; // not needed if the input is a skim
+	if(! SkimCache::isSkim(inputFilename)) {
+		if(enableVerbose) std::cout << "Reading " << inputFilename << " ... " << std::endl;
+		in.reset(TFile::Open(inputFilename.c_str(), "read"));
+		if(in -> IsZombie() || ! in -> IsOpen()) {
+			std::cerr << "error on opening " << inputFilename << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		t = dynamic_cast<TTree *>(in -> Get(treeName.c_str()));
+	}
+	
+	const int maxNumberOfHJets = 2;
+	const int maxNumberOfAJets = 20;
+	
+	Int_t nhJets;
+	Int_t naJets;
+	Float_t hJet_pt[maxNumberOfHJets];
+	Float_t hJet_eta[maxNumberOfHJets];
+	Float_t hJet_csv[maxNumberOfHJets];
+	Float_t hJet_flavour[maxNumberOfHJets];
+	Float_t aJet_pt[maxNumberOfAJets];
+	Float_t aJet_eta[maxNumberOfAJets];
+	Float_t aJet_csv[maxNumberOfAJets];
+	Float_t aJet_flavour[maxNumberOfAJets];
+	
+	EventReader reader(t, inputFilename, beginEvent, endEvent, readAhead);
+	endEvent = reader.getEndEvent();
+	
+	reader.setBranchAddress("nhJets", &nhJets);
+	reader.setBranchAddress("hJet_pt", &hJet_pt);
+	reader.setBranchAddress("hJet_eta", &hJet_eta);
+	reader.setBranchAddress("hJet_flavour", &hJet_flavour);
+	reader.setBranchAddress("hJet_csv", &hJet_csv);
+	reader.setBranchAddress("naJets", &naJets);
+	reader.setBranchAddress("aJet_pt", &aJet_pt);
+	reader.setBranchAddress("aJet_eta", &aJet_eta);
+	reader.setBranchAddress("aJet_flavour", &aJet_flavour);
+	reader.setBranchAddress("aJet_csv", &aJet_csv);
+	
+	/*********** fill the replicas ******************************/
+	
+	// one accumulator per thread at most; a task takes a free one and gives it back
+	BootstrapReplicas total(names, nReplicas, bins, minCSV, maxCSV);
+	std::vector<std::unique_ptr<BootstrapReplicas> > accumulators;
+	std::vector<BootstrapReplicas *> freeAccumulators;
+	std::mutex accumulatorMutex;
+	auto process = [&] (std::shared_ptr<Block> block) -> void {
+		BootstrapReplicas * acc;
+		{
+			std::lock_guard<std::mutex> lock(accumulatorMutex);
+			if(freeAccumulators.empty()) {
+				accumulators.emplace_back(new BootstrapReplicas(names, nReplicas, bins, minCSV, maxCSV));
+				freeAccumulators.push_back(accumulators.back().get());
+			}
+			acc = freeAccumulators.back();
+			freeAccumulators.pop_back();
+		}
+		std::vector<Double_t> weights(nReplicas);
+		for(std::size_t e = 0; e < block -> events.size(); ++e) {
+			BootstrapReplicas::generateWeights(seed, block -> events[e], weights);
+			for(std::size_t jet = block -> jetOffsets[e]; jet < block -> jetOffsets[e + 1]; ++jet) {
+				acc -> fill(block -> binIds[jet], block -> bins[jet], &weights[0]);
+			}
+		}
+		std::lock_guard<std::mutex> lock(accumulatorMutex);
+		freeAccumulators.push_back(acc);
+	};
+	
+	if(enableVerbose) std::cout << "Filling " << nReplicas << " replicas of " << (endEvent - beginEvent) << " events on " << nThreads << " threads ..." << std::endl;
+	auto t0 = std::chrono::steady_clock::now();
+	{
+		ThreadPool pool(nThreads);
+		std::size_t nSubmitted = 0;
+		std::shared_ptr<Block> block(new Block);
+		block -> jetOffsets.push_back(0);
+		while(reader.next()) {
+			for(int coll = 0; coll < 2; ++coll) {
+				bool isHJet = (coll == 0);
+				for(int j = 0; j < (isHJet ? nhJets : naJets); ++j) {
+					Float_t pt = isHJet ? hJet_pt[j] : aJet_pt[j];
+					Float_t eta = isHJet ? hJet_eta[j] : aJet_eta[j];
+					Float_t flavor = isHJet ? hJet_flavour[j] : aJet_flavour[j];
+					Float_t csv = isHJet ? hJet_csv[j] : aJet_csv[j];
+					int binId = getBinId(flavor, pt, eta);
+					if(binId == -1) continue;
+					block -> binIds.push_back(binId);
+					block -> bins.push_back(total.findBin(csv));
+				}
+			}
+			if(block -> binIds.size() == block -> jetOffsets.back()) continue; // no jets in the bins
+			block -> events.push_back(reader.getEntry());
+			block -> jetOffsets.push_back(block -> binIds.size());
+			if(block -> events.size() == blockSize) {
+				pool.submit(std::bind(process, block));
+				block.reset(new Block);
+				block -> jetOffsets.push_back(0);
+				// keep the number of blocks in memory bounded
+				if(++nSubmitted % (4 * nThreads) == 0) pool.wait();
+			}
+		}
+		if(! block -> events.empty()) pool.submit(std::bind(process, block));
+		pool.wait();
+	}
+	for(auto & acc: accumulators) total += *acc;
+	Double_t wall = std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - t0).count();
+	
+	/*********** write the replicas *****************************/
+	
+	if(enableVerbose) std::cout << "Writing the replicas to " << cmd_output << " ... " << std::endl;
+	std::unique_ptr<TFile> out(new TFile(cmd_output.c_str(), "recreate"));
+	total.write(out.get());
+	out -> cd();
+	writeEventRange(beginEvent, endEvent);
+	if(enableVerbose) {
+		std::cout << "Accumulators:\t" << accumulators.size() << std::endl;
+		std::cout << "Wall time:\t" << wall << " s" << std::endl;
+	}
+	
+	if(in) in -> Close();
+	out -> Close();
+	
+	return EXIT_SUCCESS;
+}
+catch(std::runtime_error & e) { // EventReader and SkimCache throw, for the daemon
+	std::cerr << e.what() << std::endl;
+	return EXIT_FAILURE;
+}
@@ -4,23 +4,31 @@
 #include <iostream> // std::cout, std::cerr, std::endl
 #include <fstream> // std::ofstream
 #include <streambuf> // std::streambuf
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <thread> // std::thread::hardware_concurrency()
 
-#include <TFile.h>
-#include <TTree.h>
+#include <TMath.h>
+
+#include "ColumnReader.hpp"
+#include "KahanSum.hpp"
+#include "ThreadPool.hpp"
 
 int main(int argc, char ** argv) {
 	
 	namespace po = boost::program_options;
 	
-	std::string input, treeName, output;
+	std::string treeName, output;
+	std::vector<std::string> inputs;
 	Long64_t beginEvent, endEvent;
 	bool writeToFile = false, useAnalytical = false, useMultiple = false, useRealBtags = false;
 	Int_t nBtags;
+	unsigned nThreads;
 	try {
 		po::options_description desc("allowed options");
 		desc.add_options()
 			("help,h", "prints this message")
-			("input,i", po::value<std::string>(&input), "input *.root file")
+			("input,i", po::value<std::vector<std::string> >(&inputs) -> multitoken(), "input *.root file(s) or skim(s)\nthe sums run over all of them")
 			("begin,b", po::value<Long64_t>(&beginEvent) -> default_value(0), "the event number to start with")
 			("end,e", po::value<Long64_t>(&endEvent) -> default_value(-1), "the event number to end with\ndefault (-1) means all events")
 			("tree,t", po::value<std::string>(&treeName), "name of the tree (assumed to be common)")
@@ -29,6 +37,7 @@ int main(int argc, char ** argv) {
 			("use-analytical,a", "use analytical probabilities")
 			("use-multiple,m", "use weights obtained by multiple sampling method")
 			("use-realNbtags,r", "read real number of b-tags")
+			("threads,j", po::value<unsigned>(&nThreads) -> default_value(std::thread::hardware_concurrency()), "number of files reduced in parallel")
 		;
 		
 		po::variables_map vm;
@@ -69,53 +78,52 @@ int main(int argc, char ** argv) {
 		std::exit(EXIT_FAILURE);
 	}
 	
-	/************* open iteration file *************/
-	TFile * inFile = TFile::Open(input.c_str(), "read");
-	if(inFile -> IsZombie() || ! inFile -> IsOpen()) {
-		std::cerr << "Couldn't open file " << input << " ..." << std::endl;
-		std::exit(EXIT_FAILURE);
-	}
-	TTree * t = dynamic_cast<TTree *> (inFile -> Get(treeName.c_str()));
-	
-	Float_t btag_aProb;
-	Float_t btag_mProb;
-	Int_t btag_count;
-	Int_t btag_real_count;
+	if(nThreads < 1) nThreads = 1;
 	
-	if(useAnalytical) {
-		t -> SetBranchAddress("btag_aProb", &btag_aProb);
-	}
-	if(useMultiple) {
-		t -> SetBranchAddress("btag_mProb", &btag_mProb);
+	/************* reduce the files *************/
+	// every file is reduced on its own thread, block by block over the needed columns only
+	struct Sums {
+		KahanSum aProb;
+		KahanSum mProb;
+		Long64_t bcount;
+		Long64_t realBcount;
+		Long64_t nEvents;
+		Long64_t endEvent;
+	};
+	std::vector<Sums> sums(inputs.size());
+	ThreadPool pool(nThreads);
+	for(std::size_t f = 0; f < inputs.size(); ++f) {
+		pool.submit([&, f] () {
+			ColumnReader reader(inputs[f], treeName, beginEvent, endEvent);
+			std::size_t countColumn = reader.addColumn<Int_t>("btag_count");
+			std::size_t aColumn = useAnalytical ? reader.addColumn<Float_t>("btag_aProb") : 0;
+			std::size_t mColumn = useMultiple ? reader.addColumn<Float_t>("btag_mProb") : 0;
+			std::size_t realColumn = useRealBtags ? reader.addColumn<Int_t>("btag_real_count") : 0;
+			Sums & s = sums[f];
+			s.bcount = s.realBcount = s.nEvents = 0;
+			while(reader.next()) {
+				Long64_t n = reader.getSize();
+				s.bcount += ColumnReader::count(reader.getColumn<Int_t>(countColumn), n, nBtags);
+				if(useAnalytical) s.aProb += ColumnReader::sum(reader.getColumn<Float_t>(aColumn), n);
+				if(useMultiple) s.mProb += ColumnReader::sum(reader.getColumn<Float_t>(mColumn), n);
+				if(useRealBtags) s.realBcount += ColumnReader::sum(reader.getColumn<Int_t>(realColumn), n);
+				s.nEvents += n;
+			}
+			s.endEvent = reader.getEndEvent();
+		});
 	}
-	if(useRealBtags) {
-		t -> SetBranchAddress("btag_real_count", &btag_real_count);
-	}
-	t -> SetBranchAddress("btag_count", &btag_count);
-	
-	endEvent = (endEvent == -1) ? t -> GetEntries() : endEvent;
+	pool.wait();
 	
-	Float_t mProb = 0.0;
-	Float_t aProb = 0.0;
-	Int_t bcount = 0;
-	Int_t realBcount = 0;
-	// loop over the events
-	for(Int_t i = beginEvent; i < endEvent; ++i) {
-		t -> GetEntry(i);
-		bcount += (nBtags == btag_count) ? 1 : 0;
-		if(useAnalytical) {
-			aProb += btag_aProb;
-		}
-		if(useMultiple) {
-			mProb += btag_mProb;
-		}
-		if(useRealBtags) {
-			realBcount += btag_real_count;
-		}
+	KahanSum aProb, mProb;
+	Long64_t bcount = 0, realBcount = 0, nEvents = 0;
+	for(auto & s: sums) {
+		aProb += s.aProb;
+		mProb += s.mProb;
+		bcount += s.bcount;
+		realBcount += s.realBcount;
+		nEvents += s.nEvents;
 	}
-	Int_t nEvents = endEvent - beginEvent;
-	
-	inFile -> Close();
+	endEvent = sums[0].endEvent;
 	
 	std::streambuf * buf;
 	std::ofstream of;
@@ -130,14 +138,18 @@ int main(int argc, char ** argv) {
 	out << "number of events that passed the cut:\t" << nEvents << std::endl;
 	out << "sum of " << nBtags << " b-tagged jets:\t\t\t" << bcount << std::endl;
 	if(useAnalytical) {
-		out << "sum of analytic probabilities:\t\t" << std::fixed << aProb << std::endl;
+		out << "sum of analytic probabilities:\t\t" << std::fixed << aProb.getValue() << std::endl;
 	}
 	if(useMultiple) {
-		out << "sum of multisample weights:\t\t" << std::fixed << mProb << std::endl;
+		out << "sum of multisample weights:\t\t" << std::fixed << mProb.getValue() << std::endl;
 	}
 	if(useRealBtags) {
 		out << "number of real b-tags:\t\t\t" << realBcount << std::endl;
 	}
+	if(inputs.size() == 1) { // for merge.cpp; a sum over several files is merged already
+		out << "begin event:\t\t\t\t" << beginEvent << std::endl;
+		out << "end event:\t\t\t\t" << endEvent << std::endl;
+	}
 	
 	return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include <boost/program_options.hpp>
+
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <cstdlib> // EXIT_SUCCESS, EXIT_FAILURE
+#include <cstring> // std::strncpy(), std::strerror()
+#include <cerrno> // errno
+
+#include <unistd.h> // read(), write(), close(), getcwd()
+#include <sys/socket.h> // socket(), connect()
+#include <sys/un.h> // sockaddr_un
+
+#include "GraphPresets.hpp"
+
+/**
+ * @note Sends a job to daemon.cpp and prints its replies; the job options are those of graph.out and are checked here first.
+ * Exits with EXIT_SUCCESS only if the job is done.
+ * The options of analyze.out, gsample.out and process.out are not understood: a job runs the presets of GraphPresets.hpp, whose
+ * outputs differ (e.g. the btag tree of the analyze preset has no jet branches and no btag_mProb), see README.md.
+ */
+
+int main(int argc, char ** argv) {
+	
+	namespace po = boost::program_options;
+	
+	// command line option parsing
+	std::string socketPath;
+	std::vector<std::string> arguments;
+	bool status = false, shutdown = false, quiet = false;
+	try {
+		po::options_description desc("allowed options");
+		desc.add_options()
+			("help,h", "prints this message")
+			("socket,S", po::value<std::string>(&socketPath) -> default_value("btag.sock"), "path of the socket of daemon.out")
+			("status", "prints the state of the daemon")
+			("shutdown", "stops the daemon after the queued jobs")
+			("quiet,q", "prints only the errors")
+			("job", po::value<std::vector<std::string> >(&arguments), "the options of the job, as for graph.out, e.g.\n-- -i input.root -t tree -p analyze -c cumulatives.root -o out.root")
+		;
+		po::positional_options_description positional;
+		positional.add("job", -1);
+		
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+		po::notify(vm);
+		
+		if(vm.count("status")) {
+			status = true;
+		}
+		if(vm.count("shutdown")) {
+			shutdown = true;
+		}
+		if(vm.count("quiet")) {
+			quiet = true;
+		}
+		if(vm.count("help") || (arguments.empty() && ! status && ! shutdown)) {
+			GraphJob job;
+			po::options_description jobDesc("job options");
+			addGraphOptions(jobDesc, job);
+			std::cout << desc << std::endl << jobDesc << std::endl;
+			std::exit(vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE); // ugly
+		}
+		if(! arguments.empty()) {
+			// the same checks as graph.out, before the job is queued
+			GraphJob job;
+			po::options_description jobDesc("job options");
+			addGraphOptions(jobDesc, job);
+			po::variables_map jobVm;
+			po::store(po::command_line_parser(arguments).options(jobDesc).run(), jobVm);
+			po::notify(jobVm);
+		}
+	}
+	catch(std::exception & e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		std::exit(EXIT_FAILURE); // ugly
+	}
+	catch(...) {
+		std::cerr << "exception of unkown type" << std::endl;
+	}
+	
+	/*********** request ****/
+	
+	std::string request;
+	if(shutdown) request = "--shutdown\n";
+	else if(status) request = "--status\n";
+	else {
+		char directory[4096];
+		if(! getcwd(directory, sizeof(directory))) {
+			std::cerr << "error on getting the working directory: " << std::strerror(errno) << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		request = std::string(directory) + "\n";
+		for(auto & a: arguments) {
+			if(a.find('\n') != std::string::npos) {
+				std::cerr << "the options of a job can't contain new lines" << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+			request += a + "\n";
+		}
+		request += "\n";
+	}
+	
+	sockaddr_un address;
+	if(socketPath.size() >= sizeof(address.sun_path)) {
+		std::cerr << "the path of the socket is too long" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+		std::cerr << "error on connecting to " << socketPath << ": " << std::strerror(errno) << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	for(std::size_t written = 0; written < request.size(); ) {
+		ssize_t n = write(fd, request.c_str() + written, request.size() - written);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) {
+			std::cerr << "error on sending the job: " << std::strerror(errno) << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		written += n;
+	}
+	
+	/*********** replies ****/
+	
+	std::string line, last;
+	char buffer[4096];
+	while(true) {
+		ssize_t n = read(fd, buffer, sizeof(buffer));
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) break;
+		for(ssize_t i = 0; i < n; ++i) {
+			if(buffer[i] != '\n') {
+				line += buffer[i];
+				continue;
+			}
+			if(line.compare(0, 6, "error ") == 0) std::cerr << line.substr(6) << std::endl;
+			else if(! quiet) std::cout << line << std::endl;
+			last = line;
+			line.clear();
+		}
+	}
+	close(fd);
+	
+	if(last.compare(0, 5, "done ") != 0) {
+		if(last.empty()) std::cerr << "the daemon closed the connection" << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -6,18 +6,32 @@
 #include <iostream> // std::cout, std::cerr, std::endl
 #include <fstream> // std::ofstream
 #include <streambuf> // std::streambuf
+#include <memory> // std::shared_ptr<>
+#include <thread> // std::thread::hardware_concurrency()
+#include <stdexcept> // std::runtime_error
 
 #include <TFile.h>
 #include <TTree.h>
 #include <TH1F.h>
 
-int main(int argc, char ** argv) {
+#include "EventReader.hpp"
+#include "SkimCache.hpp"
+#include "HistoBook.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+	const std::size_t blockSize = 10000; // events per task
+}
+
+int main(int argc, char ** argv) try {
 	
 	namespace po = boost::program_options;
 	
-	std::string input, treeName, output;
+	std::string input, treeName, output, configFile;
 	Long64_t beginEvent, endEvent;
 	Int_t nBtags;
+	Int_t readAhead;
+	unsigned nThreads;
 	bool useAnalytic = false, useMultiple = false, useRealCSV = false, enableVerbose = false;
 	try {
 		po::options_description desc("allowed options");
@@ -32,6 +46,9 @@ int main(int argc, char ** argv) {
 			("use-analytical,a", "use analytical probabilities")
 			("use-multiple,m", "use weights obtained by multiple sampling method")
 			("use-real-csv,r", "use real CSV")
+			("read-ahead,R", po::value<Int_t>(&readAhead) -> default_value(4), "number of event blocks decoded ahead on a separate thread\n0 means synchronous reading")
+			("config,c", po::value<std::string>(&configFile), "config file with the booked histograms\n(sections [consistency_variables] and [consistency_methods])")
+			("threads,j", po::value<unsigned>(&nThreads) -> default_value(std::thread::hardware_concurrency()), "number of threads filling the histograms")
 			("verbose,v", "enable verbose mode")
 		;
 		
@@ -68,6 +85,7 @@ int main(int argc, char ** argv) {
 		std::cerr << "exception of unkown type" << std::endl;
 	}
 	
+	if(nThreads < 1) nThreads = 1;
 	if(!(useAnalytic || useMultiple)) {
 		std::cerr << "you have to specify at least one of the following flags: -a -m" << std::endl;
 		std::exit(EXIT_FAILURE);
@@ -78,14 +96,18 @@ int main(int argc, char ** argv) {
 		std::cout << "Opening " << input << " ..." << std::endl;
 	}
 	
-	TFile * inFile = TFile::Open(input.c_str(), "read");
-	if(inFile -> IsZombie() || ! inFile -> IsOpen()) {
-		std::cerr << "Couldn't open file " << input << " ..." << std::endl;
-		std::exit(EXIT_FAILURE);
+	TFile * inFile = 0;
+	TTree * t = 0; // not needed if the input is a skim
+	if(! SkimCache::isSkim(input)) {
+		inFile = TFile::Open(input.c_str(), "read");
+		if(inFile -> IsZombie() || ! inFile -> IsOpen()) {
+			std::cerr << "Couldn't open file " << input << " ..." << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		t = dynamic_cast<TTree *> (inFile -> Get(treeName.c_str()));
 	}
-	TTree * t = dynamic_cast<TTree *> (inFile -> Get(treeName.c_str()));
 	
-	/*********** create two histograms **************/
+	/*********** book the histograms ****************/
 	if(enableVerbose) {
 		std::cout << "Creating " << output << " ..." << std::endl;
 	}
@@ -96,60 +118,11 @@ int main(int argc, char ** argv) {
 		std::exit(EXIT_FAILURE);
 	}
 	
-	std::string hardCutTitle = "hardcut", weightedTitle = "weighted";
-	std::string ptString = "pt", etaString = "eta", csvString = "csv", leadPtString = "leadPt", subleadPtString = "subleadPt";
-	Int_t nbins = 50;
-	
-	TH1F * pt_hardCut = new TH1F(ptString.c_str(), (ptString + " H").c_str(), nbins, 0.0, 250);
-	TH1F * eta_hardCut = new TH1F(etaString.c_str(), (etaString + " H").c_str(), nbins, -3.0, 3.0);
-	TH1F * csv_hardCut = new TH1F(csvString.c_str(), (csvString + " H").c_str(), nbins, 0.0, 1.0);
-	TH1F * leadPt_hardCut = new TH1F(leadPtString.c_str(), (leadPtString + " H").c_str(), nbins, 0.0, 250);
-	TH1F * subleadPt_hardCut = new TH1F(subleadPtString.c_str(), (subleadPtString + " H").c_str(), nbins, 0.0, 250);
-	
-	TH1F * pt_weightedA = new TH1F(ptString.c_str(), (ptString + " A").c_str(), nbins, 0.0, 250);
-	TH1F * eta_weightedA = new TH1F(etaString.c_str(), (etaString + " A").c_str(), nbins, -3.0, 3.0);
-	TH1F * csv_weightedA = new TH1F(csvString.c_str(), (csvString + " A").c_str(), nbins, 0.0, 1.0);
-	TH1F * leadPt_weightedA = new TH1F(leadPtString.c_str(), (leadPtString + " A").c_str(), nbins, 0.0, 250);
-	TH1F * subleadPt_weightedA = new TH1F(subleadPtString.c_str(), (subleadPtString + " A").c_str(), nbins, 0.0, 250);
-	
-	TH1F * pt_weightedM = new TH1F(ptString.c_str(), (ptString + " M").c_str(), nbins, 0.0, 250);
-	TH1F * eta_weightedM = new TH1F(etaString.c_str(), (etaString + " M").c_str(), nbins, -3.0, 3.0);
-	TH1F * csv_weightedM = new TH1F(csvString.c_str(), (csvString + " M").c_str(), nbins, 0.0, 1.0);
-	TH1F * leadPt_weightedM = new TH1F(leadPtString.c_str(), (leadPtString + " M").c_str(), nbins, 0.0, 250);
-	TH1F * subleadPt_weightedM = new TH1F(subleadPtString.c_str(), (subleadPtString + " M").c_str(), nbins, 0.0, 250);
-	
-	TH1F * pt_hardCutR = new TH1F(ptString.c_str(), (ptString + " R").c_str(), nbins, 0.0, 250);
-	TH1F * eta_hardCutR = new TH1F(etaString.c_str(), (etaString + " R").c_str(), nbins, -3.0, 3.0);
-	TH1F * csv_hardCutR = new TH1F(csvString.c_str(), (csvString + " R").c_str(), nbins, 0.0, 1.0);
-	TH1F * leadPt_hardCutR = new TH1F(leadPtString.c_str(), (leadPtString + " R").c_str(), nbins, 0.0, 250);
-	TH1F * subleadPt_hardCutR = new TH1F(subleadPtString.c_str(), (subleadPtString + " R").c_str(), nbins, 0.0, 250);
-	
-	pt_hardCut -> SetDirectory(outFile);
-	eta_hardCut -> SetDirectory(outFile);
-	csv_hardCut -> SetDirectory(outFile);
-	leadPt_hardCut -> SetDirectory(outFile);
-	subleadPt_hardCut -> SetDirectory(outFile);
-	if(useAnalytic) {
-		pt_weightedA -> SetDirectory(outFile);
-		eta_weightedA -> SetDirectory(outFile);
-		csv_weightedA -> SetDirectory(outFile);
-		leadPt_weightedA -> SetDirectory(outFile);
-		subleadPt_weightedA -> SetDirectory(outFile);
-	}
-	if(useMultiple) {
-		pt_weightedM -> SetDirectory(outFile);
-		eta_weightedM -> SetDirectory(outFile);
-		csv_weightedM -> SetDirectory(outFile);
-		leadPt_weightedM -> SetDirectory(outFile);
-		subleadPt_weightedM -> SetDirectory(outFile);
-	}
-	if(useRealCSV) {
-		pt_hardCutR -> SetDirectory(outFile);
-		eta_hardCutR -> SetDirectory(outFile);
-		csv_hardCutR -> SetDirectory(outFile);
-		leadPt_hardCutR -> SetDirectory(outFile);
-		subleadPt_hardCutR -> SetDirectory(outFile);
-	}
+	// the histograms of the methods whose branches are not read are not booked
+	HistoBook book(configFile);
+	if(! useAnalytic) book.drop(HistoBook::kAProb);
+	if(! useMultiple) book.drop(HistoBook::kMProb);
+	if(! useRealCSV) book.drop(HistoBook::kRealCount);
 	
 	if(enableVerbose) {
 		std::cout << "Setting branch addresses ..." << std::endl;
@@ -160,8 +133,8 @@ int main(int argc, char ** argv) {
 	Int_t btag_count;
 	Int_t btag_real_count;
 	
-	int maxNumberOfHJets = 2;
-	int maxNumberOfAJets = 20;
+	const int maxNumberOfHJets = 2;
+	const int maxNumberOfAJets = 20;
 	
 	Int_t nhJets;
 	Int_t naJets;
@@ -178,28 +151,33 @@ int main(int argc, char ** argv) {
 	Float_t hJet_csvGen[maxNumberOfHJets];
 	Float_t aJet_csvGen[maxNumberOfAJets];
 	
-	if(useAnalytic) {
-		t -> SetBranchAddress("btag_aProb", &btag_aProb);
+	EventReader reader(t, input, beginEvent, endEvent, readAhead);
+	endEvent = reader.getEndEvent();
+	
+	if(book.uses(HistoBook::kAProb)) {
+		reader.setBranchAddress("btag_aProb", &btag_aProb);
 	}
-	if(useMultiple) {
-		t -> SetBranchAddress("btag_mProb", &btag_mProb);
+	if(book.uses(HistoBook::kMProb)) {
+		reader.setBranchAddress("btag_mProb", &btag_mProb);
 	}
-	if(useRealCSV) {
-		t -> SetBranchAddress("btag_real_count", &btag_real_count);
+	if(book.uses(HistoBook::kRealCount)) {
+		reader.setBranchAddress("btag_real_count", &btag_real_count);
+	}
+	if(book.uses(HistoBook::kCount)) {
+		reader.setBranchAddress("btag_count", &btag_count);
+	}
+	reader.setBranchAddress("nhJets", &nhJets);
+	reader.setBranchAddress("naJets", &naJets);
+	reader.setBranchAddress("hJet_pt", &hJet_pt);
+	reader.setBranchAddress("aJet_pt", &aJet_pt);
+	reader.setBranchAddress("hJet_eta", &hJet_eta);
+	reader.setBranchAddress("aJet_eta", &aJet_eta);
+	reader.setBranchAddress("hJet_csv", &hJet_csv);
+	reader.setBranchAddress("aJet_csv", &aJet_csv);
+	if(book.uses(HistoBook::kCSVGen)) {
+		reader.setBranchAddress("hJet_csvGen", &hJet_csvGen);
+		reader.setBranchAddress("aJet_csvGen", &aJet_csvGen);
 	}
-	t -> SetBranchAddress("btag_count", &btag_count);
-	t -> SetBranchAddress("nhJets", &nhJets);
-	t -> SetBranchAddress("naJets", &naJets);
-	t -> SetBranchAddress("hJet_pt", &hJet_pt);
-	t -> SetBranchAddress("aJet_pt", &aJet_pt);
-	t -> SetBranchAddress("hJet_eta", &hJet_eta);
-	t -> SetBranchAddress("aJet_eta", &aJet_eta);
-	t -> SetBranchAddress("hJet_csv", &hJet_csv);
-	t -> SetBranchAddress("aJet_csv", &aJet_csv);
-	t -> SetBranchAddress("hJet_csvGen", &hJet_csvGen);
-	t -> SetBranchAddress("aJet_csvGen", &aJet_csvGen);
-	
-	endEvent = (endEvent == -1) ? t -> GetEntries() : endEvent;
 	
 	boost::progress_display * show_progress;
 	if(enableVerbose) {
@@ -208,85 +186,60 @@ int main(int argc, char ** argv) {
 		show_progress = new boost::progress_display(endEvent - beginEvent);
 	}
 	
-	// loop over the events
-	for(Int_t i = beginEvent; i < endEvent; ++i) {
-		t -> GetEntry(i);
+	// the events are copied into columns; full blocks are filled on the thread pool
+	{
+		ThreadPool pool(nThreads);
+		std::size_t nSubmitted = 0;
+		std::shared_ptr<HistoBook::Block> block(new HistoBook::Block);
+		auto addJet = [&block] (Float_t pt, Float_t eta, Float_t csv, Float_t csvGen) -> void {
+			block -> jets[HistoBook::kPt].push_back(pt);
+			block -> jets[HistoBook::kEta].push_back(eta);
+			block -> jets[HistoBook::kCSV].push_back(csv);
+			block -> jets[HistoBook::kCSVGen].push_back(csvGen);
+			block -> jetEvents.push_back(block -> size());
+		};
+		const bool readCSVGen = book.uses(HistoBook::kCSVGen);
 		
-		Float_t leadPt = -1.0, subleadPt = -1.0;
-		
-		for(int j = 0; j < nhJets; ++j) {
-			if(leadPt < hJet_pt[j]) {
-				subleadPt = leadPt;
-				leadPt = hJet_pt[j];
-			}
+		// loop over the events
+		while(reader.next()) {
+			// the two highest pts (a jet below the leading one used to be missed as the subleading one)
+			Float_t leadPt = -1.0, subleadPt = -1.0;
 			
-			if(btag_count == nBtags) {
-				pt_hardCut -> Fill(hJet_pt[j]);
-				eta_hardCut -> Fill(hJet_eta[j]);
-				csv_hardCut -> Fill(hJet_csv[j]);
-			}
-			if(useAnalytic) {
-				pt_weightedA -> Fill(hJet_pt[j], btag_aProb);
-				eta_weightedA -> Fill(hJet_eta[j], btag_aProb);
-				csv_weightedA -> Fill(hJet_csv[j], btag_aProb);
+			for(int j = 0; j < nhJets; ++j) {
+				if(leadPt < hJet_pt[j]) {
+					subleadPt = leadPt;
+					leadPt = hJet_pt[j];
+				}
+				else if(subleadPt < hJet_pt[j]) subleadPt = hJet_pt[j];
+				addJet(hJet_pt[j], hJet_eta[j], hJet_csv[j], readCSVGen ? hJet_csvGen[j] : 0);
 			}
-			if(useMultiple) {
-				pt_weightedM -> Fill(hJet_pt[j], btag_mProb);
-				eta_weightedM -> Fill(hJet_eta[j], btag_mProb);
-				csv_weightedM -> Fill(hJet_csv[j], btag_mProb);
-			}
-			if(btag_real_count == nBtags) {
-				pt_hardCutR -> Fill(hJet_pt[j]);
-				eta_hardCutR -> Fill(hJet_eta[j]);
-				csv_hardCutR -> Fill(hJet_csv[j]);
-			}
-		}
-		for(int j = 0; j < naJets; ++j) {
-			if(leadPt < aJet_pt[j]) {
-				subleadPt = leadPt;
-				leadPt = aJet_pt[j];
+			for(int j = 0; j < naJets; ++j) {
+				if(leadPt < aJet_pt[j]) {
+					subleadPt = leadPt;
+					leadPt = aJet_pt[j];
+				}
+				else if(subleadPt < aJet_pt[j]) subleadPt = aJet_pt[j];
+				addJet(aJet_pt[j], aJet_eta[j], aJet_csv[j], readCSVGen ? aJet_csvGen[j] : 0);
 			}
 			
-			if(btag_count == nBtags) {
-				pt_hardCut -> Fill(aJet_pt[j]);
-				eta_hardCut -> Fill(aJet_eta[j]);
-				csv_hardCut -> Fill(aJet_csv[j]);
-			}
-			if(useAnalytic) {
-				pt_weightedA -> Fill(aJet_pt[j], btag_aProb);
-				eta_weightedA -> Fill(aJet_eta[j], btag_aProb);
-				csv_weightedA -> Fill(aJet_csv[j], btag_aProb);
-			}
-			if(useMultiple) {
-				pt_weightedM -> Fill(aJet_pt[j], btag_mProb);
-				eta_weightedM -> Fill(aJet_eta[j], btag_mProb);
-				csv_weightedM -> Fill(aJet_csv[j], btag_mProb);
-			}
-			if(btag_real_count == nBtags) {
-				pt_hardCutR -> Fill(aJet_pt[j]);
-				eta_hardCutR -> Fill(aJet_eta[j]);
-				csv_hardCutR -> Fill(aJet_csv[j]);
+			block -> aProb.push_back(book.uses(HistoBook::kAProb) ? btag_aProb : 0);
+			block -> mProb.push_back(book.uses(HistoBook::kMProb) ? btag_mProb : 0);
+			block -> count.push_back(book.uses(HistoBook::kCount) ? btag_count : -1);
+			block -> realCount.push_back(book.uses(HistoBook::kRealCount) ? btag_real_count : -1);
+			block -> events[0].push_back(leadPt);
+			block -> events[1].push_back(subleadPt);
+			
+			if(block -> size() == blockSize) {
+				pool.submit([&book, block, nBtags] () { book.fill(*block, nBtags); });
+				block.reset(new HistoBook::Block);
+				// keep the number of blocks in memory bounded
+				if(++nSubmitted % (4 * nThreads) == 0) pool.wait();
 			}
+			
+			if(enableVerbose) ++(*show_progress);
 		}
-		
-		if(btag_count == nBtags) {
-			leadPt_hardCut -> Fill(leadPt);
-			subleadPt_hardCut -> Fill(subleadPt);
-		}
-		if(useAnalytic) {
-			leadPt_weightedA -> Fill(leadPt, btag_aProb);
-			subleadPt_weightedA -> Fill(subleadPt, btag_aProb);
-		}
-		if(useMultiple) {
-			leadPt_weightedM -> Fill(leadPt, btag_mProb);
-			subleadPt_weightedM -> Fill(subleadPt, btag_mProb);
-		}
-		if(btag_real_count == nBtags) {
-			leadPt_hardCutR -> Fill(leadPt);
-			subleadPt_hardCutR -> Fill(subleadPt);
-		}
-		
-		if(enableVerbose) ++(*show_progress);
+		if(block -> size() > 0) pool.submit([&book, block, nBtags] () { book.fill(*block, nBtags); });
+		pool.wait();
 	}
 	
 	/************ write the histograms *****************/
@@ -295,33 +248,18 @@ int main(int argc, char ** argv) {
 		std::cout << "Writing to " << output << " ..." << std::endl;
 	}
 	
-	pt_hardCut -> Write();
-	if(useAnalytic) pt_weightedA -> Write();
-	if(useMultiple) pt_weightedM -> Write();
-	if(useRealCSV)	pt_hardCutR -> Write();
-	eta_hardCut -> Write();
-	if(useAnalytic) eta_weightedA -> Write();
-	if(useMultiple) eta_weightedM -> Write();
-	if(useRealCSV)	eta_hardCutR -> Write();
-	csv_hardCut -> Write();
-	if(useAnalytic) csv_weightedA -> Write();
-	if(useMultiple) csv_weightedM -> Write();
-	if(useRealCSV)	csv_hardCutR -> Write();
-	leadPt_hardCut -> Write();
-	if(useAnalytic) leadPt_weightedA -> Write();
-	if(useMultiple) leadPt_weightedM -> Write();
-	if(useRealCSV)	leadPt_hardCutR -> Write();
-	subleadPt_hardCut -> Write();
-	if(useAnalytic) subleadPt_weightedA -> Write();
-	if(useMultiple) subleadPt_weightedM -> Write();
-	if(useRealCSV)	subleadPt_hardCutR -> Write();
+	book.write(outFile);
 	
 	if(enableVerbose) {
 		std::cout << "Closing " << input << " and " << output << " ..." << std::endl;
 	}
 	
-	inFile -> Close();
+	if(inFile) inFile -> Close();
 	outFile -> Close();
 	
 	return EXIT_SUCCESS;
+}
+catch(std::runtime_error & e) { // EventReader and SkimCache throw, for the daemon
+	std::cerr << e.what() << std::endl;
+	return EXIT_FAILURE;
 }
\ No newline at end of file
@@ -1,28 +1,110 @@
 #include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
 
 #include <string> // std::string
-#include <cstdlib> // EXIT_SUCCESS
+#include <vector> // std::vector<>
+#include <map> // std::map<>
+#include <cstdlib> // EXIT_SUCCESS, EXIT_FAILURE, std::atof(), std::atoll()
+#include <cmath> // std::llround()
+#include <algorithm> // std::min(), std::max()
 #include <iostream> // std::cout, std::cerr, std::endl
+#include <chrono> // std::chrono::steady_clock, std::chrono::duration<>
 
+#include <RConfigure.h>
 #include <TFile.h>
 #include <TTree.h>
 #include <TString.h>
+#include <TRandom3.h>
+#ifdef R__USE_IMT
+#include <TROOT.h>
+#endif
+
+#include "ColumnReader.hpp"
+
+namespace {
+	// the branches copied by default
+	const char * defaultBranches[] = {
+		"nhJets", "naJets",
+		"hJet_pt", "hJet_eta", "hJet_csv", "hJet_flavour",
+		"aJet_pt", "aJet_eta", "aJet_csv", "aJet_flavour",
+		"nvlep", "nalep",
+		"vLepton_pt", "aLepton_pt", "vLepton_eta", "aLepton_eta",
+		"vLepton_pfCombRelIso", "aLepton_pfCombRelIso", "vLepton_type", "aLepton_type",
+		"vLepton_id80", "aLepton_id80", "vLepton_id95", "aLepton_id95",
+		"vLepton_charge", "aLepton_charge", "vLepton_idMVAtrig", "aLepton_idMVAtrig",
+		"vLepton_idMVAnotrig", "aLepton_idMVAnotrig", "vLepton_idMVApresel", "aLepton_idMVApresel",
+		"vLepton_particleIso", "aLepton_particleIso", "vLepton_dxy", "aLepton_dxy",
+		"vLepton_innerHits", "aLepton_innerHits"
+	};
+	
+	enum Mode { kAll, kFirst, kRandom, kEvery, kStratified };
+	
+	struct Subsample {
+		std::string output;
+		std::string spec;
+		Mode mode;
+		Double_t fraction; // kRandom, kStratified
+		Long64_t n; // kFirst: number of entries, kEvery: the step
+		TRandom3 * random;
+		std::vector<char> selected; // kStratified: decided before the copy
+		TFile * file;
+		TTree * tree;
+		Long64_t nSelected;
+	};
+	
+	// parses all, first:N, random:F, every:K or stratified:F
+	bool parseSpec(std::string spec, Subsample & s) {
+		std::string mode = spec.substr(0, spec.find(":"));
+		std::string value = spec.find(":") == std::string::npos ? "" : spec.substr(spec.find(":") + 1);
+		s.spec = spec;
+		s.fraction = 1;
+		s.n = -1;
+		if(mode == "all" && value.empty()) s.mode = kAll;
+		else if(mode == "first" && ! value.empty()) {
+			s.mode = kFirst;
+			s.n = std::atoll(value.c_str());
+			return s.n >= 0;
+		}
+		else if(mode == "every" && ! value.empty()) {
+			s.mode = kEvery;
+			s.n = std::atoll(value.c_str());
+			return s.n > 0;
+		}
+		else if((mode == "random" || mode == "stratified") && ! value.empty()) {
+			s.mode = mode == "random" ? kRandom : kStratified;
+			s.fraction = std::atof(value.c_str());
+			return s.fraction > 0 && s.fraction <= 1;
+		}
+		else return false;
+		return true;
+	}
+}
 
 int main(int argc, char ** argv) {
 	
 	namespace po = boost::program_options;
 	
-	std::string inName, inTreeName, outName;
-	Int_t nEntries;
+	std::string inName, inTreeName;
+	std::vector<std::string> outNames, specs, branchPatterns;
+	Int_t nEntries, nThreads, minPerStratum, maxJets;
+	UInt_t seed;
+	bool enableVerbose = false;
 	
 	try {
 		po::options_description desc("allowed options");
 		desc.add_options()
 			("help,h", "prints this message")
 			("input,I", po::value<std::string>(&inName), "input file name")
-			("nEntries,n", po::value<Int_t>(&nEntries) -> default_value(-1), "number of entries to be copied")
-			("out,o", po::value<std::string>(&outName), "output file name")
+			("nEntries,n", po::value<Int_t>(&nEntries) -> default_value(-1), "number of entries to be copied (if no --sample is given)")
+			("out,o", po::value<std::vector<std::string> >(&outNames) -> multitoken(), "output file name(s)")
 			("tree,t", po::value<std::string>(&inTreeName), "tree name")
+			("branches,b", po::value<std::vector<std::string> >(&branchPatterns) -> multitoken(), "branches (or patterns, e.g. 'hJet_*') to be copied\ndefault: the jet and lepton branches")
+			("sample,s", po::value<std::vector<std::string> >(&specs) -> multitoken(), "subsample of each output, one of\n  all           every entry (fast copy)\n  first:N       the first N entries\n  random:F      each entry with probability F\n  every:K       every K-th entry\n  stratified:F  the fraction F of every jet multiplicity")
+			("seed", po::value<UInt_t>(&seed) -> default_value(4357), "seed of the random subsamples")
+			("min-per-stratum", po::value<Int_t>(&minPerStratum) -> default_value(1), "minimum number of entries of every (non-empty) jet multiplicity in the stratified subsamples")
+			("max-jets", po::value<Int_t>(&maxJets) -> default_value(10), "jet multiplicities above this are one stratum")
+			("threads,j", po::value<Int_t>(&nThreads) -> default_value(0), "number of threads compressing the outputs (needs ROOT with implicit multithreading)\n0 disables it")
+			("verbose,v", "verbose mode")
 		;
 		
 		po::variables_map vm;
@@ -37,6 +119,9 @@ int main(int argc, char ** argv) {
 			std::cout << desc << std::endl;
 			std::exit(EXIT_SUCCESS);
 		}
+		if(vm.count("verbose")) {
+			enableVerbose = true;
+		}
 	}
 	catch(std::exception & e) {
 		std::cerr << "error: " << e.what() << std::endl;
@@ -46,61 +131,173 @@ int main(int argc, char ** argv) {
 		std::cerr << "exception of unkown type" << std::endl;
 	}
 	
+	/*********** subsamples ****/
+	
+	if(specs.empty()) specs.push_back(nEntries < 0 ? "all" : "first:" + std::to_string(nEntries));
+	if(specs.size() == 1) specs.resize(outNames.size(), specs[0]);
+	if(specs.size() != outNames.size()) {
+		std::cerr << "the number of subsamples (" << specs.size() << ") and outputs (" << outNames.size() << ") differ" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	std::vector<Subsample> subsamples(outNames.size());
+	bool needStrata = false;
+	for(std::size_t i = 0; i < subsamples.size(); ++i) {
+		Subsample & s = subsamples[i];
+		if(! parseSpec(specs[i], s)) {
+			std::cerr << "invalid subsample " << specs[i] << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		s.output = outNames[i];
+		s.random = new TRandom3(seed + i); // an independent sequence for every output
+		s.file = 0;
+		s.tree = 0;
+		s.nSelected = 0;
+		if(s.mode == kStratified) needStrata = true;
+	}
+	if(branchPatterns.empty()) branchPatterns.assign(defaultBranches, defaultBranches + sizeof(defaultBranches) / sizeof(defaultBranches[0]));
+	else {
+		std::vector<std::string> patterns;
+		for(auto & b: branchPatterns) {
+			std::vector<std::string> tokens;
+			boost::algorithm::split(tokens, b, boost::is_any_of(","), boost::token_compress_on);
+			for(auto & token: tokens) if(! token.empty()) patterns.push_back(token);
+		}
+		branchPatterns = patterns;
+	}
+#ifdef R__USE_IMT
+	if(nThreads > 0) ROOT::EnableImplicitMT(nThreads);
+#else
+	if(nThreads > 0) std::cerr << "ROOT has no implicit multithreading, -j is ignored" << std::endl;
+#endif
+	
+	auto start = std::chrono::steady_clock::now();
+	
+	/*********** strata ****/
+	
+	// the stratified subsamples are decided beforehand from the jet multiplicities only,
+	// so that every multiplicity gets its share exactly (rare ones at least --min-per-stratum)
+	if(needStrata) {
+		std::vector<Int_t> strata;
+		std::map<Int_t, Long64_t> stratumSize;
+		ColumnReader reader(inName, inTreeName, 0, -1);
+		std::size_t nhJetsColumn = reader.addColumn<Int_t>("nhJets");
+		std::size_t naJetsColumn = reader.addColumn<Int_t>("naJets");
+		strata.reserve(reader.getEndEvent());
+		while(reader.next()) {
+			const Int_t * nhJets = reader.getColumn<Int_t>(nhJetsColumn);
+			const Int_t * naJets = reader.getColumn<Int_t>(naJetsColumn);
+			for(Long64_t i = 0; i < reader.getSize(); ++i) {
+				Int_t stratum = std::min(nhJets[i] + naJets[i], maxJets);
+				strata.push_back(stratum);
+				++stratumSize[stratum];
+			}
+		}
+		for(auto & s: subsamples) {
+			if(s.mode != kStratified) continue;
+			// selection sampling: an entry is taken with probability (still needed) / (still left) of its stratum
+			std::map<Int_t, Long64_t> needed, left = stratumSize;
+			for(auto & kv: stratumSize) {
+				Long64_t n = std::max(Long64_t(minPerStratum), Long64_t(std::llround(s.fraction * kv.second)));
+				needed[kv.first] = std::min(n, kv.second);
+			}
+			if(enableVerbose) {
+				std::cout << s.output << ":";
+				for(auto & kv: needed) std::cout << " " << kv.second << "/" << stratumSize[kv.first] << " with " << kv.first << " jets;";
+				std::cout << std::endl;
+			}
+			s.selected.resize(strata.size());
+			for(std::size_t i = 0; i < strata.size(); ++i) {
+				Long64_t & n = needed[strata[i]];
+				Long64_t & l = left[strata[i]];
+				s.selected[i] = n > 0 && s.random -> Rndm() * l < n;
+				if(s.selected[i]) --n;
+				--l;
+			}
+		}
+	}
+	
+	/*********** input ****/
+	
 	TFile * in = TFile::Open(inName.c_str(), "read");
-	if(in -> IsZombie() || ! in -> IsOpen()) {
+	if(! in || in -> IsZombie() || ! in -> IsOpen()) {
 		std::cerr << "error on opening " << inName << std::endl;
 		std::exit(EXIT_FAILURE);
 	}
 	TTree * inTree = dynamic_cast<TTree *>(in -> Get(inTreeName.c_str()));
+	if(! inTree) {
+		std::cerr << "error on accessing tree " << inTreeName << " in " << inName << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	const Long64_t nInput = inTree -> GetEntries();
 	
 	inTree -> SetBranchStatus("*", 0);
-	inTree -> SetBranchStatus("nhJets", 1);
-	inTree -> SetBranchStatus("naJets", 1);
-	inTree -> SetBranchStatus("hJet_pt", 1);
-	inTree -> SetBranchStatus("hJet_eta", 1);
-	inTree -> SetBranchStatus("hJet_csv", 1);
-	inTree -> SetBranchStatus("hJet_flavour", 1);
-	inTree -> SetBranchStatus("aJet_pt", 1);
-	inTree -> SetBranchStatus("aJet_eta", 1);
-	inTree -> SetBranchStatus("aJet_csv", 1);
-	inTree -> SetBranchStatus("aJet_flavour", 1);
-	inTree -> SetBranchStatus("nvlep", 1);
-	inTree -> SetBranchStatus("nalep", 1);
-	inTree -> SetBranchStatus("vLepton_pt", 1);
-	inTree -> SetBranchStatus("aLepton_pt", 1);
-	inTree -> SetBranchStatus("vLepton_eta", 1);
-	inTree -> SetBranchStatus("aLepton_eta", 1);
-	inTree -> SetBranchStatus("vLepton_pfCombRelIso", 1);
-	inTree -> SetBranchStatus("aLepton_pfCombRelIso", 1);
-	inTree -> SetBranchStatus("vLepton_type", 1);
-	inTree -> SetBranchStatus("aLepton_type", 1);
-	inTree -> SetBranchStatus("vLepton_id80", 1);
-	inTree -> SetBranchStatus("aLepton_id80", 1);
-	inTree -> SetBranchStatus("vLepton_id95", 1);
-	inTree -> SetBranchStatus("aLepton_id95", 1);
-	inTree -> SetBranchStatus("vLepton_charge", 1);
-	inTree -> SetBranchStatus("aLepton_charge", 1);
-	inTree -> SetBranchStatus("vLepton_idMVAtrig", 1);
-	inTree -> SetBranchStatus("aLepton_idMVAtrig", 1);
-	inTree -> SetBranchStatus("vLepton_idMVAnotrig", 1);
-	inTree -> SetBranchStatus("aLepton_idMVAnotrig", 1);
-	inTree -> SetBranchStatus("vLepton_idMVApresel", 1);
-	inTree -> SetBranchStatus("aLepton_idMVApresel", 1);
-	inTree -> SetBranchStatus("vLepton_particleIso", 1);
-	inTree -> SetBranchStatus("aLepton_particleIso", 1);
-	inTree -> SetBranchStatus("vLepton_dxy", 1);
-	inTree -> SetBranchStatus("aLepton_dxy", 1);
-	inTree -> SetBranchStatus("vLepton_innerHits", 1);
-	inTree -> SetBranchStatus("aLepton_innerHits", 1);
-	
-	TFile * out = new TFile(outName.c_str(), "recreate");
-	TTree * outTree = inTree -> CloneTree(nEntries);
-	out -> Write();
-	
-	delete inTree;
-	delete outTree;
+	for(auto & b: branchPatterns) inTree -> SetBranchStatus(b.c_str(), 1);
+	
+	/*********** copy ****/
+	
+	// every entry: the baskets of the selected branches are copied as they are, without decompression
+	for(auto & s: subsamples) {
+		if(s.mode != kAll && ! (s.mode == kFirst && s.n >= nInput)) continue;
+		s.file = new TFile(s.output.c_str(), "recreate");
+		s.tree = inTree -> CloneTree(-1, "fast");
+		s.nSelected = s.tree -> GetEntries();
+		s.file -> Write();
+		s.file -> Close();
+		s.tree = 0;
+	}
+	
+	// subsamples: the selected entries are read once and filled into every output that takes them
+	std::vector<Subsample *> active;
+	for(auto & s: subsamples) {
+		if(s.file) continue;
+		s.file = new TFile(s.output.c_str(), "recreate");
+		s.tree = inTree -> CloneTree(0);
+		active.push_back(&s);
+	}
+	if(! active.empty()) {
+		Long64_t nRead = 0;
+		std::vector<Subsample *> takers;
+		for(Long64_t i = 0; i < nInput; ++i) {
+			takers.clear();
+			for(auto s: active) {
+				bool take = false;
+				switch(s -> mode) {
+					case kFirst: take = i < s -> n; break;
+					case kEvery: take = i % s -> n == 0; break;
+					case kRandom: take = s -> random -> Rndm() < s -> fraction; break;
+					case kStratified: take = s -> selected[i]; break;
+					default: break;
+				}
+				if(take) takers.push_back(s);
+			}
+			if(takers.empty()) continue;
+			if(inTree -> GetEntry(i) <= 0) {
+				std::cerr << "error on reading entry " << i << " from " << inName << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+			++nRead;
+			for(auto s: takers) {
+				s -> tree -> Fill();
+				++(s -> nSelected);
+			}
+		}
+		for(auto s: active) {
+			s -> file -> cd();
+			s -> tree -> Write();
+			s -> file -> Close();
+		}
+		if(enableVerbose) std::cout << nRead << " of " << nInput << " entries read" << std::endl;
+	}
+	
+	std::chrono::duration<Double_t> elapsed = std::chrono::steady_clock::now() - start;
+	for(auto & s: subsamples) {
+		std::cout << s.output << ": " << s.nSelected << " of " << nInput << " entries (" << s.spec << ")" << std::endl;
+		delete s.file;
+		delete s.random;
+	}
+	std::cout << "copied in " << elapsed.count() << " s" << std::endl;
+	
 	in -> Close();
-	out -> Close();
 	
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -3,25 +3,35 @@
 #include <cstdlib> // EXIT_SUCCESS, std::exit
 #include <iostream> // std::cout, std::cerr, std::endl
 #include <vector> // std::vector<>
-#include <map> // std::map<>
+#include <algorithm> // std::upper_bound()
+#include <sstream> // std::stringstream
 
 #include <TFile.h>
 #include <TH1F.h>
+#include <TH1D.h>
+#include <TAxis.h>
+#include <TString.h>
 #include <TKey.h>
 #include <TROOT.h>
 #include <TClass.h>
 
+#include "KahanSum.hpp"
+
 int main(int argc, char ** argv) {
 	
 	namespace po = boost::program_options;
 	
 	std::string inFilename, outFilename;
+	Int_t nQuantiles;
+	std::vector<Double_t> workingPoints;
 	try {
 		po::options_description desc("allowed options");
 		desc.add_options()
 			("help,h", "prints this message")
 			("input,i", po::value<std::string>(&inFilename), "input *.root file")
 			("output,o", po::value<std::string>(&outFilename), "output file name")
+			("quantiles,q", po::value<Int_t>(&nQuantiles) -> default_value(1000), "resolution of the quantile tables (quantile_<name>)\n0 means no tables")
+			("working-points,w", po::value<std::vector<Double_t> >(&workingPoints) -> multitoken(), "working points of the tag probability tables (tagprob_<name>)\ndefault: 0.244 0.679 0.898 (CSVL, CSVM, CSVT)")
 		;
 		
 		po::variables_map vm;
@@ -41,6 +51,12 @@ int main(int argc, char ** argv) {
 		std::cerr << "exception of unkown type" << std::endl;
 	}
 	
+	if(workingPoints.empty()) {
+		workingPoints.push_back(0.244);
+		workingPoints.push_back(0.679);
+		workingPoints.push_back(0.898);
+	}
+	
 	TFile * in = TFile::Open(inFilename.c_str(), "read");
 	if(in -> IsZombie() || ! in -> IsOpen()) {
 		std::cerr << "Couldn't open " << inFilename << "." << std::endl;
@@ -59,19 +75,73 @@ int main(int argc, char ** argv) {
 	
 	// http://root.cern.ch/root/html/tutorials/hist/twoscales.C.html
 	TFile * out = TFile::Open(outFilename.c_str(), "recreate");
-	std::map<TString, TH1F *> cumulHistos;
 	for(auto h: histoVector) {
 		Int_t nBins = h -> GetNbinsX();
 		TString name = h -> GetName();
-		cumulHistos[name] = new TH1F(name, name, nBins, 0, 1);
-		cumulHistos[name] -> SetDirectory(out);
-		Float_t total = 0;
+		
+		// the binning of the input, summed and normalized in double precision
+		std::vector<Double_t> edges(nBins + 1), cdf(nBins + 2, 0);
+		for(Int_t i = 1; i <= nBins + 1; ++i) edges[i - 1] = h -> GetBinLowEdge(i);
+		KahanSum total;
 		for(Int_t i = 1; i <= nBins; ++i) {
 			total += h -> GetBinContent(i);
-			cumulHistos[name] -> SetBinContent(i, total);
+			cdf[i] = total.getValue();
+		}
+		if(total.getValue() <= 0) {
+			std::cerr << name << " is empty, skipping it" << std::endl;
+			continue;
+		}
+		for(Int_t i = 1; i <= nBins; ++i) cdf[i] /= total.getValue();
+		
+		TH1F * cumul = new TH1F(name, name, nBins, &edges[0]);
+		cumul -> SetDirectory(out);
+		for(Int_t i = 1; i <= nBins; ++i) cumul -> SetBinContent(i, cdf[i]);
+		cumul -> Write();
+		
+		// x of the probabilities k / nQuantiles, k = 0..nQuantiles (bin k + 1), the inverse of the linear interpolation of the cumulative
+		if(nQuantiles > 0) {
+			TString qName = "quantile_";
+			qName += name;
+			TH1D * quantiles = new TH1D(qName, qName, nQuantiles + 1, -0.5 / nQuantiles, 1 + 0.5 / nQuantiles);
+			quantiles -> SetDirectory(out);
+			Int_t bin = 1;
+			for(Int_t k = 0; k <= nQuantiles; ++k) {
+				Double_t p = Double_t(k) / nQuantiles;
+				if(k == 0) {
+					while(bin < nBins && cdf[bin] <= 0) ++bin;
+					quantiles -> SetBinContent(k + 1, edges[bin - 1]);
+					continue;
+				}
+				while(bin < nBins && cdf[bin] < p) ++bin;
+				Double_t y1 = cdf[bin - 1], y2 = cdf[bin];
+				Double_t x = (y2 > y1) ? edges[bin - 1] + (p - y1) * (edges[bin] - edges[bin - 1]) / (y2 - y1) : edges[bin];
+				quantiles -> SetBinContent(k + 1, x);
+			}
+			quantiles -> Write();
+		}
+		
+		// the probability to be above every working point, as the analytic mode of analyze.cpp finds it
+		if(! workingPoints.empty()) {
+			TString pName = "tagprob_";
+			pName += name;
+			TH1D * probabilities = new TH1D(pName, pName, workingPoints.size(), 0, workingPoints.size());
+			probabilities -> SetDirectory(out);
+			for(std::size_t w = 0; w < workingPoints.size(); ++w) {
+				Double_t wp = workingPoints[w];
+				Double_t p;
+				if(wp < edges[0]) p = 1;
+				else if(wp >= edges[nBins]) p = 0;
+				else {
+					Int_t bin = std::upper_bound(edges.begin(), edges.end(), wp) - edges.begin(); // the bin containing wp
+					p = 1.0 - (cdf[bin - 1] + (cdf[bin] - cdf[bin - 1]) * (wp - edges[bin - 1]) / (edges[bin] - edges[bin - 1]));
+				}
+				probabilities -> SetBinContent(w + 1, p);
+				std::stringstream label;
+				label << wp;
+				probabilities -> GetXaxis() -> SetBinLabel(w + 1, label.str().c_str());
+			}
+			probabilities -> Write();
 		}
-		cumulHistos[name] -> Scale(1.0 / h -> Integral());
-		cumulHistos[name] -> Write();
 	}
 	
 	in -> Close();
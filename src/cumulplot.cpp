@@ -1,11 +1,12 @@
 #include <boost/program_options.hpp>
 
-#include <cstdlib> // EXIT_SUCCESS
+#include <cstdlib> // EXIT_SUCCESS, EXIT_FAILURE, std::exit()
 #include <map> // std::map
 #include <vector> // std::vector<>
 #include <sstream> // std::stringstream
 #include <iostream> // std::cout, std::cerr, std::endl
 #include <algorithm> // std::sort
+#include <thread> // std::thread::hardware_concurrency()
 
 #include <TCanvas.h>
 #include <TFile.h>
@@ -15,6 +16,7 @@
 #include <TLegend.h>
 
 #include "common.hpp"
+#include "BatchRenderer.hpp"
 
 int main(int argc, char ** argv) {
 	
@@ -23,7 +25,8 @@ int main(int argc, char ** argv) {
 	// command line option parsing
 	Int_t dimX, dimY;
 	std::string inName, extension, dir;
-	bool setLog = false;
+	Int_t nWorkers;
+	bool setLog = false, force = false;
 	
 	try {
 		po::options_description desc("allowed options");
@@ -35,6 +38,8 @@ int main(int argc, char ** argv) {
 			("extension,e", po::value<std::string>(&extension), "the extension of the output file")
 			("dir,d", po::value<std::string>(&dir), "the output directory")
 			("enable-log,l", "sets y-axis to logarithmic scale")
+			("workers", po::value<Int_t>(&nWorkers) -> default_value(std::thread::hardware_concurrency()), "number of rendering processes")
+			("force", "render the plots even if their inputs haven't changed")
 		;
 		
 		po::variables_map vm;
@@ -52,6 +57,9 @@ int main(int argc, char ** argv) {
 		if(vm.count("enable-log")) {
 			setLog = true;
 		}
+		if(vm.count("force")) {
+			force = true;
+		}
 	}
 	catch(std::exception & e) {
 		std::cerr << "error: " << e.what() << std::endl;
@@ -72,45 +80,71 @@ int main(int argc, char ** argv) {
 		std::exit(EXIT_FAILURE);
 	}
 	
+	// the histograms are read once here; the workers draw their own copies
+	std::map<std::string, TH1F *> histos;
+	for(int i = 0; i < 3; ++i) {
+		for(int j = 0; j < 6; ++j) {
+			for(int k = 0; k < 3; ++k) {
+				histos[getName(i, j, k)] = dynamic_cast<TH1F *> (in -> Get(getName(i, j, k).c_str()));
+			}
+		}
+	}
+	
+	BatchRenderer renderer((dir.empty() ? "" : dir + "/") + ".plotcache", nWorkers, force);
 	for(int j = 0; j < 6; ++j) {
 		for(int k = 0; k < 3; ++k) {
 			std::string canvasTitle = getAbbrName(j, k);
-			TCanvas * c = new TCanvas(canvasTitle.c_str(), canvasTitle.c_str(), dimX, dimY);
-			gStyle -> SetOptStat(kFALSE);
-			TLegend * legend = new TLegend(0.17, 0.85, 0.43, 0.90);
-			legend -> SetNColumns(3);
-			for(int i = 0; i < 3; ++i) {
-				TH1F * h = dynamic_cast<TH1F *> (in -> Get(getName(i, j, k).c_str()));
-				std::string legendLabel = flavorNames[i] + " jet";
-				std::stringstream histoTitle;
-				histoTitle << "CSV CDF   " << getHistoTitle(j, k) << " @ ";
-				histoTitle << h -> GetNbinsX() << " bins";
-				std::string xLabel = "CSV discriminator";
-				h -> SetLineColor(colorRanges[i]);
-				h -> SetLineWidth(2);
-				h -> GetXaxis() -> SetTitle(xLabel.c_str());
-				h -> GetYaxis() -> SetTitle("Cumulative probability");
-				h -> GetYaxis() -> SetTitleOffset(1.2);
-				h -> SetMaximum(1.05);
-				h -> SetMinimum(0.0);
-				h -> Draw((i == 0 ? "hist" : "same hist")); // same e for the error bars
-				h -> SetTitle(histoTitle.str().c_str());
-				legend -> AddEntry(h, legendLabel.c_str());
-				c -> SetGrid(1);
-				if(setLog) c -> SetLogy(1);
-				c -> SetRightMargin(0.05);
-				c -> Modified();
-				c -> Update();
-			}
-			legend -> Draw();
-			if(setLog) canvasTitle = "log_" + canvasTitle;
-			canvasTitle = "cumul_" + canvasTitle;
-			if(! dir.empty()) canvasTitle = dir + "/" + canvasTitle;
-			c -> SaveAs(canvasTitle.append("." + extension).c_str()); // char * = TString
-			c -> Close();
-			delete legend;
+			std::string fileName = canvasTitle;
+			if(setLog) fileName = "log_" + fileName;
+			fileName = "cumul_" + fileName;
+			if(! dir.empty()) fileName = dir + "/" + fileName;
+			fileName += "." + extension;
+			
+			BatchRenderer::Hash hash;
+			hash.add("cumulplot").add(dimX).add(dimY).add(setLog);
+			for(int i = 0; i < 3; ++i) hash.add(histos[getName(i, j, k)]);
+			
+			renderer.add(fileName, hash, [=, &histos] () {
+				TCanvas * c = new TCanvas(canvasTitle.c_str(), canvasTitle.c_str(), dimX, dimY);
+				gStyle -> SetOptStat(kFALSE);
+				TLegend * legend = new TLegend(0.17, 0.85, 0.43, 0.90);
+				legend -> SetNColumns(3);
+				for(int i = 0; i < 3; ++i) {
+					TH1F * h = histos.at(getName(i, j, k));
+					std::string legendLabel = flavorNames[i] + " jet";
+					std::stringstream histoTitle;
+					histoTitle << "CSV CDF   " << getHistoTitle(j, k) << " @ ";
+					histoTitle << h -> GetNbinsX() << " bins";
+					std::string xLabel = "CSV discriminator";
+					h -> SetLineColor(colorRanges[i]);
+					h -> SetLineWidth(2);
+					h -> GetXaxis() -> SetTitle(xLabel.c_str());
+					h -> GetYaxis() -> SetTitle("Cumulative probability");
+					h -> GetYaxis() -> SetTitleOffset(1.2);
+					h -> SetMaximum(1.05);
+					h -> SetMinimum(0.0);
+					h -> Draw((i == 0 ? "hist" : "same hist")); // same e for the error bars
+					h -> SetTitle(histoTitle.str().c_str());
+					legend -> AddEntry(h, legendLabel.c_str());
+					c -> SetGrid(1);
+					if(setLog) c -> SetLogy(1);
+					c -> SetRightMargin(0.05);
+					c -> Modified();
+					c -> Update();
+				}
+				legend -> Draw();
+				c -> SaveAs(fileName.c_str());
+				c -> Close();
+				delete legend;
+			});
 		}
 	}
+	bool rendered = renderer.run();
+	std::cout << renderer.report() << std::endl;
+	if(! rendered) {
+		std::cerr << "some of the plots failed" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
 	
 	in -> Close();
 	return EXIT_SUCCESS;
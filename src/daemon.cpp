@@ -0,0 +1,276 @@
+#include <boost/program_options.hpp>
+
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <sstream> // std::stringstream
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <map> // std::map<>
+#include <memory> // std::shared_ptr<>, std::unique_ptr<>
+#include <mutex> // std::mutex, std::lock_guard<>
+#include <atomic> // std::atomic<>
+#include <chrono> // std::chrono
+#include <thread> // std::thread::hardware_concurrency()
+#include <algorithm> // std::max()
+#include <stdexcept> // std::runtime_error
+#include <cstdlib> // EXIT_SUCCESS, EXIT_FAILURE
+#include <cstring> // std::strncpy(), std::strerror()
+#include <cerrno> // errno
+#include <csignal> // std::signal(), SIGPIPE
+
+#include <unistd.h> // read(), write(), close(), unlink()
+#include <sys/socket.h> // socket(), bind(), listen(), accept()
+#include <sys/un.h> // sockaddr_un
+#include <sys/time.h> // timeval
+
+#include <TROOT.h>
+
+#include "AnalysisGraph.hpp"
+#include "GraphPresets.hpp"
+#include "SkimCache.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ * @note The daemon runs the jobs of graph.out (the presets process, gsample, analyze, btagcounter and consistency)
+ * without paying the start of ROOT, the parsing and the reading of the cumulatives for each of them.
+ * The calibration tables are read once per (cumulatives, working point) and the skims stay mapped; the jobs on a skim
+ * read that mapping (see EventReader), and a failing job throws and only reports its error.
+ *
+ * Protocol (client.cpp), one line per item over a Unix-domain socket:
+ *   request   the working directory of the client, the options of graph.out, an empty line
+ *             (or a single "--status" / "--shutdown")
+ *   reply     "queued <job>", the printout of the job, then "done <seconds>" or "error <message>"
+ */
+
+namespace {
+	bool writeAll(int fd, std::string s) {
+		const char * p = s.c_str();
+		std::size_t left = s.size();
+		while(left > 0) {
+			ssize_t n = write(fd, p, left);
+			if(n < 0 && errno == EINTR) continue;
+			if(n <= 0) return false;
+			p += n;
+			left -= n;
+		}
+		return true;
+	}
+	
+	bool readLine(int fd, std::string & line) {
+		line.clear();
+		char c;
+		while(true) {
+			ssize_t n = read(fd, &c, 1);
+			if(n < 0 && errno == EINTR) continue;
+			if(n <= 0) return false;
+			if(c == '\n') return true;
+			line += c;
+		}
+	}
+	
+	// relative to the working directory of the client
+	std::string absolute(std::string directory, std::string path) {
+		if(path.empty() || path[0] == '/' || path.find("://") != std::string::npos) return path;
+		return directory + "/" + path;
+	}
+}
+
+int main(int argc, char ** argv) {
+	
+	namespace po = boost::program_options;
+	
+	// command line option parsing
+	std::string socketPath;
+	std::vector<std::string> preloadCumulatives, preloadInputs;
+	std::vector<Float_t> preloadWorkingPoints;
+	unsigned nThreads;
+	bool enableVerbose = false;
+	try {
+		po::options_description desc("allowed options");
+		desc.add_options()
+			("help,h", "prints this message")
+			("socket,S", po::value<std::string>(&socketPath) -> default_value("btag.sock"), "path of the Unix-domain socket")
+			("threads,j", po::value<unsigned>(&nThreads) -> default_value(std::max(1u, std::thread::hardware_concurrency())), "number of jobs run at the same time")
+			("cumulatives,c", po::value<std::vector<std::string> >(&preloadCumulatives) -> multitoken(), "cumulatives read at startup")
+			("working-point,w", po::value<std::vector<Float_t> >(&preloadWorkingPoints) -> multitoken(), "working points of the cumulatives read at startup\ndefault: 0.679")
+			("input,i", po::value<std::vector<std::string> >(&preloadInputs) -> multitoken(), "skims mapped at startup")
+			("verbose,v", "verbose mode (logs the jobs)")
+		;
+		
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+		po::notify(vm);
+		
+		if(vm.count("help")) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_SUCCESS); // ugly
+		}
+		if(vm.count("verbose")) {
+			enableVerbose = true;
+		}
+	}
+	catch(std::exception & e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		std::exit(EXIT_FAILURE); // ugly
+	}
+	catch(...) {
+		std::cerr << "exception of unkown type" << std::endl;
+	}
+	
+	if(nThreads < 1) {
+		std::cerr << "number of threads must be positive" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if(preloadWorkingPoints.empty()) preloadWorkingPoints.push_back(0.679);
+	
+	ROOT::EnableThreadSafety(); // the jobs open files and create histograms concurrently
+	std::signal(SIGPIPE, SIG_IGN); // a client that went away is only an error of its job
+	
+	/*********** warm state ****/
+	
+	std::mutex stateMutex;
+	std::map<std::pair<std::string, Float_t>, std::shared_ptr<CalibrationTables> > tables;
+	std::map<std::string, std::unique_ptr<SkimCache> > skims;
+	auto getTables = [&] (std::string cumulFile, Float_t workingPoint) -> std::shared_ptr<CalibrationTables> {
+		std::lock_guard<std::mutex> lock(stateMutex);
+		auto key = std::make_pair(cumulFile, workingPoint);
+		auto it = tables.find(key);
+		if(it != tables.end()) return it -> second;
+		std::shared_ptr<CalibrationTables> t(new CalibrationTables);
+		readCalibrationTables(cumulFile, workingPoint, * t);
+		tables[key] = t;
+		return t;
+	};
+	// the skims are never unmapped before the daemon stops, so the jobs may keep the pointer
+	auto keepSkim = [&] (std::string input) -> const SkimCache * {
+		if(! SkimCache::isSkim(input)) return 0;
+		std::lock_guard<std::mutex> lock(stateMutex);
+		auto it = skims.find(input);
+		if(it == skims.end()) it = skims.insert(std::make_pair(input, std::unique_ptr<SkimCache>(new SkimCache(input)))).first;
+		return it -> second.get();
+	};
+	try {
+		for(auto & c: preloadCumulatives) {
+			for(auto w: preloadWorkingPoints) {
+				if(enableVerbose) std::cout << "Reading cumulatives from " << c << " (working point " << w << ") ..." << std::endl;
+				getTables(c, w);
+			}
+		}
+		for(auto & i: preloadInputs) {
+			if(! SkimCache::isSkim(i)) throw std::runtime_error(i + " is not a skim");
+			if(enableVerbose) std::cout << "Mapping " << i << " ..." << std::endl;
+			keepSkim(i);
+		}
+	}
+	catch(std::exception & e) {
+		std::cerr << e.what() << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	
+	/*********** jobs ****/
+	
+	std::atomic<Long64_t> nQueued(0), nDone(0), nFailed(0);
+	auto runJob = [&] (int fd, Long64_t id, std::string directory, std::vector<std::string> arguments) -> void {
+		auto start = std::chrono::steady_clock::now();
+		std::stringstream results;
+		try {
+			GraphJob job;
+			po::options_description desc("job options");
+			addGraphOptions(desc, job);
+			po::variables_map vm;
+			po::store(po::command_line_parser(arguments).options(desc).run(), vm);
+			po::notify(vm);
+			job.configFile = absolute(directory, job.configFile);
+			job.input = absolute(directory, job.input);
+			job.output = absolute(directory, job.output);
+			job.cumulFile = absolute(directory, job.cumulFile);
+			completeGraphJob(job);
+			job.input = absolute(directory, job.input); // if read from the config file
+			
+			// a missing file or tree, a bad skim or a read error throw from AnalysisGraph and end only this job
+			const SkimCache * skim = keepSkim(job.input);
+			std::shared_ptr<CalibrationTables> t = getTables(job.cumulFile, job.workingPoint);
+			AnalysisGraph graph(job.input, job.treeName, job.beginEvent, job.endEvent, job.readAhead, skim);
+			declarePresets(graph, job, * t);
+			runPresets(graph, job, results, false);
+		}
+		catch(std::exception & e) {
+			++nFailed;
+			if(enableVerbose) std::cout << "job " << id << " failed: " << e.what() << std::endl;
+			writeAll(fd, results.str() + "error " + e.what() + "\n");
+			close(fd);
+			return;
+		}
+		Double_t seconds = std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - start).count();
+		++nDone;
+		if(enableVerbose) std::cout << "job " << id << " done in " << seconds << " s" << std::endl;
+		std::stringstream done;
+		done << "done " << seconds << "\n";
+		writeAll(fd, results.str() + done.str());
+		close(fd);
+	};
+	
+	/*********** socket ****/
+	
+	sockaddr_un address;
+	if(socketPath.size() >= sizeof(address.sun_path)) {
+		std::cerr << "the path of the socket is too long" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+	unlink(socketPath.c_str()); // left by a previous daemon
+	if(server < 0 || bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(server, 64) < 0) {
+		std::cerr << "error on listening on " << socketPath << ": " << std::strerror(errno) << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if(enableVerbose) std::cout << "Listening on " << socketPath << " with " << nThreads << " threads ..." << std::endl;
+	
+	{
+		ThreadPool pool(nThreads);
+		while(true) {
+			int fd = accept(server, 0, 0);
+			if(fd < 0) {
+				if(errno == EINTR) continue;
+				std::cerr << "error on accepting a client: " << std::strerror(errno) << std::endl;
+				break;
+			}
+			timeval timeout = { 5, 0 }; // a silent client doesn't block the others for long
+			setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+			std::string directory, line;
+			std::vector<std::string> arguments;
+			bool complete = readLine(fd, directory);
+			while(complete && readLine(fd, line) && ! line.empty()) arguments.push_back(line);
+			if(! complete) {
+				close(fd);
+				continue;
+			}
+			if(directory == "--shutdown") {
+				writeAll(fd, "done 0\n");
+				close(fd);
+				break;
+			}
+			if(directory == "--status") {
+				std::stringstream status;
+				{
+					std::lock_guard<std::mutex> lock(stateMutex);
+					status << "jobs: " << nQueued << " queued, " << nDone << " done, " << nFailed << " failed\n"
+						   << "tables: " << tables.size() << ", skims: " << skims.size() << ", threads: " << nThreads << "\n";
+				}
+				writeAll(fd, status.str() + "done 0\n");
+				close(fd);
+				continue;
+			}
+			Long64_t id = nQueued++;
+			writeAll(fd, "queued " + std::to_string(id) + "\n");
+			pool.submit([=, &runJob] () -> void { runJob(fd, id, directory, arguments); });
+		}
+		if(enableVerbose) std::cout << "Waiting for the running jobs ..." << std::endl;
+	} // the pool finishes the queued jobs
+	
+	close(server);
+	unlink(socketPath.c_str());
+	
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,230 @@
+#include <boost/program_options.hpp>
+
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <deque> // std::deque<>
+#include <map> // std::map<>
+#include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS
+#include <cstdio> // std::remove()
+#include <chrono> // std::chrono
+
+#include <sys/wait.h> // waitpid()
+#include <signal.h> // kill(), SIGTERM
+#include <sys/stat.h> // mkdir()
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TFileMerger.h>
+
+#include "ClusterPlan.hpp"
+#include "ChunkCommand.hpp"
+#include "SkimCache.hpp"
+
+namespace {
+	struct Task {
+		std::size_t index;
+		ClusterPlan::Chunk chunk;
+		Int_t attempts;
+	};
+}
+
+int main(int argc, char ** argv) {
+	
+	namespace po = boost::program_options;
+	
+	// command line option parsing
+	std::string input, treeName, output, planFile, workDir;
+	Long64_t beginEvent, endEvent;
+	Int_t nWorkers, nChunks, maxRetries;
+	std::vector<std::string> command;
+	bool enableVerbose = false, doMerge = true, keepPartial = false;
+	try {
+		po::options_description desc("allowed options");
+		desc.add_options()
+			("help,h", "prints this message")
+			("input,i", po::value<std::string>(&input), "input *.root file (or skim) used for planning")
+			("tree,t", po::value<std::string>(&treeName), "name of the tree")
+			("begin,b", po::value<Long64_t>(&beginEvent) -> default_value(0), "the event number to start with")
+			("end,e", po::value<Long64_t>(&endEvent) -> default_value(-1), "the event number to end with\ndefault (-1) means all events")
+			("plan,p", po::value<std::string>(&planFile), "chunks written by planner.out\nif not set, the chunks are planned here")
+			("workers,j", po::value<Int_t>(&nWorkers) -> default_value(4), "number of worker processes")
+			("chunks,n", po::value<Int_t>(&nChunks) -> default_value(-1), "number of chunks\ndefault (-1) means 8 chunks per worker")
+			("retries,r", po::value<Int_t>(&maxRetries) -> default_value(2), "number of retries of a failed chunk")
+			("output,o", po::value<std::string>(&output), "merged output *.root file")
+			("work-dir,w", po::value<std::string>(&workDir) -> default_value("driver"), "directory of the partial outputs and logs")
+			("no-merge", "don't merge the partial outputs")
+			("keep,k", "keep the partial outputs after merging")
+			("command", po::value<std::vector<std::string> >(&command), "the command run for each chunk, e.g.\n-- bin/gsample.out ... -b {begin} -e {end} -o {output}\n({chunk} is replaced by the chunk number)")
+			("verbose,v", "verbose mode")
+		;
+		po::positional_options_description positional;
+		positional.add("command", -1);
+		
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+		po::notify(vm);
+		
+		if(vm.count("help")) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_SUCCESS); // ugly
+		}
+		if(command.empty() || (vm.count("plan") == 0 && vm.count("input") == 0)) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(vm.count("no-merge")) {
+			doMerge = false;
+		}
+		else if(vm.count("output") == 0) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(vm.count("keep")) {
+			keepPartial = true;
+		}
+		if(vm.count("verbose")) {
+			enableVerbose = true;
+		}
+	}
+	catch(std::exception & e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		std::exit(EXIT_FAILURE); // ugly
+	}
+	catch(...) {
+		std::cerr << "exception of unkown type" << std::endl;
+	}
+	
+	if(nWorkers < 1) {
+		std::cerr << "number of workers must be positive" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if(nChunks < 0) nChunks = 8 * nWorkers;
+	
+	/*********** plan the chunks ********************************/
+	
+	std::vector<ClusterPlan::Chunk> chunks;
+	if(! planFile.empty()) {
+		chunks = ClusterPlan(planFile).getChunks();
+	}
+	else {
+		TFile * in = 0;
+		TTree * t = 0;
+		if(! SkimCache::isSkim(input)) {
+			in = TFile::Open(input.c_str(), "read");
+			if(! in || in -> IsZombie() || ! in -> IsOpen()) {
+				std::cerr << "error on opening " << input << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+			t = dynamic_cast<TTree *> (in -> Get(treeName.c_str()));
+			if(! t) {
+				std::cerr << "error on accessing tree " << treeName << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+		}
+		ClusterPlan plan;
+		plan.findClusters(t, input, beginEvent, endEvent);
+		plan.estimateCost(t, input, 100, 1.0, 1.0);
+		plan.split(nChunks);
+		chunks = plan.getChunks();
+		if(in) in -> Close();
+	}
+	if(chunks.empty()) {
+		std::cerr << "nothing to do" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	
+	/*********** run the workers ********************************/
+	
+	mkdir(workDir.c_str(), 0755);
+	auto partialName = [&workDir] (std::size_t index) -> std::string {
+		return workDir + "/chunk_" + std::to_string(index) + ".root";
+	};
+	auto logName = [&workDir] (std::size_t index) -> std::string {
+		return workDir + "/chunk_" + std::to_string(index) + ".log";
+	};
+	
+	ChunkCommand chunkCommand(command);
+	
+	// the queue is consumed by whichever worker is free first
+	std::deque<Task> queue;
+	for(std::size_t i = 0; i < chunks.size(); ++i) {
+		Task task = { i, chunks[i], 0 };
+		queue.push_back(task);
+	}
+	if(enableVerbose) std::cout << "Running " << chunks.size() << " chunks on " << nWorkers << " workers ..." << std::endl;
+	
+	std::map<pid_t, Task> running;
+	std::vector<std::size_t> failed;
+	std::size_t nDone = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	while(! queue.empty() || ! running.empty()) {
+		while(! queue.empty() && running.size() < std::size_t(nWorkers)) {
+			Task task = queue.front();
+			queue.pop_front();
+			pid_t pid = chunkCommand.launch(task.index, task.chunk.begin, task.chunk.end, partialName(task.index), logName(task.index));
+			if(pid < 0) {
+				// no more launches; the running chunks are stopped and reaped, so that none keeps writing its output
+				for(auto & r: running) kill(r.first, SIGTERM);
+				while(! running.empty()) {
+					int status;
+					pid_t done = waitpid(-1, &status, 0);
+					if(done < 0) break;
+					running.erase(done);
+				}
+				std::cerr << "cannot launch chunk " << task.index << ", the running chunks were stopped" << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+			running[pid] = task;
+		}
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if(pid < 0) break;
+		auto it = running.find(pid);
+		if(it == running.end()) continue;
+		Task task = it -> second;
+		running.erase(it);
+		if(ChunkCommand::succeeded(status)) {
+			++nDone;
+			if(enableVerbose) {
+				std::cout << "[" << nDone << "/" << chunks.size() << "] chunk " << task.index << " ["
+						  << task.chunk.begin << "," << task.chunk.end << ") done" << std::endl;
+			}
+		}
+		else if(task.attempts < maxRetries) {
+			++task.attempts;
+			std::cerr << "chunk " << task.index << " failed (see " << logName(task.index) << "), retrying" << std::endl;
+			queue.push_back(task);
+		}
+		else {
+			std::cerr << "chunk " << task.index << " failed " << (task.attempts + 1) << " times, giving up" << std::endl;
+			failed.push_back(task.index);
+		}
+	}
+	Double_t wall = std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - t0).count();
+	if(enableVerbose) std::cout << "Finished " << nDone << " chunks in " << wall << " s" << std::endl;
+	if(! failed.empty()) {
+		std::cerr << failed.size() << " chunk(s) failed, the outputs are not merged" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	
+	/*********** merge ******************************************/
+	
+	if(doMerge) {
+		if(enableVerbose) std::cout << "Merging into " << output << " ..." << std::endl;
+		TFileMerger merger(kFALSE);
+		merger.OutputFile(output.c_str(), "recreate");
+		for(std::size_t i = 0; i < chunks.size(); ++i) {
+			merger.AddFile(partialName(i).c_str());
+		}
+		if(! merger.Merge()) {
+			std::cerr << "error on merging into " << output << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(! keepPartial) {
+			for(std::size_t i = 0; i < chunks.size(); ++i) std::remove(partialName(i).c_str());
+		}
+	}
+	
+	return EXIT_SUCCESS;
+}
@@ -1,13 +1,14 @@
 #include <boost/program_options.hpp>
 
-#include <cstdlib> // EXIT_SUCCESS
+#include <cstdlib> // EXIT_SUCCESS, EXIT_FAILURE, std::exit()
 #include <string> // std::string
 #include <vector> // std::vector<>
 #include <fstream> // std::ofstream
-#include <iostream> // std::cout
+#include <iostream> // std::cout, std::cerr, std::endl
 #include <streambuf> // std::streambuf
 #include <map> //std::map
 #include <sstream> // std::stringstream
+#include <thread> // std::thread::hardware_concurrency()
 
 #include <TH1F.h>
 #include <TFile.h>
@@ -18,6 +19,9 @@
 #include <TLegend.h>
 
 #include "common.hpp"
+#include "EfficiencyScan.hpp"
+#include "ThreadPool.hpp"
+#include "BatchRenderer.hpp"
 
 int main(int argc, char ** argv) {
 	
@@ -25,7 +29,10 @@ int main(int argc, char ** argv) {
 	
 	std::string inFilename, outDir, ext;
 	Int_t dimx, dimy;
-	bool printToFile = false, useGeneratedCSV = false, hasDir = false;
+	Double_t thresholdStart, thresholdStep;
+	unsigned nThreads;
+	Int_t nWorkers;
+	bool printToFile = false, useGeneratedCSV = false, hasDir = false, force = false;
 	
 	try {
 		po::options_description desc("allowed options");
@@ -38,6 +45,11 @@ int main(int argc, char ** argv) {
 			("dir,d", po::value<std::string>(&outDir), "the output directory")
 			("use-generated,g", "uses the generated CSV value")
 			("print-to-file,f", "prints the data to file instead of generating plots")
+			("threshold-start", po::value<Double_t>(&thresholdStart) -> default_value(0.02), "the first CSV threshold")
+			("threshold-step,s", po::value<Double_t>(&thresholdStep) -> default_value(0.02), "the distance between the CSV thresholds")
+			("threads,n", po::value<unsigned>(&nThreads) -> default_value(std::thread::hardware_concurrency()), "number of threads writing the tables")
+			("workers", po::value<Int_t>(&nWorkers) -> default_value(std::thread::hardware_concurrency()), "number of rendering processes")
+			("force", "render the plots even if their inputs haven't changed")
 		;
 		
 		po::variables_map vm;
@@ -71,6 +83,9 @@ int main(int argc, char ** argv) {
 		if(vm.count("dir")) {
 			hasDir = true;
 		}
+		if(vm.count("force")) {
+			force = true;
+		}
 	}
 	catch(std::exception & e) {
 		std::cerr << "error: " << e.what() << std::endl;
@@ -80,9 +95,13 @@ int main(int argc, char ** argv) {
 		std::cerr << "exception of unkown type" << std::endl;
 	}
 	
+	if(thresholdStep <= 0) {
+		std::cerr << "the threshold step must be positive" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if(nThreads < 1) nThreads = 1;
+	
 	std::vector<Double_t> threshold;
-	Double_t thresholdStart = 0.02;
-	Double_t thresholdStep = 0.02;
 	while(thresholdStart < 1.0) {
 		threshold.push_back(thresholdStart);
 		thresholdStart += thresholdStep;
@@ -95,34 +114,94 @@ int main(int argc, char ** argv) {
 		std::exit(EXIT_FAILURE);
 	}
 	
+	// every histogram is read once; the threshold scans only use the cumulative sums
+	auto scanIndex = [] (int i, int j, int k) -> std::size_t {
+		return (i * 6 + j) * 3 + k;
+	};
+	std::vector<EfficiencyScan> scans;
+	for(int i = 0; i < 3; ++i) {
+		for(int j = 0; j < 6; ++j) {
+			for(int k = 0; k < 3; ++k) {
+				std::string name = useGeneratedCSV ? getName(i, j, k, "csvGen_") : getName(i, j, k, "csv_");
+				TH1F * h = dynamic_cast<TH1F *> (in -> Get(name.c_str()));
+				if(! h) {
+					std::cerr << "error on accessing histogram " << name << std::endl;
+					std::exit(EXIT_FAILURE);
+				}
+				scans.push_back(EfficiencyScan(h));
+				delete h;
+			}
+		}
+	}
+	in -> Close();
+	
+	if(printToFile) {
+		// the tables don't share anything, hence they are written in parallel
+		ThreadPool pool(nThreads);
+		for(int j = 0; j < 6; ++j) {
+			for(int k = 0; k < 3; ++k) {
+				pool.submit([&, j, k] () {
+					std::string location = "";
+					if(hasDir) location += outDir + "/";
+					if(useGeneratedCSV) location += "sampled_";
+					location += getAbbrName(j, k) + ".csv";
+					std::stringstream out;
+					out << "CSV cut,c jet,c jet error,b jet,b jet error,light jet, light jet error" << std::endl;
+					out << std::fixed;
+					for(auto th: threshold) {
+						out << th << ",";
+						for(int i = 0; i < 3; ++i) {
+							Double_t error;
+							Double_t integralAbove = scans[scanIndex(i, j, k)].getEfficiency(th, error);
+							out << integralAbove << "," << error;
+							if(i == 2) 	out << std::endl;
+							else		out << ",";
+						}
+					}
+					std::ofstream of(location);
+					of << out.str();
+				});
+			}
+		}
+		pool.wait();
+		return EXIT_SUCCESS;
+	}
+	
+	// every plot is a job of its own; the hash covers the plotted points, hence a plot is only
+	// redrawn when an efficiency, the threshold grid or the style changes
+	BatchRenderer renderer((outDir.empty() ? "" : outDir + "/") + ".plotcache", nWorkers, force);
 	for(int j = 0; j < 6; ++j) {
 		for(int k = 0; k < 3; ++k) {
-			if(! printToFile) {
-				std::map<std::string, std::vector<Double_t> > vals;
-				Int_t nbins = 0; // just to pass -Werror
+			std::map<std::string, std::vector<Double_t> > vals;
+			for(int i = 0; i < 3; ++i) {
+				std::string key = flavorStrings[i];
+				std::string key_error = key + "_error";
 				for(auto th: threshold) {
-					for(int i = 0; i < 3; ++i) {
-						std::string name = useGeneratedCSV ? getName(i, j, k, "csvGen_") : getName(i, j, k, "csv_");
-						TH1F * h = dynamic_cast<TH1F *> (in -> Get(name.c_str()));
-						h -> Scale(1.0 / h -> Integral());
-						Int_t binIndex = h -> FindBin(th);
-						//Double_t intBelow = h -> Integral(1, binIndex - 1);
-						Double_t error;
-						nbins = h -> GetNbinsX();
-						Double_t integralAbove = h -> IntegralAndError(binIndex, nbins, error);
-						std::string key = flavorStrings[i];
-						std::string key_error = key + "_error";
-						vals[key].push_back(integralAbove);
-						vals[key_error].push_back(error);
-					}
+					Double_t error;
+					vals[key].push_back(scans[scanIndex(i, j, k)].getEfficiency(th, error));
+					vals[key_error].push_back(error);
 				}
+			}
+			Int_t nbins = scans[scanIndex(2, j, k)].getNbins();
+			std::string saveLocation = "";
+			if(! outDir.empty()) saveLocation = outDir + "/";
+			saveLocation += "effs_";
+			if(useGeneratedCSV) saveLocation += "sampled_";
+			saveLocation += getAbbrName(j, k) + "." + ext;
+			
+			BatchRenderer::Hash hash;
+			hash.add("efficiency").add(dimx).add(dimy).add(useGeneratedCSV).add(nbins);
+			hash.add(&threshold[0], threshold.size() * sizeof(Double_t));
+			for(auto & v: vals) hash.add(v.first).add(&v.second[0], v.second.size() * sizeof(Double_t));
+			
+			renderer.add(saveLocation, hash, [=] () mutable {
 				TCanvas * c = new TCanvas(getAbbrName(j, k).c_str(), getAbbrName(j, k).c_str(), dimx, dimy);
 				TLegend * legend = new TLegend(0.78, 0.76, 0.90, 0.90);
 				c -> SetGrid();
 				TMultiGraph * mg = new TMultiGraph();
 				for(int i = 0; i < 3; ++i) {
 					std::string key = flavorStrings[i];
-					std::string key_error = key + "_error";				
+					std::string key_error = key + "_error";
 					TGraphErrors * gr = new TGraphErrors(threshold.size(), &threshold[0], &(vals[key])[0],
 														&thresholdErrors[0], &(vals[key_error])[0]);
 					legend -> AddEntry(gr, std::string(flavorNames[i] + " jet").c_str(), "p");
@@ -146,53 +225,19 @@ int main(int argc, char ** argv) {
 				c -> Update();
 				legend -> Draw();
 				c -> SetRightMargin(0.05);
-				std::string saveLocation = "";
-				if(! outDir.empty()) saveLocation = outDir + "/";
-				saveLocation += "effs_";
-				if(useGeneratedCSV) saveLocation += "sampled_";
-				saveLocation += getAbbrName(j, k) + "." + ext;
 				c -> SaveAs(saveLocation.c_str());
 				c -> Close();
 				delete legend;
 				delete mg;
-			}
-			else {
-				std::string csvString = "CSV cut,c jet,c jet error,b jet,b jet error,light jet, light jet error";
-				std::streambuf * buf;
-				std::ofstream of;
-				if(printToFile) {
-					std::string location = "";
-					if(hasDir) location += outDir + "/";
-					if(useGeneratedCSV) location += "sampled_";
-					location += getAbbrName(j, k) + ".csv";
-					of.open(location);
-					buf = of.rdbuf();
-				}
-				else {
-					buf = std::cout.rdbuf();
-				}
-				std::ostream out(buf);
-				out << csvString << std::endl;
-				out << std::fixed;
-				
-				for(auto th: threshold){
-					out << th << ",";
-					for(int i = 0; i < 3; ++i) {
-						std::string name = useGeneratedCSV ? getName(i, j, k, "csvGen_") : getName(i, j, k, "csv_");
-						TH1F * h = dynamic_cast<TH1F *> (in -> Get(name.c_str()));
-						h -> Scale(1.0 / h -> Integral());
-						Int_t binIndex = h -> FindBin(th);
-						//Double_t intBelow = h -> Integral(1, binIndex - 1);
-						
-						Double_t error;
-						Double_t integralAbove = h -> IntegralAndError(binIndex, h -> GetNbinsX(), error);
-						out << integralAbove << "," << error;
-						if(i == 2) 	out << std::endl;
-						else		out << ",";
-					}
-				}
-			}
+			});
 		}
 	}
+	bool rendered = renderer.run();
+	std::cout << renderer.report() << std::endl;
+	if(! rendered) {
+		std::cerr << "some of the plots failed" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	
 	return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -5,9 +5,12 @@
 #include <cstdlib> // EXIT_SUCCESS, std::exit()
 #include <iostream> // std::cout, std::endl
 #include <vector> // std::vector<>
-#include <random> // std::mt19937_64
 #include <chrono> // std::chrono
 #include <map> // std::map<>
+#include <algorithm> // std::min()
+#include <cmath> // std::llround()
+#include <thread> // std::thread::hardware_concurrency()
+#include <mutex> // std::mutex, std::lock_guard<>
 
 #include <TFile.h>
 #include <TH1F.h>
@@ -15,6 +18,9 @@
 #include <TROOT.h>
 #include <TClass.h>
 
+#include "CdfSampler.hpp"
+#include "ThreadPool.hpp"
+
 int main(int argc, char ** argv) {
 	
 	namespace po = boost::program_options;
@@ -22,6 +28,9 @@ int main(int argc, char ** argv) {
 	std::string cumulFilename; // cumulative distributions
 	std::string histoFilename; // CSV pdfs
 	std::string outFilename; // output filename
+	Long64_t drawsPerHisto, chunkSize;
+	ULong64_t seed;
+	unsigned nThreads;
 	bool enableVerbose = true;
 	
 	try {
@@ -31,6 +40,10 @@ int main(int argc, char ** argv) {
 			("cumulative,i", po::value<std::string>(&cumulFilename), "cumulative distribution")
 			("histogram,j", po::value<std::string>(&histoFilename), "histograms")
 			("output,o", po::value<std::string>(&outFilename), "output")
+			("draws,n", po::value<Long64_t>(&drawsPerHisto) -> default_value(-1), "number of draws per histogram\ndefault (-1) means the integral of the histogram")
+			("seed", po::value<ULong64_t>(&seed) -> default_value(4357), "seed of the draws (the stream of a histogram depends on the seed and its name only)")
+			("threads,t", po::value<unsigned>(&nThreads) -> default_value(std::thread::hardware_concurrency()), "number of threads")
+			("chunk-size", po::value<Long64_t>(&chunkSize) -> default_value(16777216), "number of draws per task")
 			("verbose,v", "verbose mode (enables progressbar)")
 		;
 		
@@ -49,6 +62,10 @@ int main(int argc, char ** argv) {
 			std::cout << desc << std::endl;
 			std::exit(EXIT_SUCCESS);
 		}
+		if(chunkSize <= 0 || nThreads == 0) {
+			std::cerr << "the chunk size and the number of threads must be positive" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
 	}
 	catch(std::exception & e) {
 		std::cerr << "error: " << e.what() << std::endl;
@@ -85,12 +102,12 @@ int main(int argc, char ** argv) {
 	TIter nextHisto(comp -> GetListOfKeys());
 	TKey * keyHisto;
 	std::vector<TH1F *> histoHisto;
-	std::map<TString, Int_t> integrals;
+	std::map<TString, Long64_t> integrals;
 	while((keyHisto = dynamic_cast<TKey *>(nextHisto()))) {
 		TClass * cl = gROOT -> GetClass(keyHisto -> GetClassName());
 		if(! cl -> InheritsFrom("TH1F")) continue;
 		TH1F * h = dynamic_cast<TH1F *> (keyHisto -> ReadObj());
-		integrals[h -> GetName()] = h -> Integral();
+		integrals[h -> GetName()] = std::llround(h -> Integral());
 		histoHisto.push_back(h);
 	}
 	std::map<TString, TH1F *> outsamples;
@@ -100,48 +117,77 @@ int main(int argc, char ** argv) {
 		outsamples[name] -> SetDirectory(out);
 	}
 	
-	/************************ define lambdas ***********************/
-	auto bruteSearch = [] (TH1F * h, Double_t r) {
-		Int_t binMin = h -> GetMinimumBin(), binMax = h -> GetMaximumBin();
-		Int_t bin = binMin;
-		for( ; bin <= binMax; ++bin) {
-			if(h -> GetBinContent(bin) > r) break;
-		}
-		return bin;
-	};
+	/******************* sample *************************/
 	
-	auto randLinpolEdge = [] (TH1F * h, Float_t r, Int_t (*search)(TH1F *h, Double_t r)) -> Float_t {
-		Int_t bin = search(h, r);
-		Float_t x1, y1, x2, y2;
-		x1 = h -> GetBinLowEdge(bin);
-		y1 = h -> GetBinContent(bin - 1);
-		x2 = h -> GetBinLowEdge(bin + 1);
-		y2 = h -> GetBinContent(bin);
-		Float_t x = (r - y1) * (x2 - x1) / (y2 - y1) + x1;
-		return x;
+	// every histogram is split into chunks of draws, which run in parallel and are summed in order afterwards
+	struct Chunk {
+		TH1F * output;
+		const CdfSampler * sampler;
+		ULong64_t stream;
+		Long64_t first, size;
+		std::vector<Long64_t> counts;
 	};
+	std::vector<CdfSampler *> samplers;
+	std::vector<Chunk> chunks;
+	Long64_t nDraws = 0;
+	for(auto & h: histoCumul) {
+		TString name = h -> GetName();
+		if(outsamples.count(name) == 0) continue;
+		Long64_t maxIter = drawsPerHisto >= 0 ? drawsPerHisto : integrals[name]; // assuming they're not normalized to one
+		samplers.push_back(new CdfSampler(h));
+		ULong64_t stream = CdfSampler::getStream(seed, name.Data());
+		for(Long64_t first = 0; first < maxIter; first += chunkSize) {
+			Chunk c = { outsamples[name], samplers.back(), stream, first, std::min(chunkSize, maxIter - first), std::vector<Long64_t>() };
+			chunks.push_back(c);
+		}
+		nDraws += maxIter;
+	}
 	
-	/******************* sample *************************/
-	
-	boost::progress_display * show_progress;
+	boost::progress_display * show_progress = 0;
 	if(enableVerbose) {
-		std::cout << "Looping over " << histoCumul.size() << " histograms ... " << std::endl;
-		show_progress = new boost::progress_display(histoCumul.size());
+		std::cout << "Drawing " << nDraws << " values from " << samplers.size() << " histograms in " << chunks.size() << " chunks ... " << std::endl;
+		show_progress = new boost::progress_display(chunks.size());
 	}
 	
-	for(auto & h: histoCumul) {
-		unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-		std::mt19937_64 gen(seed);
-		std::uniform_real_distribution<Float_t> dis(0,1);
-		TString name = h -> GetName();
-		Int_t maxIter = integrals[name]; // assuming they're not normalized to one
-		
-		for(int i = 0; i < maxIter; ++i) {
-			Float_t r = randLinpolEdge(h, dis(gen), bruteSearch);
-			outsamples[name] -> Fill(r);
+	auto start = std::chrono::steady_clock::now();
+	{
+		ThreadPool pool(nThreads);
+		std::mutex progressMutex;
+		for(auto & c: chunks) {
+			Chunk * chunk = &c;
+			pool.submit([chunk, show_progress, &progressMutex] () -> void {
+				TH1F * o = chunk -> output;
+				chunk -> sampler -> fill(chunk -> stream, chunk -> first, chunk -> size,
+										 o -> GetNbinsX(), o -> GetBinLowEdge(1), o -> GetBinLowEdge(o -> GetNbinsX() + 1), chunk -> counts);
+				if(show_progress) {
+					std::lock_guard<std::mutex> lock(progressMutex);
+					++(*show_progress);
+				}
+			});
+		}
+		pool.wait();
+	}
+	std::chrono::duration<Double_t> elapsed = std::chrono::steady_clock::now() - start;
+	
+	std::map<TH1F *, std::vector<Long64_t> > counts;
+	for(auto & c: chunks) {
+		std::vector<Long64_t> & sum = counts[c.output];
+		sum.resize(c.counts.size(), 0);
+		for(std::size_t bin = 0; bin < c.counts.size(); ++bin) sum[bin] += c.counts[bin];
+	}
+	for(auto & kv: counts) {
+		Long64_t nEntries = 0;
+		for(std::size_t bin = 0; bin < kv.second.size(); ++bin) {
+			kv.first -> SetBinContent(bin, kv.second[bin]);
+			nEntries += kv.second[bin];
 		}
-		if(enableVerbose) ++(*show_progress);
+		kv.first -> SetEntries(nEntries);
 	}
+	if(enableVerbose) {
+		std::cout << nDraws << " draws in " << elapsed.count() << " s (" << (elapsed.count() > 0 ? nDraws / elapsed.count() : 0) << " draws/s)" << std::endl;
+	}
+	
+	for(auto sampler: samplers) delete sampler;
 	
 	/****************** write them **********************/
 	
@@ -0,0 +1,80 @@
+#include <boost/program_options.hpp>
+
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <string> // std::string
+#include <cstdlib> // EXIT_SUCCESS, EXIT_FAILURE
+#include <stdexcept> // std::runtime_error
+
+#include "AnalysisGraph.hpp"
+#include "GraphPresets.hpp"
+
+/**
+ * @note The presets are listed in GraphPresets.hpp; daemon.cpp runs the same jobs without restarting.
+ */
+
+int main(int argc, char ** argv) {
+	
+	namespace po = boost::program_options;
+	
+	// command line option parsing
+	GraphJob job;
+	bool enableVerbose = false;
+	try {
+		po::options_description desc("allowed options");
+		desc.add_options()
+			("help,h", "prints this message")
+		;
+		addGraphOptions(desc, job);
+		desc.add_options()
+			("verbose,v", "verbose mode")
+		;
+		
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+		po::notify(vm);
+		
+		if(vm.count("help")) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_SUCCESS); // ugly
+		}
+		if(vm.count("output") == 0 || job.presets.empty() || (vm.count("config") == 0 && (vm.count("input") == 0 || vm.count("tree") == 0))) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(vm.count("verbose")) {
+			enableVerbose = true;
+		}
+	}
+	catch(std::exception & e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		std::exit(EXIT_FAILURE); // ugly
+	}
+	catch(...) {
+		std::cerr << "exception of unkown type" << std::endl;
+	}
+	
+	try {
+		completeGraphJob(job);
+		
+		/*********** cumulatives ****/
+		
+		CalibrationTables tables;
+		if(enableVerbose && ! job.cumulFile.empty()) std::cout << "Reading cumulatives from " << job.cumulFile << " ..." << std::endl;
+		readCalibrationTables(job.cumulFile, job.workingPoint, tables);
+		
+		/*********** columns and presets ****/
+		
+		AnalysisGraph graph(job.input, job.treeName, job.beginEvent, job.endEvent, job.readAhead);
+		declarePresets(graph, job, tables);
+		
+		/*********** run ****/
+		
+		runPresets(graph, job, std::cout, enableVerbose);
+	}
+	catch(std::exception & e) {
+		std::cerr << e.what() << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	
+	return EXIT_SUCCESS;
+}
@@ -10,6 +10,7 @@
 #include <memory> // std::unique_ptr<>
 #include <random> // std::mt19937_64
 #include <chrono> // std::chrono
+#include <stdexcept> // std::runtime_error
 
 #include <TString.h>
 #include <TTree.h>
@@ -18,19 +19,28 @@
 #include <TKey.h>
 #include <TROOT.h>
 #include <TClass.h>
+#include <TRandom.h>
 
 #include "common.hpp"
+#include "EventReader.hpp"
+#include "SkimCache.hpp"
+#include "TreeLayout.hpp"
+#include "Checkpoint.hpp"
+#include "EventKernels.hpp"
 
-int main(int argc, char ** argv) {
+int main(int argc, char ** argv) try {
 	
 	namespace po = boost::program_options;
 	
 	// command line option parsing
-	std::string output, input, hinput, cinput, tree, newtree;
+	std::string output, input, hinput, cinput, tree, newtree, layoutFile;
 	Long64_t beginEvent, endEvent;
 	Float_t workingPoint;
 	Int_t maxSamples;
-	bool enableVerbose = false, sampleALot = false;
+	Int_t readAhead;
+	Long64_t checkpointInterval;
+	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+	bool enableVerbose = false, sampleALot = false, resume = false, fixedSeed = false;
 	try {
 		po::options_description desc("allowed options");
 		desc.add_options()
@@ -46,6 +56,11 @@ int main(int argc, char ** argv) {
 			("working-point,w", po::value<Float_t>(&workingPoint) -> default_value(0.679), "working point of the CSV value (default CSVM)")
 			("max-samples,s", po::value<Int_t>(&maxSamples), "maximum number of samples")
 			("multiple-sampling,m", "sample N times")
+			("layout,L", po::value<std::string>(&layoutFile), "config file with the compression and basket layout of the output tree\n(sections [output], [output_compression] and [output_basket])")
+			("read-ahead,R", po::value<Int_t>(&readAhead) -> default_value(4), "number of event blocks decoded ahead on a separate thread\n0 means synchronous reading")
+			("seed", po::value<unsigned>(&seed), "seed of the random number generators\nif not set, the current time is used")
+			("checkpoint,C", po::value<Long64_t>(&checkpointInterval) -> default_value(0), "save a checkpoint (<output>.checkpoint) every N events\n0 means no checkpoints")
+			("resume", "continue from the checkpoint of the output file")
 			("verbose,v", "verbose mode (enables progressbar)")
 		;
 		
@@ -60,6 +75,12 @@ int main(int argc, char ** argv) {
 		if(vm.count("verbose") != 0) {
 			enableVerbose = true;
 		}
+		if(vm.count("seed") != 0) {
+			fixedSeed = true;
+		}
+		if(vm.count("resume") != 0) {
+			resume = true;
+		}
 		if(vm.count("output") == 0 || vm.count("tree") == 0) {
 			std::cout << desc << std::endl;
 			std::exit(EXIT_FAILURE);
@@ -97,15 +118,18 @@ int main(int argc, char ** argv) {
 	/******************************************************************************************************/
 	
 	// open the file and tree
-	if(enableVerbose) std::cout << "Reading " << input << " ... " << std::endl;
-	std::unique_ptr<TFile> in(TFile::Open(input.c_str(), "read"));
-	if(in -> IsZombie() || ! in -> IsOpen()) {
-		std::cerr << "error on opening " << input << std::endl;
-		std::exit(EXIT_FAILURE);
+	std::unique_ptr<TFile> in;
+	TTree * t = 0; // std::unique_ptr can't handle TTree .. (not needed if the input is a skim)
+	if(! SkimCache::isSkim(input)) {
+		if(enableVerbose) std::cout << "Reading " << input << " ... " << std::endl;
+		in.reset(TFile::Open(input.c_str(), "read"));
+		if(in -> IsZombie() || ! in -> IsOpen()) {
+			std::cerr << "error on opening " << input << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(enableVerbose) std::cout << "Accessing TTree " << tree << " ... " << std::endl;
+		t = dynamic_cast<TTree *>(in -> Get(tree.c_str()));
 	}
-	if(enableVerbose) std::cout << "Accessing TTree " << tree << " ... " << std::endl;
-	TTree * t; // std::unique_ptr can't handle TTree .. 
-	t = dynamic_cast<TTree *>(in -> Get(tree.c_str()));
 	
 	// which method to use to generate random vars
 	bool useCumul = ! cinput.empty();
@@ -152,49 +176,58 @@ int main(int argc, char ** argv) {
 			histograms[h -> GetName()] = h;
 		}
 	}
-	// create the output file
-	if(enableVerbose) std::cout << "Creating " << output << " ... " << std::endl;
-	std::unique_ptr<TFile> out(new TFile(output.c_str(), "recreate"));
-	TTree * u = new TTree(newtree.c_str(), "Tree with generated CSV values according to the histograms."); // output tree
-	u -> SetDirectory(out.get());
-	
-	/******************************************************************************************************/
-	// define some functions for the random number generation
-	
-	auto bruteSearch = [] (TH1F * h, Double_t r) {
-		Int_t binMin = h -> GetMinimumBin(), binMax = h -> GetMaximumBin();
-		Int_t bin = binMin;
-		for( ; bin <= binMax; ++bin) {
-			if(h -> GetBinContent(bin) > r) break;
+	// continue from the checkpoint (restores gRandom)
+	Checkpoint checkpoint(output + ".checkpoint", checkpointInterval);
+	bool resumed = resume && checkpoint.load();
+	if(resumed) {
+		if(checkpoint.get<Long64_t>("begin") != beginEvent || checkpoint.get<Long64_t>("end") != endEvent) {
+			std::cerr << "the checkpoint was made for a different range of events" << std::endl;
+			std::exit(EXIT_FAILURE);
 		}
-		return bin;
-	};
+		if(enableVerbose) std::cout << "Resuming from event " << checkpoint.getNextEntry() << " ... " << std::endl;
+		if(! Checkpoint::truncateTree(output, newtree, checkpoint.getEntries())) std::exit(EXIT_FAILURE);
+		seed = checkpoint.get<unsigned>("seed");
+	}
+	else {
+		if(resume && enableVerbose) std::cout << "No checkpoint found, starting from event " << beginEvent << " ... " << std::endl;
+		if(fixedSeed) gRandom -> SetSeed(seed);
+		checkpoint.set("begin", beginEvent);
+		checkpoint.set("end", endEvent);
+		checkpoint.set("seed", seed);
+	}
 	
-	auto randLinpolEdge = [] (TH1F * h, Float_t r, Int_t (*search)(TH1F *h, Double_t r)) -> Float_t {
-		Int_t bin = search(h, r);
-		Float_t x1, y1, x2, y2;
-		x1 = h -> GetBinLowEdge(bin);
-		y1 = h -> GetBinContent(bin - 1);
-		x2 = h -> GetBinLowEdge(bin + 1);
-		y2 = h -> GetBinContent(bin);
-		Float_t x = (r - y1) * (x2 - x1) / (y2 - y1) + x1;
-		return x;
+	// create the output file (or append to it)
+	TreeLayout layout;
+	if(! layoutFile.empty()) layout = TreeLayout(layoutFile);
+	std::unique_ptr<TFile> out;
+	TTree * u; // output tree
+	if(resumed) {
+		if(enableVerbose) std::cout << "Opening " << output << " ... " << std::endl;
+		out.reset(new TFile(output.c_str(), "update"));
+		u = dynamic_cast<TTree *> (out -> Get(newtree.c_str()));
+	}
+	else {
+		if(enableVerbose) std::cout << "Creating " << output << " ... " << std::endl;
+		out.reset(new TFile(output.c_str(), "recreate"));
+		layout.apply(out.get());
+		u = new TTree(newtree.c_str(), "Tree with generated CSV values according to the histograms.");
+		u -> SetDirectory(out.get());
+	}
+	// the branches of a resumed tree exist already
+	auto branch = [&u, resumed] (const char * name, void * address, const char * leaves) -> void {
+		if(resumed) u -> SetBranchAddress(name, address);
+		else u -> Branch(name, address, leaves);
 	};
 	
-	/******************************************************************************************************/
-	
 	// set up the variables
 	// variables to be used are commented out for obv performance reasons
 	if(enableVerbose) std::cout << "Setting up branch addresses ... " << std::endl;
-	const int maxNumberOfHJets = 2;
-	const int maxNumberOfAJets = 20;
 	
 	/******************************************************************************************************/
 	
 	// set up PRNG
-	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
 	std::mt19937_64 gen(seed);
-	std::uniform_real_distribution<Float_t> dis(0,1);
+	if(resumed) gen = checkpoint.get<std::mt19937_64>("generator");
 	
 	/******************************************************************************************************/
 	
@@ -217,23 +250,39 @@ int main(int argc, char ** argv) {
 	//Float_t aJet_e[maxNumberOfAJets];
 	//Float_t aJet_genPt[maxNumberOfAJets];
 	
-	t -> SetBranchAddress("nhJets", &nhJets);
-	t -> SetBranchAddress("naJets", &naJets);
-	
-	t -> SetBranchAddress("hJet_pt", &hJet_pt);
-	t -> SetBranchAddress("hJet_eta", &hJet_eta);
-	t -> SetBranchAddress("hJet_csv", &hJet_csv);
-	t -> SetBranchAddress("hJet_flavour", &hJet_flavour);
-	//t -> SetBranchAddress("hJet_phi", &hJet_phi);
-	//t -> SetBranchAddress("hJet_e", &hJet_e);
-	//t -> SetBranchAddress("hJet_genPt", &hJet_genPt);
-	t -> SetBranchAddress("aJet_pt", &aJet_pt);
-	t -> SetBranchAddress("aJet_eta", &aJet_eta);
-	t -> SetBranchAddress("aJet_csv", &aJet_csv);
-	t -> SetBranchAddress("aJet_flavour", &aJet_flavour);
-	//t -> SetBranchAddress("aJet_phi", &aJet_phi);
-	//t -> SetBranchAddress("aJet_e", &aJet_e);
-	//t -> SetBranchAddress("aJet_genPt", &aJet_genPt);
+	// if endEvent greater set by the user greater than the number of entries in a tree
+	// use the latter value
+	Long64_t firstEvent = resumed ? checkpoint.getNextEntry() : beginEvent;
+	EventReader reader(t, input, firstEvent, endEvent, readAhead);
+	endEvent = reader.getEndEvent();
+	
+	reader.setBranchAddress("nhJets", &nhJets);
+	reader.setBranchAddress("naJets", &naJets);
+	
+	reader.setBranchAddress("hJet_pt", &hJet_pt);
+	reader.setBranchAddress("hJet_eta", &hJet_eta);
+	reader.setBranchAddress("hJet_csv", &hJet_csv);
+	reader.setBranchAddress("hJet_flavour", &hJet_flavour);
+	//reader.setBranchAddress("hJet_phi", &hJet_phi);
+	//reader.setBranchAddress("hJet_e", &hJet_e);
+	//reader.setBranchAddress("hJet_genPt", &hJet_genPt);
+	reader.setBranchAddress("aJet_pt", &aJet_pt);
+	reader.setBranchAddress("aJet_eta", &aJet_eta);
+	reader.setBranchAddress("aJet_csv", &aJet_csv);
+	reader.setBranchAddress("aJet_flavour", &aJet_flavour);
+	//reader.setBranchAddress("aJet_phi", &aJet_phi);
+	//reader.setBranchAddress("aJet_e", &aJet_e);
+	//reader.setBranchAddress("aJet_genPt", &aJet_genPt);
+	
+	// the bin ids of a skim spare getBinId()
+	Int_t hJet_binId[maxNumberOfHJets], aJet_binId[maxNumberOfAJets];
+	const Int_t * hJetBinIds = 0, * aJetBinIds = 0;
+	if(reader.hasColumn("hJet_binId") && reader.hasColumn("aJet_binId")) {
+		reader.setBranchAddress("hJet_binId", &hJet_binId);
+		reader.setBranchAddress("aJet_binId", &aJet_binId);
+		hJetBinIds = hJet_binId;
+		aJetBinIds = aJet_binId;
+	}
 	
 	// variables for the new tree (with prefix 'n_')
 	Int_t n_nhJets;
@@ -259,46 +308,66 @@ int main(int argc, char ** argv) {
 	Long64_t n_aJet_csvN[maxNumberOfAJets]; // NEW!
 	Long64_t n_hJet_csvN[maxNumberOfHJets]; // NEW!
 	
-	u -> Branch("nhJets", &n_nhJets, "nhJets/I");
-	u -> Branch("hJet_pt", &n_hJet_pt, "hJet_pt[nhJets]/F");
-	u -> Branch("hJet_eta", &n_hJet_eta, "hJet_eta[nhJets]/F");
-	u -> Branch("hJet_csv", &n_hJet_csv, "hJet_csv[nhJets]/F");
-	u -> Branch("hJet_csvGen", &n_hJet_csvGen, "hJet_csvGen[nhJets]/F");
-	u -> Branch("hJet_flavour", &n_hJet_flavour, "hJet_flavour[nhJets]/F");
-	//u -> Branch("hJet_phi", &n_hJet_phi, "hJet_phi[nhJets]/F");
-	//u -> Branch("hJet_e", &n_hJet_e, "hJet_e[nhJets]/F");
-	//u -> Branch("hJet_genPt", &n_hJet_genPt, "hJet_genPt[nhJets]/F");
-	
-	u -> Branch("naJets", &n_naJets, "naJets/I");
-	u -> Branch("aJet_pt", &n_aJet_pt, "aJet_pt[naJets]/F");
-	u -> Branch("aJet_eta", &n_aJet_eta, "aJet_eta[naJets]/F");
-	u -> Branch("aJet_csv", &n_aJet_csv, "aJet_csv[naJets]/F");
-	u -> Branch("aJet_csvGen", &n_aJet_csvGen, "aJet_csvGen[naJets]/F");
-	u -> Branch("aJet_flavour", &n_aJet_flavour, "aJet_flavour[naJets]/F");
-	//u -> Branch("aJet_phi", &n_aJet_phi, "aJet_phi[naJets]/F");
-	//u -> Branch("aJet_e", &n_aJet_e, "aJet_e[naJets]/F");
-	//u -> Branch("aJet_genPt", &n_aJet_genPt, "aJet_genPt[naJets]/F");
+	branch("nhJets", &n_nhJets, "nhJets/I");
+	branch("hJet_pt", &n_hJet_pt, "hJet_pt[nhJets]/F");
+	branch("hJet_eta", &n_hJet_eta, "hJet_eta[nhJets]/F");
+	branch("hJet_csv", &n_hJet_csv, "hJet_csv[nhJets]/F");
+	branch("hJet_csvGen", &n_hJet_csvGen, "hJet_csvGen[nhJets]/F");
+	branch("hJet_flavour", &n_hJet_flavour, "hJet_flavour[nhJets]/F");
+	//branch("hJet_phi", &n_hJet_phi, "hJet_phi[nhJets]/F");
+	//branch("hJet_e", &n_hJet_e, "hJet_e[nhJets]/F");
+	//branch("hJet_genPt", &n_hJet_genPt, "hJet_genPt[nhJets]/F");
+	
+	branch("naJets", &n_naJets, "naJets/I");
+	branch("aJet_pt", &n_aJet_pt, "aJet_pt[naJets]/F");
+	branch("aJet_eta", &n_aJet_eta, "aJet_eta[naJets]/F");
+	branch("aJet_csv", &n_aJet_csv, "aJet_csv[naJets]/F");
+	branch("aJet_csvGen", &n_aJet_csvGen, "aJet_csvGen[naJets]/F");
+	branch("aJet_flavour", &n_aJet_flavour, "aJet_flavour[naJets]/F");
+	//branch("aJet_phi", &n_aJet_phi, "aJet_phi[naJets]/F");
+	//branch("aJet_e", &n_aJet_e, "aJet_e[naJets]/F");
+	//branch("aJet_genPt", &n_aJet_genPt, "aJet_genPt[naJets]/F");
 	
 	if(sampleALot) {
-		u -> Branch("aJet_csvN", &n_aJet_csvN, "aJet_csvN[naJets]/L");
-		u -> Branch("hJet_csvN", &n_hJet_csvN, "hJet_csvN[nhJets]/L");
+		branch("aJet_csvN", &n_aJet_csvN, "aJet_csvN[naJets]/L");
+		branch("hJet_csvN", &n_hJet_csvN, "hJet_csvN[nhJets]/L");
 	}
-	
-	// if endEvent greater set by the user greater than the number of entries in a tree
-	// use the latter value
-	endEvent = (endEvent > t -> GetEntries() || endEvent == -1) ? (t -> GetEntries()) : endEvent;
+	if(! resumed) layout.apply(u);
 	
 	// set up progress bar
 	boost::progress_display * show_progress;
 	if(enableVerbose) {
-		Long64_t dif = endEvent - beginEvent;
+		Long64_t dif = endEvent - firstEvent;
 		std::cout << "Looping over " << dif << " events ... " << std::endl;
-		show_progress = new boost::progress_display(endEvent - beginEvent);
+		show_progress = new boost::progress_display(endEvent - firstEvent);
+	}
+	
+	// the modes are fixed for the whole run, hence the kernel is instantiated for them and chosen only once
+	SampleSetup setup;
+	setup.workingPoint = workingPoint;
+	setup.maxSamples = sampleALot ? maxSamples : 0;
+	setup.cumulatives.assign(3 * 6 * 3, 0);
+	setup.histograms.assign(3 * 6 * 3, 0);
+	for(int i = 0; i < 3; ++i) {
+		for(int j = 0; j < 6; ++j) {
+			for(int k = 0; k < 3; ++k) {
+				TString key = getName(i, j, k).c_str();
+				int binId = (i * 6 + j) * 3 + k; // see getBinId()
+				if(useCumul) setup.cumulatives[binId] = histoCumul[key];
+				else setup.histograms[binId] = histograms[key];
+			}
+		}
 	}
+	RuntimeSampleModes modes = { useCumul, sampleALot };
+	SampleKernel sampleJets = getSampleKernel(modes);
 	
 	// loop over the events
-	for(Long64_t i = beginEvent; i < endEvent; ++i) {
-		t -> GetEntry(i);
+	while(reader.next()) {
+		
+		if(checkpoint.isDue(reader.getEntry())) {
+			checkpoint.set("generator", gen);
+			checkpoint.save(reader.getEntry(), u);
+		}
 		
 		n_naJets = naJets;
 		n_nhJets = nhJets;
@@ -312,51 +381,8 @@ int main(int argc, char ** argv) {
 			//n_hJet_e[j] = hJet_e[j];
 			//n_hJet_phi[j] = hJet_phi[j];
 			//n_hJet_genPt[j] = hJet_genPt[j];
-			
-			Float_t absEta = TMath::Abs(hJet_eta[j]); // only the absolute value matters
-			Float_t absFlavor = TMath::Abs(hJet_flavour[j]); // antiparticles included
-			
-			int flavorIndex = getFlavorIndex(absFlavor);
-			int ptIndex = getPtIndex(hJet_pt[j]);
-			int etaIndex = getEtaIndex(absEta);
-			
-			if(flavorIndex == -1 || ptIndex == -1 || etaIndex == -1) {
-				n_hJet_csvGen[j] = -1;
-				if(sampleALot) n_hJet_csvN[j] = -1;
-			}
-			else {
-				TString key = getName(flavorIndex, ptIndex, etaIndex).c_str();
-				if(sampleALot) {
-					Long64_t iterations = 1;
-					Double_t randomCSV = -2;
-					for(; iterations <= maxSamples; ++iterations) {
-						if(useCumul) {
-							randomCSV = randLinpolEdge(histoCumul[key], dis(gen), bruteSearch);
-						}
-						else {
-							randomCSV = histograms[key] -> GetRandom();
-						}
-						if(randomCSV >= workingPoint) break;
-					}
-					if(randomCSV < workingPoint) {
-						n_hJet_csvGen[j] = -2;
-						n_hJet_csvN[j] = -2;
-					}
-					else {
-						n_hJet_csvGen[j] = randomCSV;
-						n_hJet_csvN[j] = iterations;
-					}
-				}
-				else {
-					if(useCumul) {
-						n_hJet_csvGen[j] = randLinpolEdge(histoCumul[key], dis(gen), bruteSearch);
-					}
-					else {
-						n_hJet_csvGen[j] = histograms[key] -> GetRandom();
-					}
-				}
-			}
 		}
+		sampleJets(setup, nhJets, hJet_pt, hJet_eta, hJet_flavour, hJetBinIds, n_hJet_csvGen, n_hJet_csvN, gen);
 		
 		// loop over aJets
 		for(int j = 0; j < naJets; ++j) {
@@ -367,51 +393,8 @@ int main(int argc, char ** argv) {
 			//n_hJet_e[j] = hJet_e[j];
 			//n_hJet_phi[j] = hJet_phi[j];
 			//n_hJet_genPt[j] = hJet_genPt[j];
-			
-			Float_t absEta = TMath::Abs(aJet_eta[j]); // only the absolute value matters
-			Float_t absFlavor = TMath::Abs(aJet_flavour[j]); // antiparticles included
-			
-			int flavorIndex = getFlavorIndex(absFlavor);
-			int ptIndex = getPtIndex(aJet_pt[j]);
-			int etaIndex = getEtaIndex(absEta);
-			
-			if(flavorIndex == -1 || ptIndex == -1 || etaIndex == -1) {
-				n_aJet_csvGen[j] = -1; // default value if not in the range
-				if(sampleALot) n_aJet_csvN[j] = -1; // default value if not in the range
-			}
-			else {
-				TString key = getName(flavorIndex, ptIndex, etaIndex).c_str();
-				if(sampleALot) {
-					Long64_t iterations = 1;
-					Double_t randomCSV = -2;
-					for(iterations = 1; iterations <= maxSamples; ++iterations) {
-						if(useCumul) {
-							randomCSV = randLinpolEdge(histoCumul[key], dis(gen), bruteSearch);
-						}
-						else {
-							randomCSV = histograms[key] -> GetRandom();
-						}
-						if(randomCSV >= workingPoint) break;
-					}
-					if(randomCSV < workingPoint) {
-						n_aJet_csvGen[j] = -2;
-						n_aJet_csvN[j] = -2;
-					}
-					else {
-						n_aJet_csvGen[j] = randomCSV;
-						n_aJet_csvN[j] = iterations;
-					}
-				}
-				else {
-					if(useCumul) {
-						n_aJet_csvGen[j] = randLinpolEdge(histoCumul[key], dis(gen), bruteSearch);
-					}
-					else {
-						n_aJet_csvGen[j] = histograms[key] -> GetRandom();
-					}
-				}
-			}
 		}
+		sampleJets(setup, naJets, aJet_pt, aJet_eta, aJet_flavour, aJetBinIds, n_aJet_csvGen, n_aJet_csvN, gen);
 		
 		u -> Fill();
 		
@@ -419,17 +402,27 @@ int main(int argc, char ** argv) {
 	}
 	
 	if(enableVerbose) std::cout << "Writing to " << output << " ... " << std::endl;
-	u -> Write();
+	out -> cd();
+	u -> Write("", TObject::kOverwrite); // replaces the cycles saved by the checkpoints
+	writeEventRange(beginEvent, endEvent);
+	if(enableVerbose && checkpointInterval > 0) {
+		std::cout << "Checkpoints:\t" << checkpoint.getNumberOfSaves() << " (" << checkpoint.getOverhead() << " s)" << std::endl;
+	}
 	
 	// close the files
 	if(enableVerbose) {
 		std::cout << "Closing " << input << ", " << output << ", ";
 		std::cout << " and " << (useCumul ? cinput : hinput) << " ... " << std::endl;
 	}
-	in -> Close();
+	if(in) in -> Close();
 	out -> Close();
 	if(useCumul) fcumul -> Close();
 	else fhisto -> Close();
+	checkpoint.remove(); // the output is complete
 	
 	return EXIT_SUCCESS;
 }
+catch(std::runtime_error & e) { // EventReader and SkimCache throw, for the daemon
+	std::cerr << e.what() << std::endl;
+	return EXIT_FAILURE;
+}
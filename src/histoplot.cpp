@@ -3,12 +3,13 @@
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 
-#include <cstdlib> // EXIT_SUCCESS
+#include <cstdlib> // EXIT_SUCCESS, EXIT_FAILURE, std::exit()
 #include <map> // std::map
 #include <vector> // std::vector<>
 #include <sstream> // std::stringstream
 #include <iostream> // std::cout, std::cerr, std::endl
 #include <algorithm> // std::sort
+#include <thread> // std::thread::hardware_concurrency()
 
 #include <TCanvas.h>
 #include <TFile.h>
@@ -18,6 +19,7 @@
 #include <TLegend.h>
 
 #include "common.hpp"
+#include "BatchRenderer.hpp"
 
 int main(int argc, char ** argv) {
 	
@@ -27,8 +29,9 @@ int main(int argc, char ** argv) {
 	// command line option parsing
 	Int_t dimX, dimY;
 	Float_t cmd_workingPoint;
+	Int_t nWorkers;
 	std::string inName, extension, dir, config, otherInput;
-	bool setLog = false, useSampled = false, useMultisampled = false, plotIterations=false, plotAllInOne=true, customNorm = false;
+	bool setLog = false, useSampled = false, useMultisampled = false, plotIterations=false, plotAllInOne=true, customNorm = false, force = false;
 	
 	try {
 		po::options_description desc("allowed options");
@@ -47,6 +50,8 @@ int main(int argc, char ** argv) {
 			("use-multisampled,m", "adds 'multiple times sampled' to the x-axis label")
 			("plot-iterations,p", "plots the number of iterations to pass the working point")
 			("plot-single,n", "plot the number of iterations to separate canvases")
+			("workers", po::value<Int_t>(&nWorkers) -> default_value(std::thread::hardware_concurrency()), "number of rendering processes")
+			("force", "render the plots even if their inputs haven't changed")
 		;
 		
 		po::variables_map vm;
@@ -91,6 +96,9 @@ int main(int argc, char ** argv) {
 		if(vm.count("other-input") > 0) {
 			customNorm = true;
 		}
+		if(vm.count("force")) {
+			force = true;
+		}
 	}
 	catch(std::exception & e) {
 		std::cerr << "error: " << e.what() << std::endl;
@@ -130,47 +138,227 @@ int main(int argc, char ** argv) {
 	if(useSampled || useMultisampled) key = "csvGen_";
 	else if(plotIterations) key = "csvN_";
 	
+	// the histograms are read once here; the workers draw their own copies
+	std::map<std::string, TH1F *> histos, customHistos;
+	for(int i = 0; i < 3; ++i) {
+		for(int j = 0; j < 6; ++j) {
+			for(int k = 0; k < 3; ++k) {
+				histos[getName(i, j, k, key)] = dynamic_cast<TH1F *> (in -> Get(getName(i, j, k, key).c_str()));
+			}
+		}
+	}
+	TFile * customFile = 0;
+	if(customNorm) {
+		customFile = TFile::Open(otherInput.c_str(), "read");
+		if(! customFile || customFile -> IsZombie() || ! customFile -> IsOpen()) {
+			std::cerr << "error on opening " << otherInput << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		for(int i = 0; i < 3; ++i) {
+			for(int j = 0; j < 6; ++j) {
+				for(int k = 0; k < 3; ++k) {
+					customHistos[getName(i, j, k)] = dynamic_cast<TH1F *> (customFile -> Get(getName(i, j, k).c_str()));
+				}
+			}
+		}
+	}
+	auto get = [&histos] (const std::string & name) -> TH1F * {
+		TH1F * h = dynamic_cast<TH1F *> (histos.at(name) -> Clone());
+		h -> SetDirectory(0);
+		return h;
+	};
+	
+	BatchRenderer renderer((dir.empty() ? "" : dir + "/") + ".plotcache", nWorkers, force);
 	if(plotIterations) {
 		if(plotAllInOne) {
 			for(int j = 0; j < 6; ++j) {
 				for(int k = 0; k < 3; ++k) {
 					std::string canvasTitle = getAbbrName(j, k);
+					std::string fileName = canvasTitle;
+					if(setLog) fileName = "log_" + fileName;
+					fileName = "iter_" + fileName;
+					fileName = "hist_" + fileName;
+					if(! dir.empty()) fileName = dir + "/" + fileName;
+					fileName += "." + extension;
+					
+					BatchRenderer::Hash hash;
+					hash.add("histoplot").add(key).add(dimX).add(dimY).add(setLog).add(workingPoint).add(customNorm);
+					for(int i = 0; i < 3; ++i) {
+						hash.add(histos.at(getName(i, j, k, key)));
+						if(customNorm) hash.add(customHistos.at(getName(i, j, k)));
+					}
+					
+					renderer.add(fileName, hash, [=, &histos, &customHistos] () {
+						TCanvas * c = new TCanvas(canvasTitle.c_str(), canvasTitle.c_str(), dimX, dimY);
+						gStyle -> SetOptStat(kFALSE);
+						TLegend * legend = new TLegend(0.37, 0.85, 0.63, 0.90);
+						legend -> SetNColumns(3);
+						Float_t maxY = -1;
+						Int_t maxBins = -1;
+						// the line
+						//        maxY = maxY < h -> GetMaximum() ? h -> GetMaximum() : maxY;
+						// in the second loop doesn't work, must loop over first to get the max value
+						// of the Y axis
+						//std::map<int, Int_t> w;
+						for(int i = 0; i < 3; ++i) {
+							TH1F * h = get(getName(i, j, k, key));
+							//h -> Scale(1.0/(h -> Integral()));
+							maxY = h -> GetMaximum() > maxY ? h -> GetMaximum() : maxY;
+							maxBins = h -> GetNbinsX() > maxBins ? h -> GetNbinsX() : maxBins;
+							delete h;
+							//w[XendpointMultisample[i]] = i;
+						}
+						
+						//typedef std::map<int, Int_t>::reverse_iterator iter;
+						//int firstIndex = w.rbegin() -> second;
+						//for(iter it = w.rbegin(); it != w.rend(); ++it) {
+						for(int i = 0; i < 3; ++i) {
+							//int i = it -> second;
+							TH1F * h = get(getName(i, j, k, key));
+							std::string legendLabel = flavorNames[i] + " jet";
+							std::stringstream histoTitle;
+							histoTitle << getHistoTitle(j, k) << " @ " << maxBins << " bins";
+							h -> SetLineColor(colorRanges[i]);
+							h -> SetLineWidth(2);
+							h -> GetXaxis() -> SetTitle("Number of iterations");
+							h -> GetYaxis() -> SetTitle("Number of events");
+							h -> GetYaxis() -> SetTitleOffset(1.2);
+							h -> SetMaximum(1.1 * maxY);
+							h -> SetMinimum(1);
+							h -> Draw((i == 0 ? "hist e" : "same hist e")); // same e for the error bars
+							h -> SetTitle(histoTitle.str().c_str());
+							legend -> AddEntry(h, legendLabel.c_str());
+							if(setLog) c -> SetLogy(1);
+							c -> SetRightMargin(0.05);
+							c -> Modified();
+							c -> Update();
+						}
+						legend -> Draw();
+						
+						c -> SaveAs(fileName.c_str());
+						c -> Close();
+						delete legend;
+					});
+				}
+			}
+		} else {
+			for(int i = 0; i < 3; ++i) {
+				for(int j = 0; j < 6; ++j) {
+					for(int k = 0; k < 3; ++k) {
+						std::string canvasTitle = getName(i, j, k, key);
+						std::string fileName = canvasTitle;
+						if(setLog) fileName = "log_" + fileName;
+						fileName = "iter_" + fileName;
+						fileName = "hist_" + fileName;
+						if(! dir.empty()) fileName = dir + "/" + fileName;
+						fileName += "." + extension;
+						
+						BatchRenderer::Hash hash;
+						hash.add("histoplot").add(key).add(dimX).add(dimY).add(setLog).add(workingPoint).add(customNorm);
+						hash.add(histos.at(getName(i, j, k, key)));
+						
+						renderer.add(fileName, hash, [=, &histos, &customHistos] () {
+							TCanvas * c = new TCanvas(canvasTitle.c_str(), canvasTitle.c_str(), dimX, dimY);
+							gStyle -> SetOptStat(kFALSE);
+							
+							TH1F * h = get(getName(i, j, k, key));
+							//h -> Scale(1.0 / h -> Integral()); // ???
+							Float_t maxY = h -> GetMaximum();
+							
+							std::stringstream histoTitle;
+							histoTitle << getHistoTitle(i, j, k) << " @ " << h -> GetNbinsX() << " bins";
+							h -> SetLineColor(colorRanges[i]);
+							h -> SetLineWidth(2);
+							h -> GetXaxis() -> SetTitle("Number of iterations");
+							h -> GetYaxis() -> SetTitle("Number of events per bin");
+							h -> GetYaxis() -> SetTitleOffset(1.5);
+							h -> SetMaximum(1.1 * maxY);
+							h -> Draw("hist e"); // same e for the error bars
+							h -> SetTitle(histoTitle.str().c_str());
+							if(setLog) c -> SetLogy(1);
+							c -> SetRightMargin(0.05);
+							c -> Modified();
+							c -> Update();
+							
+							c -> SaveAs(fileName.c_str());
+							c -> Close();
+						});
+					}
+				}
+			}
+		}
+	}
+	else {
+		for(int j = 0; j < 6; ++j) {
+			for(int k = 0; k < 3; ++k) {
+				std::string canvasTitle = getAbbrName(j, k);
+				std::string fileName = canvasTitle;
+				if(setLog) fileName = "log_" + fileName;
+				if(useSampled)				fileName = "sampled_" + fileName;
+				else if(useMultisampled)	fileName = "multisampled_" + fileName;
+				fileName = "hist_" + fileName;
+				if(! dir.empty()) fileName = dir + "/" + fileName;
+				fileName += "." + extension;
+				
+				BatchRenderer::Hash hash;
+				hash.add("histoplot").add(key).add(dimX).add(dimY).add(setLog).add(workingPoint).add(customNorm);
+				for(int i = 0; i < 3; ++i) {
+					hash.add(histos.at(getName(i, j, k, key)));
+					if(customNorm) hash.add(customHistos.at(getName(i, j, k)));
+				}
+				
+				renderer.add(fileName, hash, [=, &histos, &customHistos] () {
 					TCanvas * c = new TCanvas(canvasTitle.c_str(), canvasTitle.c_str(), dimX, dimY);
 					gStyle -> SetOptStat(kFALSE);
 					TLegend * legend = new TLegend(0.37, 0.85, 0.63, 0.90);
 					legend -> SetNColumns(3);
 					Float_t maxY = -1;
-					Int_t maxBins = -1;
 					// the line
 					//        maxY = maxY < h -> GetMaximum() ? h -> GetMaximum() : maxY;
 					// in the second loop doesn't work, must loop over first to get the max value
 					// of the Y axis
-					//std::map<int, Int_t> w;
 					for(int i = 0; i < 3; ++i) {
-						TH1F * h = dynamic_cast<TH1F *> (in -> Get(getName(i, j, k, key).c_str()));
-						//h -> Scale(1.0/(h -> Integral()));
+						TH1F * h = get(getName(i, j, k, key));
+						h -> Scale(1.0/(h -> Integral()));
 						maxY = h -> GetMaximum() > maxY ? h -> GetMaximum() : maxY;
-						maxBins = h -> GetNbinsX() > maxBins ? h -> GetNbinsX() : maxBins;
 						delete h;
-						//w[XendpointMultisample[i]] = i;
 					}
-					
-					//typedef std::map<int, Int_t>::reverse_iterator iter;
-					//int firstIndex = w.rbegin() -> second;
-					//for(iter it = w.rbegin(); it != w.rend(); ++it) {
 					for(int i = 0; i < 3; ++i) {
-						//int i = it -> second;
-						TH1F * h = dynamic_cast<TH1F *> (in -> Get(getName(i, j, k, key).c_str()));
+						TH1F * h = get(getName(i, j, k, key));
 						std::string legendLabel = flavorNames[i] + " jet";
 						std::stringstream histoTitle;
-						histoTitle << getHistoTitle(j, k) << " @ " << maxBins << " bins";
+						histoTitle << "CSV   " << getHistoTitle(j, k) << " @ ";
+						std::string xLabel = "CSV discriminator";
+						if(useSampled)				xLabel = "Sampled " + xLabel;
+						else if(useMultisampled)	xLabel = "Multiple times sampled " + xLabel;
 						h -> SetLineColor(colorRanges[i]);
 						h -> SetLineWidth(2);
-						h -> GetXaxis() -> SetTitle("Number of iterations");
-						h -> GetYaxis() -> SetTitle("Number of events");
+						if(useMultisampled) {
+							Int_t wpBin = h -> FindBin(workingPoint);
+							Int_t nBins = h -> GetNbinsX();
+							//h -> GetXaxis() -> SetRange(wpBin - 1, nBins);
+							histoTitle << (nBins - wpBin + 1) << " bins";
+							xLabel += " (wp " + std::to_string(workingPoint).substr(0, 5) + ")";
+						}
+						else {
+							histoTitle << h -> GetNbinsX() << " bins";
+						}
+						h -> GetXaxis() -> SetTitle(xLabel.c_str());
+						h -> GetYaxis() -> SetTitle("Normalized number of events per bin");
 						h -> GetYaxis() -> SetTitleOffset(1.2);
+						if(customNorm) {
+							TH1F * customHisto = customHistos.at(getName(i, j, k));
+							Int_t wpBin = customHisto -> FindBin(workingPoint);
+							Int_t nBins = customHisto -> GetNbinsX();
+							Float_t notSoPreciseIntegral = customHisto -> Integral(wpBin, nBins);
+							Float_t normalizationFactor = notSoPreciseIntegral / customHisto -> Integral();
+							h -> Scale(normalizationFactor / h -> Integral());
+						}
+						else {
+							h -> Scale(1.0/(h -> Integral()));
+						}
+						h -> SetMinimum(1e-3);
 						h -> SetMaximum(1.1 * maxY);
-						h -> SetMinimum(1);
 						h -> Draw((i == 0 ? "hist e" : "same hist e")); // same e for the error bars
 						h -> SetTitle(histoTitle.str().c_str());
 						legend -> AddEntry(h, legendLabel.c_str());
@@ -180,131 +368,22 @@ int main(int argc, char ** argv) {
 						c -> Update();
 					}
 					legend -> Draw();
-					
-					if(setLog) canvasTitle = "log_" + canvasTitle;
-					canvasTitle = "iter_" + canvasTitle;
-					canvasTitle = "hist_" + canvasTitle;
-					if(! dir.empty()) canvasTitle = dir + "/" + canvasTitle;
-					c -> SaveAs(canvasTitle.append("." + extension).c_str()); // char * = TString
+					c -> SaveAs(fileName.c_str());
 					c -> Close();
 					delete legend;
-				}
-			}
-		} else {
-			for(int i = 0; i < 3; ++i) {
-				for(int j = 0; j < 6; ++j) {
-					for(int k = 0; k < 3; ++k) {
-						std::string canvasTitle = getName(i, j, k, key);
-						TCanvas * c = new TCanvas(canvasTitle.c_str(), canvasTitle.c_str(), dimX, dimY);
-						gStyle -> SetOptStat(kFALSE);
-						
-						TH1F * h = dynamic_cast<TH1F *> (in -> Get(getName(i, j, k, key).c_str()));
-						//h -> Scale(1.0 / h -> Integral()); // ???
-						Float_t maxY = h -> GetMaximum();
-						
-						std::stringstream histoTitle;
-						histoTitle << getHistoTitle(i, j, k) << " @ " << h -> GetNbinsX() << " bins";
-						h -> SetLineColor(colorRanges[i]);
-						h -> SetLineWidth(2);
-						h -> GetXaxis() -> SetTitle("Number of iterations");
-						h -> GetYaxis() -> SetTitle("Number of events per bin");
-						h -> GetYaxis() -> SetTitleOffset(1.5);
-						h -> SetMaximum(1.1 * maxY);
-						h -> Draw("hist e"); // same e for the error bars
-						h -> SetTitle(histoTitle.str().c_str());
-						if(setLog) c -> SetLogy(1);
-						c -> SetRightMargin(0.05);
-						c -> Modified();
-						c -> Update();
-						
-						if(setLog) canvasTitle = "log_" + canvasTitle;
-						canvasTitle = "iter_" + canvasTitle;
-						canvasTitle = "hist_" + canvasTitle;
-						if(! dir.empty()) canvasTitle = dir + "/" + canvasTitle;
-						c -> SaveAs(canvasTitle.append("." + extension).c_str()); // char * = TString
-						c -> Close();
-					}
-				}
+				});
 			}
 		}
 	}
-	else {
-		for(int j = 0; j < 6; ++j) {
-			for(int k = 0; k < 3; ++k) {
-				std::string canvasTitle = getAbbrName(j, k);
-				TCanvas * c = new TCanvas(canvasTitle.c_str(), canvasTitle.c_str(), dimX, dimY);
-				gStyle -> SetOptStat(kFALSE);
-				TLegend * legend = new TLegend(0.37, 0.85, 0.63, 0.90);
-				legend -> SetNColumns(3);
-				Float_t maxY = -1;
-				// the line
-				//        maxY = maxY < h -> GetMaximum() ? h -> GetMaximum() : maxY;
-				// in the second loop doesn't work, must loop over first to get the max value
-				// of the Y axis
-				for(int i = 0; i < 3; ++i) {
-					TH1F * h = dynamic_cast<TH1F *> (in -> Get(getName(i, j, k, key).c_str()));
-					h -> Scale(1.0/(h -> Integral()));
-					maxY = h -> GetMaximum() > maxY ? h -> GetMaximum() : maxY;
-					delete h;
-				}
-				for(int i = 0; i < 3; ++i) {
-					TH1F * h = dynamic_cast<TH1F *> (in -> Get(getName(i, j, k, key).c_str()));
-					std::string legendLabel = flavorNames[i] + " jet";
-					std::stringstream histoTitle;
-					histoTitle << "CSV   " << getHistoTitle(j, k) << " @ ";
-					std::string xLabel = "CSV discriminator";
-					if(useSampled)				xLabel = "Sampled " + xLabel;
-					else if(useMultisampled)	xLabel = "Multiple times sampled " + xLabel;
-					h -> SetLineColor(colorRanges[i]);
-					h -> SetLineWidth(2);
-					if(useMultisampled) {
-						Int_t wpBin = h -> FindBin(workingPoint);
-						Int_t nBins = h -> GetNbinsX();
-						//h -> GetXaxis() -> SetRange(wpBin - 1, nBins);
-						histoTitle << (nBins - wpBin + 1) << " bins";
-						xLabel += " (wp " + std::to_string(workingPoint).substr(0, 5) + ")";
-					}
-					else {
-						histoTitle << h -> GetNbinsX() << " bins";
-					}
-					h -> GetXaxis() -> SetTitle(xLabel.c_str());
-					h -> GetYaxis() -> SetTitle("Normalized number of events per bin");
-					h -> GetYaxis() -> SetTitleOffset(1.2);
-					if(customNorm) {
-						TFile * customFile = TFile::Open(otherInput.c_str(), "read");
-						TH1F * customHisto = dynamic_cast<TH1F *> (customFile -> Get(getName(i, j, k).c_str()));
-						Int_t wpBin = customHisto -> FindBin(workingPoint);
-						Int_t nBins = customHisto -> GetNbinsX();
-						Float_t notSoPreciseIntegral = customHisto -> Integral(wpBin, nBins);
-						Float_t normalizationFactor = notSoPreciseIntegral / customHisto -> Integral();
-						h -> Scale(normalizationFactor / h -> Integral());
-					}
-					else {
-						h -> Scale(1.0/(h -> Integral()));
-					}
-					h -> SetMinimum(1e-3);
-					h -> SetMaximum(1.1 * maxY);
-					h -> Draw((i == 0 ? "hist e" : "same hist e")); // same e for the error bars
-					h -> SetTitle(histoTitle.str().c_str());
-					legend -> AddEntry(h, legendLabel.c_str());
-					if(setLog) c -> SetLogy(1);
-					c -> SetRightMargin(0.05);
-					c -> Modified();
-					c -> Update();
-				}
-				legend -> Draw();
-				if(setLog) canvasTitle = "log_" + canvasTitle;
-				if(useSampled)				canvasTitle = "sampled_" + canvasTitle;
-				else if(useMultisampled)	canvasTitle = "multisampled_" + canvasTitle;
-				canvasTitle = "hist_" + canvasTitle;
-				if(! dir.empty()) canvasTitle = dir + "/" + canvasTitle;
-				c -> SaveAs(canvasTitle.append("." + extension).c_str()); // char * = TString
-				c -> Close();
-				delete legend;
-			}
-		}
+	bool rendered = renderer.run();
+	std::cout << renderer.report() << std::endl;
+	if(! rendered) {
+		std::cerr << "some of the plots failed" << std::endl;
+		std::exit(EXIT_FAILURE);
 	}
 	
+	if(customFile) customFile -> Close();
+	
 	in -> Close();
 	return EXIT_SUCCESS;
 }
\ No newline at end of file
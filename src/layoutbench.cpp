@@ -0,0 +1,152 @@
+#include <boost/program_options.hpp>
+
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <iomanip> // std::setw(), std::setprecision()
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS
+#include <cstdio> // std::remove()
+#include <algorithm> // std::min()
+#include <chrono> // std::chrono
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TROOT.h>
+
+#include "TreeLayout.hpp"
+
+int main(int argc, char ** argv) {
+	
+	namespace po = boost::program_options;
+	
+	// command line option parsing
+	std::string input, treeName, output, configFile;
+	Long64_t beginEvent, nEvents;
+	std::vector<std::string> compressions;
+	std::vector<Long64_t> autoFlushes;
+	std::vector<Int_t> basketSizes;
+	bool keepFiles = false;
+	try {
+		po::options_description desc("allowed options");
+		desc.add_options()
+			("help,h", "prints this message")
+			("input,i", po::value<std::string>(&input), "input *.root file")
+			("tree,t", po::value<std::string>(&treeName), "name of the tree")
+			("begin,b", po::value<Long64_t>(&beginEvent) -> default_value(0), "the event number to start with")
+			("events,n", po::value<Long64_t>(&nEvents) -> default_value(100000), "number of events copied in each run\n(they are kept in memory)")
+			("output,o", po::value<std::string>(&output) -> default_value("layoutbench.root"), "scratch output file")
+			("compression,z", po::value<std::vector<std::string> >(&compressions) -> multitoken(), "list of compression settings <algorithm>:<level>\ndefault: zlib:1 zlib:6 lzma:1 lzma:6")
+			("autoflush,f", po::value<std::vector<Long64_t> >(&autoFlushes) -> multitoken(), "list of AutoFlush values\n(> 0 entries, < 0 bytes per cluster)\ndefault: -30000000")
+			("basket,B", po::value<std::vector<Int_t> >(&basketSizes) -> multitoken(), "list of basket sizes in bytes\ndefault: 32000")
+			("config,c", po::value<std::string>(&configFile), "benchmark also the layout given in the config file")
+			("keep,k", "keep the output files (suffixed by the run number)")
+		;
+		
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+		po::notify(vm);
+		
+		if(vm.count("help")) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_SUCCESS); // ugly
+		}
+		if(vm.count("input") == 0 || vm.count("tree") == 0) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(vm.count("keep")) {
+			keepFiles = true;
+		}
+		if(compressions.empty()) compressions = { "zlib:1", "zlib:6", "lzma:1", "lzma:6" };
+		if(autoFlushes.empty()) autoFlushes = { -30000000 };
+		if(basketSizes.empty()) basketSizes = { 32000 };
+	}
+	catch(std::exception & e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		std::exit(EXIT_FAILURE); // ugly
+	}
+	catch(...) {
+		std::cerr << "exception of unkown type" << std::endl;
+	}
+	
+	// set up the profiles
+	std::vector<TreeLayout> layouts;
+	for(auto & c: compressions) {
+		for(auto & a: autoFlushes) {
+			for(auto & b: basketSizes) {
+				layouts.push_back(TreeLayout(TreeLayout::parseCompression(c), a, b));
+			}
+		}
+	}
+	if(! configFile.empty()) layouts.push_back(TreeLayout(configFile));
+	
+	// copy the events into memory, so that the input file doesn't bias the write speed
+	TFile * in = TFile::Open(input.c_str(), "read");
+	if(! in || in -> IsZombie() || ! in -> IsOpen()) {
+		std::cerr << "error on opening " << input << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	TTree * t = dynamic_cast<TTree *> (in -> Get(treeName.c_str()));
+	if(! t) {
+		std::cerr << "error on accessing tree " << treeName << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	Long64_t endEvent = std::min(t -> GetEntries(), beginEvent + nEvents);
+	gROOT -> cd();
+	TTree * m = t -> CloneTree(0);
+	m -> SetDirectory(0);
+	for(Long64_t i = beginEvent; i < endEvent; ++i) {
+		t -> GetEntry(i);
+		m -> Fill();
+	}
+	nEvents = m -> GetEntries();
+	std::cout << "Copied " << nEvents << " events (" << m -> GetTotBytes() / 1e6 << " MB uncompressed) into memory" << std::endl;
+	
+	std::cout << std::setw(5) << "run" << std::setw(14) << "write [MB/s]" << std::setw(14) << "read [MB/s]"
+			  << std::setw(14) << "size [MB]" << std::setw(10) << "ratio" << "  layout" << std::endl;
+	
+	for(std::size_t run = 0; run < layouts.size(); ++run) {
+		const TreeLayout & layout = layouts[run];
+		std::string filename = keepFiles ? (output + "." + std::to_string(run)) : output;
+		
+		/*********** write *******************************************/
+		auto t0 = std::chrono::steady_clock::now();
+		TFile * out = TFile::Open(filename.c_str(), "recreate");
+		layout.apply(out);
+		TTree * u = m -> CloneTree(0);
+		u -> SetDirectory(out);
+		layout.apply(u);
+		for(Long64_t i = 0; i < nEvents; ++i) {
+			m -> GetEntry(i);
+			u -> Fill();
+		}
+		Double_t totBytes = u -> GetTotBytes();
+		u -> Write();
+		out -> Close();
+		Double_t writeTime = std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - t0).count();
+		delete out;
+		
+		/*********** read back ***************************************/
+		t0 = std::chrono::steady_clock::now();
+		TFile * f = TFile::Open(filename.c_str(), "read");
+		TTree * r = dynamic_cast<TTree *> (f -> Get(treeName.c_str()));
+		for(Long64_t i = 0; i < nEvents; ++i) {
+			r -> GetEntry(i);
+		}
+		Double_t readTime = std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - t0).count();
+		Double_t fileSize = f -> GetSize();
+		f -> Close();
+		delete f;
+		if(! keepFiles) std::remove(filename.c_str());
+		
+		std::cout << std::setw(5) << run
+				  << std::setw(14) << std::setprecision(4) << (totBytes / 1e6 / writeTime)
+				  << std::setw(14) << std::setprecision(4) << (totBytes / 1e6 / readTime)
+				  << std::setw(14) << std::setprecision(4) << (fileSize / 1e6)
+				  << std::setw(10) << std::setprecision(3) << (totBytes / fileSize)
+				  << "  " << layout.toString() << std::endl;
+	}
+	
+	in -> Close();
+	return EXIT_SUCCESS;
+}
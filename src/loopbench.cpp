@@ -0,0 +1,482 @@
+#include <boost/program_options.hpp>
+
+#include <cstdlib> // EXIT_SUCCESS, std::exit()
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <iomanip> // std::setw()
+#include <sstream> // std::stringstream
+#include <vector> // std::vector<>
+#include <map> // std::map<>
+#include <string> // std::string
+#include <chrono> // std::chrono
+#include <random> // std::mt19937_64
+#include <functional> // std::function<>
+#include <algorithm> // std::find(), std::prev_permutation()
+#include <cmath> // std::fabs()
+#include <stdexcept> // std::runtime_error
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+#include <TKey.h>
+#include <TROOT.h>
+#include <TClass.h>
+#include <TRandom.h>
+
+#include "common.hpp"
+#include "JetCollection.hpp"
+#include "EventReader.hpp"
+#include "SkimCache.hpp"
+#include "EventKernels.hpp"
+
+/*********** events kept in memory ****/
+
+struct StoredEvent {
+	Int_t nhJets, naJets;
+	Float_t hJet_pt[maxNumberOfHJets], hJet_eta[maxNumberOfHJets], hJet_flavour[maxNumberOfHJets], hJet_csv[maxNumberOfHJets];
+	Float_t aJet_pt[maxNumberOfAJets], aJet_eta[maxNumberOfAJets], aJet_flavour[maxNumberOfAJets], aJet_csv[maxNumberOfAJets];
+};
+
+/**
+ * @brief Reads all TH1F of a file, by name.
+ */
+std::map<TString, TH1F *> readHistograms(std::string filename) {
+	std::map<TString, TH1F *> histograms;
+	TFile * f = TFile::Open(filename.c_str(), "read");
+	if(f -> IsZombie() || ! f -> IsOpen()) {
+		std::cerr << "Cannot open " << filename << "." << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	TKey * key;
+	TIter next(f -> GetListOfKeys());
+	while((key = dynamic_cast<TKey *>(next()))) {
+		TClass * cl = gROOT -> GetClass(key -> GetClassName());
+		if(! cl -> InheritsFrom("TH1F")) continue;
+		TH1F * h = dynamic_cast<TH1F *> (key -> ReadObj());
+		h -> SetDirectory(0);
+		histograms[h -> GetName()] = h;
+	}
+	f -> Close();
+	return histograms;
+}
+
+/**
+ * @brief The best time of a number of passes, in seconds.
+ */
+Double_t bestTime(Int_t repeat, std::function<void()> pass) {
+	Double_t best = -1;
+	for(Int_t i = 0; i < repeat; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		pass();
+		Double_t time = std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - start).count();
+		if(best < 0 || time < best) best = time;
+	}
+	return best;
+}
+
+/*********** the loops before EventKernels.hpp, as a baseline ****/
+
+/**
+ * @brief The tables of the old loops, looked up by the names of the bins.
+ */
+struct LegacyTables {
+	std::map<TString, TH1F *> histograms, cumulatives;
+	std::map<TString, Float_t> probabilities;
+	Int_t requiredJets, requiredBtags, nIterMax, maxSamples;
+	Float_t workingPoint;
+};
+
+/**
+ * @brief The event loop of analyze.cpp before the kernels: JetCollection, the bin names as keys, std::map and std::string.
+ * A jet out of the bins is never tagged, as in analyzeKernel().
+ */
+bool legacyAnalyze(const LegacyTables & l, StoredEvent & stored, AnalyzeEvent & e, const RuntimeAnalyzeModes & modes) {
+	auto comb = [] (std::vector<float> & v, int N, int K) -> float {
+		std::string bitmask(K, 1); // K leading 1's
+		bitmask.resize(N, 0); // N-K trailing 0's
+		float sum_prob = 0;
+		do {
+			float prob = 1;
+			for (int i = 0; i < N; ++i) {
+				if (bitmask[i]) prob *= v[i];
+				else prob *= (1 - v[i]);
+			}
+			sum_prob += prob;
+		} while (std::prev_permutation(bitmask.begin(), bitmask.end()));
+		return sum_prob;
+	};
+	auto sample = [&l] (std::string name) -> Float_t {
+		auto it = l.histograms.find(name.c_str());
+		return (it == l.histograms.end() || ! it -> second) ? -1 : it -> second -> GetRandom();
+	};
+	
+	JetCollection j_coll;
+	j_coll.add(stored.nhJets, stored.hJet_pt, stored.hJet_eta, stored.hJet_flavour, stored.hJet_csv, "h");
+	j_coll.add(stored.naJets, stored.aJet_pt, stored.aJet_eta, stored.aJet_flavour, stored.aJet_csv, "a");
+	j_coll.sortPt(); // sort by jet pt (descending)
+	
+	JetCollection passedJets;
+	for(auto & jet: j_coll) {
+		if(jet.getPt() < 20 || std::fabs(jet.getEta()) >= 2.5) continue;
+		int pt = getPtIndex(jet.getPt());
+		int eta = getEtaIndex(std::fabs(jet.getEta()));
+		int flavor = getFlavorIndex(std::fabs(jet.getFlavor()));
+		jet.setName((pt < 0 || eta < 0 || flavor < 0) ? "" : getName(flavor, pt, eta));
+		passedJets.add(jet);
+		if(! modes.exact && Int_t(passedJets.size()) == l.requiredJets) break; // only first 'requiredJets' jets
+	}
+	if(Int_t(passedJets.size()) != l.requiredJets) return false; // skip the event
+	
+	if(modes.multiple) {
+		int Npass = 0;
+		for(int iterations = 1; iterations <= l.nIterMax; ++iterations) {
+			int btagCounter = 0;
+			for(auto & jet: passedJets) {
+				if(sample(jet.getName()) >= l.workingPoint) ++btagCounter;
+			}
+			if(btagCounter == l.requiredBtags) ++Npass;
+		}
+		e.mProb = float(Npass) / l.nIterMax;
+	}
+	if(modes.analytic) {
+		std::vector<Float_t> individualProbabilities;
+		for(auto & jet: passedJets) {
+			auto it = l.probabilities.find(jet.getName().c_str());
+			individualProbabilities.push_back(it == l.probabilities.end() ? 0 : it -> second);
+		}
+		e.aProb = comb(individualProbabilities, l.requiredJets, l.requiredBtags);
+	}
+	if(modes.once) {
+		int btagCounter = 0;
+		std::map<std::string, std::vector<int> > indices;
+		for(auto & jet: passedJets) {
+			int index = jet.getIndex();
+			std::string type = jet.getType();
+			Float_t r = sample(jet.getName());
+			if(type == "a") e.aJet_csvGen[index] = r;
+			else e.hJet_csvGen[index] = r;
+			if(r >= l.workingPoint) ++btagCounter;
+			indices[type].push_back(index);
+		}
+		for(int j = 0; j < stored.naJets; ++j) {
+			if(std::find(indices["a"].begin(), indices["a"].end(), j) != indices["a"].end()) continue;
+			e.aJet_csvGen[j] = -1.0;
+		}
+		for(int j = 0; j < stored.nhJets; ++j) {
+			if(std::find(indices["h"].begin(), indices["h"].end(), j) != indices["h"].end()) continue;
+			e.hJet_csvGen[j] = -1.0;
+		}
+		e.count = btagCounter;
+	}
+	if(modes.real) {
+		int realBtagCounter = 0;
+		for(auto & jet: passedJets) {
+			if(jet.getCSV() >= l.workingPoint) ++realBtagCounter;
+		}
+		e.realCount = realBtagCounter;
+	}
+	return true;
+}
+
+/**
+ * @brief The jet loop of gsample.cpp before the kernels: the bin indices, then the histograms by name.
+ */
+void legacySample(const LegacyTables & l, Int_t nJets, const Float_t * pt, const Float_t * eta, const Float_t * flavour,
+				  Float_t * csvGen, Long64_t * csvN, std::mt19937_64 & gen, const RuntimeSampleModes & modes) {
+	std::uniform_real_distribution<Float_t> dis(0,1);
+	for(int j = 0; j < nJets; ++j) {
+		Float_t absEta = TMath::Abs(eta[j]); // only the absolute value matters
+		Float_t absFlavor = TMath::Abs(flavour[j]); // antiparticles included
+		
+		int flavorIndex = getFlavorIndex(absFlavor);
+		int ptIndex = getPtIndex(pt[j]);
+		int etaIndex = getEtaIndex(absEta);
+		
+		if(flavorIndex == -1 || ptIndex == -1 || etaIndex == -1) {
+			csvGen[j] = -1; // default value if not in the range
+			if(modes.aLot) csvN[j] = -1;
+			continue;
+		}
+		TString key = getName(flavorIndex, ptIndex, etaIndex).c_str();
+		auto draw = [&] () -> Float_t {
+			if(modes.cumul) return randLinpolEdge(l.cumulatives.at(key), dis(gen));
+			return l.histograms.at(key) -> GetRandom();
+		};
+		if(modes.aLot) {
+			Long64_t iterations = 1;
+			Double_t randomCSV = -2;
+			for(; iterations <= l.maxSamples; ++iterations) {
+				randomCSV = draw();
+				if(randomCSV >= l.workingPoint) break;
+			}
+			if(randomCSV < l.workingPoint) {
+				csvGen[j] = -2;
+				csvN[j] = -2;
+			}
+			else {
+				csvGen[j] = randomCSV;
+				csvN[j] = iterations;
+			}
+		}
+		else {
+			csvGen[j] = draw();
+		}
+	}
+}
+
+int main(int argc, char ** argv) try {
+	
+	namespace po = boost::program_options;
+	
+	std::string inFilename, treeName, hinput, cinput;
+	Long64_t nEvents;
+	Int_t requiredJets, requiredBtags, nIterMax, maxSamples, repeat, readAhead;
+	Float_t workingPoint;
+	UInt_t seed;
+	
+	try {
+		po::options_description desc("allowed options");
+		desc.add_options()
+			("help,h", "prints this message")
+			("input,i", po::value<std::string>(&inFilename), "input *.root file")
+			("tree,t", po::value<std::string>(&treeName), "name of the tree")
+			("events,e", po::value<Long64_t>(&nEvents) -> default_value(100000), "number of events read into memory")
+			("histograms,k", po::value<std::string>(&hinput), "histograms (the modes of analyze.out -s, -m and of gsample.out -k)")
+			("cumulatives,c", po::value<std::string>(&cinput), "cumulatives (the modes of analyze.out -a and of gsample.out -c)")
+			("Nj,j", po::value<Int_t>(&requiredJets) -> default_value(2), "required number of jets per event")
+			("Ntag,n", po::value<Int_t>(&requiredBtags) -> default_value(1), "required number of btags per event")
+			("working-point,w", po::value<Float_t>(&workingPoint) -> default_value(0.679), "CSV working point")
+			("Niter-max,x", po::value<Int_t>(&nIterMax) -> default_value(100), "number of samples of analyze.out -m")
+			("max-samples,s", po::value<Int_t>(&maxSamples) -> default_value(100), "maximum number of samples of gsample.out -m")
+			("repeat,r", po::value<Int_t>(&repeat) -> default_value(3), "passes over the events per measurement (the best one is kept)")
+			("read-ahead,R", po::value<Int_t>(&readAhead) -> default_value(4), "number of event blocks decoded ahead on a separate thread\n0 means synchronous reading")
+			("seed", po::value<UInt_t>(&seed) -> default_value(4357), "seed of the random number generators, the same for every pass")
+		;
+		
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+		po::notify(vm);
+		
+		if(vm.count("help") > 0) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_SUCCESS); // ugly
+		}
+		if(vm.count("input") == 0 || vm.count("tree") == 0 || (vm.count("histograms") == 0 && vm.count("cumulatives") == 0)) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+	}
+	catch(std::exception & e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		std::exit(EXIT_FAILURE); // ugly
+	}
+	catch(...) {
+		std::cerr << "exception of unkown type" << std::endl;
+	}
+	
+	if(requiredJets < 0 || requiredBtags < 0 || requiredBtags > requiredJets || requiredJets > maxNumberOfHJets + maxNumberOfAJets) {
+		std::cerr << "incorrect number of jets/btags" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if(repeat < 1) {
+		std::cerr << "the number of passes must be positive" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	
+	/*********** read the events ****/
+	
+	TFile * in = 0;
+	TTree * t = 0; // not needed if the input is a skim
+	if(! SkimCache::isSkim(inFilename)) {
+		in = TFile::Open(inFilename.c_str(), "read");
+		if(in -> IsZombie() || ! in -> IsOpen()) {
+			std::cerr << "Cannot open " << inFilename << "." << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		t = dynamic_cast<TTree *> (in -> Get(treeName.c_str()));
+	}
+	StoredEvent event;
+	EventReader reader(t, inFilename, 0, nEvents, readAhead);
+	reader.setBranchAddress("nhJets", &event.nhJets);
+	reader.setBranchAddress("hJet_pt", &event.hJet_pt);
+	reader.setBranchAddress("hJet_eta", &event.hJet_eta);
+	reader.setBranchAddress("hJet_flavour", &event.hJet_flavour);
+	reader.setBranchAddress("hJet_csv", &event.hJet_csv);
+	reader.setBranchAddress("naJets", &event.naJets);
+	reader.setBranchAddress("aJet_pt", &event.aJet_pt);
+	reader.setBranchAddress("aJet_eta", &event.aJet_eta);
+	reader.setBranchAddress("aJet_flavour", &event.aJet_flavour);
+	reader.setBranchAddress("aJet_csv", &event.aJet_csv);
+	std::vector<StoredEvent> events;
+	while(reader.next()) events.push_back(event);
+	std::cout << "Events:\t\t" << events.size() << " (read in " << reader.getReadTime() << " s)" << std::endl;
+	
+	/*********** the tables of the kernels ****/
+	
+	std::map<TString, TH1F *> histograms, cumulatives;
+	if(! hinput.empty()) histograms = readHistograms(hinput);
+	if(! cinput.empty()) cumulatives = readHistograms(cinput);
+	
+	AnalyzeSetup analyzeSetup;
+	analyzeSetup.requiredJets = requiredJets;
+	analyzeSetup.requiredBtags = requiredBtags;
+	analyzeSetup.nIterMax = nIterMax;
+	analyzeSetup.workingPoint = workingPoint;
+	analyzeSetup.histograms.assign(3 * 6 * 3, 0);
+	analyzeSetup.probabilities.assign(3 * 6 * 3, 0);
+	SampleSetup sampleSetup;
+	sampleSetup.workingPoint = workingPoint;
+	sampleSetup.maxSamples = maxSamples;
+	sampleSetup.cumulatives.assign(3 * 6 * 3, 0);
+	sampleSetup.histograms.assign(3 * 6 * 3, 0);
+	LegacyTables legacy;
+	legacy.histograms = histograms;
+	legacy.cumulatives = cumulatives;
+	legacy.requiredJets = requiredJets;
+	legacy.requiredBtags = requiredBtags;
+	legacy.nIterMax = nIterMax;
+	legacy.maxSamples = maxSamples;
+	legacy.workingPoint = workingPoint;
+	for(int i = 0; i < 3; ++i) {
+		for(int j = 0; j < 6; ++j) {
+			for(int k = 0; k < 3; ++k) {
+				TString name = getName(i, j, k).c_str();
+				int binId = (i * 6 + j) * 3 + k; // see getBinId()
+				if(histograms.count(name)) {
+					analyzeSetup.histograms[binId] = histograms[name];
+					sampleSetup.histograms[binId] = histograms[name];
+				}
+				if(cumulatives.count(name)) {
+					// the same interpolation as analyze.cpp
+					TH1F * h = cumulatives[name];
+					Int_t bin = h -> FindBin(workingPoint);
+					Float_t x1 = h -> GetBinLowEdge(bin), y1 = h -> GetBinContent(bin - 1);
+					Float_t x2 = h -> GetBinLowEdge(bin + 1), y2 = h -> GetBinContent(bin);
+					analyzeSetup.probabilities[binId] = 1.0 - (y1 + (y2 - y1) * (workingPoint - x1) / (x2 - x1));
+					legacy.probabilities[name] = analyzeSetup.probabilities[binId];
+					sampleSetup.cumulatives[binId] = h;
+				}
+			}
+		}
+	}
+	
+	// the speedups of the compiled version against the old loop and against the runtime flags
+	auto printRow = [] (std::string modes, Double_t legacy, Double_t runtime, Double_t policy, bool same) -> void {
+		std::cout << std::left << std::setw(28) << modes << std::right << std::fixed << std::setprecision(4)
+				  << std::setw(12) << legacy << std::setw(12) << runtime << std::setw(12) << policy
+				  << std::setprecision(2) << std::setw(10) << legacy / policy << std::setw(10) << runtime / policy
+				  << (same ? "" : "   (outputs differ!)") << std::endl;
+		std::cout.unsetf(std::ios::fixed);
+	};
+	auto printHeader = [] (std::string kernel) -> void {
+		std::cout << std::endl << kernel << std::endl;
+		std::cout << std::left << std::setw(28) << "modes" << std::right << std::setw(12) << "legacy [s]" << std::setw(12) << "runtime [s]"
+				  << std::setw(12) << "policy [s]" << std::setw(10) << "vs legacy" << std::setw(10) << "vs runtime" << std::endl;
+	};
+	
+	/*********** analyze.cpp ****/
+	
+	if(! histograms.empty() || ! cumulatives.empty()) printHeader("analyze.cpp");
+	for(int combination = 0; combination < 32; ++combination) {
+		RuntimeAnalyzeModes modes = {
+			(combination & 1) != 0, (combination & 2) != 0, (combination & 4) != 0, (combination & 8) != 0, (combination & 16) != 0
+		};
+		if(! (modes.once || modes.multiple || modes.analytic)) continue; // rejected by analyze.cpp
+		if((modes.once || modes.multiple) && histograms.empty()) continue;
+		if(modes.analytic && cumulatives.empty()) continue;
+		
+		// the sum of the outputs, to check that both versions agree
+		Float_t csvGen[maxNumberOfHJets + maxNumberOfAJets];
+		auto pass = [&] (std::function<bool(StoredEvent &, AnalyzeEvent &)> kernel) -> Double_t {
+			gRandom -> SetSeed(seed);
+			Double_t checksum = 0;
+			AnalyzeEvent e;
+			e.hJet_csvGen = csvGen;
+			e.aJet_csvGen = csvGen + maxNumberOfHJets;
+			for(auto & stored: events) {
+				e.nhJets = stored.nhJets;
+				e.naJets = stored.naJets;
+				e.hJet_pt = stored.hJet_pt;
+				e.hJet_eta = stored.hJet_eta;
+				e.hJet_flavour = stored.hJet_flavour;
+				e.hJet_csv = stored.hJet_csv;
+				e.aJet_pt = stored.aJet_pt;
+				e.aJet_eta = stored.aJet_eta;
+				e.aJet_flavour = stored.aJet_flavour;
+				e.aJet_csv = stored.aJet_csv;
+				Arena::local().reset();
+				if(! kernel(stored, e)) continue;
+				if(modes.multiple) checksum += e.mProb;
+				if(modes.analytic) checksum += e.aProb;
+				if(modes.once) checksum += e.count;
+				if(modes.real) checksum += e.realCount;
+			}
+			return checksum;
+		};
+		Double_t legacySum = 0, runtimeSum = 0, policySum = 0;
+		Double_t legacyTime = bestTime(repeat, [&] () {
+			legacySum = pass([&] (StoredEvent & stored, AnalyzeEvent & e) { return legacyAnalyze(legacy, stored, e, modes); });
+		});
+		Double_t runtime = bestTime(repeat, [&] () {
+			runtimeSum = pass([&] (StoredEvent &, AnalyzeEvent & e) { return analyzeKernel(analyzeSetup, e, modes); });
+		});
+		AnalyzeKernel kernel = getAnalyzeKernel(modes);
+		Double_t policy = bestTime(repeat, [&] () {
+			policySum = pass([&] (StoredEvent &, AnalyzeEvent & e) { return kernel(analyzeSetup, e); });
+		});
+		std::stringstream name;
+		name << (modes.once ? "-s " : "") << (modes.multiple ? "-m " : "") << (modes.analytic ? "-a " : "")
+			 << (modes.real ? "-r " : "") << (modes.exact ? "-X " : "");
+		printRow(name.str(), legacyTime, runtime, policy, legacySum == policySum && runtimeSum == policySum);
+	}
+	
+	/*********** gsample.cpp ****/
+	
+	printHeader("gsample.cpp");
+	for(int combination = 0; combination < 4; ++combination) {
+		RuntimeSampleModes modes = { (combination & 1) != 0, (combination & 2) != 0 };
+		if(modes.cumul ? cumulatives.empty() : histograms.empty()) continue;
+		
+		Float_t csvGen[maxNumberOfHJets + maxNumberOfAJets];
+		Long64_t csvN[maxNumberOfHJets + maxNumberOfAJets];
+		auto pass = [&] (std::function<void(const SampleSetup &, Int_t, const Float_t *, const Float_t *, const Float_t *, const Int_t *,
+											  Float_t *, Long64_t *, std::mt19937_64 &)> kernel) -> Double_t {
+			gRandom -> SetSeed(seed);
+			std::mt19937_64 gen(seed);
+			Double_t checksum = 0;
+			for(auto & stored: events) {
+				kernel(sampleSetup, stored.nhJets, stored.hJet_pt, stored.hJet_eta, stored.hJet_flavour, 0, csvGen, csvN, gen);
+				kernel(sampleSetup, stored.naJets, stored.aJet_pt, stored.aJet_eta, stored.aJet_flavour, 0,
+					   csvGen + maxNumberOfHJets, csvN + maxNumberOfHJets, gen);
+				for(Int_t j = 0; j < stored.nhJets; ++j) checksum += csvGen[j];
+				for(Int_t j = 0; j < stored.naJets; ++j) checksum += csvGen[maxNumberOfHJets + j];
+			}
+			return checksum;
+		};
+		Double_t legacySum = 0, runtimeSum = 0, policySum = 0;
+		Double_t legacyTime = bestTime(repeat, [&] () {
+			legacySum = pass([&] (const SampleSetup &, Int_t nJets, const Float_t * pt, const Float_t * eta, const Float_t * flavour, const Int_t *,
+								  Float_t * gen_csv, Long64_t * gen_n, std::mt19937_64 & gen) {
+				legacySample(legacy, nJets, pt, eta, flavour, gen_csv, gen_n, gen, modes);
+			});
+		});
+		Double_t runtime = bestTime(repeat, [&] () {
+			runtimeSum = pass([&] (const SampleSetup & s, Int_t nJets, const Float_t * pt, const Float_t * eta, const Float_t * flavour, const Int_t * binIds,
+								   Float_t * gen_csv, Long64_t * gen_n, std::mt19937_64 & gen) {
+				sampleKernel(s, nJets, pt, eta, flavour, binIds, gen_csv, gen_n, gen, modes);
+			});
+		});
+		SampleKernel kernel = getSampleKernel(modes);
+		Double_t policy = bestTime(repeat, [&] () { policySum = pass(kernel); });
+		std::stringstream name;
+		name << (modes.cumul ? "-c " : "-k ") << (modes.aLot ? "-m " : "");
+		printRow(name.str(), legacyTime, runtime, policy, legacySum == policySum && runtimeSum == policySum);
+	}
+	
+	if(in) in -> Close();
+	
+	return EXIT_SUCCESS;
+}
+catch(std::runtime_error & e) { // EventReader and SkimCache throw, for the daemon
+	std::cerr << e.what() << std::endl;
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,399 @@
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <fstream> // std::ifstream, std::ofstream
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <map> // std::map<>
+#include <algorithm> // std::sort(), std::min()
+#include <thread> // std::thread::hardware_concurrency()
+#include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS
+#include <cstdio> // std::remove()
+#include <cmath> // std::llround()
+
+#include <RVersion.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TParameter.h>
+#include <TFileMerger.h>
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+#include <TROOT.h>
+#else
+#include <TThread.h>
+#endif
+
+#include "ThreadPool.hpp"
+#include "KahanSum.hpp"
+
+namespace {
+	struct Range {
+		std::string name;
+		Long64_t begin;
+		Long64_t end;
+	};
+	
+	/**
+	 * @brief Sorts the ranges and checks that they are contiguous and cover [beginEvent, endEvent).
+	 * @note beginEvent/endEvent equal to -1 are not checked.
+	 */
+	bool checkRanges(std::vector<Range> & ranges, Long64_t beginEvent, Long64_t endEvent) {
+		if(ranges.empty()) return true;
+		std::sort(ranges.begin(), ranges.end(), [] (const Range & a, const Range & b) -> bool {
+			return a.begin < b.begin || (a.begin == b.begin && a.end < b.end);
+		});
+		bool ok = true;
+		for(std::size_t i = 1; i < ranges.size(); ++i) {
+			const Range & prev = ranges[i - 1], & curr = ranges[i];
+			if(curr.begin < prev.end) {
+				std::cerr << "overlap: " << prev.name << " [" << prev.begin << "," << prev.end << ") and "
+						  << curr.name << " [" << curr.begin << "," << curr.end << ")" << std::endl;
+				ok = false;
+			}
+			else if(curr.begin > prev.end) {
+				std::cerr << "missing events [" << prev.end << "," << curr.begin << ") between "
+						  << prev.name << " and " << curr.name << std::endl;
+				ok = false;
+			}
+		}
+		if(beginEvent >= 0 && ranges.front().begin != beginEvent) {
+			std::cerr << "the first event is " << ranges.front().begin << ", expected " << beginEvent << std::endl;
+			ok = false;
+		}
+		if(endEvent >= 0 && ranges.back().end != endEvent) {
+			std::cerr << "the last event is " << (ranges.back().end - 1) << ", expected " << (endEvent - 1) << std::endl;
+			ok = false;
+		}
+		return ok;
+	}
+	
+	/**
+	 * @brief Reads the range written by writeEventRange() (see common.hpp) and the number of entries of the tree.
+	 * @return false if the file or the range is missing
+	 */
+	bool readRange(std::string filename, std::string treeName, Range & range, Long64_t & nEntries) {
+		TFile * f = TFile::Open(filename.c_str(), "read");
+		if(! f || f -> IsZombie() || ! f -> IsOpen()) {
+			std::cerr << "error on opening " << filename << std::endl;
+			return false;
+		}
+		TParameter<Long64_t> * b = dynamic_cast<TParameter<Long64_t> *> (f -> Get("beginEvent"));
+		TParameter<Long64_t> * e = dynamic_cast<TParameter<Long64_t> *> (f -> Get("endEvent"));
+		nEntries = -1;
+		if(! treeName.empty()) {
+			TTree * t = dynamic_cast<TTree *> (f -> Get(treeName.c_str()));
+			if(t) nEntries = t -> GetEntries();
+		}
+		bool found = b && e;
+		if(found) {
+			range.name = filename;
+			range.begin = b -> GetVal();
+			range.end = e -> GetVal();
+		}
+		else {
+			std::cerr << "no event range in " << filename << " (use --no-check)" << std::endl;
+		}
+		f -> Close();
+		delete f;
+		return found;
+	}
+	
+	bool mergeFiles(const std::vector<std::string> & inputs, std::string output) {
+		TFileMerger merger(kFALSE);
+		if(! merger.OutputFile(output.c_str(), "recreate")) return false;
+		for(auto & input: inputs) {
+			if(! merger.AddFile(input.c_str(), kFALSE)) return false;
+		}
+		return merger.Merge();
+	}
+	
+	/**
+	 * @brief Accumulators of a text output: "<label>:<whitespace><number>" lines are summed
+	 *        (e.g. btagcounter.cpp), "EVENT <i>:..." lines are collected (e.g. normcheck.cpp).
+	 */
+	struct TextSummary {
+		std::vector<std::string> labels; // including the colon and the whitespace
+		std::vector<KahanSum> sums;
+		std::vector<bool> integral;
+		std::map<Long64_t, std::string> events;
+		std::vector<std::string> rangeLabels; // "begin event:" and "end event:" of btagcounter.cpp
+		bool hasRange;
+		Range range;
+		std::vector<std::string> errors;
+	};
+	
+	bool parseText(std::string filename, TextSummary & summary) {
+		std::ifstream in(filename.c_str());
+		if(! in.good()) {
+			std::cerr << "error on opening " << filename << std::endl;
+			return false;
+		}
+		summary.hasRange = false;
+		summary.range.name = filename;
+		Long64_t beginEvent = -1, endEvent = -1;
+		std::string line;
+		while(std::getline(in, line)) {
+			std::size_t colon = line.find(':');
+			if(colon == std::string::npos) continue;
+			std::size_t valuePos = line.find_first_not_of(" \t", colon + 1);
+			std::string label = line.substr(0, colon);
+			std::string prefix = line.substr(0, valuePos == std::string::npos ? line.size() : valuePos);
+			std::string value = valuePos == std::string::npos ? "" : line.substr(valuePos);
+			boost::algorithm::trim(value);
+			try {
+				if(boost::algorithm::starts_with(label, "EVENT ")) {
+					Long64_t event = std::stoll(label.substr(6));
+					if(! summary.events.insert(std::make_pair(event, line)).second) {
+						summary.errors.push_back("event " + std::to_string(event) + " appears twice in " + filename);
+					}
+				}
+				else if(label == "begin event") {
+					beginEvent = std::stoll(value);
+					summary.rangeLabels.push_back(prefix);
+				}
+				else if(label == "end event") {
+					endEvent = std::stoll(value);
+					summary.rangeLabels.push_back(prefix);
+				}
+				else {
+					summary.labels.push_back(prefix);
+					summary.sums.push_back(KahanSum(std::stod(value)));
+					summary.integral.push_back(value.find_first_of(".eE") == std::string::npos);
+				}
+			}
+			catch(std::exception & e) {
+				std::cerr << "cannot parse '" << line << "' in " << filename << std::endl;
+				return false;
+			}
+		}
+		if(beginEvent >= 0 && endEvent >= 0) {
+			summary.hasRange = true;
+			summary.range.begin = beginEvent;
+			summary.range.end = endEvent;
+		}
+		else if(! summary.events.empty()) {
+			summary.hasRange = true;
+			summary.range.begin = summary.events.begin() -> first;
+			summary.range.end = summary.events.rbegin() -> first + 1;
+			if(Long64_t(summary.events.size()) != summary.range.end - summary.range.begin) {
+				summary.errors.push_back("missing events in " + filename);
+			}
+		}
+		return true;
+	}
+	
+	// a += b
+	void addText(TextSummary & a, const TextSummary & b) {
+		if(a.labels != b.labels) {
+			a.errors.push_back("the lines of " + a.range.name + " and " + b.range.name + " differ");
+			return;
+		}
+		for(std::size_t i = 0; i < a.sums.size(); ++i) {
+			a.sums[i] += b.sums[i];
+			a.integral[i] = a.integral[i] && b.integral[i];
+		}
+		for(auto & kv: b.events) {
+			if(! a.events.insert(kv).second) {
+				a.errors.push_back("event " + std::to_string(kv.first) + " appears more than once");
+			}
+		}
+		a.errors.insert(a.errors.end(), b.errors.begin(), b.errors.end());
+		if(a.hasRange && b.hasRange) {
+			a.range.begin = std::min(a.range.begin, b.range.begin);
+			a.range.end = std::max(a.range.end, b.range.end);
+		}
+		else if(b.hasRange) {
+			a.hasRange = true;
+			a.range = b.range;
+		}
+	}
+}
+
+int main(int argc, char ** argv) {
+	
+	namespace po = boost::program_options;
+	
+	// command line option parsing
+	std::vector<std::string> inputs;
+	std::string output, friendTree;
+	Long64_t beginEvent, endEvent;
+	unsigned nThreads;
+	Int_t fanIn;
+	bool enableVerbose = false, checkRange = true;
+	try {
+		po::options_description desc("allowed options");
+		desc.add_options()
+			("help,h", "prints this message")
+			("input,i", po::value<std::vector<std::string> >(&inputs) -> multitoken(), "outputs of the split jobs\n*.root files of process.cpp, analyze.cpp, gsample.cpp\nor text files of btagcounter.cpp, normcheck.cpp")
+			("output,o", po::value<std::string>(&output), "merged output file")
+			("threads,j", po::value<unsigned>(&nThreads) -> default_value(std::thread::hardware_concurrency()), "number of threads")
+			("fan-in,f", po::value<Int_t>(&fanIn) -> default_value(8), "number of files merged at once in each step of the reduction")
+			("begin,b", po::value<Long64_t>(&beginEvent) -> default_value(-1), "expected first event\ndefault (-1) means not checked")
+			("end,e", po::value<Long64_t>(&endEvent) -> default_value(-1), "expected end event\ndefault (-1) means not checked")
+			("friend,F", po::value<std::string>(&friendTree), "name of the output tree which must have one entry per event\n(e.g. gsample.cpp), so that the merged tree can be a friend of the input tree")
+			("no-check", "don't check the event ranges")
+			("verbose,v", "verbose mode")
+		;
+		po::positional_options_description positional;
+		positional.add("input", -1);
+		
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+		po::notify(vm);
+		
+		if(vm.count("help")) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_SUCCESS); // ugly
+		}
+		if(inputs.empty() || vm.count("output") == 0) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(vm.count("no-check")) {
+			checkRange = false;
+		}
+		if(vm.count("verbose")) {
+			enableVerbose = true;
+		}
+	}
+	catch(std::exception & e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		std::exit(EXIT_FAILURE); // ugly
+	}
+	catch(...) {
+		std::cerr << "exception of unkown type" << std::endl;
+	}
+	
+	if(fanIn < 2) fanIn = 2;
+	bool isRoot = true;
+	for(auto & input: inputs) {
+		isRoot = isRoot && boost::algorithm::ends_with(input, ".root");
+	}
+	ThreadPool pool(nThreads);
+	
+	/*********** text outputs ***********************************/
+	
+	if(! isRoot) {
+		if(enableVerbose) std::cout << "Reading " << inputs.size() << " text files ..." << std::endl;
+		std::vector<TextSummary> summaries(inputs.size());
+		std::vector<char> parsed(inputs.size(), 0);
+		for(std::size_t i = 0; i < inputs.size(); ++i) {
+			pool.submit([&inputs, &summaries, &parsed, i] () -> void {
+				parsed[i] = parseText(inputs[i], summaries[i]);
+			});
+		}
+		pool.wait();
+		if(std::find(parsed.begin(), parsed.end(), 0) != parsed.end()) std::exit(EXIT_FAILURE);
+		
+		if(checkRange) {
+			std::vector<Range> ranges;
+			for(auto & s: summaries) {
+				if(! s.hasRange) {
+					std::cerr << "no event range in " << s.range.name << " (use --no-check)" << std::endl;
+					std::exit(EXIT_FAILURE);
+				}
+				ranges.push_back(s.range);
+			}
+			if(! checkRanges(ranges, beginEvent, endEvent)) std::exit(EXIT_FAILURE);
+		}
+		
+		// pairwise reduction, the partial sums of each level are added in parallel
+		for(std::size_t stride = 1; stride < summaries.size(); stride *= 2) {
+			for(std::size_t i = 0; i + stride < summaries.size(); i += 2 * stride) {
+				pool.submit([&summaries, i, stride] () -> void {
+					addText(summaries[i], summaries[i + stride]);
+				});
+			}
+			pool.wait();
+		}
+		const TextSummary & total = summaries[0];
+		if(! total.errors.empty()) {
+			for(auto & error: total.errors) std::cerr << error << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		
+		std::ofstream out(output.c_str());
+		if(! out.good()) {
+			std::cerr << "cannot create " << output << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		for(std::size_t i = 0; i < total.labels.size(); ++i) {
+			out << total.labels[i];
+			if(total.integral[i])	out << std::llround(total.sums[i].getValue()) << std::endl;
+			else					out << std::fixed << total.sums[i].getValue() << std::endl;
+		}
+		if(total.rangeLabels.size() == 2 && total.hasRange) {
+			out << total.rangeLabels[0] << total.range.begin << std::endl;
+			out << total.rangeLabels[1] << total.range.end << std::endl;
+		}
+		for(auto & kv: total.events) {
+			out << kv.second << std::endl;
+		}
+		if(enableVerbose) std::cout << "Wrote " << output << std::endl;
+		return EXIT_SUCCESS;
+	}
+	
+	/*********** ROOT outputs ***********************************/
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+	ROOT::EnableThreadSafety();
+#else
+	TThread::Initialize();
+#endif
+	
+	if(checkRange || ! friendTree.empty()) {
+		if(enableVerbose) std::cout << "Checking the event ranges of " << inputs.size() << " files ..." << std::endl;
+		std::vector<Range> ranges;
+		bool ok = true;
+		for(auto & input: inputs) {
+			Range range;
+			Long64_t nEntries;
+			if(! readRange(input, friendTree, range, nEntries)) std::exit(EXIT_FAILURE);
+			if(! friendTree.empty() && nEntries != range.end - range.begin) {
+				std::cerr << input << ": tree " << friendTree << " has " << nEntries << " entries, expected "
+						  << (range.end - range.begin) << std::endl;
+				ok = false;
+			}
+			ranges.push_back(range);
+		}
+		if(! checkRanges(ranges, beginEvent, endEvent) || ! ok) std::exit(EXIT_FAILURE);
+		
+		// the trees are concatenated in the order of the events
+		for(std::size_t i = 0; i < ranges.size(); ++i) inputs[i] = ranges[i].name;
+	}
+	
+	// reduction tree: groups of fanIn files are merged in parallel until fanIn files are left
+	std::vector<std::string> level = inputs;
+	std::vector<std::string> temporary;
+	for(Int_t depth = 0; level.size() > std::size_t(fanIn); ++depth) {
+		std::size_t nGroups = (level.size() + fanIn - 1) / fanIn;
+		if(enableVerbose) std::cout << "Merging " << level.size() << " files into " << nGroups << " ..." << std::endl;
+		std::vector<std::string> next(nGroups);
+		std::vector<char> merged(nGroups, 0);
+		for(std::size_t g = 0; g < nGroups; ++g) {
+			next[g] = output + ".part" + std::to_string(depth) + "_" + std::to_string(g) + ".root";
+			std::vector<std::string> group(level.begin() + g * fanIn, level.begin() + std::min(level.size(), (g + 1) * fanIn));
+			pool.submit([group, &next, &merged, g] () -> void {
+				merged[g] = mergeFiles(group, next[g]);
+			});
+		}
+		pool.wait();
+		for(auto & f: temporary) std::remove(f.c_str());
+		temporary = next;
+		if(std::find(merged.begin(), merged.end(), 0) != merged.end()) {
+			std::cerr << "error on merging" << std::endl;
+			for(auto & f: temporary) std::remove(f.c_str());
+			std::exit(EXIT_FAILURE);
+		}
+		level = next;
+	}
+	if(enableVerbose) std::cout << "Merging " << level.size() << " files into " << output << " ..." << std::endl;
+	bool merged = mergeFiles(level, output);
+	for(auto & f: temporary) std::remove(f.c_str());
+	if(! merged) {
+		std::cerr << "error on merging into " << output << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	
+	return EXIT_SUCCESS;
+}
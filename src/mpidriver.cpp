@@ -0,0 +1,422 @@
+#include <boost/program_options.hpp>
+
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <fstream> // std::ofstream
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <deque> // std::deque<>
+#include <map> // std::map<>
+#include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS
+#include <cstdio> // std::remove()
+#include <cmath> // std::sqrt()
+
+#include <sys/stat.h> // mkdir()
+
+#include <mpi.h>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TChain.h>
+#include <TH1.h>
+#include <TKey.h>
+
+#include "common.hpp"
+#include "ClusterPlan.hpp"
+#include "ChunkCommand.hpp"
+#include "SkimCache.hpp"
+#include "KahanSum.hpp"
+
+namespace {
+	const int tagResult = 1; // worker -> master: {chunk, succeeded}, chunk = -1 on the first request
+	const int tagChunk = 2; // master -> worker: chunk, -1 means stop
+	
+	// the sums printed by analyze.cpp
+	struct Summary {
+		KahanSum aProb;
+		KahanSum mProb;
+		Long64_t nEvents;
+		Long64_t bCounter;
+		Long64_t realBcounter;
+		Int_t hasAProb, hasMProb, hasCount, hasRealCount;
+	};
+	
+	void fail(std::string message) {
+		std::cerr << message << std::endl;
+		MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+	}
+	
+	/**
+	 * @brief Adds the histograms and the sums of the output tree of a finished chunk.
+	 */
+	void accumulate(std::string filename, std::string treeName, Int_t nBtags,
+					std::map<std::string, TH1 *> & histograms, Summary & summary) {
+		TFile * f = TFile::Open(filename.c_str(), "read");
+		if(! f || f -> IsZombie() || ! f -> IsOpen()) fail("error on opening " + filename);
+		TKey * key;
+		TIter next(f -> GetListOfKeys());
+		while((key = dynamic_cast<TKey *>(next()))) {
+			TH1 * h = dynamic_cast<TH1 *> (key -> ReadObj());
+			if(! h) continue;
+			auto it = histograms.find(h -> GetName());
+			if(it == histograms.end()) {
+				h -> SetDirectory(0);
+				histograms[h -> GetName()] = h;
+			}
+			else {
+				it -> second -> Add(h);
+				delete h;
+			}
+		}
+		TTree * t = treeName.empty() ? 0 : dynamic_cast<TTree *> (f -> Get(treeName.c_str()));
+		if(t) {
+			Float_t btag_aProb = 0, btag_mProb = 0;
+			Int_t btag_count = 0, btag_real_count = 0;
+			t -> SetBranchStatus("*", 0);
+			if(t -> GetBranch("btag_aProb")) {
+				t -> SetBranchStatus("btag_aProb", 1);
+				t -> SetBranchAddress("btag_aProb", &btag_aProb);
+				summary.hasAProb = 1;
+			}
+			if(t -> GetBranch("btag_mProb")) {
+				t -> SetBranchStatus("btag_mProb", 1);
+				t -> SetBranchAddress("btag_mProb", &btag_mProb);
+				summary.hasMProb = 1;
+			}
+			if(t -> GetBranch("btag_count")) {
+				t -> SetBranchStatus("btag_count", 1);
+				t -> SetBranchAddress("btag_count", &btag_count);
+				summary.hasCount = 1;
+			}
+			if(t -> GetBranch("btag_real_count")) {
+				t -> SetBranchStatus("btag_real_count", 1);
+				t -> SetBranchAddress("btag_real_count", &btag_real_count);
+				summary.hasRealCount = 1;
+			}
+			for(Long64_t i = 0; i < t -> GetEntries(); ++i) {
+				t -> GetEntry(i);
+				summary.aProb += btag_aProb;
+				summary.mProb += btag_mProb;
+				if(btag_count == nBtags) ++summary.bCounter;
+				if(btag_real_count == nBtags) ++summary.realBcounter;
+			}
+			summary.nEvents += t -> GetEntries();
+		}
+		f -> Close();
+		delete f;
+	}
+}
+
+int main(int argc, char ** argv) {
+	
+	MPI_Init(&argc, &argv);
+	int rank, nRanks;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+	
+	namespace po = boost::program_options;
+	
+	// command line option parsing
+	std::string input, treeName, output, planFile, workDir, outTreeName, summaryFile;
+	Long64_t beginEvent, endEvent;
+	Int_t nChunks, maxRetries, nBtags;
+	std::vector<std::string> command;
+	bool enableVerbose = false, keepPartial = false;
+	try {
+		po::options_description desc("allowed options");
+		desc.add_options()
+			("help,h", "prints this message")
+			("input,i", po::value<std::string>(&input), "input *.root file (or skim) used for planning")
+			("tree,t", po::value<std::string>(&treeName), "name of the tree")
+			("begin,b", po::value<Long64_t>(&beginEvent) -> default_value(0), "the event number to start with")
+			("end,e", po::value<Long64_t>(&endEvent) -> default_value(-1), "the event number to end with\ndefault (-1) means all events")
+			("plan,p", po::value<std::string>(&planFile), "chunks written by planner.out\nif not set, the chunks are planned here")
+			("chunks,n", po::value<Int_t>(&nChunks) -> default_value(-1), "number of chunks\ndefault (-1) means 8 chunks per worker rank")
+			("retries,r", po::value<Int_t>(&maxRetries) -> default_value(2), "number of retries of a failed chunk")
+			("output,o", po::value<std::string>(&output), "merged output *.root file")
+			("out-tree,T", po::value<std::string>(&outTreeName), "name of the output tree of the command\n(concatenated and summed over; if not set, only the histograms are reduced)")
+			("nBtags,N", po::value<Int_t>(&nBtags) -> default_value(2), "number of b-tags counted in btag_count and btag_real_count")
+			("summary,s", po::value<std::string>(&summaryFile), "file of the summed probabilities and counts\n(in the format of btagcounter.cpp)")
+			("work-dir,w", po::value<std::string>(&workDir) -> default_value("mpidriver"), "directory of the partial outputs and logs\n(must be shared by the ranks)")
+			("keep,k", "keep the partial outputs")
+			("command", po::value<std::vector<std::string> >(&command), "the command run for each chunk, e.g.\n-- bin/analyze.out ... -b {begin} -e {end} -o {output}\n({chunk} is replaced by the chunk number)")
+			("verbose,v", "verbose mode")
+		;
+		po::positional_options_description positional;
+		positional.add("command", -1);
+		
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+		po::notify(vm);
+		
+		if(vm.count("help")) {
+			if(rank == 0) std::cout << desc << std::endl;
+			MPI_Finalize();
+			std::exit(EXIT_SUCCESS); // ugly
+		}
+		if(command.empty() || vm.count("output") == 0 || (vm.count("plan") == 0 && vm.count("input") == 0)) {
+			if(rank == 0) std::cout << desc << std::endl;
+			MPI_Finalize();
+			std::exit(EXIT_FAILURE);
+		}
+		if(vm.count("keep")) {
+			keepPartial = true;
+		}
+		if(vm.count("verbose")) {
+			enableVerbose = rank == 0;
+		}
+	}
+	catch(std::exception & e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+	}
+	catch(...) {
+		std::cerr << "exception of unkown type" << std::endl;
+	}
+	
+	const int nWorkers = nRanks > 1 ? nRanks - 1 : 1; // rank 0 only hands out the chunks, unless it is alone
+	if(nChunks < 0) nChunks = 8 * nWorkers;
+	TH1::AddDirectory(kFALSE);
+	Double_t t0 = MPI_Wtime();
+	
+	/*********** plan the chunks (rank 0) ***********************/
+	
+	std::vector<Long64_t> bounds; // begin and end of each chunk
+	if(rank == 0) {
+		std::vector<ClusterPlan::Chunk> chunks;
+		if(! planFile.empty()) {
+			chunks = ClusterPlan(planFile).getChunks();
+		}
+		else {
+			TFile * in = 0;
+			TTree * t = 0;
+			if(! SkimCache::isSkim(input)) {
+				in = TFile::Open(input.c_str(), "read");
+				if(! in || in -> IsZombie() || ! in -> IsOpen()) fail("error on opening " + input);
+				t = dynamic_cast<TTree *> (in -> Get(treeName.c_str()));
+				if(! t) fail("error on accessing tree " + treeName);
+			}
+			ClusterPlan plan;
+			plan.findClusters(t, input, beginEvent, endEvent);
+			plan.estimateCost(t, input, 100, 1.0, 1.0);
+			plan.split(nChunks);
+			chunks = plan.getChunks();
+			if(in) in -> Close();
+		}
+		if(chunks.empty()) fail("nothing to do");
+		for(auto & c: chunks) {
+			bounds.push_back(c.begin);
+			bounds.push_back(c.end);
+		}
+		mkdir(workDir.c_str(), 0755);
+		if(enableVerbose) std::cout << "Running " << chunks.size() << " chunks on " << nWorkers << " worker rank(s) ..." << std::endl;
+	}
+	int nBounds = bounds.size();
+	MPI_Bcast(&nBounds, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	bounds.resize(nBounds);
+	MPI_Bcast(bounds.data(), nBounds, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+	const int nTotal = nBounds / 2;
+	
+	auto partialName = [&workDir] (int index) -> std::string {
+		return workDir + "/chunk_" + std::to_string(index) + ".root";
+	};
+	auto logName = [&workDir] (int index) -> std::string {
+		return workDir + "/chunk_" + std::to_string(index) + ".log";
+	};
+	
+	/*********** run the chunks *********************************/
+	
+	ChunkCommand chunkCommand(command);
+	std::map<std::string, TH1 *> histograms;
+	Summary summary = { KahanSum(), KahanSum(), 0, 0, 0, 0, 0, 0, 0 };
+	auto runChunk = [&] (int index) -> bool {
+		bool ok = chunkCommand.run(index, bounds[2 * index], bounds[2 * index + 1], partialName(index), logName(index));
+		if(ok) accumulate(partialName(index), outTreeName, nBtags, histograms, summary);
+		return ok;
+	};
+	
+	int nFailed = 0;
+	if(nRanks == 1) {
+		for(int i = 0; i < nTotal; ++i) {
+			bool ok = false;
+			for(int attempt = 0; attempt <= maxRetries && ! ok; ++attempt) ok = runChunk(i);
+			if(! ok) {
+				std::cerr << "chunk " << i << " failed " << (maxRetries + 1) << " times, giving up" << std::endl;
+				++nFailed;
+			}
+			else if(enableVerbose) std::cout << "[" << (i + 1) << "/" << nTotal << "] chunk " << i << " done" << std::endl;
+		}
+	}
+	else if(rank == 0) {
+		// dynamic distribution: a chunk is sent to whichever rank reports first
+		std::deque<int> queue;
+		for(int i = 0; i < nTotal; ++i) queue.push_back(i);
+		std::vector<Int_t> attempts(nTotal, 0);
+		std::vector<int> idle;
+		int inFlight = 0, nStopped = 0, nDone = 0;
+		while(nStopped < nRanks - 1) {
+			int message[2];
+			MPI_Status status;
+			MPI_Recv(message, 2, MPI_INT, MPI_ANY_SOURCE, tagResult, MPI_COMM_WORLD, &status);
+			if(message[0] >= 0) {
+				--inFlight;
+				int index = message[0];
+				if(message[1]) {
+					++nDone;
+					if(enableVerbose) std::cout << "[" << nDone << "/" << nTotal << "] chunk " << index << " done on rank " << status.MPI_SOURCE << std::endl;
+				}
+				else if(attempts[index] < maxRetries) {
+					++attempts[index];
+					std::cerr << "chunk " << index << " failed (see " << logName(index) << "), retrying" << std::endl;
+					queue.push_back(index);
+				}
+				else {
+					std::cerr << "chunk " << index << " failed " << (attempts[index] + 1) << " times, giving up" << std::endl;
+					++nFailed;
+				}
+			}
+			idle.push_back(status.MPI_SOURCE);
+			while(! idle.empty() && ! queue.empty()) {
+				int index = queue.front();
+				queue.pop_front();
+				MPI_Send(&index, 1, MPI_INT, idle.back(), tagChunk, MPI_COMM_WORLD);
+				idle.pop_back();
+				++inFlight;
+			}
+			if(queue.empty() && inFlight == 0) {
+				// nothing can be requeued anymore
+				int stop = -1;
+				for(int worker: idle) MPI_Send(&stop, 1, MPI_INT, worker, tagChunk, MPI_COMM_WORLD);
+				nStopped += idle.size();
+				idle.clear();
+			}
+		}
+	}
+	else {
+		int message[2] = { -1, 0 };
+		while(true) {
+			MPI_Send(message, 2, MPI_INT, 0, tagResult, MPI_COMM_WORLD);
+			int index;
+			MPI_Recv(&index, 1, MPI_INT, 0, tagChunk, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+			if(index < 0) break;
+			message[0] = index;
+			message[1] = runChunk(index) ? 1 : 0;
+		}
+	}
+	MPI_Bcast(&nFailed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if(nFailed > 0) {
+		if(rank == 0) std::cerr << nFailed << " chunk(s) failed, the outputs are not merged" << std::endl;
+		MPI_Finalize();
+		return EXIT_FAILURE;
+	}
+	
+	/*********** reduce the histograms and the sums *************/
+	
+	// the names and binning are taken from the first chunk, missing histograms count as empty
+	std::vector<TH1 *> templates;
+	std::string names;
+	if(rank == 0) {
+		TFile * f = TFile::Open(partialName(0).c_str(), "read");
+		if(! f || f -> IsZombie() || ! f -> IsOpen()) fail("error on opening " + partialName(0));
+		TKey * key;
+		TIter next(f -> GetListOfKeys());
+		while((key = dynamic_cast<TKey *>(next()))) {
+			TH1 * h = dynamic_cast<TH1 *> (key -> ReadObj());
+			if(! h) continue;
+			h -> SetDirectory(0);
+			templates.push_back(h);
+			names += std::string(h -> GetName()) + "\n";
+		}
+		f -> Close();
+	}
+	int namesLength = names.size();
+	MPI_Bcast(&namesLength, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	names.resize(namesLength);
+	MPI_Bcast(&names[0], namesLength, MPI_CHAR, 0, MPI_COMM_WORLD);
+	std::vector<int> nCells(templates.size());
+	for(std::size_t i = 0; i < templates.size(); ++i) nCells[i] = templates[i] -> GetNcells();
+	int nHistograms = nCells.size();
+	MPI_Bcast(&nHistograms, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	nCells.resize(nHistograms);
+	MPI_Bcast(nCells.data(), nHistograms, MPI_INT, 0, MPI_COMM_WORLD);
+	
+	// per histogram: entries, contents and squared errors of all cells including under/overflow
+	std::vector<Double_t> local, reduced;
+	std::size_t start = 0;
+	for(int i = 0; i < nHistograms; ++i) {
+		std::size_t end = names.find('\n', start);
+		std::string name = names.substr(start, end - start);
+		start = end + 1;
+		auto it = histograms.find(name);
+		TH1 * h = it == histograms.end() ? 0 : it -> second;
+		if(h && h -> GetNcells() != nCells[i]) fail("the binning of " + name + " differs between the chunks");
+		local.push_back(h ? h -> GetEntries() : 0);
+		for(int bin = 0; bin < nCells[i]; ++bin) local.push_back(h ? h -> GetBinContent(bin) : 0);
+		for(int bin = 0; bin < nCells[i]; ++bin) local.push_back(h ? h -> GetBinError(bin) * h -> GetBinError(bin) : 0);
+	}
+	if(rank == 0) reduced.resize(local.size());
+	MPI_Reduce(local.data(), reduced.data(), local.size(), MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+	
+	Double_t localSums[2] = { summary.aProb.getValue(), summary.mProb.getValue() }, sums[2];
+	Long64_t localCounts[3] = { summary.nEvents, summary.bCounter, summary.realBcounter }, counts[3];
+	Int_t localFlags[4] = { summary.hasAProb, summary.hasMProb, summary.hasCount, summary.hasRealCount }, flags[4];
+	MPI_Reduce(localSums, sums, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+	MPI_Reduce(localCounts, counts, 3, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+	MPI_Reduce(localFlags, flags, 4, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+	
+	/*********** write the output (rank 0) **********************/
+	
+	if(rank == 0) {
+		if(enableVerbose) std::cout << "Writing " << output << " ..." << std::endl;
+		TFile * out = TFile::Open(output.c_str(), "recreate");
+		if(! out || out -> IsZombie() || ! out -> IsOpen()) fail("cannot create " + output);
+		if(! outTreeName.empty()) {
+			// the partial trees are concatenated in the order of the events
+			TChain chain(outTreeName.c_str());
+			for(int i = 0; i < nTotal; ++i) chain.Add(partialName(i).c_str());
+			chain.Merge(out, 0, "fast keep");
+		}
+		out -> cd();
+		std::size_t offset = 0;
+		for(std::size_t i = 0; i < templates.size(); ++i) {
+			TH1 * h = templates[i];
+			h -> Reset();
+			for(int bin = 0; bin < nCells[i]; ++bin) {
+				h -> SetBinContent(bin, reduced[offset + 1 + bin]);
+				h -> SetBinError(bin, std::sqrt(reduced[offset + 1 + nCells[i] + bin]));
+			}
+			h -> SetEntries(reduced[offset]);
+			h -> Write();
+			offset += 1 + 2 * nCells[i];
+		}
+		writeEventRange(bounds.front(), bounds.back());
+		out -> Close();
+		
+		std::streambuf * buf;
+		std::ofstream of;
+		if(! summaryFile.empty()) {
+			of.open(summaryFile);
+			buf = of.rdbuf();
+		}
+		else {
+			buf = std::cout.rdbuf();
+		}
+		std::ostream summaryOut(buf);
+		if(! outTreeName.empty()) {
+			summaryOut << "number of events that passed the cut:\t" << counts[0] << std::endl;
+			if(flags[2]) summaryOut << "sum of " << nBtags << " b-tagged jets:\t\t\t" << counts[1] << std::endl;
+			if(flags[0]) summaryOut << "sum of analytic probabilities:\t\t" << std::fixed << sums[0] << std::endl;
+			if(flags[1]) summaryOut << "sum of multisample weights:\t\t" << std::fixed << sums[1] << std::endl;
+			if(flags[3]) summaryOut << "number of real b-tags:\t\t\t" << counts[2] << std::endl;
+			summaryOut << "begin event:\t\t\t\t" << bounds.front() << std::endl;
+			summaryOut << "end event:\t\t\t\t" << bounds.back() << std::endl;
+		}
+		
+		if(! keepPartial) {
+			for(int i = 0; i < nTotal; ++i) std::remove(partialName(i).c_str());
+		}
+		if(enableVerbose) std::cout << "Wall time:\t" << (MPI_Wtime() - t0) << " s" << std::endl;
+	}
+	
+	MPI_Finalize();
+	return EXIT_SUCCESS;
+}
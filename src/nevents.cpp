@@ -10,6 +10,8 @@
 #include <TFile.h>
 #include <TTree.h>
 
+#include "MetaCache.hpp"
+
 int main(int argc, char ** argv) {
 	
 	namespace po = boost::program_options;
@@ -17,7 +19,7 @@ int main(int argc, char ** argv) {
 	
 	// command line option parsing
 	std::string cmd_input, cmd_tree, configFile, field;
-	bool hasConfig = false;
+	bool hasConfig = false, useCache = true, listContents = false;
 	std::string fieldHelp = "the field of the config file to be read";
 	fieldHelp.append("\npossible values:\n    H (for histogram)\n    S (for sample)\n");
 	fieldHelp.append("the flag must be given if config file is specified");
@@ -25,10 +27,12 @@ int main(int argc, char ** argv) {
 		po::options_description desc("allowed options");
 		desc.add_options()
 			("help,h", "prints this message")
-			("input,i", po::value<std::string>(&cmd_input), "input *.root file")
+			("input,i", po::value<std::string>(&cmd_input), "input *.root file\nwith a config file, replaces its input")
 			("tree,t", po::value<std::string>(&cmd_tree), "tree name of the input file")
 			("config,c", po::value<std::string>(&configFile), "config file\nif not set, read input flags")
 			("field,f", po::value<std::string>(&field),	fieldHelp.c_str())
+			("list,l", "lists the keys, trees and branches (compressed and uncompressed bytes) instead")
+			("no-cache", "opens the file even if its metadata is cached (see MetaCache)")
 		;
 		
 		po::variables_map vm;
@@ -50,6 +54,12 @@ int main(int argc, char ** argv) {
 		if(vm.count("config")) {
 			hasConfig = true;
 		}
+		if(vm.count("list")) {
+			listContents = true;
+		}
+		if(vm.count("no-cache")) {
+			useCache = false;
+		}
 	}
 	catch(std::exception & e) {
 		std::cerr << "error: " << e.what() << std::endl;
@@ -77,9 +87,24 @@ int main(int argc, char ** argv) {
 		cfg_tree = trim(pt_ini.get<std::string>(key + ".tree"));
 	}
 	
-	std::string input = hasConfig ? cfg_input : cmd_input;
+	std::string input = (hasConfig && cmd_input.empty()) ? cfg_input : cmd_input;
 	std::string tree = hasConfig ? cfg_tree : cmd_tree;
 	
+	if(listContents) {
+		MetaCache cache; // owns the entry
+		const MetaCache::File & file = cache.get(input);
+		for(auto & k: file.keys) std::cout << k.className << "\t" << k.name << ";" << k.cycle << std::endl;
+		for(auto & t: file.trees) {
+			std::cout << t.name << ": " << t.entries << " entries in " << (t.clusters.size() - 1) << " clusters" << std::endl;
+			for(auto & b: t.branches) std::cout << "\t" << b.name << "\t" << b.zipBytes << "\t" << b.totBytes << std::endl;
+		}
+		return EXIT_SUCCESS;
+	}
+	
+	if(useCache) {
+		std::cout << MetaCache().getEntries(input, tree);
+		return EXIT_SUCCESS;
+	}
 	TFile * f = TFile::Open(input.c_str(), "read");
 	if(f -> IsZombie() || ! f -> IsOpen()) {
 		std::cerr << "error on opening " << input << std::endl;
@@ -5,15 +5,20 @@
 
 #include <cstdlib> // std::exit(), EXIT_SUCCESS, EXIT_FAILURE
 #include <string> // std::string
-#include <algorithm> // std::accumulate()
+#include <algorithm> // std::min()
 #include <vector> // std::vector<>
 #include <fstream> // std::ofstream
 #include <iostream> // std::cout
 #include <streambuf> // std::streambuf
+#include <thread> // std::thread::hardware_concurrency()
 
 #include <TFile.h>
 #include <TTree.h>
 
+#include "common.hpp"
+#include "ColumnReader.hpp"
+#include "ThreadPool.hpp"
+
 int main(int argc, char ** argv) {
 	
 	namespace po = boost::program_options;
@@ -21,7 +26,8 @@ int main(int argc, char ** argv) {
 	
 	std::string configFile, output, varName, treeName;
 	bool enableVerbose = false, writeToFile = false;
-	Long64_t beginEvent, endEvent;
+	Long64_t beginEvent, endEvent, blockSize;
+	unsigned nThreads;
 	try {
 		po::options_description desc("allowed options");
 		desc.add_options()
@@ -29,9 +35,11 @@ int main(int argc, char ** argv) {
 			("config,c", po::value<std::string>(&configFile), "read config file")
 			("begin,b", po::value<Long64_t>(&beginEvent) -> default_value(0), "the event number to start with")
 			("end,e", po::value<Long64_t>(&endEvent) -> default_value(-1), "the event number to end with\ndefault (-1) means all events")
-			("output,o", po::value<std::string>(&output), "output file name")
+			("output,o", po::value<std::string>(&output), "output file name\na *.root file gets a tree of the sums instead of the text")
 			("var-name,n", po::value<std::string>(&varName), "name of the probability variable")
 			("tree,t", po::value<std::string>(&treeName), "tree name")
+			("threads,j", po::value<unsigned>(&nThreads) -> default_value(std::thread::hardware_concurrency()), "number of files read in parallel")
+			("block-size", po::value<Long64_t>(&blockSize) -> default_value(100000), "number of events read from every file at once")
 			("verbose,v", "verbose mode (enables progressbar)")
 		;
 		
@@ -67,6 +75,11 @@ int main(int argc, char ** argv) {
 		std::cerr << "incorrect values for begin and/or end" << std::endl;
 		std::exit(EXIT_FAILURE);
 	}
+	if(blockSize < 1) {
+		std::cerr << "the block size must be positive" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if(nThreads < 1) nThreads = 1;
 	
 	if(enableVerbose) std::cout << "Parsing configuration file " << configFile << " ... " << std::endl;
 	ptree pt_ini;
@@ -79,33 +92,40 @@ int main(int argc, char ** argv) {
 	
 	if(enableVerbose) std::cout << "Opening files ..." << std::endl;
 	auto section = pt_ini.get_child("norm");
-	std::vector<TFile *> files;
+	std::vector<ColumnReader *> readers;
 	for(auto & key: section) {
-		files.push_back(TFile::Open(trim(key.second.data()).c_str(), "read"));
+		ColumnReader * reader = new ColumnReader(trim(key.second.data()), treeName, beginEvent, endEvent);
+		reader -> addColumn<Float_t>(varName);
+		readers.push_back(reader);
 	}
-	
-	if(enableVerbose) std::cout << "Opening trees ..." << std::endl;
-	std::vector<TTree *> trees;
-	for(auto & file: files) {
-		trees.push_back(dynamic_cast<TTree *>(file -> Get(treeName.c_str())));
-	}
-	
-	std::vector<Float_t> probabilities(trees.size(), 0);
-	for(unsigned int i = 0; i < trees.size(); ++i) {
-		trees[i] -> SetBranchAddress(varName.c_str(), &probabilities[i]);
+	if(readers.empty()) {
+		std::cerr << "no files in the [norm] section of " << configFile << std::endl;
+		std::exit(EXIT_FAILURE);
 	}
 	
-	if(endEvent == -1) {
-		Long64_t maxEvent = trees[0] -> GetEntries();
-		for(auto & tree: trees) {
-			if(maxEvent > tree -> GetEntries()) maxEvent = tree -> GetEntries();
-		}
-		endEvent = maxEvent;
+	// the readers clamp their ranges to their files, a block must not go beyond the shortest one
+	Long64_t maxEvent = readers[0] -> getEndEvent();
+	for(auto & reader: readers) {
+		if(maxEvent > reader -> getEndEvent()) maxEvent = reader -> getEndEvent();
 	}
+	if(endEvent == -1 || endEvent > maxEvent) endEvent = maxEvent;
 	
+	// the results are either a tree (if the output is a *.root file) or text lines, written one block at a time
+	bool writeTree = writeToFile && boost::algorithm::ends_with(output, ".root");
+	TFile * outFile = 0;
+	TTree * outTree = 0;
+	Long64_t event;
+	Double_t sum;
 	std::streambuf * buf;
 	std::ofstream of;
-	if(writeToFile) {
+	if(writeTree) {
+		outFile = new TFile(output.c_str(), "recreate");
+		outTree = new TTree(treeName.c_str(), ("sum of " + varName).c_str());
+		outTree -> Branch("event", &event, "event/L");
+		outTree -> Branch((varName + "_sum").c_str(), &sum, (varName + "_sum/D").c_str());
+		buf = std::cout.rdbuf();
+	}
+	else if(writeToFile) {
 		of.open(output);
 		buf = of.rdbuf();
 	}
@@ -115,17 +135,49 @@ int main(int argc, char ** argv) {
 	std::ostream out(buf);
 	
 	if(enableVerbose) std::cout << "Looping over " << (endEvent - beginEvent) << " events ..." << std::endl;
-	for(Long64_t i = beginEvent; i < endEvent; ++i) {
-		for(auto & tree: trees) {
-			tree -> GetEntry(i);
+	ThreadPool pool(std::min(unsigned(readers.size()), nThreads));
+	std::vector<Double_t> sums;
+	std::string text;
+	for(Long64_t first = beginEvent; first < endEvent; first += blockSize) {
+		Long64_t n = std::min(blockSize, endEvent - first);
+		// the files of a block are read in parallel, each on its own thread
+		for(auto reader: readers) {
+			pool.submit([reader, first, n] () {
+				reader -> read(first, n);
+			});
+		}
+		pool.wait();
+		sums.assign(n, 0);
+		for(auto reader: readers) {
+			const Float_t * probabilities = reader -> getColumn<Float_t>(0);
+			for(Long64_t i = 0; i < n; ++i) sums[i] += probabilities[i];
+		}
+		if(writeTree) {
+			for(Long64_t i = 0; i < n; ++i) {
+				event = first + i;
+				sum = sums[i];
+				outTree -> Fill();
+			}
+		}
+		else {
+			text.clear();
+			for(Long64_t i = 0; i < n; ++i) {
+				text += "EVENT " + std::to_string(first + i) + ":\t" + std::to_string(sums[i]) + "\n";
+			}
+			out << text;
 		}
-		Float_t sum = std::accumulate(probabilities.begin(), probabilities.end(), 0.0);
-		out << "EVENT " << std::to_string(i) << ":\t" << std::fixed << std::to_string(sum) << std::endl;
 	}
+	out.flush();
 	
 	if(enableVerbose) std::cout << "Closing the files ..." << std::endl;
-	for(auto file: files) {
-		file -> Close();
+	if(writeTree) {
+		outFile -> cd();
+		outTree -> Write();
+		writeEventRange(beginEvent, endEvent);
+		outFile -> Close();
+	}
+	for(auto reader: readers) {
+		delete reader;
 	}
 	
 	return EXIT_SUCCESS;
@@ -0,0 +1,141 @@
+#include <boost/program_options.hpp>
+
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <string> // std::string
+#include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include "ClusterPlan.hpp"
+#include "SkimCache.hpp"
+#include "MetaCache.hpp"
+
+int main(int argc, char ** argv) {
+	
+	namespace po = boost::program_options;
+	
+	// command line option parsing
+	std::string input, treeName, output;
+	Long64_t beginEvent, endEvent;
+	Int_t nJobs, samplesPerCluster;
+	Double_t baseCost, jetCost;
+	bool enableVerbose = false, useCache = true;
+	try {
+		po::options_description desc("allowed options");
+		desc.add_options()
+			("help,h", "prints this message")
+			("input,i", po::value<std::string>(&input), "input *.root file (or skim)")
+			("tree,t", po::value<std::string>(&treeName), "name of the tree")
+			("output,o", po::value<std::string>(&output), "output plan file\nif not set, the plan is printed")
+			("begin,b", po::value<Long64_t>(&beginEvent) -> default_value(0), "the event number to start with")
+			("end,e", po::value<Long64_t>(&endEvent) -> default_value(-1), "the event number to end with\ndefault (-1) means all events")
+			("jobs,j", po::value<Int_t>(&nJobs), "number of chunks")
+			("samples,s", po::value<Int_t>(&samplesPerCluster) -> default_value(100), "number of events sampled per cluster for the cost estimate\n0 means every event, -1 none (the cost is the number of events)")
+			("base-cost", po::value<Double_t>(&baseCost) -> default_value(1.0), "cost of an event")
+			("jet-cost", po::value<Double_t>(&jetCost) -> default_value(1.0), "additional cost of a jet")
+			("no-cache", "don't use the metadata cache (see MetaCache)")
+			("verbose,v", "verbose mode")
+		;
+		
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+		po::notify(vm);
+		
+		if(vm.count("help")) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_SUCCESS); // ugly
+		}
+		if(vm.count("input") == 0 || vm.count("jobs") == 0) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(vm.count("verbose")) {
+			enableVerbose = true;
+		}
+		if(vm.count("no-cache")) {
+			useCache = false;
+		}
+	}
+	catch(std::exception & e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		std::exit(EXIT_FAILURE); // ugly
+	}
+	catch(...) {
+		std::cerr << "exception of unkown type" << std::endl;
+	}
+	
+	// sanity check
+	if((endEvent >=0 && beginEvent > endEvent) || beginEvent < 0) {
+		std::cerr << "incorrect values for begin and/or end" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if(nJobs < 1) {
+		std::cerr << "number of jobs must be positive" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	
+	bool isSkim = SkimCache::isSkim(input);
+	if(! isSkim && treeName.empty()) {
+		std::cerr << "the name of the tree must be given" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	
+	// the file is only opened if the clusters aren't cached or the cost is estimated from the events
+	TFile * in = 0;
+	TTree * t = 0; // not needed if the input is a skim
+	auto openTree = [&] () -> void {
+		in = TFile::Open(input.c_str(), "read");
+		if(! in || in -> IsZombie() || ! in -> IsOpen()) {
+			std::cerr << "error on opening " << input << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		t = dynamic_cast<TTree *> (in -> Get(treeName.c_str()));
+		if(! t) {
+			std::cerr << "error on accessing tree " << treeName << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+	};
+	
+	ClusterPlan plan;
+	if(enableVerbose) std::cout << "Finding the clusters ..." << std::endl;
+	if(! isSkim && useCache) {
+		MetaCache cache;
+		const MetaCache::Tree * cached = cache.getTree(input, treeName);
+		if(! cached) {
+			std::cerr << "error on accessing tree " << treeName << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(enableVerbose) std::cout << "Metadata of " << input << (cache.getNumberOfHits() ? " found in" : " added to") << " the cache" << std::endl;
+		plan.setClusters(cached -> clusters, beginEvent, endEvent);
+	}
+	else {
+		if(! isSkim) openTree();
+		plan.findClusters(t, input, beginEvent, endEvent);
+	}
+	if(enableVerbose) std::cout << "Estimating the cost of " << plan.getClusters().size() << " clusters ..." << std::endl;
+	if(! isSkim && ! t && samplesPerCluster >= 0) openTree();
+	plan.estimateCost(t, input, samplesPerCluster, baseCost, jetCost);
+	plan.split(nJobs);
+	
+	const auto & chunks = plan.getChunks();
+	Double_t meanCost = chunks.empty() ? 0 : plan.getTotalCost() / chunks.size();
+	if(enableVerbose || output.empty()) {
+		std::cout << "Clusters:\t" << plan.getClusters().size() << std::endl;
+		std::cout << "Chunks:\t\t" << chunks.size() << std::endl;
+		std::cout << "Total cost:\t" << plan.getTotalCost() << std::endl;
+		std::cout << "Max / mean:\t" << (meanCost > 0 ? plan.getMaxCost() / meanCost : 0) << std::endl;
+	}
+	if(output.empty()) {
+		for(std::size_t i = 0; i < chunks.size(); ++i) {
+			std::cout << (i + 1) << ") [" << chunks[i].begin << "," << chunks[i].end << "] " << chunks[i].cost << std::endl;
+		}
+	}
+	else {
+		plan.write(output);
+	}
+	
+	if(in) in -> Close();
+	
+	return EXIT_SUCCESS;
+}
@@ -9,6 +9,7 @@
 #include <map> // std::map<>
 #include <string> // std::string
 #include <vector> // std::vector<>
+#include <thread> // std::thread::hardware_concurrency()
 
 #include <TFile.h>
 #include <TTree.h>
@@ -21,14 +22,15 @@
 #include <TCanvas.h>
 
 #include "common.hpp"
+#include "BatchRenderer.hpp"
 
 int main(int argc, char ** argv) {
 	
 	namespace po = boost::program_options;
 	
 	std::string input, output, dir, extension;
-	Int_t dimX, dimY;
-	bool setLog = false, writeToFile = false, doPlots = false, doKolmogorov = false, doChi2 = false, useNormalizedTest = false, useNormalizedHistos = false;
+	Int_t dimX, dimY, nWorkers;
+	bool setLog = false, writeToFile = false, doPlots = false, doKolmogorov = false, doChi2 = false, useNormalizedTest = false, useNormalizedHistos = false, force = false;
 	try {
 		po::options_description desc("allowed options");
 		desc.add_options()
@@ -44,6 +46,8 @@ int main(int argc, char ** argv) {
 			("enable-log,l", "sets y-axis to logarithmic scale")
 			("use-normalized-test,n", "use normalized histograms to do the statistical tests")
 			("use-normalized-histograms,N", "plot normalized histograms")
+			("workers", po::value<Int_t>(&nWorkers) -> default_value(std::thread::hardware_concurrency()), "number of rendering processes")
+			("force", "render the plots even if their inputs haven't changed")
 		;
 		
 		po::variables_map vm;
@@ -79,6 +83,9 @@ int main(int argc, char ** argv) {
 		if(vm.count("use-normalized-histograms") > 0) {
 			useNormalizedHistos = true;
 		}
+		if(vm.count("force") > 0) {
+			force = true;
+		}
 	}
 	catch(std::exception & e) {
 		std::cerr << "error: " << e.what() << std::endl;
@@ -139,63 +146,87 @@ int main(int argc, char ** argv) {
 	histoXaxis["subleadPt"] = "p_{t} of sublead jet (GeV)";
 	
 	if(doPlots) {
+		BatchRenderer renderer((dir.empty() ? "" : dir + "/") + ".plotcache", nWorkers, force);
 		for(auto & kv: vars) {
 			auto s = kv.first;
-			TCanvas * c = new TCanvas(histoTitles[s].c_str(), histoTitles[s].c_str(), dimX, dimY);
-			gStyle -> SetOptStat(kFALSE);
-			TLegend * legend = new TLegend(0.70, 0.90, 0.95, 1.0);
-			//legend -> SetNColumns(vars[s]);
+			std::string fileName = s;
+			if(setLog) fileName = "log_" + fileName;
+			if(! dir.empty()) fileName = dir + "/" + fileName;
+			fileName += "." + extension;
 			
-			Float_t maxY = -1;
+			BatchRenderer::Hash hash;
+			hash.add("plotntest").add(dimX).add(dimY).add(setLog).add(useNormalizedHistos);
 			for(auto & h: histoMap) {
 				std::string title = h.first;
-				if(boost::iequals(title.substr(0, title.find(" ")), s)) {
-					Float_t scaleFactor = useNormalizedHistos ? float(1e5) / h.second -> Integral() : 1;
-					maxY = maxY < scaleFactor * (h.second -> GetMaximum()) ? scaleFactor * (h.second -> GetMaximum()) : maxY;
-				}
+				if(boost::iequals(title.substr(0, title.find(" ")), s)) hash.add(h.second);
 			}
 			
-			int counter = 0;
-			for(auto & h: histoMap) {
-				std::string title = h.first;
-				if(boost::iequals(title.substr(0, title.find(" ")), s)) {
-					std::string suffix = title.substr(title.find(s) + s.size() + 1);
-					h.second -> SetLineColor(colorRanges[counter]);
-					h.second -> SetLineWidth(2);
-					h.second -> SetLineWidth(2);
-					
-					h.second -> GetXaxis() -> SetTitle(histoXaxis[s].c_str());
-					h.second -> GetXaxis() -> SetTitleOffset(1.2);
-					
-					if(useNormalizedHistos) {
-						h.second -> Scale(float(1e5) / h.second -> Integral());
-						h.second -> GetYaxis() -> SetTitle("Normalized (to 10^{5}) number of events per bin");
+			// the workers scale and restyle their own copies of the histograms
+			renderer.add(fileName, hash, [&, s, fileName] () {
+				TCanvas * c = new TCanvas(histoTitles[s].c_str(), histoTitles[s].c_str(), dimX, dimY);
+				gStyle -> SetOptStat(kFALSE);
+				TLegend * legend = new TLegend(0.70, 0.90, 0.95, 1.0);
+				//legend -> SetNColumns(vars[s]);
+				
+				Float_t maxY = -1;
+				for(auto & h: histoMap) {
+					std::string title = h.first;
+					if(boost::iequals(title.substr(0, title.find(" ")), s)) {
+						Float_t scaleFactor = useNormalizedHistos ? float(1e5) / h.second -> Integral() : 1;
+						maxY = maxY < scaleFactor * (h.second -> GetMaximum()) ? scaleFactor * (h.second -> GetMaximum()) : maxY;
 					}
-					else {
-						h.second -> GetYaxis() -> SetTitle("Number of events per bin");
+				}
+				
+				int counter = 0;
+				for(auto & h: histoMap) {
+					std::string title = h.first;
+					if(boost::iequals(title.substr(0, title.find(" ")), s)) {
+						std::string suffix = title.substr(title.find(s) + s.size() + 1);
+						h.second -> SetLineColor(colorRanges[counter]);
+						h.second -> SetLineWidth(2);
+						h.second -> SetLineWidth(2);
+						
+						h.second -> GetXaxis() -> SetTitle(histoXaxis[s].c_str());
+						h.second -> GetXaxis() -> SetTitleOffset(1.2);
+						
+						if(useNormalizedHistos) {
+							h.second -> Scale(float(1e5) / h.second -> Integral());
+							h.second -> GetYaxis() -> SetTitle("Normalized (to 10^{5}) number of events per bin");
+						}
+						else {
+							h.second -> GetYaxis() -> SetTitle("Number of events per bin");
+						}
+						h.second -> GetYaxis() -> SetTitleOffset(1.3);
+						h.second -> SetMinimum(0);
+						h.second -> SetMaximum(1.1 * maxY);
+						h.second -> Draw((counter == 0 ? "hist e" : "same hist e")); // same e for the error bars
+						h.second -> SetTitle(histoTitles[s].c_str());
+						std::string entriesString = " (" + std::to_string(Int_t(h.second -> GetEntries())) + ")";
+						legend -> AddEntry(h.second, (histoLabels[suffix] + entriesString).c_str());
+						c -> SetGrid();
+						if(setLog) c -> SetLogy(1);
+						c -> SetRightMargin(0.05);
+						c -> Modified();
+						c -> Update();
+						++counter;
 					}
-					h.second -> GetYaxis() -> SetTitleOffset(1.3);
-					h.second -> SetMinimum(0);
-					h.second -> SetMaximum(1.1 * maxY);
-					h.second -> Draw((counter == 0 ? "hist e" : "same hist e")); // same e for the error bars
-					h.second -> SetTitle(histoTitles[s].c_str());
-					std::string entriesString = " (" + std::to_string(Int_t(h.second -> GetEntries())) + ")";
-					legend -> AddEntry(h.second, (histoLabels[suffix] + entriesString).c_str());
-					c -> SetGrid();
-					if(setLog) c -> SetLogy(1);
-					c -> SetRightMargin(0.05);
-					c -> Modified();
-					c -> Update();
-					++counter;
 				}
-			}
-			legend -> Draw();
-			std::string canvasTitle = s;
-			if(setLog) canvasTitle = "log_" + canvasTitle;
-			if(! dir.empty()) canvasTitle = dir + "/" + canvasTitle;
-			c -> SaveAs(canvasTitle.append("." + extension).c_str());
-			c -> Close();
-			delete legend;
+				legend -> Draw();
+				c -> SaveAs(fileName.c_str());
+				c -> Close();
+				delete legend;
+			});
+		}
+		bool rendered = renderer.run();
+		std::cerr << renderer.report() << std::endl; // stdout may carry the test results
+		if(! rendered) {
+			std::cerr << "some of the plots failed" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		
+		// the plots used to normalize the histograms in place, which the tests below rely on
+		if(useNormalizedHistos) {
+			for(auto & h: histoMap) h.second -> Scale(float(1e5) / h.second -> Integral());
 		}
 	}
 	
@@ -249,7 +280,7 @@ int main(int argc, char ** argv) {
 		out << ss.str();
 		//out << binss.str();
 	}
-		
+	
 	inFile -> Close();
 	
 	return EXIT_SUCCESS;
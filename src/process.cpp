@@ -11,6 +11,7 @@
 #include <iostream> // std::cout, std::cerr, std::endl
 #include <cstdlib> // std::atoi(), std::atof(), EXIT_SUCCESS
 #include <memory> // std::unique_ptr<>
+#include <stdexcept> // std::runtime_error
 
 #include <TString.h>
 #include <TTree.h>
@@ -18,6 +19,8 @@
 #include <TH1F.h>
 
 #include "common.hpp"
+#include "EventReader.hpp"
+#include "SkimCache.hpp"
 
 /**
  * @note Assumptions:
@@ -25,7 +28,7 @@
  *  - flavors, and pt and eta ranges hardcoded
  */
 
-int main(int argc, char ** argv) {
+int main(int argc, char ** argv) try {
 	
 	namespace po = boost::program_options;
 	using boost::property_tree::ptree; // ptree, read_ini
@@ -33,6 +36,7 @@ int main(int argc, char ** argv) {
 	// command line option parsing
 	std::string configFile, cmd_output, cmd_input, cmd_treeName; // cmd_mBins;
 	Long64_t beginEvent, endEvent;
+	Int_t readAhead;
 	bool enableVerbose = false, plotGeneratedCSV = false, plotSampleTries = false;
 	try {
 		po::options_description desc("allowed options");
@@ -46,6 +50,7 @@ int main(int argc, char ** argv) {
 			("tree,t", po::value<std::string>(&cmd_treeName), "name of the tree\nif not set, read from config file")
 			("use-CSVgen,g", "plot generated CSV value (default = use original CSV value); or")
 			("use-CSVN,n", "plot the number of sample tries (default = use original CSV value)")
+			("read-ahead,R", po::value<Int_t>(&readAhead) -> default_value(4), "number of event blocks decoded ahead on a separate thread\n0 means synchronous reading")
 			("verbose,v", "verbose mode (enables progressbar)")
 		;
 		
@@ -132,15 +137,18 @@ int main(int argc, char ** argv) {
 	/******************************************************************************************************/
 	
 	// open the file and tree
-	if(enableVerbose) std::cout << "Reading " << inputFilename << " ... " << std::endl;
-	std::unique_ptr<TFile> in(TFile::Open(inputFilename.c_str(), "read"));
-	if(in -> IsZombie() || ! in -> IsOpen()) {
-		std::cerr << "error on opening " << inputFilename << std::endl;
-		std::exit(EXIT_FAILURE);
+	std::unique_ptr<TFile> in;
+	TTree * t = 0; // std::unique_ptr can't handle TTree .. (not needed if the input is a skim)
+	if(! SkimCache::isSkim(inputFilename)) {
+		if(enableVerbose) std::cout << "Reading " << inputFilename << " ... " << std::endl;
+		in.reset(TFile::Open(inputFilename.c_str(), "read"));
+		if(in -> IsZombie() || ! in -> IsOpen()) {
+			std::cerr << "error on opening " << inputFilename << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(enableVerbose) std::cout << "Accessing TTree " << treeName << " ... " << std::endl;
+		t = dynamic_cast<TTree *>(in -> Get(treeName.c_str()));
 	}
-	if(enableVerbose) std::cout << "Accessing TTree " << treeName << " ... " << std::endl;
-	TTree * t; // std::unique_ptr can't handle TTree .. 
-	t = dynamic_cast<TTree *>(in -> Get(treeName.c_str()));
 	std::unique_ptr<TFile> out(new TFile(cmd_output.c_str(), "recreate"));
 	
 	// set up the variables
@@ -175,38 +183,43 @@ int main(int argc, char ** argv) {
 	Long64_t hJet_csvN[maxNumberOfHJets];
 	Long64_t aJet_csvN[maxNumberOfAJets];
 	
-	t -> SetBranchAddress("nhJets", &nhJets);
-	t -> SetBranchAddress("hJet_pt", &hJet_pt);
-	t -> SetBranchAddress("hJet_eta", &hJet_eta);
-	t -> SetBranchAddress("hJet_flavour", &hJet_flavour);
-	//t -> SetBranchAddress("hJet_phi", &hJet_phi);
-	//t -> SetBranchAddress("hJet_e", &hJet_e);
-	//t -> SetBranchAddress("hJet_genPt", &hJet_genPt);
+	// if endEvent greater set by the user greater than the number of entries in a tree
+	// use the latter value
+	EventReader reader(t, inputFilename, beginEvent, endEvent, readAhead);
+	endEvent = reader.getEndEvent();
+	
+	reader.setBranchAddress("nhJets", &nhJets);
+	reader.setBranchAddress("hJet_pt", &hJet_pt);
+	reader.setBranchAddress("hJet_eta", &hJet_eta);
+	reader.setBranchAddress("hJet_flavour", &hJet_flavour);
+	//reader.setBranchAddress("hJet_phi", &hJet_phi);
+	//reader.setBranchAddress("hJet_e", &hJet_e);
+	//reader.setBranchAddress("hJet_genPt", &hJet_genPt);
 	if(plotGeneratedCSV) {
-		t -> SetBranchAddress("hJet_csvGen", &hJet_csvGen);
+		reader.setBranchAddress("hJet_csvGen", &hJet_csvGen);
 	}
 	else if(plotSampleTries) {
-		t -> SetBranchAddress("hJet_csvN", &hJet_csvN);
+		reader.setBranchAddress("hJet_csvN", &hJet_csvN);
 	}
 	else {
-		t -> SetBranchAddress("hJet_csv", &hJet_csv);
+		reader.setBranchAddress("hJet_csv", &hJet_csv);
 	}
 	
-	t -> SetBranchAddress("naJets", &naJets);
-	t -> SetBranchAddress("aJet_pt", &aJet_pt);
-	t -> SetBranchAddress("aJet_eta", &aJet_eta);
-	t -> SetBranchAddress("aJet_flavour", &aJet_flavour);
-	//t -> SetBranchAddress("aJet_phi", &aJet_phi);
-	//t -> SetBranchAddress("aJet_e", &aJet_e);
-	//t -> SetBranchAddress("aJet_genPt", &aJet_genPt);
+	reader.setBranchAddress("naJets", &naJets);
+	reader.setBranchAddress("aJet_pt", &aJet_pt);
+	reader.setBranchAddress("aJet_eta", &aJet_eta);
+	reader.setBranchAddress("aJet_flavour", &aJet_flavour);
+	//reader.setBranchAddress("aJet_phi", &aJet_phi);
+	//reader.setBranchAddress("aJet_e", &aJet_e);
+	//reader.setBranchAddress("aJet_genPt", &aJet_genPt);
 	if(plotGeneratedCSV) {
-		t -> SetBranchAddress("aJet_csvGen", &aJet_csvGen);
+		reader.setBranchAddress("aJet_csvGen", &aJet_csvGen);
 	}
 	else if(plotSampleTries) {
-		t -> SetBranchAddress("aJet_csvN", &aJet_csvN);
+		reader.setBranchAddress("aJet_csvN", &aJet_csvN);
 	}
 	else {
-		t -> SetBranchAddress("aJet_csv", &aJet_csv);
+		reader.setBranchAddress("aJet_csv", &aJet_csv);
 	}
 	
 	
@@ -229,10 +242,6 @@ int main(int argc, char ** argv) {
 		}
 	}
 	
-	// if endEvent greater set by the user greater than the number of entries in a tree
-	// use the latter value
-	endEvent = (endEvent > t -> GetEntries() || endEvent == -1) ? (t -> GetEntries()) : endEvent;
-	
 	// set up progress bar
 	boost::progress_display * show_progress;
 	if(enableVerbose) {
@@ -242,8 +251,7 @@ int main(int argc, char ** argv) {
 	}
 	
 	// loop over the events
-	for(Long64_t i = beginEvent; i < endEvent; ++i) {
-		t -> GetEntry(i);
+	while(reader.next()) {
 		for(int coll = 0; coll < 2; ++coll) {
 			bool isHJet = (coll == 0);
 			for(int j = 0; j < (isHJet ? nhJets : naJets); ++j) {
@@ -286,14 +294,20 @@ int main(int argc, char ** argv) {
 	
 	// write them histograms
 	if(enableVerbose) std::cout << "Writing histograms to " << cmd_output << " ... " << std::endl;
+	out -> cd();
 	for(const auto & kv: histoMap) {
 		kv.second -> Write();
 	}
+	writeEventRange(beginEvent, endEvent);
 	
 	// close the files
 	if(enableVerbose) std::cout << "Closing " << inputFilename << " and " << cmd_output << " ... " << std::endl;
-	in -> Close();
+	if(in) in -> Close();
 	out -> Close();
 	
 	return EXIT_SUCCESS;
 }
+catch(std::runtime_error & e) { // EventReader and SkimCache throw, for the daemon
+	std::cerr << e.what() << std::endl;
+	return EXIT_FAILURE;
+}
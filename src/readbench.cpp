@@ -0,0 +1,163 @@
+#include <boost/program_options.hpp>
+
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <iomanip> // std::setw(), std::setprecision()
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS
+#include <chrono> // std::chrono
+
+#include <fcntl.h> // open(), posix_fadvise()
+#include <unistd.h> // close()
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TMath.h>
+
+#include "EventReader.hpp"
+
+/**
+ * @brief Drops the file from the page cache so that the next read hits the disk.
+ * @note Works only for local files; remote files (e.g. root://) are left untouched.
+ */
+void dropPageCache(std::string filename) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0) {
+		std::cerr << "cannot drop the page cache of " << filename << " (not a local file?)" << std::endl;
+		return;
+	}
+	if(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) != 0) {
+		std::cerr << "posix_fadvise failed on " << filename << std::endl;
+	}
+	close(fd);
+}
+
+int main(int argc, char ** argv) {
+	
+	namespace po = boost::program_options;
+	
+	// command line option parsing
+	std::string input, treeName;
+	Long64_t beginEvent, endEvent;
+	std::vector<Int_t> readAheads;
+	Int_t work;
+	bool coldCache = false;
+	try {
+		po::options_description desc("allowed options");
+		desc.add_options()
+			("help,h", "prints this message")
+			("input,i", po::value<std::string>(&input), "input *.root file")
+			("tree,t", po::value<std::string>(&treeName), "name of the tree")
+			("begin,b", po::value<Long64_t>(&beginEvent) -> default_value(0), "the event number to start with")
+			("end,e", po::value<Long64_t>(&endEvent) -> default_value(-1), "the event number to end with\ndefault (-1) means all events")
+			("read-ahead,R", po::value<std::vector<Int_t> >(&readAheads) -> multitoken(), "list of read-ahead depths to compare\ndefault: 0 4")
+			("work,w", po::value<Int_t>(&work) -> default_value(0), "busy work per event in microseconds (simulates the event loop)")
+			("cold,C", "drop the input file from the page cache before each run")
+		;
+		
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+		po::notify(vm);
+		
+		if(vm.count("help")) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_SUCCESS); // ugly
+		}
+		if(vm.count("input") == 0 || vm.count("tree") == 0) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(vm.count("cold")) {
+			coldCache = true;
+		}
+		if(readAheads.empty()) {
+			readAheads.push_back(0);
+			readAheads.push_back(4);
+		}
+	}
+	catch(std::exception & e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		std::exit(EXIT_FAILURE); // ugly
+	}
+	catch(...) {
+		std::cerr << "exception of unkown type" << std::endl;
+	}
+	
+	const int maxNumberOfHJets = 2;
+	const int maxNumberOfAJets = 20;
+	
+	Int_t nhJets, naJets;
+	Float_t hJet_pt[maxNumberOfHJets], hJet_eta[maxNumberOfHJets];
+	Float_t hJet_csv[maxNumberOfHJets], hJet_flavour[maxNumberOfHJets];
+	Float_t aJet_pt[maxNumberOfAJets], aJet_eta[maxNumberOfAJets];
+	Float_t aJet_csv[maxNumberOfAJets], aJet_flavour[maxNumberOfAJets];
+	
+	std::cout << (coldCache ? "cold" : "warm") << " cache, " << work << " us of work per event" << std::endl;
+	std::cout << std::setw(12) << "read-ahead" << std::setw(12) << "events"
+			  << std::setw(12) << "wall [s]" << std::setw(12) << "events/s"
+			  << std::setw(12) << "read [s]" << std::setw(12) << "wait [s]"
+			  << std::setw(12) << "overlap" << std::endl;
+	
+	for(Int_t readAhead: readAheads) {
+		if(coldCache) dropPageCache(input);
+		
+		TFile * in = TFile::Open(input.c_str(), "read");
+		if(! in || in -> IsZombie() || ! in -> IsOpen()) {
+			std::cerr << "error on opening " << input << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		TTree * t = dynamic_cast<TTree *> (in -> Get(treeName.c_str()));
+		if(! t) {
+			std::cerr << "error on accessing tree " << treeName << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		
+		auto t0 = std::chrono::steady_clock::now();
+		Long64_t nEvents = 0;
+		Double_t checksum = 0; // keeps the compiler from optimizing the loop away
+		try {
+			EventReader reader(t, input, beginEvent, endEvent, readAhead);
+			reader.setBranchAddress("nhJets", &nhJets);
+			reader.setBranchAddress("hJet_pt", &hJet_pt);
+			reader.setBranchAddress("hJet_eta", &hJet_eta);
+			reader.setBranchAddress("hJet_csv", &hJet_csv);
+			reader.setBranchAddress("hJet_flavour", &hJet_flavour);
+			reader.setBranchAddress("naJets", &naJets);
+			reader.setBranchAddress("aJet_pt", &aJet_pt);
+			reader.setBranchAddress("aJet_eta", &aJet_eta);
+			reader.setBranchAddress("aJet_csv", &aJet_csv);
+			reader.setBranchAddress("aJet_flavour", &aJet_flavour);
+			
+			while(reader.next()) {
+				for(int j = 0; j < nhJets; ++j) checksum += hJet_pt[j] + hJet_eta[j] + hJet_csv[j] + hJet_flavour[j];
+				for(int j = 0; j < naJets; ++j) checksum += aJet_pt[j] + aJet_eta[j] + aJet_csv[j] + aJet_flavour[j];
+				if(work > 0) {
+					auto w0 = std::chrono::steady_clock::now();
+					while(std::chrono::steady_clock::now() - w0 < std::chrono::microseconds(work));
+				}
+				++nEvents;
+			}
+			
+			Double_t wall = std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - t0).count();
+			Double_t readTime = reader.getReadTime(), waitTime = reader.getWaitTime();
+			// synchronous reading is never overlapped with the event loop
+			Double_t overlap = (readAhead > 0 && readTime > 0) ? TMath::Max(0.0, 1 - waitTime / readTime) : 0.0;
+			std::cout << std::setw(12) << readAhead << std::setw(12) << nEvents
+					  << std::setw(12) << std::setprecision(4) << wall
+					  << std::setw(12) << std::setprecision(6) << (wall > 0 ? nEvents / wall : 0)
+					  << std::setw(12) << std::setprecision(4) << readTime
+					  << std::setw(12) << std::setprecision(4) << (readAhead > 0 ? waitTime : readTime)
+					  << std::setw(12) << std::setprecision(3) << overlap << std::endl;
+		}
+		catch(std::exception & e) {
+			std::cerr << e.what() << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(checksum == -1) std::cout << std::endl; // never true
+		
+		in -> Close();
+		delete in;
+	}
+	
+	return EXIT_SUCCESS;
+}
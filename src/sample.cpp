@@ -18,6 +18,7 @@
 #include <TH1F.h>
 
 #include "common.hpp"
+#include "TreeLayout.hpp"
 
 /**
  * @todo
@@ -145,8 +146,11 @@ int main(int argc, char ** argv) {
 	}
 	
 	// create the output file
+	// the layout of the output tree is read from the same config file
+	TreeLayout layout(configFile);
 	if(enableVerbose) std::cout << "Creating " << cmd_output << " ... " << std::endl;
 	std::unique_ptr<TFile> out(new TFile(cmd_output.c_str(), "recreate"));
+	layout.apply(out.get());
 	TTree * u = new TTree(newTreeName.c_str(), "Tree with generated CSV values according to the histograms."); // output tree
 	u -> SetDirectory(out.get());
 	
@@ -243,6 +247,7 @@ int main(int argc, char ** argv) {
 		u -> Branch("aJet_csvN", &n_aJet_csvN, "aJet_csvN[naJets]/L");
 		u -> Branch("hJet_csvN", &n_hJet_csvN, "hJet_csvN[nhJets]/L");
 	}
+	layout.apply(u);
 	
 	// if endEvent greater set by the user greater than the number of entries in a tree
 	// use the latter value
@@ -1,23 +1,41 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/program_options.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/ini_parser.hpp>
 #include <boost/progress.hpp>
 #include <boost/timer.hpp>
 
 #include <cstdlib> //EXIT_SUCCESS, std::abs
 #include <iostream> // std::cout
-#include <map> // std::map<>
-#include <cmath> // std::fabs
+#include <cmath> // std::fabs, std::sqrt
 #include <vector> // std::vector<>
-#include <algorithm> // std::find, std::sort
+#include <algorithm> // std::sort, std::min()
+#include <map> // std::map<>
+#include <string> // std::string
+#include <mutex> // std::mutex, std::lock_guard<>
+#include <chrono> // std::chrono
+#include <thread> // std::thread::hardware_concurrency()
 
+#include <RVersion.h>
 #include <TFile.h>
 #include <TTree.h>
 #include <TH1F.h>
 #include <TMath.h>
+#include <TDirectory.h>
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+#include <TROOT.h>
+#else
+#include <TThread.h>
+#endif
 
 #include "common.hpp"
+#include "CutExpression.hpp"
 #include "Jet.hpp"
 #include "JetCollection.hpp"
+#include "SampleCatalog.hpp"
+#include "ThreadPool.hpp"
+
+/*********** the hand-written selection, the baseline of --compare-cuts ****/
 
 class Lepton {
 public:
@@ -75,14 +93,166 @@ private:
 	std::vector<Lepton> leptons;
 };
 
+/**
+ * @brief The branches read by the selection; every task has its own copy.
+ */
+struct EventBranches {
+	static const int maxNumberOfHJets = 2;
+	static const int maxNumberOfAJets = 20;
+	static const int maxVLeptons = 2;
+	static const int maxALeptons = 100; // there were up to40 leptons in the first 100k events
+	
+	/*********** jets *******************************************/
+	
+	Int_t nhJets;
+	Int_t naJets;
+	
+	Float_t hJet_pt[maxNumberOfHJets];
+	Float_t hJet_eta[maxNumberOfHJets];
+	Float_t hJet_csv[maxNumberOfHJets];
+	Float_t hJet_flavour[maxNumberOfHJets];
+	Float_t aJet_pt[maxNumberOfAJets];
+	Float_t aJet_eta[maxNumberOfAJets];
+	Float_t aJet_csv[maxNumberOfAJets];
+	Float_t aJet_flavour[maxNumberOfAJets];
+	
+	/*********** leptons ****************************************/
+	
+	Int_t nvlep;
+	Int_t nalep;
+	
+	Float_t vLepton_pt[maxVLeptons];
+	Float_t vLepton_eta[maxVLeptons];
+	Float_t vLepton_pfCombRelIso[maxVLeptons];
+	Int_t vLepton_type[maxVLeptons];
+	Float_t vLepton_idMVAtrig[maxVLeptons];
+	
+	Float_t aLepton_pt[maxALeptons];
+	Float_t aLepton_eta[maxALeptons];
+	Float_t aLepton_pfCombRelIso[maxALeptons];
+	Int_t aLepton_type[maxALeptons];
+	Float_t aLepton_idMVAtrig[maxALeptons];
+	
+	void setBranchAddresses(TTree * t) {
+		t -> SetBranchAddress("nhJets", &nhJets);
+		t -> SetBranchAddress("hJet_pt", &hJet_pt);
+		t -> SetBranchAddress("hJet_eta", &hJet_eta);
+		t -> SetBranchAddress("hJet_flavour", &hJet_flavour);
+		t -> SetBranchAddress("hJet_csv", &hJet_csv);
+		
+		t -> SetBranchAddress("naJets", &naJets);
+		t -> SetBranchAddress("aJet_pt", &aJet_pt);
+		t -> SetBranchAddress("aJet_eta", &aJet_eta);
+		t -> SetBranchAddress("aJet_flavour", &aJet_flavour);
+		t -> SetBranchAddress("aJet_csv", &aJet_csv);
+		
+		t -> SetBranchAddress("nvlep", &nvlep);
+		t -> SetBranchAddress("nalep", &nalep);
+		
+		t -> SetBranchAddress("vLepton_pt", &vLepton_pt);
+		t -> SetBranchAddress("aLepton_pt", &aLepton_pt);
+		t -> SetBranchAddress("vLepton_eta", &vLepton_eta);
+		t -> SetBranchAddress("aLepton_eta", &aLepton_eta);
+		t -> SetBranchAddress("vLepton_pfCombRelIso", &vLepton_pfCombRelIso);
+		t -> SetBranchAddress("aLepton_pfCombRelIso", &aLepton_pfCombRelIso);
+		t -> SetBranchAddress("vLepton_type", &vLepton_type);
+		t -> SetBranchAddress("aLepton_type", &aLepton_type);
+		t -> SetBranchAddress("vLepton_idMVAtrig", &vLepton_idMVAtrig);
+		t -> SetBranchAddress("aLepton_idMVAtrig", &aLepton_idMVAtrig);
+	}
+};
+
+/**
+ * @brief The leptons and jets of a block of events as columns, on which the cuts run; every task has its own.
+ */
+struct EventBlock {
+	static const Long64_t maxEvents = 1024;
+	static const int maxJets = EventBranches::maxNumberOfHJets + EventBranches::maxNumberOfAJets;
+	static std::vector<std::string> getLeptonVariables() { return {"pt", "eta", "relIso", "type", "idMVAtrig"}; }
+	static std::vector<std::string> getJetVariables() { return {"pt", "eta", "csv", "flavour"}; }
+	
+	std::size_t nEvents;
+	std::vector<Float_t> leptons[5]; // the columns of getLeptonVariables()
+	std::vector<UInt_t> leptonEvent; // the event of every lepton
+	std::vector<Float_t> jets[4]; // the columns of getJetVariables(), by pt (descending) in every event
+	std::vector<UInt_t> jetEvent;
+	std::vector<UInt_t> firstJet; // of every event, and the end
+	
+	// results of the selection per event
+	std::vector<Int_t> categories;
+	std::vector<Int_t> sumsOfJets;
+	
+	// scratch of the selection
+	std::vector<UInt_t> candidates, tight, loose, good, tagged;
+	std::vector<Int_t> nTight, nLoose, nTags;
+	CutExpression::Workspace workspace;
+	
+	void clear() {
+		nEvents = 0;
+		for(auto & column: leptons) column.clear();
+		for(auto & column: jets) column.clear();
+		leptonEvent.clear();
+		jetEvent.clear();
+		firstJet.assign(1, 0);
+	}
+	void addLeptons(Int_t n, const Float_t * pt, const Float_t * eta, const Float_t * relIso, const Int_t * type, const Float_t * idMVAtrig) {
+		for(Int_t i = 0; i < n; ++i) {
+			leptons[0].push_back(pt[i]);
+			leptons[1].push_back(eta[i]);
+			leptons[2].push_back(relIso[i]);
+			leptons[3].push_back(type[i]);
+			leptons[4].push_back(idMVAtrig[i]);
+			leptonEvent.push_back(nEvents);
+		}
+	}
+	void add(const EventBranches & ev) {
+		addLeptons(ev.nvlep, ev.vLepton_pt, ev.vLepton_eta, ev.vLepton_pfCombRelIso, ev.vLepton_type, ev.vLepton_idMVAtrig);
+		addLeptons(ev.nalep, ev.aLepton_pt, ev.aLepton_eta, ev.aLepton_pfCombRelIso, ev.aLepton_type, ev.aLepton_idMVAtrig);
+		
+		// h jets, then a jets, sorted as JetCollection::sortPt() does
+		Float_t pt[maxJets], eta[maxJets], csv[maxJets], flavour[maxJets];
+		Int_t order[maxJets];
+		Int_t nJets = 0;
+		for(Int_t i = 0; i < ev.nhJets; ++i, ++nJets) {
+			pt[nJets] = ev.hJet_pt[i];
+			eta[nJets] = ev.hJet_eta[i];
+			csv[nJets] = ev.hJet_csv[i];
+			flavour[nJets] = ev.hJet_flavour[i];
+		}
+		for(Int_t i = 0; i < ev.naJets; ++i, ++nJets) {
+			pt[nJets] = ev.aJet_pt[i];
+			eta[nJets] = ev.aJet_eta[i];
+			csv[nJets] = ev.aJet_csv[i];
+			flavour[nJets] = ev.aJet_flavour[i];
+		}
+		for(Int_t i = 0; i < nJets; ++i) order[i] = i;
+		std::sort(order, order + nJets,
+			[&pt] (Int_t i, Int_t j) -> bool {
+				return pt[i] > pt[j];
+			}
+		);
+		for(Int_t k = 0; k < nJets; ++k) {
+			Int_t i = order[k];
+			jets[0].push_back(pt[i]);
+			jets[1].push_back(eta[i]);
+			jets[2].push_back(csv[i]);
+			jets[3].push_back(flavour[i]);
+			jetEvent.push_back(nEvents);
+		}
+		firstJet.push_back(jets[0].size());
+		++nEvents;
+	}
+};
+
 int main(int argc, char ** argv) {
 	
 	namespace po = boost::program_options;
 	
 	/*********** input ******************************************/
-	std::string inFilename, treeName, outFilename;
-	bool enableVerbose = false;
-	Long64_t beginEvent, endEvent;
+	std::string inFilename, treeName, outFilename, configFile, cutsFile;
+	bool enableVerbose = false, compareCuts = false;
+	Long64_t beginEvent, endEvent, chunkSize;
+	unsigned nThreads;
 	
 	try {
 		po::options_description desc("allowed options");
@@ -90,9 +260,14 @@ int main(int argc, char ** argv) {
 			("help,h", "prints this message")
 			("input,i", po::value<std::string>(&inFilename), "input *.root file")
 			("tree,t", po::value<std::string>(&treeName), "name of the tree")
-			("begin,b", po::value<Long64_t>(&beginEvent) -> default_value(0), "the event number to start with")
-			("end,e", po::value<Long64_t>(&endEvent) -> default_value(-1), "the event number to end with\ndefault (-1) means all events")
+			("config,c", po::value<std::string>(&configFile), "config file with the sample catalog ([catalog], [catalog_samples])\nreplaces -i and -t")
+			("cuts", po::value<std::string>(&cutsFile), "config file with the cuts ([selection])\ndefault: the one of -c, else the built-in cuts")
+			("begin,b", po::value<Long64_t>(&beginEvent) -> default_value(0), "the event number to start with (in every file)")
+			("end,e", po::value<Long64_t>(&endEvent) -> default_value(-1), "the event number to end with (in every file)\ndefault (-1) means all events")
 			("output,o", po::value<std::string>(&outFilename), "output file name")
+			("threads,j", po::value<unsigned>(&nThreads) -> default_value(std::thread::hardware_concurrency()), "number of threads shared by all samples")
+			("chunk-size", po::value<Long64_t>(&chunkSize) -> default_value(100000), "number of events processed by a task")
+			("compare-cuts", "runs the hand-written selection (the default cuts) too, compares its results and prints the time of both")
 			("verbose,v", "verbose mode (enables progressbar)")
 		;
 		
@@ -107,7 +282,10 @@ int main(int argc, char ** argv) {
 		if(vm.count("verbose")) {
 			enableVerbose = true;
 		}
-		if(vm.count("output") == 0 || vm.count("input") == 0 || vm.count("tree") == 0) {
+		if(vm.count("compare-cuts")) {
+			compareCuts = true;
+		}
+		if(vm.count("output") == 0 || (vm.count("config") == 0 && (vm.count("input") == 0 || vm.count("tree") == 0))) {
 			std::cout << desc << std::endl;
 			std::exit(EXIT_SUCCESS);
 		}
@@ -125,157 +303,129 @@ int main(int argc, char ** argv) {
 		std::cerr << "incorrect values for begin and/or end" << std::endl;
 		std::exit(EXIT_FAILURE);
 	}
+	if(chunkSize < 1) {
+		std::cerr << "the chunk size must be positive" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	if(nThreads < 1) nThreads = 1;
 	
-	/*********** jets *******************************************/
-	
-	int maxNumberOfHJets = 2;
-	int maxNumberOfAJets = 20;
-	
-	Int_t nhJets;
-	Int_t naJets;
-	
-	Float_t hJet_pt[maxNumberOfHJets];
-	Float_t hJet_eta[maxNumberOfHJets];
-	Float_t hJet_csv[maxNumberOfHJets];
-	Float_t hJet_flavour[maxNumberOfHJets];
-	//Float_t hJet_phi[maxNumberOfHJets];
-	//Float_t hJet_e[maxNumberOfHJets];
-	//Float_t hJet_genPt[maxNumberOfHJets];
-	Float_t aJet_pt[maxNumberOfAJets];
-	Float_t aJet_eta[maxNumberOfAJets];
-	Float_t aJet_csv[maxNumberOfAJets];
-	Float_t aJet_flavour[maxNumberOfAJets];
-	//Float_t aJet_phi[maxNumberOfAJets];
-	//Float_t aJet_e[maxNumberOfAJets];
-	//Float_t aJet_genPt[maxNumberOfAJets];
-	
-	//Float_t hJet_csvGen[maxNumberOfHJets]; // SAMPLING
-	//Float_t aJet_csvGen[maxNumberOfAJets]; // SAMPLING
-	
-	//Long64_t hJet_csvN[maxNumberOfHJets]; // SAMPLING
-	//Long64_t aJet_csvN[maxNumberOfAJets]; // SAMPLING
-	
-	/*********** sample vars ************************************/
-	
-	//Float_t hJet_csvGen[maxNumberOfHJets];
-	//Float_t aJet_csvGen[maxNumberOfAJets];
-	
-	//Long64_t hJet_csvN[maxNumberOfHJets];
-	//Long64_t aJet_csvN[maxNumberOfAJets];
-	
-	/*********** leptons ****************************************/
-	
-	int maxVLeptons = 2;
-	int maxALeptons = 100; // there were up to40 leptons in the first 100k events
+	/*********** samples ****************************************/
 	
-	Int_t nvlep;
-	Int_t nalep;
+	// without a catalog the single input is processed as an unnamed sample and not scaled
+	SampleCatalog catalog = configFile.empty() ? SampleCatalog("", treeName, std::vector<std::string>(1, inFilename)) : SampleCatalog(configFile);
 	
-	Float_t vLepton_pt[maxVLeptons];
-	Float_t vLepton_eta[maxVLeptons];
-	Float_t vLepton_pfCombRelIso[maxVLeptons];
-	Int_t vLepton_type[maxVLeptons];
-	//Float_t vLepton_id80[maxVLeptons];
-	//Float_t vLepton_id95[maxVLeptons];
-	//Float_t vLepton_charge[maxVLeptons];
-	Float_t vLepton_idMVAtrig[maxVLeptons];
-	//Float_t vLepton_idMVAnotrig[maxVLeptons];
-	//Float_t vLepton_idMVApresel[maxVLeptons];
-	//Float_t vLepton_particleIso[maxVLeptons];
-	//Float_t vLepton_dxy[maxVLeptons];
-	//Float_t vLepton_innerHits[maxVLeptons];
-	
-	Float_t aLepton_pt[maxALeptons];
-	Float_t aLepton_eta[maxALeptons];
-	Float_t aLepton_pfCombRelIso[maxALeptons];
-	Int_t aLepton_type[maxALeptons];
-	//Float_t aLepton_id80[maxALeptons];
-	//Float_t aLepton_id95[maxALeptons];
-	//Float_t aLepton_charge[maxALeptons];
-	Float_t aLepton_idMVAtrig[maxALeptons];
-	//Float_t aLepton_idMVAnotrig[maxALeptons];
-	//Float_t aLepton_idMVApresel[maxALeptons];
-	//Float_t aLepton_particleIso[maxALeptons];
-	//Float_t aLepton_dxy[maxALeptons];
-	//Float_t aLepton_innerHits[maxALeptons];
-	
-	/*********** open files *************************************/
-	if(enableVerbose) std::cout << "Opening file " << inFilename << " ..." << std::endl;
-	TFile * in = TFile::Open(inFilename.c_str(), "read");
-	if(in -> IsZombie() || ! in -> IsOpen()) {
-		std::cerr << "Cannot open " << inFilename << "." << std::endl;
-		std::exit(EXIT_FAILURE);
+	struct Task {
+		std::size_t sample;
+		std::string filename;
+		std::string treeName;
+		Long64_t begin;
+		Long64_t end;
+	};
+	std::vector<Task> tasks;
+	Long64_t nTotal = 0;
+	for(std::size_t s = 0; s < catalog.size(); ++s) {
+		const SampleCatalog::Sample & sample = catalog.getSample(s);
+		for(auto & filename: sample.files) {
+			if(enableVerbose) std::cout << "Opening file " << filename << " ..." << std::endl;
+			TFile * in = TFile::Open(filename.c_str(), "read");
+			if(! in || in -> IsZombie() || ! in -> IsOpen()) {
+				std::cerr << "Cannot open " << filename << "." << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+			TTree * t = dynamic_cast<TTree *> (in -> Get(sample.treeName.c_str()));
+			if(! t) {
+				std::cerr << "Cannot access tree " << sample.treeName << " in " << filename << "." << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+			Long64_t end = (endEvent < 0 || endEvent > t -> GetEntries()) ? t -> GetEntries() : endEvent;
+			for(Long64_t first = beginEvent; first < end; first += chunkSize) {
+				Task task = { s, filename, sample.treeName, first, std::min(first + chunkSize, end) };
+				tasks.push_back(task);
+				nTotal += task.end - task.begin;
+			}
+			in -> Close();
+		}
 	}
-	if(enableVerbose) std::cout << "Accessing tree " << treeName << " ..." << std::endl;
-	TTree * t = dynamic_cast<TTree *> (in -> Get(treeName.c_str()));
-	if(enableVerbose) std::cout << "Creating file " << outFilename << " ..." << std::endl;
-	TFile * out = TFile::Open(outFilename.c_str(), "recreate");
 	
 	/*********** set up histograms ******************************/
 	
 	std::string ttbar_light = "ttbar+light", ttbar_cc = "ttbar+cc", ttbar_b = "ttbar+b", ttbar_bb = "ttbar+bb";
 	std::vector<std::string> labels = {ttbar_light, ttbar_cc, ttbar_b, ttbar_bb};
-	std::map<std::string, TH1F *> histoMap;
-	for(auto label: labels) {
-		histoMap[label] = new TH1F(label.c_str(), label.c_str(), 5, 5, 10);
-		histoMap[label] -> SetDirectory(out);
+	const Int_t nBins = 5;
+	const Double_t xMin = 5, xMax = 10;
+	// the tasks count the events per sample, category and bin (including under- and overflow)
+	struct SampleCounts {
+		std::vector<Long64_t> counts;
+		Long64_t nProcessed;
+		Long64_t nSelected;
+		Double_t busyTime;
+		Double_t cutTime, legacyCutTime; // --compare-cuts
+		Long64_t nDiffering;
+		std::chrono::steady_clock::time_point firstStart;
+		std::chrono::steady_clock::time_point lastEnd;
+		bool started;
+	};
+	std::vector<SampleCounts> sampleCounts(catalog.size());
+	for(auto & sc: sampleCounts) {
+		sc.counts.assign(labels.size() * (nBins + 2), 0);
+		sc.nProcessed = sc.nSelected = 0;
+		sc.busyTime = sc.cutTime = sc.legacyCutTime = 0;
+		sc.nDiffering = 0;
+		sc.started = false;
 	}
+	auto findBin = [nBins, xMin, xMax] (Double_t x) -> Int_t {
+		if(x < xMin) return 0;
+		if(x >= xMax) return nBins + 1;
+		return Int_t(nBins * (x - xMin) / (xMax - xMin)) + 1;
+	};
 	
-	
-	/*********** jet branches ***********************************/
-	
-	if(enableVerbose) std::cout << "Setting up branch addresses ..." << std::endl;
-	
-	t -> SetBranchAddress("nhJets", &nhJets);
-	t -> SetBranchAddress("hJet_pt", &hJet_pt);
-	t -> SetBranchAddress("hJet_eta", &hJet_eta);
-	t -> SetBranchAddress("hJet_flavour", &hJet_flavour);
-	//t -> SetBranchAddress("hJet_phi", &hJet_phi);
-	//t -> SetBranchAddress("hJet_e", &hJet_e);
-	//t -> SetBranchAddress("hJet_genPt", &hJet_genPt);
-	//t -> SetBranchAddress("hJet_csvGen", &hJet_csvGen); // SAMPLING
-	//t -> SetBranchAddress("hJet_csvN", &hJet_csvN); // SAMPLING
-	t -> SetBranchAddress("hJet_csv", &hJet_csv);
-	
-	t -> SetBranchAddress("naJets", &naJets);
-	t -> SetBranchAddress("aJet_pt", &aJet_pt);
-	t -> SetBranchAddress("aJet_eta", &aJet_eta);
-	t -> SetBranchAddress("aJet_flavour", &aJet_flavour);
-	//t -> SetBranchAddress("aJet_phi", &aJet_phi);
-	//t -> SetBranchAddress("aJet_e", &aJet_e);
-	//t -> SetBranchAddress("aJet_genPt", &aJet_genPt);
-	//t -> SetBranchAddress("aJet_csvGen", &aJet_csvGen); // SAMPLING
-	//t -> SetBranchAddress("aJet_csvN", &aJet_csvN); // SAMPLING
-	t -> SetBranchAddress("aJet_csv", &aJet_csv);
-	
-	/*********** lepton branches ********************************/
-	
-	t -> SetBranchAddress("nvlep", &nvlep);
-	t -> SetBranchAddress("nalep", &nalep);
-	
-	t -> SetBranchAddress("vLepton_pt", &vLepton_pt);
-	t -> SetBranchAddress("aLepton_pt", &aLepton_pt);
-	t -> SetBranchAddress("vLepton_eta", &vLepton_eta);
-	t -> SetBranchAddress("aLepton_eta", &aLepton_eta);
-	t -> SetBranchAddress("vLepton_pfCombRelIso", &vLepton_pfCombRelIso);
-	t -> SetBranchAddress("aLepton_pfCombRelIso", &aLepton_pfCombRelIso);
-	t -> SetBranchAddress("vLepton_type", &vLepton_type);
-	t -> SetBranchAddress("aLepton_type", &aLepton_type);
-	t -> SetBranchAddress("vLepton_idMVAtrig", &vLepton_idMVAtrig);
-	t -> SetBranchAddress("aLepton_idMVAtrig", &aLepton_idMVAtrig);
-	
-	/*********** loop over events *******************************/
-	
-	if(endEvent < 0) endEvent = t -> GetEntries();
-	Float_t CSVM = 0.679;
-	
-	boost::progress_display * show_progress;
+	/*********** cuts *******************************************/
+	
+	// the cuts of the analysis, replaced by those in [selection]; a loose lepton passes the loose cut but not the tight one
+	std::string tightLeptonCut = "(abs(type) == 11 && pt > 30 && abs(eta) < 2.5 && relIso < 0.10) || (abs(type) == 13 && pt > 26 && abs(eta) < 2.1 && relIso < 0.12)";
+	std::string looseLeptonCut = "(abs(type) == 11 && pt > 20 && abs(eta) < 2.5 && relIso < 0.15) || (abs(type) == 13 && pt > 20 && abs(eta) < 2.4 && relIso < 0.20)";
+	std::string jetCut = "pt > 30 && abs(eta) < 2.5";
+	std::string taggedJetCut = "csv >= 0.679";
+	Int_t nTightLeptons = 1, nLooseLeptons = 0, minJets = 5, minTags = 2;
+	if(cutsFile.empty()) cutsFile = configFile;
+	if(! cutsFile.empty()) {
+		boost::property_tree::ptree pt_ini;
+		boost::property_tree::read_ini(cutsFile, pt_ini);
+		auto read = [&pt_ini] (std::string key, std::string & value) -> void {
+			if(auto v = pt_ini.get_optional<std::string>("selection." + key)) {
+				value = v -> substr(0, v -> find(";")); // remove the comment
+				boost::algorithm::trim(value);
+			}
+		};
+		auto readCount = [&read] (std::string key, Int_t & count) -> void {
+			std::string value;
+			read(key, value);
+			if(! value.empty()) count = std::atoi(value.c_str());
+		};
+		read("tight_lepton", tightLeptonCut);
+		read("loose_lepton", looseLeptonCut);
+		read("jet", jetCut);
+		read("tagged_jet", taggedJetCut);
+		readCount("tight_leptons", nTightLeptons);
+		readCount("loose_leptons", nLooseLeptons);
+		readCount("min_jets", minJets);
+		readCount("min_tags", minTags);
+	}
+	// compiled once, shared (read-only) by the tasks
+	const CutExpression tightLepton(tightLeptonCut, EventBlock::getLeptonVariables());
+	const CutExpression looseLepton(looseLeptonCut, EventBlock::getLeptonVariables());
+	const CutExpression goodJet(jetCut, EventBlock::getJetVariables());
+	const CutExpression taggedJet(taggedJetCut, EventBlock::getJetVariables());
 	if(enableVerbose) {
-		Long64_t dif = endEvent - beginEvent;
-		std::cout << "Looping over " << dif << " events ... " << std::endl;
-		show_progress = new boost::progress_display(endEvent - beginEvent);
+		std::cout << "Selecting " << nTightLeptons << " tight lepton(s): " << tightLepton.getExpression() << std::endl
+				  << "          " << nLooseLeptons << " loose lepton(s): " << looseLepton.getExpression() << std::endl
+				  << "          >= " << minJets << " jets: " << goodJet.getExpression() << std::endl
+				  << "          >= " << minTags << " of them tagged: " << taggedJet.getExpression() << std::endl;
 	}
 	
+	/*********** loop over events *******************************/
+	
+	// the selection before CutExpression, with the cuts in the code (--compare-cuts)
 	std::string tight = "tight", loose = "loose";
 	std::string bKey = "b", cKey = "c", lKey = "l";
 	std::vector<std::string> flavorKeys = {bKey, cKey, lKey};
@@ -294,18 +444,16 @@ int main(int argc, char ** argv) {
 		return "";
 	};
 	
-	for(Long64_t i = beginEvent; i < endEvent; ++i) {
-		if(enableVerbose) ++(*show_progress);
-		
-		t -> GetEntry(i);
-		
+	// the category (index of labels) of the event, -1 if it doesn't pass the selection
+	Float_t CSVM = 0.679;
+	auto legacySelectEvent = [&] (EventBranches & ev, Int_t & sumOfJets) -> int {
 		LeptonCollection l_coll;
-		l_coll.add(nvlep, vLepton_pt, vLepton_eta, vLepton_pfCombRelIso, vLepton_type);
-		l_coll.add(nalep, aLepton_pt, aLepton_eta, aLepton_pfCombRelIso, aLepton_type);
+		l_coll.add(ev.nvlep, ev.vLepton_pt, ev.vLepton_eta, ev.vLepton_pfCombRelIso, ev.vLepton_type);
+		l_coll.add(ev.nalep, ev.aLepton_pt, ev.aLepton_eta, ev.aLepton_pfCombRelIso, ev.aLepton_type);
 		
 		JetCollection j_coll;
-		j_coll.add(nhJets, hJet_pt, hJet_eta, hJet_flavour, hJet_csv, "h");
-		j_coll.add(naJets, aJet_pt, aJet_eta, aJet_flavour, aJet_csv, "a");
+		j_coll.add(ev.nhJets, ev.hJet_pt, ev.hJet_eta, ev.hJet_flavour, ev.hJet_csv, "h");
+		j_coll.add(ev.naJets, ev.aJet_pt, ev.aJet_eta, ev.aJet_flavour, ev.aJet_csv, "a");
 		
 		l_coll.sortPt(); // sort by lepton pt (descending)
 		j_coll.sortPt(); // sort by jet pt (descending)
@@ -337,10 +485,10 @@ int main(int argc, char ** argv) {
 				break;
 			}
 		}
-		if(! proceed || leptons[tight] != 1 || leptons[loose] > 0) continue;
+		if(! proceed || leptons[tight] != 1 || leptons[loose] > 0) return -1;
 		
 		/********************** cut them jets ****************************/
-		if(j_coll.size() < 5) continue;
+		if(j_coll.size() < 5) return -1;
 		
 		std::vector<Jet> validJets;
 		std::vector<Jet> passedWP;
@@ -352,9 +500,9 @@ int main(int argc, char ** argv) {
 				}
 			}
 		}
-		int sumOfJets = validJets.size();
-		if(sumOfJets < 5) continue;
-		if(passedWP.size() < 2) continue;
+		sumOfJets = validJets.size();
+		if(sumOfJets < 5) return -1;
+		if(passedWP.size() < 2) return -1;
 		
 		/****************** identify b-tagged jets ****************************/
 		
@@ -372,22 +520,224 @@ int main(int argc, char ** argv) {
 			if(btagCounter == 2) break;
 		}
 		
-		if(histoVals[lKey] > 0) histoMap[ttbar_light] -> Fill(sumOfJets);
-		else if(histoVals[cKey] == 2) histoMap[ttbar_cc] -> Fill(sumOfJets);
-		else if(histoVals[bKey] == 1) histoMap[ttbar_b] -> Fill(sumOfJets);
-		else if(histoVals[bKey] == 2) histoMap[ttbar_bb] -> Fill(sumOfJets);
+		if(histoVals[lKey] > 0) return 0;
+		else if(histoVals[cKey] == 2) return 1;
+		else if(histoVals[bKey] == 1) return 2;
+		else if(histoVals[bKey] == 2) return 3;
+		return -1;
+	};
+	
+	// sets the category (index of labels, -1 if the event doesn't pass the selection) and the number of jets of every event
+	auto selectBlock = [&] (EventBlock & b) -> void {
+		b.categories.assign(b.nEvents, -1);
+		b.sumsOfJets.assign(b.nEvents, 0);
+		
+		/********************** lepton cut ************************/
+		
+		std::size_t nLeptons = b.leptonEvent.size();
+		const Float_t * leptonColumns[] = { b.leptons[0].data(), b.leptons[1].data(), b.leptons[2].data(), b.leptons[3].data(), b.leptons[4].data() };
+		b.candidates.resize(nLeptons);
+		b.tight.resize(nLeptons);
+		b.loose.resize(nLeptons);
+		for(std::size_t i = 0; i < nLeptons; ++i) b.candidates[i] = i;
+		std::size_t nTight = tightLepton.select(leptonColumns, b.candidates.data(), nLeptons, b.tight.data(), b.workspace);
+		std::size_t nNotTight = 0;
+		for(std::size_t i = 0, k = 0; i < nLeptons; ++i) {
+			if(k < nTight && b.tight[k] == i) ++k;
+			else b.candidates[nNotTight++] = i;
+		}
+		std::size_t nLoose = looseLepton.select(leptonColumns, b.candidates.data(), nNotTight, b.loose.data(), b.workspace);
+		b.nTight.assign(b.nEvents, 0);
+		b.nLoose.assign(b.nEvents, 0);
+		for(std::size_t k = 0; k < nTight; ++k) ++b.nTight[b.leptonEvent[b.tight[k]]];
+		for(std::size_t k = 0; k < nLoose; ++k) ++b.nLoose[b.leptonEvent[b.loose[k]]];
+		
+		/********************** cut them jets ****************************/
+		
+		// only the jets of the events passing the lepton cut
+		std::size_t nJets = b.jetEvent.size(), nCandidates = 0;
+		b.candidates.resize(nJets);
+		b.good.resize(nJets);
+		b.tagged.resize(nJets);
+		for(std::size_t e = 0; e < b.nEvents; ++e) {
+			if(b.nTight[e] != nTightLeptons || b.nLoose[e] != nLooseLeptons) continue;
+			if(Int_t(b.firstJet[e + 1] - b.firstJet[e]) < minJets) continue;
+			for(UInt_t j = b.firstJet[e]; j < b.firstJet[e + 1]; ++j) b.candidates[nCandidates++] = j;
+		}
+		const Float_t * jetColumns[] = { b.jets[0].data(), b.jets[1].data(), b.jets[2].data(), b.jets[3].data() };
+		std::size_t nGood = goodJet.select(jetColumns, b.candidates.data(), nCandidates, b.good.data(), b.workspace);
+		std::size_t nTagged = taggedJet.select(jetColumns, b.good.data(), nGood, b.tagged.data(), b.workspace);
+		b.nTags.assign(b.nEvents, 0);
+		for(std::size_t k = 0; k < nGood; ++k) ++b.sumsOfJets[b.jetEvent[b.good[k]]];
+		for(std::size_t k = 0; k < nTagged; ++k) ++b.nTags[b.jetEvent[b.tagged[k]]];
+		
+		/****************** identify b-tagged jets ****************************/
+		
+		// the two leading tagged jets of known flavour; the tagged jets of an event are consecutive
+		for(std::size_t e = 0, first = 0; e < b.nEvents; first += b.nTags[e], ++e) {
+			if(b.sumsOfJets[e] < minJets || b.nTags[e] < minTags) continue;
+			Int_t flavors[3] = { 0, 0, 0 }; // indices of getFlavorIndex(): c, b, light
+			Int_t btagCounter = 0;
+			for(std::size_t k = first; k < first + b.nTags[e] && btagCounter < 2; ++k) {
+				int flavor = getFlavorIndex(std::fabs(b.jets[3][b.tagged[k]])); // antiparticles
+				if(flavor < 0) continue;
+				++flavors[flavor];
+				++btagCounter;
+			}
+			if		(flavors[2] > 0) b.categories[e] = 0;
+			else if	(flavors[0] == 2) b.categories[e] = 1;
+			else if	(flavors[1] == 1) b.categories[e] = 2;
+			else if	(flavors[1] == 2) b.categories[e] = 3;
+		}
+	};
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+	ROOT::EnableThreadSafety();
+#else
+	TThread::Initialize();
+#endif
+	
+	boost::progress_display * show_progress;
+	if(enableVerbose) {
+		std::cout << "Looping over " << nTotal << " events of " << catalog.size() << " sample(s) in "
+				  << tasks.size() << " tasks on " << nThreads << " threads ... " << std::endl;
+		show_progress = new boost::progress_display(nTotal);
+	}
+	
+	// all samples share the pool, hence a small sample doesn't leave threads idle
+	std::mutex countsMutex;
+	ThreadPool pool(nThreads);
+	for(auto & task: tasks) {
+		pool.submit([&, task] () {
+			auto t0 = std::chrono::steady_clock::now();
+			std::vector<Long64_t> counts(labels.size() * (nBins + 2), 0);
+			Long64_t nSelected = 0;
+			Double_t cutTime = 0, legacyCutTime = 0;
+			Long64_t nDiffering = 0;
+			auto secondsSince = [] (std::chrono::steady_clock::time_point start) -> Double_t {
+				return std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - start).count();
+			};
+			{
+				TDirectory::TContext context;
+				TFile * in = TFile::Open(task.filename.c_str(), "read");
+				if(! in || in -> IsZombie() || ! in -> IsOpen()) {
+					std::cerr << "Cannot open " << task.filename << "." << std::endl;
+					std::exit(EXIT_FAILURE);
+				}
+				TTree * t = dynamic_cast<TTree *> (in -> Get(task.treeName.c_str()));
+				EventBranches ev;
+				ev.setBranchAddresses(t);
+				EventBlock block;
+				std::vector<Int_t> legacyCategories, legacySumsOfJets;
+				for(Long64_t first = task.begin; first < task.end; first += EventBlock::maxEvents) {
+					Long64_t last = std::min(first + EventBlock::maxEvents, task.end);
+					block.clear();
+					if(! compareCuts) {
+						for(Long64_t i = first; i < last; ++i) {
+							t -> GetEntry(i);
+							block.add(ev);
+						}
+						selectBlock(block);
+					}
+					else {
+						// both without the reading of the entries
+						legacyCategories.clear();
+						legacySumsOfJets.clear();
+						for(Long64_t i = first; i < last; ++i) {
+							t -> GetEntry(i);
+							auto start = std::chrono::steady_clock::now();
+							block.add(ev);
+							cutTime += secondsSince(start);
+							start = std::chrono::steady_clock::now();
+							Int_t sumOfJets = 0;
+							legacyCategories.push_back(legacySelectEvent(ev, sumOfJets));
+							legacySumsOfJets.push_back(sumOfJets);
+							legacyCutTime += secondsSince(start);
+						}
+						auto start = std::chrono::steady_clock::now();
+						selectBlock(block);
+						cutTime += secondsSince(start);
+						for(std::size_t e = 0; e < block.nEvents; ++e) {
+							if(block.categories[e] != legacyCategories[e]) ++nDiffering;
+							else if(block.categories[e] >= 0 && block.sumsOfJets[e] != legacySumsOfJets[e]) ++nDiffering;
+						}
+					}
+					for(std::size_t e = 0; e < block.nEvents; ++e) {
+						if(block.categories[e] < 0) continue;
+						++counts[block.categories[e] * (nBins + 2) + findBin(block.sumsOfJets[e])];
+						++nSelected;
+					}
+				}
+				in -> Close();
+				delete in;
+			}
+			auto t1 = std::chrono::steady_clock::now();
+			
+			std::lock_guard<std::mutex> lock(countsMutex);
+			SampleCounts & sc = sampleCounts[task.sample];
+			for(std::size_t b = 0; b < counts.size(); ++b) sc.counts[b] += counts[b];
+			sc.nProcessed += task.end - task.begin;
+			sc.nSelected += nSelected;
+			sc.busyTime += std::chrono::duration<Double_t>(t1 - t0).count();
+			sc.cutTime += cutTime;
+			sc.legacyCutTime += legacyCutTime;
+			sc.nDiffering += nDiffering;
+			if(! sc.started || t0 < sc.firstStart) sc.firstStart = t0;
+			if(! sc.started || t1 > sc.lastEnd) sc.lastEnd = t1;
+			sc.started = true;
+			if(enableVerbose) (*show_progress) += task.end - task.begin;
+		});
 	}
+	pool.wait();
 	
-	if(enableVerbose) std::cout << "Writing the histograms to " << outFilename << " ..." << std::endl;
-	for(auto & kv: histoMap) {
-		kv.second -> Write();
+	/*********** write the histograms ***************************/
+	
+	if(enableVerbose) std::cout << "Creating file " << outFilename << " ..." << std::endl;
+	TFile * out = TFile::Open(outFilename.c_str(), "recreate");
+	for(std::size_t s = 0; s < catalog.size(); ++s) {
+		const SampleCatalog::Sample & sample = catalog.getSample(s);
+		SampleCounts & sc = sampleCounts[s];
+		Double_t weight = catalog.getWeight(s, sc.nProcessed);
+		for(std::size_t c = 0; c < labels.size(); ++c) {
+			// a single unnamed sample keeps the names of the categories
+			std::string name = sample.name.empty() ? labels[c] : sample.name + "_" + labels[c];
+			std::string title = sample.name.empty() ? labels[c] : sample.name + " " + labels[c];
+			TH1F * h = new TH1F(name.c_str(), title.c_str(), nBins, xMin, xMax);
+			h -> SetDirectory(out);
+			h -> Sumw2();
+			Long64_t entries = 0;
+			for(Int_t b = 0; b <= nBins + 1; ++b) {
+				Long64_t n = sc.counts[c * (nBins + 2) + b];
+				h -> SetBinContent(b, weight * n);
+				h -> SetBinError(b, weight * std::sqrt(Double_t(n)));
+				entries += n;
+			}
+			h -> SetEntries(entries);
+			h -> Write();
+		}
+	}
+	
+	/*********** throughput *************************************/
+	
+	for(std::size_t s = 0; s < catalog.size(); ++s) {
+		const SampleCatalog::Sample & sample = catalog.getSample(s);
+		SampleCounts & sc = sampleCounts[s];
+		Double_t wall = sc.started ? std::chrono::duration<Double_t>(sc.lastEnd - sc.firstStart).count() : 0;
+		std::cout << (sample.name.empty() ? inFilename : sample.name) << ":\t"
+				  << sc.nProcessed << " events (" << sc.nSelected << " selected) in " << wall << " s, "
+				  << (wall > 0 ? sc.nProcessed / wall : 0) << " events/s (" << sc.busyTime << " s on all threads), "
+				  << "weight " << catalog.getWeight(s, sc.nProcessed) << std::endl;
+		if(compareCuts) {
+			std::cout << "\tcuts: " << sc.cutTime << " s (hand-written: " << sc.legacyCutTime << " s, "
+					  << (sc.cutTime > 0 ? sc.legacyCutTime / sc.cutTime : 0) << " times faster), "
+					  << sc.nDiffering << " events with a different result" << std::endl;
+		}
 	}
 	
 	/*********** close everything *******************************/
 	
-	if(enableVerbose) std::cout << "Closing " << inFilename << " and " << outFilename << " ..." << std::endl;
-	in -> Close();
+	if(enableVerbose) std::cout << "Closing " << outFilename << " ..." << std::endl;
 	out -> Close();
 	
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,191 @@
+#include <boost/program_options.hpp>
+#include <boost/progress.hpp>
+
+#include <iostream> // std::cout, std::cerr, std::endl
+#include <string> // std::string
+#include <vector> // std::vector<>
+#include <cstdlib> // EXIT_FAILURE, EXIT_SUCCESS
+#include <cstring> // std::strcmp()
+#include <stdexcept> // std::runtime_error
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TLeaf.h>
+
+#include "common.hpp"
+#include "EventReader.hpp"
+#include "SkimCache.hpp"
+
+int main(int argc, char ** argv) try {
+	
+	namespace po = boost::program_options;
+	
+	// command line option parsing
+	std::string input, treeName, output;
+	Long64_t beginEvent, endEvent;
+	Int_t requiredJets, readAhead;
+	std::vector<std::string> extraBranches;
+	bool enableVerbose = false;
+	try {
+		po::options_description desc("allowed options");
+		desc.add_options()
+			("help,h", "prints this message")
+			("input,i", po::value<std::string>(&input), "input *.root file")
+			("tree,t", po::value<std::string>(&treeName), "name of the tree")
+			("output,o", po::value<std::string>(&output), "output skim file")
+			("begin,b", po::value<Long64_t>(&beginEvent) -> default_value(0), "the event number to start with")
+			("end,e", po::value<Long64_t>(&endEvent) -> default_value(-1), "the event number to end with\ndefault (-1) means all events")
+			("Nj,j", po::value<Int_t>(&requiredJets) -> default_value(0), "minimum number of jets within the (flavor, pt, eta) bins")
+			("branches,B", po::value<std::vector<std::string> >(&extraBranches) -> multitoken(), "additional branches to be kept\n(e.g. hJet_csvGen aJet_csvGen btag_count)")
+			("read-ahead,R", po::value<Int_t>(&readAhead) -> default_value(4), "number of event blocks decoded ahead on a separate thread\n0 means synchronous reading")
+			("verbose,v", "verbose mode (enables progressbar)")
+		;
+		
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+		po::notify(vm);
+		
+		if(vm.count("help")) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_SUCCESS); // ugly
+		}
+		if(vm.count("input") == 0 || vm.count("tree") == 0 || vm.count("output") == 0) {
+			std::cout << desc << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if(vm.count("verbose")) {
+			enableVerbose = true;
+		}
+	}
+	catch(std::exception & e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		std::exit(EXIT_FAILURE); // ugly
+	}
+	catch(...) {
+		std::cerr << "exception of unkown type" << std::endl;
+	}
+	
+	// sanity check
+	if((endEvent >=0 && beginEvent > endEvent) || beginEvent < 0) {
+		std::cerr << "incorrect values for begin and/or end" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	
+	/*********** input ******************************************/
+	
+	if(enableVerbose) std::cout << "Opening file " << input << " ..." << std::endl;
+	TFile * in = TFile::Open(input.c_str(), "read");
+	if(! in || in -> IsZombie() || ! in -> IsOpen()) {
+		std::cerr << "Cannot open " << input << "." << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	TTree * t = dynamic_cast<TTree *> (in -> Get(treeName.c_str()));
+	if(! t) {
+		std::cerr << "Cannot access tree " << treeName << "." << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	
+	const int maxNumberOfHJets = 2;
+	const int maxNumberOfAJets = 20;
+	
+	Int_t nhJets, naJets;
+	Float_t hJet_pt[maxNumberOfHJets], hJet_eta[maxNumberOfHJets];
+	Float_t hJet_flavour[maxNumberOfHJets], hJet_csv[maxNumberOfHJets];
+	Float_t aJet_pt[maxNumberOfAJets], aJet_eta[maxNumberOfAJets];
+	Float_t aJet_flavour[maxNumberOfAJets], aJet_csv[maxNumberOfAJets];
+	Int_t hJet_binId[maxNumberOfHJets], aJet_binId[maxNumberOfAJets];
+	
+	EventReader reader(t, input, beginEvent, endEvent, readAhead);
+	endEvent = reader.getEndEvent();
+	SkimCache::Writer writer(output);
+	
+	reader.setBranchAddress("nhJets", &nhJets);
+	reader.setBranchAddress("naJets", &naJets);
+	reader.setBranchAddress("hJet_pt", &hJet_pt);
+	reader.setBranchAddress("hJet_eta", &hJet_eta);
+	reader.setBranchAddress("hJet_flavour", &hJet_flavour);
+	reader.setBranchAddress("hJet_csv", &hJet_csv);
+	reader.setBranchAddress("aJet_pt", &aJet_pt);
+	reader.setBranchAddress("aJet_eta", &aJet_eta);
+	reader.setBranchAddress("aJet_flavour", &aJet_flavour);
+	reader.setBranchAddress("aJet_csv", &aJet_csv);
+	
+	writer.addColumn("nhJets", SkimCache::kEvent, sizeof(Int_t), &nhJets);
+	writer.addColumn("naJets", SkimCache::kEvent, sizeof(Int_t), &naJets);
+	writer.addColumn("hJet_pt", SkimCache::kHJet, sizeof(Float_t), hJet_pt);
+	writer.addColumn("hJet_eta", SkimCache::kHJet, sizeof(Float_t), hJet_eta);
+	writer.addColumn("hJet_flavour", SkimCache::kHJet, sizeof(Float_t), hJet_flavour);
+	writer.addColumn("hJet_csv", SkimCache::kHJet, sizeof(Float_t), hJet_csv);
+	writer.addColumn("hJet_binId", SkimCache::kHJet, sizeof(Int_t), hJet_binId);
+	writer.addColumn("aJet_pt", SkimCache::kAJet, sizeof(Float_t), aJet_pt);
+	writer.addColumn("aJet_eta", SkimCache::kAJet, sizeof(Float_t), aJet_eta);
+	writer.addColumn("aJet_flavour", SkimCache::kAJet, sizeof(Float_t), aJet_flavour);
+	writer.addColumn("aJet_csv", SkimCache::kAJet, sizeof(Float_t), aJet_csv);
+	writer.addColumn("aJet_binId", SkimCache::kAJet, sizeof(Int_t), aJet_binId);
+	
+	// additional branches: scalars or arrays counted by nhJets/naJets
+	std::vector<std::vector<Long64_t> > extraBuffers(extraBranches.size(), std::vector<Long64_t>(maxNumberOfAJets));
+	for(std::size_t i = 0; i < extraBranches.size(); ++i) {
+		const std::string & name = extraBranches[i];
+		TLeaf * leaf = t -> GetLeaf(name.c_str());
+		if(! leaf) {
+			std::cerr << "no branch " << name << " in tree " << treeName << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		Int_t kind = SkimCache::kEvent;
+		if(leaf -> GetLeafCount()) {
+			if(std::strcmp(leaf -> GetLeafCount() -> GetName(), "nhJets") == 0) 		kind = SkimCache::kHJet;
+			else if(std::strcmp(leaf -> GetLeafCount() -> GetName(), "naJets") == 0) 	kind = SkimCache::kAJet;
+			else {
+				std::cerr << "branch " << name << " must be counted by nhJets or naJets" << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+		}
+		else if(leaf -> GetLenStatic() != 1) {
+			std::cerr << "branch " << name << " is a fixed-size array" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		Int_t size = leaf -> GetLenType();
+		reader.setBranchAddress(name, extraBuffers[i].data(), kind == SkimCache::kEvent ? size : extraBuffers[i].size() * sizeof(Long64_t));
+		writer.addColumn(name, kind, size, extraBuffers[i].data());
+	}
+	
+	/*********** loop over events *******************************/
+	
+	boost::progress_display * show_progress;
+	if(enableVerbose) {
+		Long64_t dif = endEvent - beginEvent;
+		std::cout << "Looping over " << dif << " events ... " << std::endl;
+		show_progress = new boost::progress_display(dif);
+	}
+	
+	Long64_t nSelected = 0;
+	while(reader.next()) {
+		if(enableVerbose) ++(*show_progress);
+		
+		Int_t passedJets = 0;
+		for(Int_t j = 0; j < nhJets; ++j) {
+			hJet_binId[j] = getBinId(hJet_flavour[j], hJet_pt[j], hJet_eta[j]);
+			if(hJet_binId[j] != -1) ++passedJets;
+		}
+		for(Int_t j = 0; j < naJets; ++j) {
+			aJet_binId[j] = getBinId(aJet_flavour[j], aJet_pt[j], aJet_eta[j]);
+			if(aJet_binId[j] != -1) ++passedJets;
+		}
+		if(passedJets < requiredJets) continue;
+		
+		writer.fill(nhJets, naJets);
+		++nSelected;
+	}
+	
+	if(enableVerbose) std::cout << "Writing " << nSelected << " events to " << output << " ..." << std::endl;
+	writer.close();
+	
+	in -> Close();
+	
+	return EXIT_SUCCESS;
+}
+catch(std::runtime_error & e) { // EventReader and SkimCache throw, for the daemon
+	std::cerr << e.what() << std::endl;
+	return EXIT_FAILURE;
+}
@@ -3,6 +3,9 @@
 #include <cstdlib> // EXIT_SUCCESS, std::exit
 #include <iostream> // std::cout, std::cerr, std::endl
 #include <vector> // std::vector<>
+#include <map> // std::multimap<>
+#include <utility> // std::make_pair()
+#include <algorithm> // std::max()
 
 #include <TFile.h>
 #include <TH1F.h>
@@ -78,32 +81,28 @@ int main(int argc, char ** argv) {
 		std::exit(EXIT_FAILURE);
 	}
 	
-	std::vector<Int_t> colors = { kRed + 2, kRed + 3, kRed + 1, kRed - 7 };
+	std::vector<Int_t> colors = { kRed + 2, kRed + 3, kRed + 1, kRed - 7, kAzure + 2, kAzure - 4, kGreen + 2, kGreen - 6, kOrange + 1, kViolet - 5 };
 	THStack * stack = new THStack("sh", "Multiplicity of jets");
 	TCanvas canvas("c", "canvas", dimX, dimY);
 	canvas.SetRightMargin(0.05);
-	TLegend * legend = new TLegend(0.8, 0.75, 0.9, 0.9);
 	TIter next(in -> GetListOfKeys());
 	TKey * key;
-	int histoIndex = 0;
-	std::vector<TH1F *> histoVector;
-	std::map<Double_t, int> histoIndices;
+	// the histograms are already normalized (see selection.cpp), the smallest ones are stacked first
+	std::multimap<Double_t, TH1F *> histos;
 	while((key = dynamic_cast<TKey *>(next()))) {
 		TClass * cl = gROOT -> GetClass(key -> GetClassName());
 		if(! cl -> InheritsFrom("TH1F")) continue;
 		TH1F * h = dynamic_cast<TH1F *> (key -> ReadObj());
-		histoVector.push_back(h);
-		histoIndices[h -> GetEntries()] = histoIndex++;
+		histos.insert(std::make_pair(h -> Integral(), h));
 	}
-	histoIndex = 1;
-	Float_t nominator = 107.66 * 19.5 * 1000;
-	for(auto kv: histoIndices) {
-		//histoVector[kv.second] -> Scale(nominator / histoVector[kv.second] -> Integral());
-		histoVector[kv.second] -> SetFillColor(colors[histoIndex++]);
-		//histoVector[kv.second] -> SetLineWidth(1);
-		histoVector[kv.second] -> SetLineColor(colors[histoIndex]);
-		stack -> Add(histoVector[kv.second]);
-		legend -> AddEntry(histoVector[kv.second], histoVector[kv.second] -> GetName());
+	TLegend * legend = new TLegend(0.8, std::max(0.1, 0.9 - 0.0375 * histos.size()), 0.9, 0.9);
+	std::size_t histoIndex = 0;
+	for(auto kv: histos) {
+		kv.second -> SetFillColor(colors[histoIndex % colors.size()]);
+		kv.second -> SetLineColor(colors[(histoIndex + 1) % colors.size()]);
+		++histoIndex;
+		stack -> Add(kv.second);
+		legend -> AddEntry(kv.second, kv.second -> GetTitle());
 	}
 	if(useLogy) {
 		canvas.SetLogy(1);
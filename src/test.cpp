@@ -2,34 +2,47 @@
 
 #include <cstdlib> // EXIT_SUCCESS
 #include <string> // std::string
+#include <vector> // std::vector<>
 #include <iostream> // std::cout
 #include <sstream> // std::stringstream
 #include <streambuf> // std::streambuf
 #include <fstream> // std::ofstream
+#include <memory> // std::unique_ptr<>
+#include <thread> // std::thread::hardware_concurrency()
+#include <cmath> // std::abs()
+#include <algorithm> // std::max()
 
 #include <TFile.h>
 #include <TH1F.h>
 #include <TString.h>
 
 #include "common.hpp"
+#include "BinnedHistograms.hpp"
+#include "ThreadPool.hpp"
 
 int main(int argc, char ** argv) {
 	
 	namespace po = boost::program_options;
 	
-	std::string input_1, input_2, outFile;
-	bool doKolmogorov = false, doChi2 = false, doTexFormat = false;
+	std::string input_1, outFile, csvFile, texFile;
+	std::vector<std::string> inputs_2;
+	unsigned nThreads;
+	bool doKolmogorov = false, doChi2 = false, doTexFormat = false, doValidate = false;
 	
 	try {
 		po::options_description desc("allowed options");
 		desc.add_options()
 			("help,h", "prints this message")
 			("input1,i", po::value<std::string>(&input_1), "the first input *.root file")
-			("input2,j", po::value<std::string>(&input_2), "the second input *.root file")
+			("input2,j", po::value<std::vector<std::string> >(&inputs_2) -> multitoken(), "the second input *.root file(s)\neach one is compared to the first input")
 			("out,o", po::value<std::string>(&outFile), "output file; if not set, print to stdout")
 			("tex,t", "formats the output to tex table format")
+			("csv-out", po::value<std::string>(&csvFile), "also write the csv table to this file")
+			("tex-out", po::value<std::string>(&texFile), "also write the tex table to this file")
 			("use-kolmogorov,K", "Kolmogorov test")
 			("use-chi2,C", "Chi2 test")
+			("threads,n", po::value<unsigned>(&nThreads) -> default_value(std::thread::hardware_concurrency()), "number of threads")
+			("validate,V", "repeat the tests with TH1::KolmogorovTest() and TH1::Chi2Test() and report the largest difference")
 		;
 		
 		po::variables_map vm;
@@ -53,7 +66,10 @@ int main(int argc, char ** argv) {
 		if(vm.count("tex")) {
 			doTexFormat = true;
 		}
-		if(vm.count("use-kolmogorov") == 0 && vm.count("use-chi2")) {
+		if(vm.count("validate")) {
+			doValidate = true;
+		}
+		if(vm.count("use-kolmogorov") == 0 && vm.count("use-chi2") == 0) {
 			std::cout << "You must specify at least one test." << std::endl;
 			std::cout << desc << std::endl;
 			std::exit(EXIT_FAILURE);
@@ -66,60 +82,108 @@ int main(int argc, char ** argv) {
 	catch(...) {
 		std::cerr << "exception of unkown type" << std::endl;
 	}
+	if(nThreads < 1) nThreads = 1;
 	
-	TFile * df = TFile::Open(input_1.c_str(), "read");
-	TFile * sf = TFile::Open(input_2.c_str(), "read");
-	if(df -> IsZombie() || ! df -> IsOpen()) {
-		std::cerr << "error on opening " << input_1 << std::endl;
-		std::exit(EXIT_FAILURE);
-	}
-	if(sf -> IsZombie() || ! sf -> IsOpen()) {
-		std::cerr << "error on opening " << input_2 << std::endl;
-		std::exit(EXIT_FAILURE);
+	/*********** read the histograms ****************************/
+	
+	std::vector<std::string> names;
+	std::vector<std::string> texNames;
+	for(int i = 0; i < 3; ++i) {
+		for(int j = 0; j < 6; ++j) {
+			for(int k = 0; k < 3; ++k) {
+				names.push_back(getName(i, j, k));
+				texNames.push_back(getTexTableFormat(i, j, k));
+			}
+		}
 	}
+	const Double_t normalization = float(1e5);
 	
-	std::stringstream ss;
-	if(doTexFormat) {
-		ss << "flavor & $p_t$ range (GeV) & $\\eta$ range";
-		if(doKolmogorov) ss << " & \\mcell{Kolmogorov-Smirnov\\\\test statistic}";
-		if(doChi2) ss << "& \\mcell{$\\chi^2$ test\\\\$p$-value} \\\\ \\hline";
+	// every file is read exactly once; the tests only touch the bin arrays
+	BinnedHistograms first(input_1, names, normalization);
+	std::vector<std::unique_ptr<BinnedHistograms> > seconds;
+	for(auto & input_2: inputs_2) {
+		seconds.emplace_back(new BinnedHistograms(input_2, names, normalization));
 	}
-	else {
-		ss << "histogram";
-		if(doKolmogorov) ss << ",kolmogorov";
-		if(doChi2) ss << ",chi2";
+	
+	/*********** run the tests **********************************/
+	
+	const std::size_t nHistograms = names.size();
+	std::vector<Double_t> kolmoVals(seconds.size() * nHistograms), chi2Vals(seconds.size() * nHistograms);
+	{
+		ThreadPool pool(nThreads);
+		for(std::size_t v = 0; v < seconds.size(); ++v) {
+			pool.submit([&, v] () {
+				for(std::size_t h = 0; h < nHistograms; ++h) {
+					if(doKolmogorov) kolmoVals[v * nHistograms + h] = BinnedHistograms::kolmogorovTest(first, *seconds[v], h);
+					if(doChi2) chi2Vals[v * nHistograms + h] = BinnedHistograms::chi2Test(first, *seconds[v], h);
+				}
+			});
+		}
+		pool.wait();
 	}
-	ss << std::endl;
 	
-	for(int i = 0; i < 3; ++i) {
-		for(int j = 0; j < 6; ++j) {
-			for(int k = 0; k < 3; ++k) {
-				std::string hname = getName(i, j, k);
-				TH1F * dh = dynamic_cast<TH1F *> (df -> Get(hname.c_str()));
-				TH1F * sh = dynamic_cast<TH1F *> (sf -> Get(hname.c_str()));
+	if(doValidate) {
+		Double_t maxKolmoDiff = 0, maxChi2Diff = 0;
+		TFile * df = TFile::Open(input_1.c_str(), "read");
+		for(std::size_t v = 0; v < seconds.size(); ++v) {
+			TFile * sf = TFile::Open(inputs_2[v].c_str(), "read");
+			for(std::size_t h = 0; h < nHistograms; ++h) {
+				TH1F * dh = dynamic_cast<TH1F *> (df -> Get(names[h].c_str()));
+				TH1F * sh = dynamic_cast<TH1F *> (sf -> Get(names[h].c_str()));
 				dh -> Scale(float(1e5) / dh -> Integral());
 				sh -> Scale(float(1e5) / sh -> Integral());
-				if(doTexFormat) ss << getTexTableFormat(i, j, k);
-				else 			ss << hname;
-				if(doKolmogorov) {
-					Double_t kolmoVal = dh -> KolmogorovTest(sh);
-					if(doTexFormat) ss << " & " << std::fixed << kolmoVal;
-					else 			ss << "," << std::fixed << kolmoVal;
-				}
-				if(doChi2) {
-					Double_t chi2Val = dh -> Chi2Test(sh, "UU");
-					if(doTexFormat) ss << " & " << std::fixed << chi2Val;
-					else 			ss << "," << std::fixed << chi2Val;
-				}
-				if(doTexFormat) ss << " \\\\";
-				ss << std::endl;
+				if(doKolmogorov) maxKolmoDiff = std::max(maxKolmoDiff, std::abs(dh -> KolmogorovTest(sh) - kolmoVals[v * nHistograms + h]));
+				if(doChi2) maxChi2Diff = std::max(maxChi2Diff, std::abs(dh -> Chi2Test(sh, "UU") - chi2Vals[v * nHistograms + h]));
 				delete dh;
 				delete sh;
 			}
+			sf -> Close();
+		}
+		df -> Close();
+		std::cerr << "largest difference to ROOT:";
+		if(doKolmogorov) std::cerr << " kolmogorov " << maxKolmoDiff;
+		if(doChi2) std::cerr << " chi2 " << maxChi2Diff;
+		std::cerr << std::endl;
+		if(maxKolmoDiff > 1e-6 || maxChi2Diff > 1e-6) {
+			std::cerr << "validation failed" << std::endl;
+			std::exit(EXIT_FAILURE);
 		}
 	}
-	df -> Close();
-	sf -> Close();
+	
+	/*********** write the tables *******************************/
+	
+	// with several second inputs the csv table gets a file column and the tex table a comment per file
+	const bool severalInputs = seconds.size() > 1;
+	auto table = [&] (bool tex) -> std::string {
+		std::stringstream ss;
+		if(tex) {
+			ss << "flavor & $p_t$ range (GeV) & $\\eta$ range";
+			if(doKolmogorov) ss << " & \\mcell{Kolmogorov-Smirnov\\\\test statistic}";
+			if(doChi2) ss << "& \\mcell{$\\chi^2$ test\\\\$p$-value} \\\\ \\hline";
+		}
+		else {
+			if(severalInputs) ss << "file,";
+			ss << "histogram";
+			if(doKolmogorov) ss << ",kolmogorov";
+			if(doChi2) ss << ",chi2";
+		}
+		ss << std::endl;
+		for(std::size_t v = 0; v < seconds.size(); ++v) {
+			if(tex && severalInputs) ss << "% " << inputs_2[v] << std::endl;
+			for(std::size_t h = 0; h < nHistograms; ++h) {
+				if(tex) ss << texNames[h];
+				else {
+					if(severalInputs) ss << inputs_2[v] << ",";
+					ss << names[h];
+				}
+				if(doKolmogorov) ss << (tex ? " & " : ",") << std::fixed << kolmoVals[v * nHistograms + h];
+				if(doChi2) ss << (tex ? " & " : ",") << std::fixed << chi2Vals[v * nHistograms + h];
+				if(tex) ss << " \\\\";
+				ss << std::endl;
+			}
+		}
+		return ss.str();
+	};
 	
 	std::streambuf * buf;
 	std::ofstream of;
@@ -132,7 +196,15 @@ int main(int argc, char ** argv) {
 	}
 	std::ostream out(buf);
 	
-	out << ss.str();
+	out << table(doTexFormat);
+	if(! csvFile.empty()) {
+		std::ofstream csv(csvFile);
+		csv << table(false);
+	}
+	if(! texFile.empty()) {
+		std::ofstream tex(texFile);
+		tex << table(true);
+	}
 	
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}